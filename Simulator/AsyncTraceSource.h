@@ -0,0 +1,259 @@
+// -----------------------------------------------------------------------------
+// File: AsyncTraceSource.h
+// Description:
+//    Defines a trace source that decompresses and decodes another source on a
+//    helper thread. The helper fills fixed size batches of records into a
+//    single-producer/single-consumer ring and the simulation thread only
+//    copies records out of it. Either side blocks while the ring is full
+//    (helper) or empty (simulation thread) and is woken by the other.
+// -----------------------------------------------------------------------------
+
+#ifndef __ASYNC_TRACE_SOURCE_H__
+#define __ASYNC_TRACE_SOURCE_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "Types.h"
+#include "TraceSource.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <pthread.h>
+#include <cstdio>
+#include <cstdlib>
+
+// records in a batch and batches in the ring
+#define ASYNC_TRACE_BATCH 4096
+#define ASYNC_TRACE_SLOTS 8
+
+
+// -----------------------------------------------------------------------------
+// Class: AsyncTraceSource
+// Description:
+//    Reads another source ahead on a helper thread. At the end of the trace
+//    the helper marks the last batch and goes on with the next pass right
+//    away, as the trace reader always rewinds after the end. If a pass has no
+//    records the helper stops.
+// -----------------------------------------------------------------------------
+
+class AsyncTraceSource : public TraceSource {
+
+  protected:
+
+    struct Batch {
+      uint32 count;
+      bool end;
+      TraceRecord records[ASYNC_TRACE_BATCH];
+    };
+
+    // the source being read (owned)
+    TraceSource *_source;
+
+    // ring of batches. _head is moved by the helper only, _tail by the
+    // simulation thread only, both under _lock. _notFull and _notEmpty wake
+    // the helper and the simulation thread.
+    Batch *_slots;
+    uint32 _head;
+    uint32 _tail;
+    bool _stop;
+    bool _exited;
+    pthread_mutex_t _lock;
+    pthread_cond_t _notFull;
+    pthread_cond_t _notEmpty;
+
+    pthread_t _thread;
+    bool _running;
+
+    // batch being read by the simulation thread
+    Batch *_current;
+    uint32 _pos;
+    bool _atEnd;
+
+
+    // -------------------------------------------------------------------------
+    // Helper thread
+    // -------------------------------------------------------------------------
+
+    static void *Run(void *arg) {
+      ((AsyncTraceSource *)arg) -> Produce();
+      return NULL;
+    }
+
+    void Produce() {
+
+      uint64 passRecords = 0;
+
+      pthread_mutex_lock(&_lock);
+      while (true) {
+
+        // wait for a free slot
+        while (!_stop && _head - _tail == ASYNC_TRACE_SLOTS)
+          pthread_cond_wait(&_notFull, &_lock);
+        if (_stop)
+          break;
+        uint32 head = _head;
+        pthread_mutex_unlock(&_lock);
+
+        // fill the batch
+        Batch &batch = _slots[head % ASYNC_TRACE_SLOTS];
+        batch.count = _source -> NextBatch(batch.records, ASYNC_TRACE_BATCH);
+        batch.end = false;
+        passRecords += batch.count;
+        if (batch.count < ASYNC_TRACE_BATCH)
+          batch.end = true;
+
+        // start the next pass
+        bool last = false;
+        if (batch.end) {
+          if (passRecords == 0)
+            last = true;
+          else
+            _source -> Rewind();
+          passRecords = 0;
+        }
+
+        // publish the batch
+        pthread_mutex_lock(&_lock);
+        _head = head + 1;
+        pthread_cond_signal(&_notEmpty);
+        if (last)
+          break;
+      }
+
+      _exited = true;
+      pthread_mutex_unlock(&_lock);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Functions to start and stop the helper
+    // -------------------------------------------------------------------------
+
+    void Start() {
+      _head = _tail = 0;
+      _stop = false;
+      _exited = false;
+      _current = NULL;
+      _pos = 0;
+      _atEnd = false;
+      if (pthread_create(&_thread, NULL, Run, this) != 0) {
+        fprintf(stderr, "Error: cannot create the trace reader thread\n");
+        exit(-1);
+      }
+      _running = true;
+    }
+
+    void Stop() {
+      if (!_running) return;
+      pthread_mutex_lock(&_lock);
+      _stop = true;
+      pthread_cond_signal(&_notFull);
+      pthread_mutex_unlock(&_lock);
+      pthread_join(_thread, NULL);
+      _running = false;
+    }
+
+
+  public:
+
+    // -------------------------------------------------------------------------
+    // Constructor. Takes over the source.
+    // -------------------------------------------------------------------------
+
+    AsyncTraceSource(TraceSource *source) {
+      _source = source;
+      _slots = new Batch[ASYNC_TRACE_SLOTS];
+      _running = false;
+      pthread_mutex_init(&_lock, NULL);
+      pthread_cond_init(&_notFull, NULL);
+      pthread_cond_init(&_notEmpty, NULL);
+      Start();
+    }
+
+    ~AsyncTraceSource() {
+      Stop();
+      pthread_cond_destroy(&_notEmpty);
+      pthread_cond_destroy(&_notFull);
+      pthread_mutex_destroy(&_lock);
+      delete [] _slots;
+      delete _source;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to get the next record
+    // -------------------------------------------------------------------------
+
+    bool Next(TraceRecord &record) {
+
+      if (_atEnd)
+        return false;
+
+      while (true) {
+
+        // get the next batch
+        if (_current == NULL) {
+          pthread_mutex_lock(&_lock);
+          while (_head == _tail)
+            pthread_cond_wait(&_notEmpty, &_lock);
+          pthread_mutex_unlock(&_lock);
+          _current = &_slots[_tail % ASYNC_TRACE_SLOTS];
+          _pos = 0;
+        }
+
+        if (_pos < _current -> count) {
+          record = _current -> records[_pos ++];
+          return true;
+        }
+
+        // release the batch
+        bool end = _current -> end;
+        _current = NULL;
+        pthread_mutex_lock(&_lock);
+        _tail ++;
+        pthread_cond_signal(&_notFull);
+        pthread_mutex_unlock(&_lock);
+        if (end) {
+          _atEnd = true;
+          return false;
+        }
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to go back to the first record. At the end of the trace the
+    // helper is already reading the next pass; anywhere else (or if it has
+    // stopped) it is restarted from the start of the source.
+    // -------------------------------------------------------------------------
+
+    void Rewind() {
+      pthread_mutex_lock(&_lock);
+      bool exited = _exited;
+      pthread_mutex_unlock(&_lock);
+      if (_atEnd && !exited) {
+        _atEnd = false;
+        return;
+      }
+      Stop();
+      _source -> Rewind();
+      Start();
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to seek. The helper is restarted from the new position.
+    // -------------------------------------------------------------------------
+
+    void Seek(uint64 icount) {
+      Stop();
+      _source -> Seek(icount);
+      Start();
+    }
+};
+
+#endif // __ASYNC_TRACE_SOURCE_H__
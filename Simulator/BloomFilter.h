@@ -12,6 +12,7 @@
 // -----------------------------------------------------------------------------
 
 #include "Types.h"
+#include "Checkpoint.h"
 
 // -----------------------------------------------------------------------------
 // Standard includes
@@ -204,6 +205,18 @@ public:
   }
 
 
+  // ---------------------------------------------------------------------------
+  // save or restore the filter (the hash functions come from the parameters)
+  // ---------------------------------------------------------------------------
+
+  void CheckpointState(CheckpointFile &cp) {
+    CheckpointTransfer(cp, _filter);
+    CheckpointTransfer(cp, _numElements);
+    CheckpointTransfer(cp, _falsePositives);
+    CheckpointTransfer(cp, _tests);
+  }
+
+
   virtual void compute_hash_functions() {
     srand(RAND_SEED);
       
@@ -263,6 +263,18 @@ public:
   TableEntry force_evict(uint32 index) {
     return _sets[index].force_evict();
   }
+
+
+  // -------------------------------------------------------------------------
+  // Function to save or restore the tag store
+  // -------------------------------------------------------------------------
+
+  void CheckpointState(CheckpointFile &cp) {
+    cp.Size(_numSets, "a tag store");
+    cp.Marker(_policy);
+    for (uint32 i = 0; i < _numSets; i ++)
+      _sets[i].CheckpointState(cp);
+  }
 };
 
 #endif // __BYPASS_TAGSTORE_H__
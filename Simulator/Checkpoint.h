@@ -0,0 +1,400 @@
+// -----------------------------------------------------------------------------
+// File: Checkpoint.h
+// Description:
+//    Defines the checkpoint file, used to save the state of a simulation
+//    after warm up and to start other simulations from it. The same code
+//    saves and restores: each class has a CheckpointState function that
+//    passes its fields to CheckpointTransfer, which writes them when saving
+//    and reads them back when restoring.
+//
+//    Plain data is copied as it is (this is checked at compile time);
+//    strings and the standard containers are written element by element.
+//    A vector that is already sized when it is restored (a structure sized
+//    by the configuration) must get the same number of elements, otherwise
+//    the checkpoint does not fit the simulator and restoring stops.
+//
+//    Objects held by several structures (memory requests) are written once
+//    and referred to by number afterwards, so they are shared again when
+//    restored. Pointers to fixed objects (the components) are written as
+//    their index among the registered targets.
+// -----------------------------------------------------------------------------
+
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "Types.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <zlib.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <set>
+#include <utility>
+#include <algorithm>
+
+using namespace std;
+
+#define CHECKPOINT_MAGIC "MSCHKPNT"
+#define CHECKPOINT_VERSION 5
+
+
+// -----------------------------------------------------------------------------
+// Class: CheckpointFile
+// Description:
+//    A checkpoint being saved or restored
+// -----------------------------------------------------------------------------
+
+class CheckpointFile {
+
+  protected:
+
+    gzFile _file;
+    string _fileName;
+    bool _restoring;
+
+    // shared objects seen so far (numbered from 1 in the order they are
+    // written)
+    map <void *, uint64> _objectIDs;
+    vector <void *> _objects;
+
+    // fixed objects pointers can refer to
+    vector <void *> _targets;
+
+  public:
+
+    CheckpointFile() {
+      _file = NULL;
+      _restoring = false;
+    }
+
+    ~CheckpointFile() {
+      Close();
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Functions to open a checkpoint to save or to restore. Return false if
+    // the file cannot be opened or is not a checkpoint.
+    // -------------------------------------------------------------------------
+
+    bool OpenForSave(string fileName) {
+      _fileName = fileName;
+      _restoring = false;
+      _file = gzopen(fileName.c_str(), "wb1");
+      if (_file == NULL)
+        return false;
+      uint32 version = CHECKPOINT_VERSION;
+      Bytes((void *)CHECKPOINT_MAGIC, 8);
+      Bytes(&version, sizeof(version));
+      return true;
+    }
+
+    bool OpenForRestore(string fileName) {
+      _fileName = fileName;
+      _restoring = true;
+      _file = gzopen(fileName.c_str(), "rb");
+      if (_file == NULL)
+        return false;
+      char magic[8];
+      uint32 version;
+      if (gzread(_file, magic, 8) != 8 ||
+          memcmp(magic, CHECKPOINT_MAGIC, 8) != 0 ||
+          gzread(_file, &version, sizeof(version)) != sizeof(version) ||
+          version != CHECKPOINT_VERSION) {
+        Close();
+        return false;
+      }
+      return true;
+    }
+
+    void Close() {
+      if (_file != NULL) {
+        if (gzclose(_file) != Z_OK && !_restoring) {
+          fprintf(stderr, "Error: cannot write the checkpoint `%s'\n",
+              _fileName.c_str());
+          exit(-1);
+        }
+        _file = NULL;
+      }
+    }
+
+    bool Restoring() {
+      return _restoring;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to write or read raw bytes
+    // -------------------------------------------------------------------------
+
+    void Bytes(void *data, size_t size) {
+      if (size == 0)
+        return;
+      int done = _restoring ? gzread(_file, data, size) :
+        gzwrite(_file, data, size);
+      if (done != (int)size) {
+        fprintf(stderr, "Error: cannot %s the checkpoint `%s'\n",
+            _restoring ? "read" : "write", _fileName.c_str());
+        exit(-1);
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to write or check a marker (a component name, a definition),
+    // so that a checkpoint restored into another simulator is refused
+    // -------------------------------------------------------------------------
+
+    void Marker(string marker) {
+      uint32 length = marker.size();
+      Bytes(&length, sizeof(length));
+      if (!_restoring) {
+        Bytes((void *)marker.data(), length);
+        return;
+      }
+      string saved(length, ' ');
+      Bytes(&saved[0], length);
+      if (saved != marker) {
+        fprintf(stderr, "Error: checkpoint `%s' does not fit this simulator "
+            "(found `%s' where `%s' was expected)\n", _fileName.c_str(),
+            saved.c_str(), marker.c_str());
+        exit(-1);
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to write or check the size of a structure sized by the
+    // configuration
+    // -------------------------------------------------------------------------
+
+    void Size(uint64 size, const char *what) {
+      uint64 saved = size;
+      Bytes(&saved, sizeof(saved));
+      if (saved != size) {
+        fprintf(stderr, "Error: checkpoint `%s' does not fit this simulator "
+            "(%s has %llu entries instead of %llu)\n", _fileName.c_str(),
+            what, saved, size);
+        exit(-1);
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to write or read a reference to a shared object. Returns true
+    // the first time the object is seen: the caller then transfers the
+    // object itself, and when restoring allocates it and calls AddObject
+    // before transferring anything that may refer back to it.
+    // -------------------------------------------------------------------------
+
+    bool Reference(void *&ptr) {
+      uint64 id = 0;
+      if (!_restoring) {
+        if (ptr != NULL) {
+          map <void *, uint64>::iterator it = _objectIDs.find(ptr);
+          if (it != _objectIDs.end())
+            id = it -> second;
+          else {
+            id = _objectIDs.size() + 1;
+            _objectIDs[ptr] = id;
+            Bytes(&id, sizeof(id));
+            return true;
+          }
+        }
+        Bytes(&id, sizeof(id));
+        return false;
+      }
+      Bytes(&id, sizeof(id));
+      if (id == _objects.size() + 1) {
+        ptr = NULL;
+        return true;
+      }
+      if (id > _objects.size()) {
+        fprintf(stderr, "Error: checkpoint `%s' is corrupt\n",
+            _fileName.c_str());
+        exit(-1);
+      }
+      ptr = (id == 0) ? NULL : _objects[id - 1];
+      return false;
+    }
+
+    void AddObject(void *ptr) {
+      _objects.push_back(ptr);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Functions to register the fixed objects and to write or read a pointer
+    // to one of them (or NULL)
+    // -------------------------------------------------------------------------
+
+    void AddTarget(void *ptr) {
+      _targets.push_back(ptr);
+    }
+
+    void Pointer(void *&ptr, const char *what) {
+      uint32 index = 0;
+      if (!_restoring && ptr != NULL) {
+        index = find(_targets.begin(), _targets.end(), ptr) -
+          _targets.begin() + 1;
+        if (index > _targets.size()) {
+          fprintf(stderr, "Error: %s cannot be saved in a checkpoint\n",
+              what);
+          exit(-1);
+        }
+      }
+      Bytes(&index, sizeof(index));
+      if (_restoring) {
+        if (index > _targets.size()) {
+          fprintf(stderr, "Error: checkpoint `%s' does not fit this "
+              "simulator (%s)\n", _fileName.c_str(), what);
+          exit(-1);
+        }
+        ptr = (index == 0) ? NULL : _targets[index - 1];
+      }
+    }
+};
+
+
+// -----------------------------------------------------------------------------
+// Transfer functions. The overloads are declared first so that containers of
+// containers find them.
+// -----------------------------------------------------------------------------
+
+template <class T> void CheckpointTransfer(CheckpointFile &cp, T &value);
+inline void CheckpointTransfer(CheckpointFile &cp, string &value);
+inline void CheckpointTransfer(CheckpointFile &cp, vector <bool> &value);
+template <class T> void CheckpointTransfer(CheckpointFile &cp,
+    vector <T> &value);
+template <class T> void CheckpointTransfer(CheckpointFile &cp,
+    list <T> &value);
+template <class T> void CheckpointTransfer(CheckpointFile &cp,
+    set <T> &value);
+template <class K, class V> void CheckpointTransfer(CheckpointFile &cp,
+    map <K, V> &value);
+template <class A, class B> void CheckpointTransfer(CheckpointFile &cp,
+    pair <A, B> &value);
+
+
+// plain data
+template <class T> void CheckpointTransfer(CheckpointFile &cp, T &value) {
+  typedef char plain_data[__is_trivially_copyable(T) ? 1 : -1];
+  (void)sizeof(plain_data);
+  cp.Bytes(&value, sizeof(T));
+}
+
+inline void CheckpointTransfer(CheckpointFile &cp, string &value) {
+  uint64 size = value.size();
+  cp.Bytes(&size, sizeof(size));
+  value.resize(size);
+  if (size > 0)
+    cp.Bytes(&value[0], size);
+}
+
+// an empty vector takes the saved size, a sized one must have it
+template <class T> uint64 CheckpointVectorSize(CheckpointFile &cp,
+    vector <T> &value) {
+  uint64 size = value.size();
+  if (!cp.Restoring() || value.empty()) {
+    cp.Bytes(&size, sizeof(size));
+    value.resize(size);
+  }
+  else
+    cp.Size(size, "a table");
+  return size;
+}
+
+inline void CheckpointTransfer(CheckpointFile &cp, vector <bool> &value) {
+  uint64 size = CheckpointVectorSize(cp, value);
+  for (uint64 i = 0; i < size; i ++) {
+    bool bit = value[i];
+    cp.Bytes(&bit, sizeof(bit));
+    value[i] = bit;
+  }
+}
+
+template <class T> void CheckpointTransfer(CheckpointFile &cp,
+    vector <T> &value) {
+  uint64 size = CheckpointVectorSize(cp, value);
+  for (uint64 i = 0; i < size; i ++)
+    CheckpointTransfer(cp, value[i]);
+}
+
+template <class T> void CheckpointTransfer(CheckpointFile &cp,
+    list <T> &value) {
+  uint64 size = value.size();
+  cp.Bytes(&size, sizeof(size));
+  if (cp.Restoring())
+    value.resize(size);
+  typename list <T>::iterator it;
+  for (it = value.begin(); it != value.end(); it ++)
+    CheckpointTransfer(cp, *it);
+}
+
+template <class T> void CheckpointTransfer(CheckpointFile &cp,
+    set <T> &value) {
+  uint64 size = value.size();
+  cp.Bytes(&size, sizeof(size));
+  if (!cp.Restoring()) {
+    typename set <T>::iterator it;
+    for (it = value.begin(); it != value.end(); it ++) {
+      T element = *it;
+      CheckpointTransfer(cp, element);
+    }
+    return;
+  }
+  value.clear();
+  for (uint64 i = 0; i < size; i ++) {
+    T element = T();
+    CheckpointTransfer(cp, element);
+    value.insert(value.end(), element);
+  }
+}
+
+template <class K, class V> void CheckpointTransfer(CheckpointFile &cp,
+    map <K, V> &value) {
+  uint64 size = value.size();
+  cp.Bytes(&size, sizeof(size));
+  if (!cp.Restoring()) {
+    typename map <K, V>::iterator it;
+    for (it = value.begin(); it != value.end(); it ++) {
+      K key = it -> first;
+      CheckpointTransfer(cp, key);
+      CheckpointTransfer(cp, it -> second);
+    }
+    return;
+  }
+  value.clear();
+  for (uint64 i = 0; i < size; i ++) {
+    K key = K();
+    CheckpointTransfer(cp, key);
+    CheckpointTransfer(cp, value[key]);
+  }
+}
+
+template <class A, class B> void CheckpointTransfer(CheckpointFile &cp,
+    pair <A, B> &value) {
+  CheckpointTransfer(cp, value.first);
+  CheckpointTransfer(cp, value.second);
+}
+
+
+// -----------------------------------------------------------------------------
+// Macros for the CheckpointState functions (the checkpoint is cp)
+// -----------------------------------------------------------------------------
+
+#define CHECKPOINT(field) CheckpointTransfer(cp, field)
+
+#endif // __CHECKPOINT_H__
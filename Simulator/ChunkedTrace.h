@@ -0,0 +1,334 @@
+// -----------------------------------------------------------------------------
+// File: ChunkedTrace.h
+// Description:
+//    Defines the chunked trace container. Records are coded as in the binary
+//    format (see TraceFormat.h) but in frames of a fixed number of records.
+//    Each frame restarts the delta coding and is compressed on its own, and
+//    an index at the end of the file gives the first icount and the offset
+//    of every frame. A reader can therefore start at any frame, and frames
+//    can be decompressed independently of each other.
+//
+//    Layout (all fields little endian):
+//      header  magic "MSCTRACE", version, block size, core id, records per
+//              frame (u32 each), frame count, index offset (u64 each)
+//      frames  zlib streams
+//      index   per frame: first icount, offset (u64), compressed size,
+//              decoded size, record count (u32)
+// -----------------------------------------------------------------------------
+
+#ifndef __CHUNKED_TRACE_H__
+#define __CHUNKED_TRACE_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "Types.h"
+#include "TraceFormat.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <zlib.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define CHUNKED_TRACE_MAGIC "MSCTRACE"
+#define CHUNKED_TRACE_VERSION 1
+#define CHUNKED_TRACE_HEADER_SIZE 40
+#define CHUNKED_TRACE_INDEX_ENTRY_SIZE 28
+#define CHUNKED_TRACE_FRAME_RECORDS 65536
+
+
+// -----------------------------------------------------------------------------
+// Little endian helpers
+// -----------------------------------------------------------------------------
+
+inline void PutLE(uint8 *out, uint64 value, uint32 bytes) {
+  for (uint32 i = 0; i < bytes; i ++)
+    out[i] = (value >> (8 * i)) & 0xFF;
+}
+
+inline uint64 GetLE(const uint8 *in, uint32 bytes) {
+  uint64 value = 0;
+  for (uint32 i = 0; i < bytes; i ++)
+    value |= (uint64)in[i] << (8 * i);
+  return value;
+}
+
+
+// -----------------------------------------------------------------------------
+// Structure: ChunkedTraceFrame
+// Description:
+//    Index entry of a frame
+// -----------------------------------------------------------------------------
+
+struct ChunkedTraceFrame {
+  uint64 firstIcount;
+  uint64 offset;
+  uint32 compressedSize;
+  uint32 rawSize;
+  uint32 count;
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: ChunkedTraceWriter
+// Description:
+//    Writes a chunked trace
+// -----------------------------------------------------------------------------
+
+class ChunkedTraceWriter {
+
+  protected:
+
+    FILE *_file;
+    TraceHeader _header;
+    uint32 _frameRecords;
+    uint64 _offset;
+    vector <ChunkedTraceFrame> _index;
+
+    // frame being filled
+    TraceDeltaCoder _coder;
+    vector <uint8> _raw;
+    uint32 _rawSize;
+    uint32 _count;
+    uint64 _firstIcount;
+    vector <uint8> _compressed;
+
+
+    // -------------------------------------------------------------------------
+    // Function to write the header
+    // -------------------------------------------------------------------------
+
+    void WriteHeader() {
+      uint8 bytes[CHUNKED_TRACE_HEADER_SIZE];
+      memcpy(bytes, CHUNKED_TRACE_MAGIC, 8);
+      PutLE(bytes + 8, CHUNKED_TRACE_VERSION, 4);
+      PutLE(bytes + 12, _header.blockSize, 4);
+      PutLE(bytes + 16, _header.coreID, 4);
+      PutLE(bytes + 20, _frameRecords, 4);
+      PutLE(bytes + 24, _index.size(), 8);
+      PutLE(bytes + 32, _offset, 8);
+      fseeko(_file, 0, SEEK_SET);
+      fwrite(bytes, CHUNKED_TRACE_HEADER_SIZE, 1, _file);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to compress and write the current frame
+    // -------------------------------------------------------------------------
+
+    void FlushFrame() {
+      if (_count == 0) return;
+
+      uLongf size = compressBound(_rawSize);
+      _compressed.resize(size);
+      compress2(&_compressed[0], &size, &_raw[0], _rawSize, Z_DEFAULT_COMPRESSION);
+      fwrite(&_compressed[0], size, 1, _file);
+
+      ChunkedTraceFrame frame;
+      frame.firstIcount = _firstIcount;
+      frame.offset = _offset;
+      frame.compressedSize = size;
+      frame.rawSize = _rawSize;
+      frame.count = _count;
+      _index.push_back(frame);
+
+      _offset += size;
+      _rawSize = 0;
+      _count = 0;
+    }
+
+
+  public:
+
+    ChunkedTraceWriter() {
+      _file = NULL;
+    }
+
+    ~ChunkedTraceWriter() {
+      Close();
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to create a trace. Returns false if the file cannot be created.
+    // -------------------------------------------------------------------------
+
+    bool Open(string fileName, const TraceHeader &header,
+        uint32 frameRecords = CHUNKED_TRACE_FRAME_RECORDS) {
+      Close();
+      _file = fopen(fileName.c_str(), "wb");
+      if (_file == NULL)
+        return false;
+      _header = header;
+      _frameRecords = frameRecords;
+      _index.clear();
+      _raw.resize((size_t)frameRecords * TRACE_RECORD_MAX_BYTES);
+      _rawSize = 0;
+      _count = 0;
+      _offset = CHUNKED_TRACE_HEADER_SIZE;
+      // placeholder header, rewritten on close
+      WriteHeader();
+      return true;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to add a record
+    // -------------------------------------------------------------------------
+
+    void Write(const TraceRecord &record) {
+      if (_count == 0) {
+        _coder.Reset();
+        _firstIcount = record.icount;
+      }
+      _rawSize += _coder.Encode(record, &_raw[_rawSize]);
+      _count ++;
+      if (_count == _frameRecords)
+        FlushFrame();
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to write the index and close the trace
+    // -------------------------------------------------------------------------
+
+    void Close() {
+      if (_file == NULL) return;
+      FlushFrame();
+
+      uint8 bytes[CHUNKED_TRACE_INDEX_ENTRY_SIZE];
+      for (uint32 i = 0; i < _index.size(); i ++) {
+        PutLE(bytes, _index[i].firstIcount, 8);
+        PutLE(bytes + 8, _index[i].offset, 8);
+        PutLE(bytes + 16, _index[i].compressedSize, 4);
+        PutLE(bytes + 20, _index[i].rawSize, 4);
+        PutLE(bytes + 24, _index[i].count, 4);
+        fwrite(bytes, CHUNKED_TRACE_INDEX_ENTRY_SIZE, 1, _file);
+      }
+
+      WriteHeader();
+      fclose(_file);
+      _file = NULL;
+    }
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: ChunkedTraceFile
+// Description:
+//    Random access to the frames of a chunked trace
+// -----------------------------------------------------------------------------
+
+class ChunkedTraceFile {
+
+  protected:
+
+    FILE *_file;
+    TraceHeader _header;
+    vector <ChunkedTraceFrame> _index;
+    vector <uint8> _compressed;
+
+  public:
+
+    ChunkedTraceFile() {
+      _file = NULL;
+    }
+
+    ~ChunkedTraceFile() {
+      if (_file != NULL)
+        fclose(_file);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to open a trace and read its index. Returns false if the file
+    // is not a chunked trace.
+    // -------------------------------------------------------------------------
+
+    bool Open(string fileName) {
+
+      _file = fopen(fileName.c_str(), "rb");
+      if (_file == NULL)
+        return false;
+
+      uint8 bytes[CHUNKED_TRACE_HEADER_SIZE];
+      if (fread(bytes, CHUNKED_TRACE_HEADER_SIZE, 1, _file) != 1 ||
+          memcmp(bytes, CHUNKED_TRACE_MAGIC, 8) != 0 ||
+          GetLE(bytes + 8, 4) != CHUNKED_TRACE_VERSION)
+        return false;
+
+      _header.blockSize = GetLE(bytes + 12, 4);
+      _header.coreID = GetLE(bytes + 16, 4);
+      uint64 frames = GetLE(bytes + 24, 8);
+      uint64 indexOffset = GetLE(bytes + 32, 8);
+
+      _index.resize(frames);
+      fseeko(_file, indexOffset, SEEK_SET);
+      uint8 entry[CHUNKED_TRACE_INDEX_ENTRY_SIZE];
+      for (uint64 i = 0; i < frames; i ++) {
+        if (fread(entry, CHUNKED_TRACE_INDEX_ENTRY_SIZE, 1, _file) != 1)
+          return false;
+        _index[i].firstIcount = GetLE(entry, 8);
+        _index[i].offset = GetLE(entry + 8, 8);
+        _index[i].compressedSize = GetLE(entry + 16, 4);
+        _index[i].rawSize = GetLE(entry + 20, 4);
+        _index[i].count = GetLE(entry + 24, 4);
+      }
+      return true;
+    }
+
+    const TraceHeader &Header() {
+      return _header;
+    }
+
+    uint32 NumFrames() {
+      return _index.size();
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to return the last frame starting at or before an icount
+    // (frame 0 if there is none)
+    // -------------------------------------------------------------------------
+
+    uint32 FindFrame(uint64 icount) {
+      uint32 lo = 0, hi = _index.size();
+      while (hi - lo > 1) {
+        uint32 mid = (lo + hi) / 2;
+        if (_index[mid].firstIcount <= icount)
+          lo = mid;
+        else
+          hi = mid;
+      }
+      return lo;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to read and decompress a frame. Returns false on error.
+    // -------------------------------------------------------------------------
+
+    bool LoadFrame(uint32 frame, vector <uint8> &raw) {
+      const ChunkedTraceFrame &entry = _index[frame];
+      _compressed.resize(entry.compressedSize);
+      raw.resize(entry.rawSize);
+      if (fseeko(_file, entry.offset, SEEK_SET) != 0 ||
+          fread(&_compressed[0], entry.compressedSize, 1, _file) != 1)
+        return false;
+      uLongf size = entry.rawSize;
+      if (uncompress(&raw[0], &size, &_compressed[0], entry.compressedSize)
+          != Z_OK || size != entry.rawSize)
+        return false;
+      return true;
+    }
+};
+
+#endif // __CHUNKED_TRACE_H__
@@ -74,6 +74,13 @@ protected:
       b2.clear();
       p = 0;
     }
+    friend void CheckpointTransfer(CheckpointFile &cp, ARCList &lists) {
+      CheckpointTransfer(cp, lists.t1);
+      CheckpointTransfer(cp, lists.t2);
+      CheckpointTransfer(cp, lists.b1);
+      CheckpointTransfer(cp, lists.b2);
+      CheckpointTransfer(cp, lists.p);
+    }
   };
 
 
@@ -186,6 +193,17 @@ public:
   }
 
 
+  // -------------------------------------------------------------------------
+  // Function to save or restore the state of the component
+  // -------------------------------------------------------------------------
+
+  void CheckpointState(CheckpointFile &cp) {
+    MemoryComponent::CheckpointState(cp);
+    CHECKPOINT(_sets);
+    CHECKPOINT(_occupancy);
+  }
+
+
 protected:
 
   // -------------------------------------------------------------------------
@@ -41,6 +41,7 @@ protected:
   uint32 _blockSize;
   uint32 _associativity;
   string _policy;
+  bool _flatTagStore;				// use the flat (structure of arrays) tag store
 
   uint32 _tagStoreLatency;
   uint32 _dataStoreLatency;
@@ -77,6 +78,11 @@ protected:
     uint32 dirty;
     list <uint32> reuse;
     EvictionData() { count = 0; dirty = 0; reuse.clear(); }
+    friend void CheckpointTransfer(CheckpointFile &cp, EvictionData &data) {
+      CheckpointTransfer(cp, data.count);
+      CheckpointTransfer(cp, data.dirty);
+      CheckpointTransfer(cp, data.reuse);
+    }
   };
 
 // each address has an associated eviction data
@@ -111,6 +117,7 @@ public:
     _blockSize = 64;
     _associativity = 2;
     _policy = "lru";
+    _flatTagStore = true;
     _tagStoreLatency = 1;
     _dataStoreLatency = 2;
     _virtualTag = true;
@@ -139,6 +146,7 @@ public:
       CMP_PARAMETER_UINT("block-size", _blockSize)
       CMP_PARAMETER_UINT("associativity", _associativity)
       CMP_PARAMETER_STRING("policy", _policy)
+      CMP_PARAMETER_BOOLEAN("flat-tag-store", _flatTagStore)
       CMP_PARAMETER_UINT("tag-store-latency", _tagStoreLatency)
       CMP_PARAMETER_UINT("data-store-latency", _dataStoreLatency)
       CMP_PARAMETER_BOOLEAN("virtual-tag", _virtualTag)
@@ -179,7 +187,8 @@ public:
   void StartSimulation() {
     // compute the number of sets and initialize the tag store
     _numSets = _size / (_blockSize * _associativity);
-    _tags.SetTagStoreParameters(_numSets, _associativity, _policy);
+    _tags.SetTagStoreParameters(_numSets, _associativity, _policy,
+                                _flatTagStore);
   }
 
     
@@ -220,6 +229,18 @@ public:
     }
   }
 
+
+  // -------------------------------------------------------------------------
+  // Function to save or restore the state of the component
+  // -------------------------------------------------------------------------
+
+  void CheckpointState(CheckpointFile &cp) {
+    MemoryComponent::CheckpointState(cp);
+    _tags.CheckpointState(cp);
+    CHECKPOINT(_evictionData);
+    CHECKPOINT(_reuse);
+  }
+
 protected:
 
   // -------------------------------------------------------------------------
@@ -237,6 +258,7 @@ protected:
                    (request -> physicalAddress)) / _blockSize;
       
     table_t <addr_t, CacheTagValue>::entry tagentry;
+    generic_tagstore_t <addr_t, CacheTagValue>::handle block;
     cycles_t latency;
 
     // if its a partial write and the size is same as block size, then convert
@@ -269,16 +291,17 @@ protected:
       //     latency = tag
       // cache stalls for the tag
 
-      tagentry = _tags.read(ctag);
-      if (tagentry.valid) {
+      block = _tags.find(ctag);
+      if (block.valid) {
+        _tags.read(block);
         latency = (_serialLookup ? _tagStoreLatency : 0) + 
           _dataStoreLatency;
-        _tags[ctag].reuse ++;
+        block -> reuse ++;
 
-        if (_tags[ctag].prefetched) {
-          _tags[ctag].prefetched = false;
+        if (block -> prefetched) {
+          block -> prefetched = false;
           if (_demotePH)
-            _tags.read(ctag, POLICY_LOW);
+            _tags.read(block, POLICY_LOW);
           if (_forwardFake) {
             MemoryRequest *fake = new MemoryRequest(*request);
             fake -> type = MemoryRequest::FAKE_READ;
@@ -308,9 +331,10 @@ protected:
       // (hopefully MSHR).
       // cache stalls for tag
           
-      tagentry = _tags.silentupdate(ctag);
-      if (tagentry.valid) {
-        _tags[ctag].dirty = true;
+      block = _tags.find(ctag);
+      if (block.valid) {
+        _tags.silentupdate(block);
+        block -> dirty = true;
         request -> serviced = true;
       }
       else {
@@ -334,9 +358,10 @@ protected:
       //    latency = tag
       // cache stalls for the tag
           
-      tagentry = _tags.read(ctag); // TODO: Check this line
-      if (tagentry.valid) {
-        _tags[ctag].dirty = true; // CHANGE
+      block = _tags.find(ctag); // TODO: Check this line
+      if (block.valid) {
+        _tags.read(block);
+        block -> dirty = true; // CHANGE
         latency = (_serialLookup ? _tagStoreLatency : 0) + 
           _dataStoreLatency;
         request -> serviced = true;
@@ -360,15 +385,16 @@ protected:
       // if the block is not present, evict a block and insert this into the cache
       // cache stalls for the tag
 
-      if (_tags.lookup(ctag)) {
-        _tags[ctag].dirty = true;
+      block = _tags.find(ctag);
+      if (block.valid) {
+        block -> dirty = true;
       }
       else {
-        tagentry = _tags.insert(ctag, CacheTagValue());
+        tagentry = _tags.insert(block, ctag, CacheTagValue());
         // this will return the evicted entry
-        _tags[ctag].dirty = true;
-        _tags[ctag].vcla = ((request -> virtualAddress)/_blockSize)*_blockSize;
-        _tags[ctag].pcla = ((request -> physicalAddress)/_blockSize)*_blockSize;
+        block -> dirty = true;
+        block -> vcla = ((request -> virtualAddress)/_blockSize)*_blockSize;
+        block -> pcla = ((request -> physicalAddress)/_blockSize)*_blockSize;
         EvictBlock(tagentry, request);
       }
 
@@ -398,22 +424,23 @@ protected:
                    request -> physicalAddress) / _blockSize;
 
     // else check if the block is already present in the cache
-    if (_tags.lookup(ctag))
+    generic_tagstore_t <addr_t, CacheTagValue>::handle block = _tags.find(ctag);
+    if (block.valid)
       return 0;
 
     table_t <addr_t, CacheTagValue>::entry tagentry;
 
     // else insert the block into the cache
-    tagentry = _tags.insert(ctag, CacheTagValue());
-    _tags[ctag].vcla = ((request -> virtualAddress) / _blockSize) * _blockSize;
-    _tags[ctag].pcla = ((request -> physicalAddress) / _blockSize) * _blockSize;
+    tagentry = _tags.insert(block, ctag, CacheTagValue());
+    block -> vcla = ((request -> virtualAddress) / _blockSize) * _blockSize;
+    block -> pcla = ((request -> physicalAddress) / _blockSize) * _blockSize;
     if (request -> type == MemoryRequest::WRITE || 
         request -> type == MemoryRequest::PARTIALWRITE ||
         request -> dirtyReply)
-      _tags[ctag].dirty = true;
+      block -> dirty = true;
 
     if (request -> type == MemoryRequest::PREFETCH)
-      _tags[ctag].prefetched = true;
+      block -> prefetched = true;
 
     // Need to clean this up
     request -> dirtyReply = false;
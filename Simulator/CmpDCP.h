@@ -45,6 +45,7 @@ protected:
   uint32 _blockSize;
   uint32 _associativity;
   string _policy;
+  bool _flatTagStore;				// use the flat (structure of arrays) tag store
 
   uint32 _tagStoreLatency;
   uint32 _dataStoreLatency;
@@ -126,6 +127,10 @@ protected:
   struct AccuracyEntry {
     saturating_counter counter;
     generic_tagstore_t <addr_t, bool> ipEAF;
+    friend void CheckpointTransfer(CheckpointFile &cp, AccuracyEntry &entry) {
+      CheckpointTransfer(cp, entry.counter);
+      entry.ipEAF.CheckpointState(cp);
+    }
   };
 
   vector <AccuracyEntry> _accuracyTable;
@@ -190,6 +195,7 @@ public:
     _tagStoreLatency = 6;
     _dataStoreLatency = 15;
     _policy = "lru";
+    _flatTagStore = true;
     _prefetchRequestPromote = false;
     _reusePrediction = false;
     _demandReusePrediction = false;
@@ -223,6 +229,7 @@ public:
       CMP_PARAMETER_UINT("block-size", _blockSize)
       CMP_PARAMETER_UINT("associativity", _associativity)
       CMP_PARAMETER_STRING("policy", _policy)
+      CMP_PARAMETER_BOOLEAN("flat-tag-store", _flatTagStore)
       CMP_PARAMETER_UINT("tag-store-latency", _tagStoreLatency)
       CMP_PARAMETER_UINT("data-store-latency", _dataStoreLatency)
 
@@ -298,7 +305,8 @@ public:
 
     // compute number of sets
     _numSets = (_size * 1024) / (_blockSize * _associativity);
-    _tags.SetTagStoreParameters(_numSets, _associativity, _policy);
+    _tags.SetTagStoreParameters(_numSets, _associativity, _policy,
+                                _flatTagStore);
     _missCounter.resize(_numSets, 0);
     _procMisses.resize(_numCPUs, 0);
 
@@ -338,6 +346,22 @@ public:
   void HeartBeat(cycles_t hbCount) {
   }
 
+
+  // -------------------------------------------------------------------------
+  // Function to save or restore the state of the component
+  // -------------------------------------------------------------------------
+
+  void CheckpointState(CheckpointFile &cp) {
+    MemoryComponent::CheckpointState(cp);
+    _tags.CheckpointState(cp);
+    _eaf.CheckpointState(cp);
+    CHECKPOINT(_duelInfo);
+    CHECKPOINT(_psel);
+    CHECKPOINT(_accuracyTable);
+    CHECKPOINT(_missCounter);
+    CHECKPOINT(_procMisses);
+  }
+
   void EndProcWarmUp(uint32 cpuID) {
     _procMisses[cpuID] = 0;
   }
@@ -374,6 +398,7 @@ protected:
     // compute the cache block tag
     addr_t ctag = VADDR(request) / _blockSize;
     uint32 index = _tags.index(ctag);
+    generic_tagstore_t <addr_t, TagEntry>::handle block = _tags.find(ctag);
 
     // check if its a read or write back
     switch (request -> type) {
@@ -384,7 +409,7 @@ protected:
 
       INCREMENT(reads);
           
-      if (_tags.lookup(ctag)) {
+      if (block.valid) {
 
         request -> serviced = true;
         request -> AddLatency(_tagStoreLatency + _dataStoreLatency);
@@ -397,7 +422,7 @@ protected:
         // _tags.read(ctag);
         
         // read to update state
-        TagEntry &tagentry = _tags[ctag];
+        TagEntry &tagentry = *block.value;
         policy_value_t priority;
         
         // check the prefetched state
@@ -443,14 +468,14 @@ protected:
             if (priority == POLICY_LOW) tagentry.dcpDemoted = true;
           }
           
-          _tags.read(ctag, priority);
+          _tags.read(block, priority);
 
           // update counters
           INCREMENT(used_prefetches);
           break;
           
         case PREFETCHED_USED:
-          _tags.read(ctag, POLICY_HIGH);
+          _tags.read(block, POLICY_HIGH);
           tagentry.prefState = PREFETCHED_REUSED;
           if (tagentry.dcpDemoted)
             INCREMENT(incorrect_dcp_demotions);
@@ -460,7 +485,7 @@ protected:
           
         case NOT_PREFETCHED:
         case PREFETCHED_REUSED:
-          _tags.read(ctag, POLICY_HIGH);
+          _tags.read(block, POLICY_HIGH);
           // do nothing
           break;
         }
@@ -484,8 +509,10 @@ protected:
           if (request -> d_prefetched) {
             uint32 prefID = _perEntryAcc ? request -> d_prefID : 0;
             AccuracyEntry &accEntry = _accuracyTable[prefID];
-            if (accEntry.ipEAF.lookup(ctag)) {
-              accEntry.ipEAF.invalidate(ctag);
+            generic_tagstore_t <addr_t, bool>::handle eafEntry =
+              accEntry.ipEAF.find(ctag);
+            if (eafEntry.valid) {
+              accEntry.ipEAF.invalidate(eafEntry);
               accEntry.counter.increment();
               INCREMENT(accurate_predicted_inaccurate);
             }
@@ -503,15 +530,15 @@ protected:
     case MemoryRequest::FAKE_READ:
       INCREMENT(fake_reads);
       if (_handleFake) {
-        if (_tags.lookup(ctag)) {
-          TagEntry &tagentry = _tags[ctag];
+        if (block.valid) {
+          TagEntry &tagentry = *block.value;
           if (tagentry.prefState == PREFETCHED_UNUSED) {
             INCREMENT(fake_read_hits);
             tagentry.fakeDemoted = true;
             tagentry.useMiss = _missCounter[index];
             tagentry.useCycle = request -> currentCycle;
             // demote the block
-            _tags.read(ctag, POLICY_LOW);
+            _tags.read(block, POLICY_LOW);
           }
         }          
       }
@@ -522,7 +549,7 @@ protected:
 
       INCREMENT(prefetches);
           
-      if (_tags.lookup(ctag)) {
+      if (block.valid) {
         request -> serviced = true;
         request -> AddLatency(_tagStoreLatency + _dataStoreLatency);
 
@@ -533,7 +560,7 @@ protected:
           uint32 prefID = _perEntryAcc ? request -> prefetcherID : 0;
           AccuracyEntry &accEntry = _accuracyTable[prefID];
           if (accEntry.counter > (_accuracyCounterMax / 2)) {
-            _tags.read(ctag, POLICY_HIGH);
+            _tags.read(block, POLICY_HIGH);
             INCREMENT(predicted_accurate);
           }
         }
@@ -542,7 +569,7 @@ protected:
         // if we shoule promote on a prefetch request hit?
         // else do nothing
         else if (_prefetchRequestPromote)
-          _tags.read(ctag, POLICY_HIGH);
+          _tags.read(block, POLICY_HIGH);
       }
       else { 
         if (_accuracyPrediction && _drop) {
@@ -570,10 +597,10 @@ protected:
 
       INCREMENT(writebacks);
 
-      if (_tags.lookup(ctag))
-        _tags[ctag].dirty = true;
+      if (block.valid)
+        block -> dirty = true;
       else
-        INSERT_BLOCK(ctag, true, request);
+        INSERT_BLOCK(block, ctag, true, request);
 
       request -> serviced = true;
       return _tagStoreLatency;
@@ -599,20 +626,23 @@ protected:
     addr_t ctag = VADDR(request) / _blockSize;
 
     // if the block is already present, return
-    if (_tags.lookup(ctag))
+    generic_tagstore_t <addr_t, TagEntry>::handle block = _tags.find(ctag);
+    if (block.valid)
       return 0;
 
-    INSERT_BLOCK(ctag, false, request);
+    INSERT_BLOCK(block, ctag, false, request);
 
     return 0;
   }
 
 
   // -------------------------------------------------------------------------
-  // Function to insert a block into the cache
+  // Function to insert a block into the cache. block is the handle from the
+  // lookup that missed.
   // -------------------------------------------------------------------------
 
-  void INSERT_BLOCK(addr_t ctag, bool dirty, MemoryRequest *request) {
+  void INSERT_BLOCK(generic_tagstore_t <addr_t, TagEntry>::handle &block,
+                    addr_t ctag, bool dirty, MemoryRequest *request) {
 
     table_t <addr_t, TagEntry>::entry tagentry;
     policy_value_t priority = POLICY_HIGH;
@@ -646,23 +676,23 @@ protected:
     }      
 
     // insert the block into the cache
-    tagentry = _tags.insert(ctag, TagEntry(), priority);
-    _tags[ctag].vcla = BLOCK_ADDRESS(VADDR(request), _blockSize);
-    _tags[ctag].pcla = BLOCK_ADDRESS(PADDR(request), _blockSize);
-    _tags[ctag].dirty = dirty;
-    _tags[ctag].appID = request -> cpuID;
-    _tags[ctag].prefState = NOT_PREFETCHED;
+    tagentry = _tags.insert(block, ctag, TagEntry(), priority);
+    block -> vcla = BLOCK_ADDRESS(VADDR(request), _blockSize);
+    block -> pcla = BLOCK_ADDRESS(PADDR(request), _blockSize);
+    block -> dirty = dirty;
+    block -> appID = request -> cpuID;
+    block -> prefState = NOT_PREFETCHED;
 
     uint32 index = _tags.index(ctag);
 
     // Handle prefetch
     if (request -> type == MemoryRequest::PREFETCH) {
-      _tags[ctag].prefState = PREFETCHED_UNUSED;
-      _tags[ctag].prefID = request -> prefetcherID;
-      _tags[ctag].prefetchCycle = request -> currentCycle;
-      _tags[ctag].prefetchMiss = _missCounter[index];
+      block -> prefState = PREFETCHED_UNUSED;
+      block -> prefID = request -> prefetcherID;
+      block -> prefetchCycle = request -> currentCycle;
+      block -> prefetchMiss = _missCounter[index];
       if (priority == POLICY_LOW) {
-        _tags[ctag].lowPriority = true;
+        block -> lowPriority = true;
       }
 
     }
@@ -15,14 +15,13 @@
 #include "Types.h"
 
 #include "DRAM.h"
+#include "DRAMAddressMapping.h"
 
 // -----------------------------------------------------------------------------
 // Standard includes
 // -----------------------------------------------------------------------------
 
-#include <bitset>
-
-#define MAX_BANKS 16
+#include <map>
 
 // macros
 #define FOR_EACH_CHANNEL                                \
@@ -38,11 +37,12 @@
        bank < (rank -> banks) + _numBanks; bank ++)
 
 
-#define FOR_EACH_REQUEST(reqlist) \
-  for (list <MemoryRequest *>::iterator req = (reqlist).begin();        \
-       req != (reqlist).end(); req ++)
+#define FOR_EACH_REQUEST(reqqueue) \
+  for (DRAMRequestQueue::iterator req = (reqqueue).begin();             \
+       req != (reqqueue).end(); req ++)
 
-#define UPDATE_MAX(a,b) if ((a) < (b)) a = (b)
+#define UPDATE_MAX(a,b) do { if ((a) < (b)) (a) = (b); } while (0)
+#define UPDATE_MIN(a,b) do { if ((a) > (b)) (a) = (b); } while (0)
 
 // -----------------------------------------------------------------------------
 // Class: CmpDRAMCtlr
@@ -58,42 +58,74 @@ protected:
   // Parameters
   // -------------------------------------------------------------------------
 
-  // counts
+  // counts. the banks of a rank are split evenly into its bank groups, and
+  // a channel into its pseudo-channels (channels of their own that share
+  // the command bus)
   uint32 _numChannels;
+  uint32 _numPseudoChannels;
   uint32 _numRanks;
+  uint32 _numBankGroups;
   uint32 _numBanks;
   uint32 _rowSize;
   uint32 _columnSize;
 
-  // timing parameters
+  // timing parameters. tCCD, tRRD and tWTR apply between bank groups (the
+  // _S values), tCCDL, tRRDL and tWTRL within a bank group
   uint32 _tRC;
   uint32 _tRCD;
   uint32 _tRAS;
   uint32 _tCL;
   uint32 _tCWL;
   uint32 _tCCD;
+  uint32 _tCCDL;
   uint32 _tBL;
   uint32 _tRP;
   uint32 _tRTW;
   uint32 _tWTR;
+  uint32 _tWTRL;
   uint32 _tWR;
   uint32 _tRTRS;
+  uint32 _tRRD;
+  uint32 _tRRDL;
   uint32 _tFAW;
+  uint32 _tREFI;
+  uint32 _tRFC;
+  uint32 _tRFCpb;
 
   uint32 _memProcessorRatio;
 
   // queue sizes and scheduling algo
   uint32 _numWriteBuffers;
   string _addressMapping;
+  string _addressHash;
   string _scheduler;
 
-  
+  // refresh (none, all-bank or per-bank) and the number of refreshes (in
+  // tREFI) that can be postponed or pulled in
+  string _refresh;
+  uint32 _maxPostponedRefreshes;
+  uint32 _maxPulledInRefreshes;
+
 
   // -------------------------------------------------------------------------
   // Private members
   // -------------------------------------------------------------------------
 
   DRAMChannel *_channels;
+  DRAMCommandBus *_buses;
+  DRAMAddressMapping _mapping;
+
+  // refresh settings derived from the parameters: the cycles between two
+  // refreshes of a rank and the limits on the refreshes owed by a rank
+  bool _refreshEnabled;
+  bool _perBankRefresh;
+  cycles_t _refreshInterval;
+  int32 _refreshPostponeLimit;
+  int32 _refreshPullInLimit;
+
+  // first scheduler pass at which a channel can issue its next command, as
+  // found by the last pass (WAKE_UP_NEVER if all wait for a request)
+  cycles_t _nextReady;
 
   // -------------------------------------------------------------------------
   // Declare Counters
@@ -117,7 +149,9 @@ public:
 
   CmpDRAMCtlr() {
     _numChannels = 1;
+    _numPseudoChannels = 1;
     _numRanks = 1;
+    _numBankGroups = 1;
     _numBanks = 8;
     _rowSize = 128;
     _columnSize = 64;
@@ -128,19 +162,31 @@ public:
     _tCL = 10;
     _tCWL = 7;
     _tCCD = 4;
+    _tCCDL = 4;
     _tBL = 4;
     _tRP = 10;
     _tRTW = 2;
     _tWTR = 6;
+    _tWTRL = 6;
     _tWR = 10;
     _tRTRS = 2;
+    _tRRD = 0;
+    _tRRDL = 0;
     _tFAW = 34;
+    _tREFI = 5200;
+    _tRFC = 174;
+    _tRFCpb = 90;
 
     _memProcessorRatio = 4;
 
     _numWriteBuffers = 8;
     _addressMapping = "rbRcC";
+    _addressHash = "";
     _scheduler = "frfcfs-dwf";
+
+    _refresh = "none";
+    _maxPostponedRefreshes = 8;
+    _maxPulledInRefreshes = 8;
   }
 
 
@@ -149,7 +195,9 @@ public:
   // -------------------------------------------------------------------------
 
   // -------------------------------------------------------------------------
-  // Function to add a parameter to the component
+  // Function to add a parameter to the component. A preset sets the counts,
+  // the timing and the address mapping of a DRAM standard at once; the
+  // parameters that come after it change them.
   // -------------------------------------------------------------------------
 
   void AddParameter(string pname, string pvalue) {
@@ -157,8 +205,14 @@ public:
     CMP_PARAMETER_BEGIN
 
       // Add the list of parameters to the component here
+      else if (pname.compare("preset") == 0) {
+        SetPreset(pvalue);
+      }
+
       CMP_PARAMETER_UINT("num-channels", _numChannels)
+      CMP_PARAMETER_UINT("num-pseudo-channels", _numPseudoChannels)
       CMP_PARAMETER_UINT("num-ranks", _numRanks)
+      CMP_PARAMETER_UINT("num-bank-groups", _numBankGroups)
       CMP_PARAMETER_UINT("num-banks", _numBanks)
       CMP_PARAMETER_UINT("row-size", _rowSize)
       CMP_PARAMETER_UINT("column-size", _columnSize)
@@ -169,24 +223,171 @@ public:
       CMP_PARAMETER_UINT("tcl", _tCL)
       CMP_PARAMETER_UINT("tcwl", _tCWL)
       CMP_PARAMETER_UINT("tccd", _tCCD)
+      CMP_PARAMETER_UINT("tccdl", _tCCDL)
       CMP_PARAMETER_UINT("tbl", _tBL)
       CMP_PARAMETER_UINT("trp", _tRP)
       CMP_PARAMETER_UINT("trtw", _tRTW)
       CMP_PARAMETER_UINT("twtr", _tWTR)
+      CMP_PARAMETER_UINT("twtrl", _tWTRL)
       CMP_PARAMETER_UINT("twr", _tWR)
       CMP_PARAMETER_UINT("trtrs", _tRTRS)
+      CMP_PARAMETER_UINT("trrd", _tRRD)
+      CMP_PARAMETER_UINT("trrdl", _tRRDL)
       CMP_PARAMETER_UINT("tfaw", _tFAW)
+      CMP_PARAMETER_UINT("trefi", _tREFI)
+      CMP_PARAMETER_UINT("trfc", _tRFC)
+      CMP_PARAMETER_UINT("trfcpb", _tRFCpb)
       
       CMP_PARAMETER_UINT("mem-processor-ratio", _memProcessorRatio)
       
       CMP_PARAMETER_UINT("num-write-buffers", _numWriteBuffers)
       CMP_PARAMETER_STRING("address-mapping", _addressMapping)
+      CMP_PARAMETER_STRING("address-hash", _addressHash)
       CMP_PARAMETER_STRING("scheduler", _scheduler)
 
+      CMP_PARAMETER_STRING("refresh", _refresh)
+      CMP_PARAMETER_UINT("max-postponed-refreshes", _maxPostponedRefreshes)
+      CMP_PARAMETER_UINT("max-pulled-in-refreshes", _maxPulledInRefreshes)
+
     CMP_PARAMETER_END
   }
 
 
+  // -------------------------------------------------------------------------
+  // Function to set the parameters of a DRAM standard. The timing is in
+  // memory cycles (the memory to processor clock ratio is left as it is).
+  // Per-bank refresh is not part of DDR3 and DDR4, so it costs as much as
+  // an all-bank refresh there.
+  // -------------------------------------------------------------------------
+
+  void SetPreset(string preset) {
+
+    // 11-11-11, 8 banks, 8 KB rows (4 Gb x8 devices)
+    if (preset.compare("ddr3-1600") == 0) {
+      _numPseudoChannels = 1;
+      _numBankGroups = 1;
+      _numBanks = 8;
+      _rowSize = 128;
+      _tRC = 39;
+      _tRCD = 11;
+      _tRAS = 28;
+      _tCL = 11;
+      _tCWL = 8;
+      _tCCD = 4;
+      _tCCDL = 4;
+      _tBL = 4;
+      _tRP = 11;
+      _tRTW = 2;
+      _tWTR = 6;
+      _tWTRL = 6;
+      _tWR = 12;
+      _tRTRS = 2;
+      _tRRD = 5;
+      _tRRDL = 5;
+      _tFAW = 24;
+      _tREFI = 6240;
+      _tRFC = 208;
+      _tRFCpb = 208;
+      _addressMapping = "rbRcC";
+    }
+
+    // 22-22-22, 4 bank groups of 4 banks, 8 KB rows (8 Gb x8 devices)
+    else if (preset.compare("ddr4-3200") == 0) {
+      _numPseudoChannels = 1;
+      _numBankGroups = 4;
+      _numBanks = 16;
+      _rowSize = 128;
+      _tRC = 74;
+      _tRCD = 22;
+      _tRAS = 52;
+      _tCL = 22;
+      _tCWL = 16;
+      _tCCD = 4;
+      _tCCDL = 8;
+      _tBL = 4;
+      _tRP = 22;
+      _tRTW = 2;
+      _tWTR = 4;
+      _tWTRL = 12;
+      _tWR = 24;
+      _tRTRS = 2;
+      _tRRD = 4;
+      _tRRDL = 8;
+      _tFAW = 34;
+      _tREFI = 12480;
+      _tRFC = 560;
+      _tRFCpb = 560;
+      _addressMapping = "rgbRcC";
+    }
+
+    // 40-39-39, 8 bank groups of 4 banks. A channel is a 32-bit
+    // sub-channel: 4 KB rows and bursts of 16 (16 Gb x8 devices)
+    else if (preset.compare("ddr5-4800") == 0) {
+      _numPseudoChannels = 1;
+      _numBankGroups = 8;
+      _numBanks = 32;
+      _rowSize = 64;
+      _tRC = 116;
+      _tRCD = 39;
+      _tRAS = 77;
+      _tCL = 40;
+      _tCWL = 38;
+      _tCCD = 8;
+      _tCCDL = 12;
+      _tBL = 8;
+      _tRP = 39;
+      _tRTW = 2;
+      _tWTR = 6;
+      _tWTRL = 24;
+      _tWR = 72;
+      _tRTRS = 2;
+      _tRRD = 8;
+      _tRRDL = 12;
+      _tFAW = 32;
+      _tREFI = 9360;
+      _tRFC = 708;
+      _tRFCpb = 312;
+      _addressMapping = "rgbRcC";
+    }
+
+    // 2 Gb/s, 2 pseudo-channels per channel, each with 4 bank groups of 4
+    // banks and 1 KB rows. A pseudo-channel is 64 bits wide with bursts of
+    // 4, so a 64 byte column takes two bursts
+    else if (preset.compare("hbm2") == 0) {
+      _numPseudoChannels = 2;
+      _numBankGroups = 4;
+      _numBanks = 16;
+      _rowSize = 16;
+      _tRC = 48;
+      _tRCD = 14;
+      _tRAS = 34;
+      _tCL = 14;
+      _tCWL = 4;
+      _tCCD = 4;
+      _tCCDL = 8;
+      _tBL = 4;
+      _tRP = 14;
+      _tRTW = 2;
+      _tWTR = 3;
+      _tWTRL = 8;
+      _tWR = 16;
+      _tRTRS = 1;
+      _tRRD = 4;
+      _tRRDL = 6;
+      _tFAW = 16;
+      _tREFI = 3900;
+      _tRFC = 350;
+      _tRFCpb = 160;
+      _addressMapping = "rgbRcC";
+    }
+
+    else {
+      fprintf(stderr, "Unknown DRAM preset `%s'\n", preset.c_str());
+      exit(-1);
+    }
+  }
+
+
   // -------------------------------------------------------------------------
   // Function to initialize statistics
   // -------------------------------------------------------------------------
@@ -209,35 +410,91 @@ public:
 
   void StartSimulation() {
 
-    // create channels
+    if (_numPseudoChannels == 0 || _numBankGroups == 0 ||
+        _numBanks % _numBankGroups != 0) {
+      fprintf(stderr, "The banks cannot be split into %u bank groups\n",
+              _numBankGroups);
+      exit(-1);
+    }
+
+    // create channels (the pseudo-channels of a channel are channels that
+    // share its command bus)
+    _buses = new DRAMCommandBus[_numChannels];
+    _numChannels *= _numPseudoChannels;
     _channels = new DRAMChannel[_numChannels];
 
-    // for each channel create ranks and banks
+    // for each channel create ranks, bank groups and banks
+    uint32 banksPerGroup = _numBanks / _numBankGroups;
     FOR_EACH_CHANNEL {
+      channel -> bus = &_buses[(channel - _channels) / _numPseudoChannels];
       channel -> ranks = new DRAMRank[_numRanks];
       FOR_EACH_RANK(channel) {
         rank -> channel = channel;
         rank -> banks = new DRAMBank[_numBanks];
+        rank -> bankGroups = new DRAMBankGroup[_numBankGroups];
         FOR_EACH_BANK(rank) {
           bank -> channel = channel;
           bank -> rank = rank;
+          bank -> group =
+            &(rank -> bankGroups[(bank - rank -> banks) / banksPerGroup]);
         }
       }
     }
 
+    // address mapping (see DRAMAddressMapping.h). the bank of a request is
+    // its bank in the rank
+    addr_t entries[NUM_DRAM_FIELDS];
+    entries[DRAM_CHANNEL] = _numChannels;
+    entries[DRAM_RANK] = _numRanks;
+    entries[DRAM_BANK_GROUP] = _numBankGroups;
+    entries[DRAM_BANK] = banksPerGroup;
+    entries[DRAM_ROW] = 0;
+    entries[DRAM_COLUMN] = _rowSize;
+    _mapping.Initialize(_addressMapping, _addressHash, entries, _columnSize);
+
     _tRC *= _memProcessorRatio;
     _tRCD *= _memProcessorRatio;
     _tRAS *= _memProcessorRatio;
     _tCL *= _memProcessorRatio;
     _tCWL *= _memProcessorRatio;
     _tCCD *= _memProcessorRatio;
+    _tCCDL *= _memProcessorRatio;
     _tBL *= _memProcessorRatio;
     _tRP *= _memProcessorRatio;
     _tRTW *= _memProcessorRatio;
     _tWTR *= _memProcessorRatio;
+    _tWTRL *= _memProcessorRatio;
     _tWR *= _memProcessorRatio;
     _tRTRS *= _memProcessorRatio;
+    _tRRD *= _memProcessorRatio;
+    _tRRDL *= _memProcessorRatio;
     _tFAW *= _memProcessorRatio;
+    _tREFI *= _memProcessorRatio;
+    _tRFC *= _memProcessorRatio;
+    _tRFCpb *= _memProcessorRatio;
+
+    // refresh. per-bank refreshes are spread over tREFI, one bank at a time
+    if (_refresh.compare("none") != 0 && _refresh.compare("all-bank") != 0 &&
+        _refresh.compare("per-bank") != 0) {
+      fprintf(stderr, "Unknown refresh scheme `%s'\n", _refresh.c_str());
+      exit(-1);
+    }
+    _refreshEnabled = _refresh.compare("none") != 0;
+    _perBankRefresh = _refresh.compare("per-bank") == 0;
+    _refreshInterval = _tREFI;
+    _refreshPostponeLimit = _maxPostponedRefreshes;
+    _refreshPullInLimit = _maxPulledInRefreshes;
+    if (_perBankRefresh) {
+      _refreshInterval = max(_tREFI / _numBanks, (uint32)1);
+      _refreshPostponeLimit *= _numBanks;
+      _refreshPullInLimit *= _numBanks;
+    }
+    FOR_EACH_CHANNEL {
+      FOR_EACH_RANK(channel) {
+        rank -> nextRefresh = _refreshInterval;
+      }
+    }
+    _nextReady = 0;
   }
 
 
@@ -249,6 +506,61 @@ public:
   void HeartBeat(cycles_t hbCount) {
   }
 
+
+  // -------------------------------------------------------------------------
+  // Function to save or restore the state of the component
+  // -------------------------------------------------------------------------
+
+  void CheckpointState(CheckpointFile &cp) {
+    MemoryComponent::CheckpointState(cp);
+    cp.Size(_numChannels * _numRanks * _numBanks, "the DRAM");
+    cp.Size(_numChannels * _numRanks * _numBankGroups, "the DRAM bank groups");
+    for (uint32 i = 0; i < _numChannels / _numPseudoChannels; i ++) {
+      CHECKPOINT(_buses[i].nextRowCommand);
+      CHECKPOINT(_buses[i].nextColumnCommand);
+    }
+    FOR_EACH_CHANNEL {
+      CHECKPOINT(channel -> lastRank);
+      CHECKPOINT(channel -> lastOp);
+      CHECKPOINT(channel -> lastColumnOp);
+      CHECKPOINT(channel -> lastIssueCycle);
+      CHECKPOINT(channel -> nextIssueCycle);
+      CHECKPOINT(channel -> queue[CMODE_READ]);
+      CHECKPOINT(channel -> queue[CMODE_WRITE]);
+      CHECKPOINT(channel -> arrivals);
+      CHECKPOINT(channel -> mode);
+      CHECKPOINT(channel -> numReadToWrites);
+      CHECKPOINT(channel -> numWriteToReads);
+      FOR_EACH_RANK(channel) {
+        CHECKPOINT(rank -> lastActivates);
+        CHECKPOINT(rank -> nextActivate);
+        CHECKPOINT(rank -> nextRefresh);
+        CHECKPOINT(rank -> refreshesOwed);
+        for (uint32 i = 0; i < _numBankGroups; i ++)
+          CHECKPOINT(rank -> bankGroups[i].nextIssueCycle);
+        FOR_EACH_BANK(rank) {
+          CHECKPOINT(bank -> state);
+          CHECKPOINT(bank -> openRow);
+          CHECKPOINT(bank -> lastIssueCycle);
+          CHECKPOINT(bank -> nextIssueCycle);
+          CHECKPOINT(bank -> numCmds);
+          CHECKPOINT(bank -> numActs);
+          CHECKPOINT(bank -> refreshed);
+          CHECKPOINT(bank -> refreshBlocked);
+          CHECKPOINT(bank -> refreshBlockedSince);
+          CHECKPOINT(bank -> refreshBlockedCycles);
+        }
+      }
+      // the queues of the banks are rebuilt from the channel queues
+      if (cp.Restoring()) {
+        for (int mode = 0; mode < NUM_CMODES; mode ++) {
+          FOR_EACH_REQUEST(channel -> queue[mode])
+            IndexRequest((DRAMChannelMode)mode, req -> first, req -> second);
+        }
+      }
+    }
+  }
+
   // Override end warmup. clear local counters
   void EndWarmUp() {
     FOR_EACH_CHANNEL {
@@ -258,6 +570,7 @@ public:
         FOR_EACH_BANK(rank) {
           memset(bank -> numCmds, 0, sizeof(bank -> numCmds));
           memset(bank -> numActs, 0, sizeof(bank -> numActs));
+          bank -> refreshBlockedCycles = 0;
         }
       }
     }
@@ -265,6 +578,14 @@ public:
     RESET_ALL_COUNTERS;
   }
 
+  // -------------------------------------------------------------------------
+  // Function to access the component in functional mode. No command is
+  // issued: the request is serviced at once and the banks keep their state.
+  // -------------------------------------------------------------------------
+
+  void FunctionalAccess(MemoryRequest *request) {
+  }
+
   // Overrride end simulation
   void EndSimulation() {
     uint64 totalActs = 0;
@@ -275,6 +596,8 @@ public:
     uint64 totalPres = 0;
     uint64 totalReadToWrites = 0;
     uint64 totalWriteToReads = 0;
+    uint64 totalRefs = 0;
+    uint64 totalRefreshBlockedCycles = 0;
     
     for (int i = 0; i < _numChannels; i ++) {
       DRAMChannel *channel = (_channels + i);
@@ -287,6 +610,11 @@ public:
           CMP_LOG("C%d-R%d-B%d-reads = %llu", i, j, k, bank -> numCmds[CMD_READ]);
           CMP_LOG("C%d-R%d-B%d-writes = %llu", i, j, k, bank -> numCmds[CMD_WRITE]);
           CMP_LOG("C%d-R%d-B%d-pres = %llu", i, j, k, bank -> numCmds[CMD_PRE]);
+          if (_refreshEnabled) {
+            CMP_LOG("C%d-R%d-B%d-refs = %llu", i, j, k, bank -> numCmds[CMD_REF]);
+            CMP_LOG("C%d-R%d-B%d-refresh-blocked-cycles = %llu", i, j, k,
+                    bank -> refreshBlockedCycles);
+          }
 
           totalActs += bank -> numCmds[CMD_ACT];
           totalReadActs += bank -> numActs[CMODE_READ];
@@ -294,6 +622,8 @@ public:
           totalReads += bank -> numCmds[CMD_READ];
           totalWrites += bank -> numCmds[CMD_WRITE];
           totalPres += bank -> numCmds[CMD_PRE];
+          totalRefs += bank -> numCmds[CMD_REF];
+          totalRefreshBlockedCycles += bank -> refreshBlockedCycles;
         }
       }
       CMP_LOG("C%d-read-to-writes = %llu", i, channel -> numReadToWrites);
@@ -309,45 +639,41 @@ public:
     CMP_LOG("total-reads = %llu", totalReads);
     CMP_LOG("total-writes = %llu", totalWrites);
     CMP_LOG("total-pres = %llu", totalPres);
+    if (_refreshEnabled) {
+      CMP_LOG("total-refs = %llu", totalRefs);
+      CMP_LOG("total-refresh-blocked-cycles = %llu", totalRefreshBlockedCycles);
+    }
     DUMP_STATISTICS;
     CLOSE_ALL_LOGS;
   }
 
 
-  // override earliest request
-  MemoryRequest *EarliestRequest() {
-    MemoryRequest *earliest, *request;
-    earliest = NULL;
+  // override the wake-up cycle: the next request to take in, or the cycle
+  // after the next scheduler pass that can issue a command. Idle channels
+  // have their refreshes done when a request is taken in.
+  cycles_t NextWakeUpCycle() {
+    cycles_t wake = WAKE_UP_NEVER;
+    if (!_queue.empty())
+      wake = _queue.top() -> currentCycle;
     FOR_EACH_CHANNEL {
-      FOR_EACH_REQUEST(channel -> queue[CMODE_READ]) {
-        request = *req;
-        if (earliest == NULL) {
-          earliest = request;
-        }
-        else if (earliest -> currentCycle > request -> currentCycle) {
-          earliest = request;
-        }
-      }
-      FOR_EACH_REQUEST(channel -> queue[CMODE_WRITE]) {
-        request = *req;
-        if (earliest == NULL) {
-          earliest = request;
-        }
-        else if (earliest -> currentCycle > request -> currentCycle) {
-          earliest = request;
-        }
-      }
-    }
-    if (!_queue.empty()) {
-      request = _queue.top();
-      if (earliest == NULL) {
-        earliest = request;
-      }
-      else if (earliest -> currentCycle > request -> currentCycle) {
-        earliest = request;
+      if (!ChannelIdle(channel)) {
+        if (_nextReady != WAKE_UP_NEVER)
+          UPDATE_MIN(wake, max(_nextReady, _currentCycle) + 1);
+        break;
       }
     }
-    return earliest;
+    return wake;
+  }
+
+  // override the earliest cycle. The queued requests wait for the scheduler,
+  // so the simulator advances to the wake-up cycle whatever their cycles are.
+  // The passes before the simulator cycle are run first: they see the same
+  // requests whenever they are run, and the cycle does not depend on how
+  // often the controller was stepped.
+  cycles_t EarliestCycle() {
+    if (_currentCycle < (*_simulatorCycle) && !Idle())
+      Scheduler((*_simulatorCycle) - 1);
+    return NextWakeUpCycle();
   }
 
   // debug info
@@ -359,7 +685,7 @@ public:
       printf("Channel mode is %d\n", channel -> mode);
       printf("Read requests\n");
       FOR_EACH_REQUEST(channel -> queue[CMODE_READ]) {
-        MemoryRequest *request = *req;
+        MemoryRequest *request = req -> second;
         DRAMRank *rank = &(channel -> ranks[request -> dramRankID]);
         DRAMBank *bank = &(rank -> banks[request -> dramBankID]);
         printf("%llu %X %X %d %X %llu\n", request -> currentCycle, request, request -> dramRowID,
@@ -367,7 +693,7 @@ public:
       }
       printf("Write requests\n");
       FOR_EACH_REQUEST(channel -> queue[CMODE_WRITE]) {
-        MemoryRequest *request = *req;
+        MemoryRequest *request = req -> second;
         DRAMRank *rank = &(channel -> ranks[request -> dramRankID]);
         DRAMBank *bank = &(rank -> banks[request -> dramBankID]);
         printf("%llu %X %X %d %X\n", request -> currentCycle, request, request -> dramRowID,
@@ -403,55 +729,39 @@ protected:
   // -------------------------------------------------------------------------
   
   void AddressMapping(MemoryRequest *request) {
-
-    if (_addressMapping.compare("rbRcC") == 0) {
-      addr_t address = request -> virtualAddress;
-      address /= _columnSize;
-      request -> dramChannelID = address % _numChannels;
-      address /= _numChannels;
-      request -> dramColumnID = address % _rowSize;
-      address /= _rowSize;
-      request -> dramRankID = address % _numRanks;
-      address /= _numRanks;
-      request -> dramBankID = address % _numBanks;
-      address /= _numBanks;
-      request -> dramRowID = address;
-    }
-
-    else {
-      fprintf(stderr, "Unknown address mapping scheme\n");
-      exit(0);
-    }
+    addr_t fields[NUM_DRAM_FIELDS];
+    _mapping.Map(request -> virtualAddress, fields);
+    request -> dramChannelID = fields[DRAM_CHANNEL];
+    request -> dramRankID = fields[DRAM_RANK];
+    request -> dramBankID = fields[DRAM_BANK_GROUP] *
+      (_numBanks / _numBankGroups) + fields[DRAM_BANK];
+    request -> dramRowID = fields[DRAM_ROW];
+    request -> dramColumnID = fields[DRAM_COLUMN];
   }
 
   
   // -------------------------------------------------------------------------
-  // Override process pending requests
+  // Override process next request. A step runs the scheduler passes before
+  // the simulator cycle and then takes all the requests up to it. A pass
+  // is run only once the simulator is past its cycle, so it sees all the
+  // requests taken in by its cycle, however often the controller is stepped.
   // -------------------------------------------------------------------------
 
-  void ProcessPendingRequests() {
-
-    if (_processing) return;
-    _processing = true;
+  bool ProcessNextRequest() {
 
     // check if all queues are empty
-    bool empty = true;
-    FOR_EACH_CHANNEL {
-      if (!channel -> queue[CMODE_READ].empty() ||
-          !channel -> queue[CMODE_WRITE].empty()) {
-        empty = false;
-        break;
-      }
-    }
-    if (empty && _queue.empty()) {
-      _processing = false;
-      return;
+    if (Idle()) {
+      return false;
     }
 
     MemoryRequest *request;
 
+    // Call the scheduler
+    if (_currentCycle < (*_simulatorCycle))
+      Scheduler((*_simulatorCycle) - 1);
+
     // Take all processable requests and transfer them to the corresponding queues
-    if (!_queue.empty()) {
+    if (!_queue.empty() && _queue.top() -> currentCycle <= (*_simulatorCycle)) {
       request = _queue.top();
       while (request -> currentCycle <= (*_simulatorCycle)) {
         _queue.pop();
@@ -473,17 +783,20 @@ protected:
           case MemoryRequest::PREFETCH:
             // printf("Add -> %X %16X read channel-%u\n", request, 
             //        request -> virtualAddress, request -> dramChannelID); // VIVEK
-            _channels[request -> dramChannelID].queue[CMODE_READ].push_back(request);
+            EnqueueRequest(CMODE_READ, request);
             break;
           case MemoryRequest::WRITEBACK:
             // printf("Add -> %X %16X write channel-%u\n", request, 
             //        request -> virtualAddress, request -> dramChannelID); // VIVEK
-            _channels[request -> dramChannelID].queue[CMODE_WRITE].push_back(request);
+            EnqueueRequest(CMODE_WRITE, request);
             break;
           default:
             fprintf(stderr, "Invalid request to DRAM");
             exit(0);
           }
+
+          // the next pass has a new request to look at
+          _nextReady = 0;
         }
 
         if (_queue.empty())
@@ -493,47 +806,173 @@ protected:
       }
     }
 
-    // Call the scheduler
-    Scheduler();
-
     // done processing
-    _processing = false;
+    return false;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Functions to add a request to the queues of its channel and bank, and to
+  // take it out when it is served. The bank queues are indexed by row, so
+  // the row hits of a bank are found without going through its queue.
+  // -------------------------------------------------------------------------
+
+  void EnqueueRequest(DRAMChannelMode mode, MemoryRequest *request) {
+    DRAMChannel *channel = &_channels[request -> dramChannelID];
+    uint64 arrival = channel -> arrivals ++;
+    channel -> queue[mode][arrival] = request;
+    IndexRequest(mode, arrival, request);
+  }
+
+  void IndexRequest(DRAMChannelMode mode, uint64 arrival,
+                    MemoryRequest *request) {
+    DRAMChannel *channel = &_channels[request -> dramChannelID];
+    DRAMRank *rank = &(channel -> ranks[request -> dramRankID]);
+    DRAMBank *bank = &(rank -> banks[request -> dramBankID]);
+    bank -> pending[mode][arrival] = request;
+    bank -> rows[mode][request -> dramRowID][arrival] = request;
+  }
+
+  void DequeueRequest(DRAMChannelMode mode, uint64 arrival,
+                      MemoryRequest *request) {
+    DRAMChannel *channel = &_channels[request -> dramChannelID];
+    DRAMRank *rank = &(channel -> ranks[request -> dramRankID]);
+    DRAMBank *bank = &(rank -> banks[request -> dramBankID]);
+    channel -> queue[mode].erase(arrival);
+    bank -> pending[mode].erase(arrival);
+    map <addr_t, DRAMRequestQueue>::iterator row =
+      bank -> rows[mode].find(request -> dramRowID);
+    row -> second.erase(arrival);
+    if (row -> second.empty())
+      bank -> rows[mode].erase(row);
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to check if a channel has no request waiting
+  // -------------------------------------------------------------------------
+
+  bool ChannelIdle(DRAMChannel *channel) {
+    return channel -> queue[CMODE_READ].empty() &&
+      channel -> queue[CMODE_WRITE].empty();
+  }
+
+  // -------------------------------------------------------------------------
+  // Function to check if the controller has no request at all. An idle
+  // controller runs no pass: the passes are run once a request comes in.
+  // -------------------------------------------------------------------------
+
+  bool Idle() {
+    FOR_EACH_CHANNEL {
+      if (!ChannelIdle(channel))
+        return false;
+    }
+    return _queue.empty();
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to get the row hits waiting for a bank (NULL if there are none)
+  // -------------------------------------------------------------------------
+
+  DRAMRequestQueue *RowHits(DRAMBank *bank, DRAMChannelMode mode) {
+    if (bank -> state != BANK_ACTIVATED)
+      return NULL;
+    map <addr_t, DRAMRequestQueue>::iterator row =
+      bank -> rows[mode].find(bank -> openRow);
+    if (row == bank -> rows[mode].end())
+      return NULL;
+    return &(row -> second);
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to get the earliest cycle the command bus of a channel can take
+  // a command (shared by the pseudo-channels of a channel)
+  // -------------------------------------------------------------------------
+
+  cycles_t BusIssueCycle(DRAMChannel *channel, DRAMCommand cmd) {
+    if (cmd == CMD_READ || cmd == CMD_WRITE)
+      return channel -> bus -> nextColumnCommand;
+    return channel -> bus -> nextRowCommand;
   }
 
   
   // -------------------------------------------------------------------------
-  // Overall scheduler
+  // Overall scheduler, run up to the given cycle. A pass that issues nothing
+  // leaves the channels as they are until a timing constraint expires, so
+  // the scheduler skips to the first memory cycle at which some channel can
+  // issue a command instead of running a pass every memory cycle.
   // -------------------------------------------------------------------------
 
-  void Scheduler() {
+  void Scheduler(cycles_t until) {
     // round robin across all channels
     if (_scheduler.compare("frfcfs-dwf") == 0) {
-      while (_currentCycle <= (*_simulatorCycle)) {
+      while (_currentCycle <= until) {
+        cycles_t next = WAKE_UP_NEVER;
         FOR_EACH_CHANNEL {
-          FRFCFSDWFScheduler(channel);
-        }
-        _currentCycle += _memProcessorRatio;
-      }
-      FOR_EACH_CHANNEL {
-        FOR_EACH_REQUEST(channel -> queue[CMODE_READ]) {
-          MemoryRequest *request = *req;
-          if (request -> currentCycle < _currentCycle)
-            request -> currentCycle = _currentCycle;
-        }
-        FOR_EACH_REQUEST(channel -> queue[CMODE_WRITE]) {
-          MemoryRequest *request = *req;
-          if (request -> currentCycle < _currentCycle)
-            request -> currentCycle = _currentCycle;
+          cycles_t ready = FRFCFSDWFScheduler(channel);
+          if (ready < next)
+            next = ready;
         }
+        _nextReady = NextPassCycle(next);
+        cycles_t last = until - (until - _currentCycle) % _memProcessorRatio;
+        _currentCycle = min(_nextReady, last + _memProcessorRatio);
       }
     }
   }
 
   // -------------------------------------------------------------------------
-  // Channel scheduler
+  // Function to get the first pass after the current one that is not before
+  // the given cycle (WAKE_UP_NEVER if the cycle is)
   // -------------------------------------------------------------------------
 
-  void FRFCFSDWFScheduler(DRAMChannel *channel) {
+  cycles_t NextPassCycle(cycles_t ready) {
+    if (ready <= _currentCycle)
+      return _currentCycle + _memProcessorRatio;
+    if (ready == WAKE_UP_NEVER)
+      return WAKE_UP_NEVER;
+    return _currentCycle + ((ready - _currentCycle + _memProcessorRatio - 1) /
+                            _memProcessorRatio) * _memProcessorRatio;
+  }
+
+  // -------------------------------------------------------------------------
+  // Function to find the first request of a bank queue, from req on, that
+  // can be issued by the current cycle given the earliest cycle of the
+  // command. Otherwise the earliest cycle a request becomes ready is
+  // brought down to the cycle the command (or a request) can be issued.
+  // -------------------------------------------------------------------------
+
+  bool FirstReady(DRAMRequestQueue::iterator &req,
+                  DRAMRequestQueue::iterator end, cycles_t issue,
+                  cycles_t &ready) {
+    if (req == end)
+      return false;
+    if (issue > _currentCycle) {
+      UPDATE_MAX(req -> second -> currentCycle, issue);
+      UPDATE_MIN(ready, issue);
+      return false;
+    }
+    for (; req != end; req ++) {
+      MemoryRequest *request = req -> second;
+      UPDATE_MAX(request -> currentCycle, issue);
+      if (request -> currentCycle <= _currentCycle)
+        return true;
+      UPDATE_MIN(ready, request -> currentCycle);
+    }
+    return false;
+  }
+
+  // -------------------------------------------------------------------------
+  // Channel scheduler. Returns the earliest cycle at which the channel can
+  // issue its next command (the current cycle if it issued one, or
+  // WAKE_UP_NEVER if it waits for a new request). The requests of a bank
+  // wait for the same command, so a pass looks at the first ready request
+  // of each bank (or at its first ready row hit) instead of going through
+  // the whole queue.
+  // -------------------------------------------------------------------------
+
+  cycles_t FRFCFSDWFScheduler(DRAMChannel *channel) {
 
     // if read mode and write buffer is full, switch to write mode
     // else if write mode and write buffer is empty, switch to read mode
@@ -553,87 +992,322 @@ protected:
       channel -> numWriteToReads ++;
     }
 
+    cycles_t ready = WAKE_UP_NEVER;
+
+    // a refresh that cannot be postponed any more comes first
+    if (_refreshEnabled) {
+      UpdateRefresh(channel, ready);
+      if (IssueRefresh(channel, true, ready))
+        return _currentCycle;
+    }
+
     // if queue is empty, return
-    if (channel -> queue[channel -> mode].empty())
-      return;
+    if (channel -> queue[channel -> mode].empty()) {
+      if (_refreshEnabled && IssueRefresh(channel, false, ready))
+        return _currentCycle;
+      return ready;
+    }
 
-    // is a row hit request present
-    bitset <MAX_BANKS> rowHitPresent;
+    DRAMChannelMode mode = channel -> mode;
+    DRAMCommand colCmd = mode == CMODE_READ ? CMD_READ : CMD_WRITE;
+
+    // oldest ready request: a row hit or an activate
+    DRAMRequestQueue::iterator first;
+    DRAMBank *firstBank = NULL;
+    DRAMCommand firstCmd = colCmd;
+
+    FOR_EACH_RANK(channel) {
+      FOR_EACH_BANK(rank) {
+        DRAMRequestQueue &pending = bank -> pending[mode];
+        if (pending.empty() || bank -> refreshBlocked)
+          continue;
+
+        // check for row hit
+        DRAMRequestQueue *hits = RowHits(bank, mode);
+        if (hits != NULL) {
+          cycles_t issue = max(bank -> nextIssueCycle[colCmd],
+                               channel -> nextIssueCycle[colCmd]);
+          UPDATE_MAX(issue, bank -> group -> nextIssueCycle[colCmd]);
+          UPDATE_MAX(issue, BusIssueCycle(channel, colCmd));
+          DRAMRequestQueue::iterator hit = hits -> begin();
+          if (FirstReady(hit, hits -> end(), issue, ready) &&
+              (firstBank == NULL || hit -> first < first -> first)) {
+            first = hit;
+            firstBank = bank;
+            firstCmd = colCmd;
+          }
+        }
 
-    rowHitPresent.reset();
-    
-    // check for ready requests
-    FOR_EACH_REQUEST(channel -> queue[channel -> mode]) {
-      MemoryRequest *request = *req;
-
-      DRAMRank *rank = &(channel -> ranks[request -> dramRankID]);
-      DRAMBank *bank = &(rank -> banks[request -> dramBankID]);
-
-      // check for row hit
-      if (bank -> state == BANK_ACTIVATED &&
-          bank -> openRow == request -> dramRowID) {
-        DRAMCommand colCmd = (channel -> mode) == CMODE_READ ? CMD_READ : CMD_WRITE;
-
-        // check when the request can be issued
-        UPDATE_MAX(request -> currentCycle, bank -> nextIssueCycle[colCmd]);
-        UPDATE_MAX(request -> currentCycle, channel -> nextIssueCycle[colCmd]);
-
-        // if request is scheulable, schedule,
-        // mark request as served, send it back, and return
-        if (request -> currentCycle <= _currentCycle) {
-          ScheduleRequest(bank, colCmd, request);
-          if (colCmd == CMD_READ)
-            request -> currentCycle = _currentCycle + _tCL + _tBL;
-          else if (colCmd == CMD_WRITE)
-            request -> currentCycle = _currentCycle + _tCWL + _tBL;
-          request -> serviced = true;
-          channel -> queue[channel -> mode].erase(req);
-          // printf("Serve <- %X\n", request); // VIVEK
-          SendToNextComponent(request);
-          return;
+        // check for ready activate
+        else if (bank -> state == BANK_PRECHARGED) {
+          cycles_t issue = max(bank -> nextIssueCycle[CMD_ACT],
+                               rank -> nextActivate);
+          UPDATE_MAX(issue, bank -> group -> nextIssueCycle[CMD_ACT]);
+          UPDATE_MAX(issue, BusIssueCycle(channel, CMD_ACT));
+          DRAMRequestQueue::iterator req = pending.begin();
+          if (FirstReady(req, pending.end(), issue, ready) &&
+              (firstBank == NULL || req -> first < first -> first)) {
+            first = req;
+            firstBank = bank;
+            firstCmd = CMD_ACT;
+          }
         }
-        
-        rowHitPresent.set(request -> dramBankID);
       }
+    }
+
+    // if a column request is ready, schedule it, mark request as served,
+    // and send it back. else schedule the activate
+    if (firstBank != NULL) {
+      MemoryRequest *request = first -> second;
+      ScheduleRequest(firstBank, firstCmd, request);
+      if (firstCmd == CMD_ACT)
+        return _currentCycle;
+      if (colCmd == CMD_READ)
+        request -> currentCycle = _currentCycle + _tCL + _tBL;
+      else if (colCmd == CMD_WRITE)
+        request -> currentCycle = _currentCycle + _tCWL + _tBL;
+      request -> serviced = true;
+      DequeueRequest(mode, first -> first, request);
+      // printf("Serve <- %X\n", request); // VIVEK
+      SendToNextComponent(request);
+      return _currentCycle;
+    }
 
-      // check for ready activate
-      else if (bank -> state == BANK_PRECHARGED) {
-        // check when an activate is schedulable
-        UPDATE_MAX(request -> currentCycle, bank -> nextIssueCycle[CMD_ACT]);
-        UPDATE_MAX(request -> currentCycle, rank -> nextActivate);
+    // if there are no ready requests, a refresh that can wait is issued if
+    // it does not get in the way of the requests
+    if (_refreshEnabled && IssueRefresh(channel, false, ready))
+      return _currentCycle;
 
-        // if the request is schedulable, schedule and return
-        if (request -> currentCycle <= _currentCycle) {
-          ScheduleRequest(bank, CMD_ACT, request);
-          return;
+    // if there are no ready requests, then precharge the bank
+    // of the oldest request that can be precharged (a bank with
+    // no row hits)
+    DRAMRequestQueue::iterator firstPre;
+    DRAMBank *firstPreBank = NULL;
+    bool precharged = false;
+
+    FOR_EACH_RANK(channel) {
+      FOR_EACH_BANK(rank) {
+        DRAMRequestQueue &pending = bank -> pending[mode];
+        if (pending.empty() || bank -> refreshBlocked)
+          continue;
+        if (bank -> state == BANK_PRECHARGED) {
+          precharged = true;
+          continue;
+        }
+        if (RowHits(bank, mode) != NULL)
+          continue;
+        DRAMRequestQueue::iterator req = pending.begin();
+        cycles_t issue = max(bank -> nextIssueCycle[CMD_PRE],
+                             BusIssueCycle(channel, CMD_PRE));
+        if (FirstReady(req, pending.end(), issue, ready) &&
+            (firstPreBank == NULL || req -> first < firstPre -> first)) {
+          firstPre = req;
+          firstPreBank = bank;
         }
       }
     }
 
-    // if there are no ready requests, then precharge the bank
-    // corresponding to the first request
-    FOR_EACH_REQUEST(channel -> queue[channel -> mode]) {
-      MemoryRequest *request = *req;
-      
-      DRAMRank *rank = &(channel -> ranks[request -> dramRankID]);
-      DRAMBank *bank = &(rank -> banks[request -> dramBankID]);
+    // the requests of precharged banks older than the precharged one cannot
+    // be issued before the precharge cycle of their bank either
+    if (precharged) {
+      uint64 arrival = (firstPreBank != NULL) ? firstPre -> first :
+        channel -> arrivals;
+      cycles_t bus = BusIssueCycle(channel, CMD_PRE);
+      FOR_EACH_RANK(channel) {
+        FOR_EACH_BANK(rank) {
+          if (bank -> state != BANK_PRECHARGED || bank -> refreshBlocked)
+            continue;
+          cycles_t issue = max(bank -> nextIssueCycle[CMD_PRE], bus);
+          FOR_EACH_REQUEST(bank -> pending[mode]) {
+            if (req -> first >= arrival)
+              break;
+            UPDATE_MAX(req -> second -> currentCycle, issue);
+          }
+        }
+      }
+    }
+
+    if (firstPreBank != NULL) {
+      ScheduleRequest(firstPreBank, CMD_PRE, firstPre -> second);
+      return _currentCycle;
+    }
+
+    return ready;
+  }
+
+  // -------------------------------------------------------------------------
+  // Refresh. A rank owes a refresh every refresh interval (tREFI, or tREFI
+  // divided by the number of banks for per-bank refresh). Refreshes are
+  // postponed while the banks have requests and pulled in while they are
+  // idle, within the limits. A refresh that cannot be postponed any more is
+  // forced: the banks it refreshes take no other command until then.
+  // -------------------------------------------------------------------------
+
+  // how much a refresh of a bank gets in the way of its requests
+  enum RefreshCost {
+    REFRESH_IDLE_PRECHARGED,
+    REFRESH_IDLE,
+    REFRESH_PRECHARGED,
+    REFRESH_NO_ROW_HITS,
+    REFRESH_ROW_HITS
+  };
+
+  RefreshCost BankRefreshCost(DRAMBank *bank) {
+    bool precharged = bank -> state == BANK_PRECHARGED;
+    if (bank -> pending[CMODE_READ].empty() &&
+        bank -> pending[CMODE_WRITE].empty())
+      return precharged ? REFRESH_IDLE_PRECHARGED : REFRESH_IDLE;
+    if (precharged)
+      return REFRESH_PRECHARGED;
+    if (RowHits(bank, CMODE_READ) == NULL &&
+        RowHits(bank, CMODE_WRITE) == NULL)
+      return REFRESH_NO_ROW_HITS;
+    return REFRESH_ROW_HITS;
+  }
 
-      if (!rowHitPresent.test(request -> dramBankID)) {
-        // check when a precharge can be scheduled
-        UPDATE_MAX(request -> currentCycle, bank -> nextIssueCycle[CMD_PRE]);
+  // -------------------------------------------------------------------------
+  // Function to bring the refreshes owed by the ranks of a channel up to the
+  // current cycle, and to block the banks of the forced ones. Refreshes that
+  // fell due while the controller did not run (in functional mode) are not
+  // made up for beyond a forced one.
+  // -------------------------------------------------------------------------
+
+  void UpdateRefresh(DRAMChannel *channel, cycles_t &ready) {
+    FOR_EACH_RANK(channel) {
+      if (rank -> nextRefresh <= _currentCycle) {
+        uint64 due = (_currentCycle - rank -> nextRefresh) /
+          _refreshInterval + 1;
+        rank -> nextRefresh += due * _refreshInterval;
+        if (due > (uint64)(_refreshPostponeLimit + 1 - rank -> refreshesOwed))
+          rank -> refreshesOwed = _refreshPostponeLimit + 1;
+        else
+          rank -> refreshesOwed += due;
+      }
+      UPDATE_MIN(ready, rank -> nextRefresh);
 
-        // if the request is schedulable, schedule and return
-        if (request -> currentCycle <= _currentCycle) {
-          ScheduleRequest(bank, CMD_PRE, request);
-          return;
+      if (rank -> refreshesOwed <= _refreshPostponeLimit)
+        continue;
+      if (_perBankRefresh)
+        BlockForRefresh(RefreshTarget(rank, REFRESH_ROW_HITS));
+      else {
+        FOR_EACH_BANK(rank) {
+          BlockForRefresh(bank);
         }
       }
-      
-      // request cannot be scheduled this cycle anyway
-      else if (request -> currentCycle <= _currentCycle) {
-        request -> currentCycle = _currentCycle + _memProcessorRatio;
+    }
+  }
+
+  void BlockForRefresh(DRAMBank *bank) {
+    if (!bank -> refreshBlocked) {
+      bank -> refreshBlocked = true;
+      bank -> refreshBlockedSince = _currentCycle;
+    }
+  }
+
+  // -------------------------------------------------------------------------
+  // Function to pick the bank of the next per-bank refresh of a rank: the
+  // bank blocked for a forced refresh, else the bank not refreshed yet in
+  // this round whose refresh costs least (NULL if they all cost more than
+  // the given cost)
+  // -------------------------------------------------------------------------
+
+  DRAMBank *RefreshTarget(DRAMRank *rank, RefreshCost worst) {
+    DRAMBank *target = NULL;
+    RefreshCost targetCost = worst;
+    FOR_EACH_BANK(rank) {
+      if (bank -> refreshBlocked)
+        return bank;
+      if (bank -> refreshed)
+        continue;
+      RefreshCost cost = BankRefreshCost(bank);
+      if (cost <= worst && (target == NULL || cost < targetCost)) {
+        target = bank;
+        targetCost = cost;
       }
     }
+    return target;
+  }
+
+  // -------------------------------------------------------------------------
+  // Function to issue a command for the forced refreshes of a channel, or
+  // for the other ones: a refresh that fell due is issued if it does not
+  // close a row with pending hits, one pulled in only on idle banks. The
+  // open banks are precharged first. Returns true if a command was issued;
+  // otherwise the earliest cycle the command can be issued is brought down
+  // to.
+  // -------------------------------------------------------------------------
+
+  bool IssueRefresh(DRAMChannel *channel, bool forced, cycles_t &ready) {
+    FOR_EACH_RANK(channel) {
+      int32 owed = rank -> refreshesOwed;
+      if ((owed > _refreshPostponeLimit) != forced ||
+          owed <= -_refreshPullInLimit)
+        continue;
+      RefreshCost worst = forced ? REFRESH_ROW_HITS :
+        (owed > 0 ? REFRESH_NO_ROW_HITS : REFRESH_IDLE);
+
+      // banks to refresh
+      DRAMBank *first = rank -> banks;
+      DRAMBank *last = rank -> banks + _numBanks;
+      if (_perBankRefresh) {
+        first = RefreshTarget(rank, worst);
+        if (first == NULL)
+          continue;
+        last = first + 1;
+      }
+      else {
+        bool allowed = true;
+        FOR_EACH_BANK(rank) {
+          if (BankRefreshCost(bank) > worst)
+            allowed = false;
+        }
+        if (!allowed)
+          continue;
+      }
+
+      // precharge the open banks, then refresh
+      bool precharged = true;
+      cycles_t issue = BusIssueCycle(channel, CMD_REF);
+      for (DRAMBank *bank = first; bank < last; bank ++) {
+        if (bank -> state == BANK_ACTIVATED) {
+          precharged = false;
+          cycles_t pre = max(bank -> nextIssueCycle[CMD_PRE],
+                             BusIssueCycle(channel, CMD_PRE));
+          if (pre <= _currentCycle) {
+            ScheduleRequest(bank, CMD_PRE, NULL);
+            return true;
+          }
+          UPDATE_MIN(ready, pre);
+        }
+        UPDATE_MAX(issue, bank -> nextIssueCycle[CMD_REF]);
+      }
+      if (!precharged)
+        continue;
+      if (issue > _currentCycle) {
+        UPDATE_MIN(ready, issue);
+        continue;
+      }
+      for (DRAMBank *bank = first; bank < last; bank ++)
+        ScheduleRequest(bank, CMD_REF, NULL);
+      rank -> refreshesOwed --;
+
+      // start a new round of per-bank refreshes once all the banks are
+      // refreshed
+      if (_perBankRefresh) {
+        bool done = true;
+        FOR_EACH_BANK(rank) {
+          if (!bank -> refreshed)
+            done = false;
+        }
+        if (done) {
+          FOR_EACH_BANK(rank) {
+            bank -> refreshed = false;
+          }
+        }
+      }
+      return true;
+    }
+    return false;
   }
 
   void ScheduleRequest(DRAMBank *bank, DRAMCommand cmd,
@@ -644,6 +1318,15 @@ protected:
 
     DRAMChannel *channel = bank -> channel;
     DRAMRank *rank = bank -> rank;
+    DRAMBankGroup *group = bank -> group;
+
+    // the command bus takes one row and one column command per memory cycle
+    if (cmd == CMD_READ || cmd == CMD_WRITE)
+      UPDATE_MAX(channel -> bus -> nextColumnCommand,
+                 _currentCycle + _memProcessorRatio);
+    else
+      UPDATE_MAX(channel -> bus -> nextRowCommand,
+                 _currentCycle + _memProcessorRatio);
     
     switch (cmd) {
       
@@ -657,10 +1340,12 @@ protected:
       UPDATE_MAX(bank -> nextIssueCycle[CMD_WRITE], _currentCycle + _tRCD);
       UPDATE_MAX(bank -> nextIssueCycle[CMD_PRE], _currentCycle + _tRAS);
 
-      // update rank for tfaw
+      // update rank for tfaw and trrd, and the bank group for trrdl
       rank -> lastActivates.pop_front();
       rank -> lastActivates.push_back(_currentCycle);
-      rank -> nextActivate = rank -> lastActivates.front() + _tFAW;
+      rank -> nextActivate = max(rank -> lastActivates.front() + _tFAW,
+                                 _currentCycle + _tRRD);
+      UPDATE_MAX(group -> nextIssueCycle[CMD_ACT], _currentCycle + _tRRDL);
 
       // read act or write act
       bank -> numActs[channel -> mode] ++;
@@ -677,6 +1362,9 @@ protected:
       UPDATE_MAX(channel -> nextIssueCycle[CMD_READ], _currentCycle + _tCCD);
       UPDATE_MAX(channel -> nextIssueCycle[CMD_WRITE],
                  _currentCycle + _tCL + _tBL + _tRTW - _tCWL);
+      // and for the bank group
+      UPDATE_MAX(group -> nextIssueCycle[CMD_READ], _currentCycle + _tCCDL);
+      UPDATE_MAX(group -> nextIssueCycle[CMD_WRITE], _currentCycle + _tCCDL);
 
       break;
       
@@ -691,6 +1379,10 @@ protected:
       UPDATE_MAX(channel -> nextIssueCycle[CMD_WRITE], _currentCycle + _tCCD);
       UPDATE_MAX(channel -> nextIssueCycle[CMD_READ],
                  _currentCycle + _tCWL + _tBL + _tWTR);
+      // and for the bank group
+      UPDATE_MAX(group -> nextIssueCycle[CMD_WRITE], _currentCycle + _tCCDL);
+      UPDATE_MAX(group -> nextIssueCycle[CMD_READ],
+                 _currentCycle + _tCWL + _tBL + _tWTRL);
       break;
       
     case CMD_PRE:
@@ -700,7 +1392,22 @@ protected:
       UPDATE_MAX(bank -> nextIssueCycle[CMD_READ], _currentCycle + _tRP + _tRCD);
       UPDATE_MAX(bank -> nextIssueCycle[CMD_WRITE], _currentCycle + _tRP + _tRCD);
       UPDATE_MAX(bank -> nextIssueCycle[CMD_PRE], _currentCycle + _tRC);
+      UPDATE_MAX(bank -> nextIssueCycle[CMD_REF], _currentCycle + _tRP);
       break;
+
+    case CMD_REF: {
+      // no change to bank state. the bank is blocked until the refresh is
+      // done
+      cycles_t done = _currentCycle + (_perBankRefresh ? _tRFCpb : _tRFC);
+      UPDATE_MAX(bank -> nextIssueCycle[CMD_ACT], done);
+      UPDATE_MAX(bank -> nextIssueCycle[CMD_REF], done);
+      if (!bank -> refreshBlocked)
+        bank -> refreshBlockedSince = _currentCycle;
+      bank -> refreshBlockedCycles += done - bank -> refreshBlockedSince;
+      bank -> refreshBlocked = false;
+      bank -> refreshed = true;
+      break;
+    }
     }
   }
 };
@@ -191,6 +191,21 @@ class CmpDynamicLLC : public MemoryComponent {
     }
 
 
+    // -------------------------------------------------------------------------
+    // Function to save or restore the state of the component
+    // -------------------------------------------------------------------------
+
+    void CheckpointState(CheckpointFile &cp) {
+      MemoryComponent::CheckpointState(cp);
+      _tags.CheckpointState(cp);
+      CHECKPOINT(_occupancy);
+      CHECKPOINT(_hits);
+      CHECKPOINT(_misses);
+      CHECKPOINT(_victimHits);
+      CHECKPOINT(_victimMisses);
+    }
+
+
   protected:
 
     // -------------------------------------------------------------------------
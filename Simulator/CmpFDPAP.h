@@ -38,6 +38,7 @@ protected:
   uint32 _blockSize;
   uint32 _associativity;
   string _policy;
+  bool _flatTagStore;				// use the flat (structure of arrays) tag store
   uint32 _policyVal;
 
   uint32 _tagStoreLatency;
@@ -78,6 +79,7 @@ protected:
     
     TagEntry() {
       dirty = false;
+      lowPriority = false;
       prefState = NOT_PREFETCHED;
     }
    };
@@ -94,6 +96,13 @@ protected:
     uint64 cur_prefetches;
     uint64 cur_used;
     generic_tagstore_t <addr_t, bool> ipEAF;
+    friend void CheckpointTransfer(CheckpointFile &cp, AccuracyEntry &entry) {
+      CheckpointTransfer(cp, entry.avg_prefetches);
+      CheckpointTransfer(cp, entry.avg_used);
+      CheckpointTransfer(cp, entry.cur_prefetches);
+      CheckpointTransfer(cp, entry.cur_used);
+      entry.ipEAF.CheckpointState(cp);
+    }
   };
 
   vector <AccuracyEntry> _accuracyTable;
@@ -144,6 +153,7 @@ public:
     _tagStoreLatency = 6;
     _dataStoreLatency = 15;
     _policy = "lru";
+    _flatTagStore = true;
     _policyVal = 0;
     _accuracyTableSize = 128;
     _prefetchDistance = 24;
@@ -167,6 +177,7 @@ public:
       CMP_PARAMETER_UINT("block-size", _blockSize)
       CMP_PARAMETER_UINT("associativity", _associativity)
       CMP_PARAMETER_STRING("policy", _policy)
+      CMP_PARAMETER_BOOLEAN("flat-tag-store", _flatTagStore)
       CMP_PARAMETER_UINT("policy-value", _policyVal)
       CMP_PARAMETER_UINT("tag-store-latency", _tagStoreLatency)
       CMP_PARAMETER_UINT("data-store-latency", _dataStoreLatency)
@@ -219,7 +230,8 @@ public:
     // compute number of sets
     _numSets = (_size * 1024) / (_blockSize * _associativity);
     _numBlocks = _numSets * _associativity;
-    _tags.SetTagStoreParameters(_numSets, _associativity, _policy);
+    _tags.SetTagStoreParameters(_numSets, _associativity, _policy,
+                                _flatTagStore);
     _missCounter.resize(_numSets, 0);
     _procMisses.resize(_numCPUs, 0);
 
@@ -248,6 +260,20 @@ public:
   void HeartBeat(cycles_t hbCount) {
   }
 
+
+  // -------------------------------------------------------------------------
+  // Function to save or restore the state of the component
+  // -------------------------------------------------------------------------
+
+  void CheckpointState(CheckpointFile &cp) {
+    MemoryComponent::CheckpointState(cp);
+    _tags.CheckpointState(cp);
+    CHECKPOINT(_pval);
+    CHECKPOINT(_accuracyTable);
+    CHECKPOINT(_missCounter);
+    CHECKPOINT(_procMisses);
+  }
+
   void EndProcWarmUp(uint32 cpuID) {
     _procMisses[cpuID] = 0;
   }
@@ -47,6 +47,7 @@ protected:
   uint32 _blockSize;
   uint32 _associativity;
   string _policy;
+  bool _flatTagStore;				// use the flat (structure of arrays) tag store
   uint32 _policyVal;
 
   uint32 _tagStoreLatency;
@@ -98,6 +99,7 @@ public:
     _tagStoreLatency = 6;
     _dataStoreLatency = 15;
     _policy = "lru";
+    _flatTagStore = true;
     _policyVal = 0;
   }
 
@@ -119,6 +121,7 @@ public:
       CMP_PARAMETER_UINT("block-size", _blockSize)
       CMP_PARAMETER_UINT("associativity", _associativity)
       CMP_PARAMETER_STRING("policy", _policy)
+      CMP_PARAMETER_BOOLEAN("flat-tag-store", _flatTagStore)
       CMP_PARAMETER_UINT("policy-value", _policyVal)
       CMP_PARAMETER_UINT("tag-store-latency", _tagStoreLatency)
       CMP_PARAMETER_UINT("data-store-latency", _dataStoreLatency)
@@ -150,7 +153,8 @@ public:
 
     // compute number of sets
     _numSets = (_size * 1024) / (_blockSize * _associativity);
-    _tags.SetTagStoreParameters(_numSets, _associativity, _policy);
+    _tags.SetTagStoreParameters(_numSets, _associativity, _policy,
+                                _flatTagStore);
 
     switch (_policyVal) {
     case 0: _pval = POLICY_HIGH; break;
@@ -172,6 +176,19 @@ public:
   }
 
 
+  // -------------------------------------------------------------------------
+  // Function to save or restore the state of the component
+  // -------------------------------------------------------------------------
+
+  void CheckpointState(CheckpointFile &cp) {
+    MemoryComponent::CheckpointState(cp);
+    _tags.CheckpointState(cp);
+    CHECKPOINT(_pval);
+    CHECKPOINT(_hits);
+    CHECKPOINT(_misses);
+  }
+
+
 protected:
 
   // -------------------------------------------------------------------------
@@ -185,7 +202,7 @@ protected:
     // update stats
     INCREMENT(accesses);
 
-    table_t <addr_t, TagEntry>::entry tagentry;
+    generic_tagstore_t <addr_t, TagEntry>::handle block;
     cycles_t latency;
 
     // NO WRITES (Complete or partial)
@@ -208,8 +225,9 @@ protected:
 
       INCREMENT(reads);
           
-      tagentry = _tags.read(ctag);
-      if (tagentry.valid) {
+      block = _tags.find(ctag);
+      if (block.valid) {
+        _tags.read(block);
         request -> serviced = true;
         request -> AddLatency(_tagStoreLatency + _dataStoreLatency);
 
@@ -231,10 +249,11 @@ protected:
 
       INCREMENT(writebacks);
 
-      if (_tags.lookup(ctag))
-        _tags[ctag].dirty = true;
+      block = _tags.find(ctag);
+      if (block.valid)
+        block -> dirty = true;
       else
-        INSERT_BLOCK(ctag, true, request);
+        INSERT_BLOCK(block, ctag, true, request);
 
       request -> serviced = true;
       return _tagStoreLatency;
@@ -260,29 +279,32 @@ protected:
     addr_t ctag = VADDR(request) / _blockSize;
 
     // if the block is already present, return
-    if (_tags.lookup(ctag))
+    generic_tagstore_t <addr_t, TagEntry>::handle block = _tags.find(ctag);
+    if (block.valid)
       return 0;
 
-    INSERT_BLOCK(ctag, false, request);
+    INSERT_BLOCK(block, ctag, false, request);
 
     return 0;
   }
 
 
   // -------------------------------------------------------------------------
-  // Function to insert a block into the cache
+  // Function to insert a block into the cache. block is the handle from the
+  // lookup that missed.
   // -------------------------------------------------------------------------
 
-  void INSERT_BLOCK(addr_t ctag, bool dirty, MemoryRequest *request) {
+  void INSERT_BLOCK(generic_tagstore_t <addr_t, TagEntry>::handle &block,
+                    addr_t ctag, bool dirty, MemoryRequest *request) {
 
     table_t <addr_t, TagEntry>::entry tagentry;
 
     // insert the block into the cache
-    tagentry = _tags.insert(ctag, TagEntry(), _pval);
-    _tags[ctag].vcla = BLOCK_ADDRESS(VADDR(request), _blockSize);
-    _tags[ctag].pcla = BLOCK_ADDRESS(PADDR(request), _blockSize);
-    _tags[ctag].dirty = dirty;
-    _tags[ctag].appID = request -> cpuID;
+    tagentry = _tags.insert(block, ctag, TagEntry(), _pval);
+    block -> vcla = BLOCK_ADDRESS(VADDR(request), _blockSize);
+    block -> pcla = BLOCK_ADDRESS(PADDR(request), _blockSize);
+    block -> dirty = dirty;
+    block -> appID = request -> cpuID;
 
     // if the evicted tag entry is valid
     if (tagentry.valid) {
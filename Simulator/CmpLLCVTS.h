@@ -41,6 +41,7 @@ protected:
   uint32 _blockSize;
   uint32 _associativity;
   string _policy;
+  bool _flatTagStore;				// use the flat (structure of arrays) tag store
   uint32 _policyVal;
 
   uint32 _tagStoreLatency;
@@ -120,6 +121,7 @@ public:
     _tagStoreLatency = 6;
     _dataStoreLatency = 15;
     _policy = "drrip";
+    _flatTagStore = true;
     _ideal = false;
     _noClear = false;
     _decoupleClear = false;
@@ -149,6 +151,7 @@ public:
       CMP_PARAMETER_UINT("block-size", _blockSize)
       CMP_PARAMETER_UINT("associativity", _associativity)
       CMP_PARAMETER_STRING("policy", _policy)
+      CMP_PARAMETER_BOOLEAN("flat-tag-store", _flatTagStore)
       CMP_PARAMETER_UINT("tag-store-latency", _tagStoreLatency)
       CMP_PARAMETER_UINT("data-store-latency", _dataStoreLatency)
       CMP_PARAMETER_UINT("num-dueling-sets", _numDuelingSets)
@@ -189,7 +192,8 @@ public:
 
     // compute number of sets
     _numSets = (_size * 1024) / (_blockSize * _associativity);
-    _tags.SetTagStoreParameters(_numSets, _associativity, _policy);
+    _tags.SetTagStoreParameters(_numSets, _associativity, _policy,
+                                _flatTagStore);
     _occupancy.resize(_numCPUs, 0);
     _vts.initialize(_numSets * _associativity, _useBloomFilter,
                     _ideal, _noClear, _decoupleClear, _segmented, _alpha);
@@ -237,6 +241,22 @@ public:
   }
 
 
+  // -------------------------------------------------------------------------
+  // Function to save or restore the state of the component
+  // -------------------------------------------------------------------------
+
+  void CheckpointState(CheckpointFile &cp) {
+    MemoryComponent::CheckpointState(cp);
+    _tags.CheckpointState(cp);
+    CHECKPOINT(_psel);
+    CHECKPOINT(_sets);
+    CHECKPOINT(_occupancy);
+    CHECKPOINT(_hits);
+    CHECKPOINT(_misses);
+    _vts.CheckpointState(cp);
+  }
+
+
   void EndSimulation() {
     CMP_LOG("false_positives = %lf", _vts.false_positive_rate());
     DUMP_STATISTICS;
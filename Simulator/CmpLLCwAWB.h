@@ -63,6 +63,7 @@ protected:
   uint32 _associativity;
   string _policy;
   string _dbipolicy;
+  bool _flatDBI;				// use the flat (structure of arrays) tag store for the DBI
   uint32 _policyVal;
   uint32 _dbiPolicyVal;
 
@@ -174,6 +175,7 @@ public:
     _dataStoreLatency = 15;
     _policy = "lru";
     _dbipolicy = "drrip";
+    _flatDBI = false;
     _policyVal = 0;
     _dbiPolicyVal = 0;
     _dbiSize = 128;
@@ -207,6 +209,7 @@ public:
       CMP_PARAMETER_UINT("associativity", _associativity)
       CMP_PARAMETER_STRING("policy", _policy)
       CMP_PARAMETER_STRING("dbi-policy", _dbipolicy)
+      CMP_PARAMETER_BOOLEAN("flat-dbi", _flatDBI)
       CMP_PARAMETER_UINT("policy-value", _policyVal)
       CMP_PARAMETER_UINT("dbi-policy-value", _dbiPolicyVal)
       CMP_PARAMETER_UINT("tag-store-latency", _tagStoreLatency)
@@ -265,7 +268,7 @@ public:
     _tags.SetTagStoreParameters(_numCPUs, _numSets, _associativity, _policy, _numDuelingSets, _maxPSELValue);		// for dynamic bypass
     //_tags.SetTagStoreParameters(_numCPUs, _numSets, _associativity, _policy, _numDuelingSets);    			// for lru bypass 
     //_tags.SetTagStoreParameters(_numSets, _associativity, _policy);							// for AWB without bypass, ie using a generic tagstore
-    _dbi.SetTagStoreParameters(_numdbiSets, 16, _dbipolicy);  
+    _dbi.SetTagStoreParameters(_numdbiSets, 16, _dbipolicy, _flatDBI);  
 
     switch (_policyVal) {
     case 0: _pval = POLICY_HIGH; break;
@@ -316,6 +319,30 @@ public:
   }
 
 
+  // -------------------------------------------------------------------------
+  // Function to save or restore the state of the component
+  // -------------------------------------------------------------------------
+
+  void CheckpointState(CheckpointFile &cp) {
+    MemoryComponent::CheckpointState(cp);
+    _tags.CheckpointState(cp);
+    _dbi.CheckpointState(cp);
+    CHECKPOINT(_pval);
+    CHECKPOINT(_dbipval);
+    CHECKPOINT(_hitsHIGH);
+    CHECKPOINT(_missesHIGH);
+    CHECKPOINT(_hitsBIMODAL);
+    CHECKPOINT(_missesBIMODAL);
+    CHECKPOINT(_bypass);
+    CHECKPOINT(milestone);
+    CHECKPOINT(_epoch);
+    CHECKPOINT(missRateHIGH);
+    CHECKPOINT(missRateBIMODAL);
+    CHECKPOINT(cleanRow);
+    CHECKPOINT(_cleanFlag);
+  }
+
+
 protected:
 
   // -------------------------------------------------------------------------
@@ -355,6 +382,8 @@ protected:
 
     table_t <addr_t, TagEntry>::entry tagentry;
     table_t <addr_t, DBIEntry>::entry dbientry;
+    set_dueling_tagstore_t <addr_t, TagEntry>::handle block;
+    generic_tagstore_t <addr_t, DBIEntry>::handle row;
     cycles_t latency;
 
     // NO WRITES (Complete or partial)
@@ -375,11 +404,12 @@ protected:
 
       if((!_doBypass)||(!_bypass[request->cpuID]) || ((_tags._type[setIndex].leader)&&(_tags._type[setIndex].appID==request->cpuID))){
       //if(!_doBypass){																// for plain AWB without bypass
-      tagentry = _tags.read(ctag);
+      block = _tags.find(ctag);
       INCREMENT(accesses); 
       INCREMENT(reads);
 
-      if (tagentry.valid) {
+      if (block.valid) {
+        _tags.read(block);
         request -> serviced = true;
         request -> AddLatency(_tagStoreLatency + _dataStoreLatency);
 
@@ -414,7 +444,8 @@ protected:
          // first of all, add dbi lookup delay to request
          //On a bypass read,check the dbi, if not present, don't do anything
          //If present, do dbi read, set request as served, 
-         if(_dbi.lookup(logicalRow) && (_dbi[logicalRow].dirtyBits[ctag % _granularity])){
+         row = _dbi.find(logicalRow);
+         if(row.valid && (row -> dirtyBits[ctag % _granularity])){
 	 request -> serviced = true;
          INCREMENT(dbi_hits);
          request -> AddLatency(_dbiLatency + _tagStoreLatency + _dataStoreLatency);		// after checking DBI, it will go to tagstore to read it     
@@ -433,24 +464,26 @@ protected:
       INCREMENT(accesses);
       INCREMENT(writebacks);
 
-      if (_tags.lookup(ctag)){
+      block = _tags.find(ctag);
+      if (block.valid){
 	INCREMENT(writebackhits);
         //_tags[ctag].dirty = true;        
 
-        if(_dbi.lookup(logicalRow)){	
+        row = _dbi.find(logicalRow);
+        if(row.valid){	
         INCREMENT(dbi_reads);
-	_dbi[logicalRow].dirtyBits.set(ctag % _granularity);	
+	row -> dirtyBits.set(ctag % _granularity);	
 	// Not all clean blocks are guaranteed to have their dirty bit info in the DBI
         //INCREMENT(dbi_hits);
 	// dummy read to update with replacement policy
-        _dbi.read(logicalRow);
+        _dbi.read(row);
         }
 
 	else{
 	table_t <addr_t, DBIEntry>::entry dbientry;    
 	
         //INCREMENT(dbi_misses);
-	HANDLE_DBI_INSERTION(ctag, request, dbientry, true);
+	HANDLE_DBI_INSERTION(ctag, request, dbientry, row);
 // this will handle dbi insertion when dbi entry is not present  
 	 }   
         }
@@ -458,7 +491,7 @@ protected:
       else {
 	INCREMENT(writebackmisses);
 
-        INSERT_BLOCK(ctag, true, request);
+        INSERT_BLOCK(block, ctag, true, request);
       }
 
 
@@ -469,19 +502,21 @@ protected:
      case MemoryRequest::CLEAN:
 
      // check if the row hasn't been cleaned yet and the that the corresponding dbientry still exists
-        if((!_cleanFlag)&&_dbi.lookup(cleanRow)){
+        if(!_cleanFlag) row = _dbi.find(cleanRow);
+
+        if((!_cleanFlag)&&row.valid){
 
            // We don't count DBI hits because for these accesses, misses don't hurt us           
-           if(!_dbi[cleanRow].dirtyBits.any()){		// row has been cleaned, no cleaning operation left
+           if(!row -> dirtyBits.any()){		// row has been cleaned, no cleaning operation left
              // Should we invalidate it ? 
-             _dbi.invalidate(cleanRow);
+             _dbi.invalidate(row);
              _cleanFlag = true;
              request -> serviced = true;
              }
 
            else{
            int i=0;
-           while(!_dbi[cleanRow].dirtyBits[i])	i++;
+           while(!row -> dirtyBits[i])	i++;
            
            addr_t wbtag = (cleanRow * _granularity) + i;
            TagEntry wbentry = _tags[wbtag];
@@ -495,13 +530,13 @@ protected:
            writeback -> icount = request -> icount;
            writeback -> ip = request -> ip;
            SendToNextComponent(writeback);
-           _dbi[cleanRow].dirtyBits.reset(i);
+           row -> dirtyBits.reset(i);
            }
 
         }
 
      //  if row is not clean and its dbientry doesn't exist, it means that row has been evicted and its dirty blocks cleaned
-        else if((!_cleanFlag)&&(!_dbi.lookup(cleanRow))){
+        else if((!_cleanFlag)&&(!row.valid)){
 	  // We don't count a DBI miss for this part because a dbi miss doesn't harm us
           _cleanFlag = true;
           request -> serviced = true;
@@ -541,10 +576,11 @@ protected:
     addr_t ctag = VADDR(request) / _blockSize;
 
     // if the block is already present, return
-    if (_tags.lookup(ctag))
+    set_dueling_tagstore_t <addr_t, TagEntry>::handle block = _tags.find(ctag);
+    if (block.valid)
       return 0;
 
-    INSERT_BLOCK(ctag, false, request);
+    INSERT_BLOCK(block, ctag, false, request);
 
     return 0;
     }
@@ -554,48 +590,42 @@ protected:
 
 
    // ----------------------------------------------------------------------
-   // Overriding ProcessPendingRequests to enforce priority of demand
+   // Overriding ProcessNextRequest to enforce priority of demand
    // accesses over DRAM aware writebacks, i.e clean requests
    // ---------------------------------------------------------------------- 
   
-    void ProcessPendingRequests() {
-
-      // if already processing, return
-      if (_processing) return;
-      _processing = true;
+    bool ProcessNextRequest() {
 
       // if the queue is empty, return
-      if (_queue.empty()) {
-        _processing = false;
-        return;
-      }
+      if (_queue.empty())
+        return false;
 
       // get the request on the top of the queue
-      pick : MemoryRequest *request = _queue.top();
+      MemoryRequest *request = _queue.top();
 
-      while (request -> currentCycle <= (*_simulatorCycle)) {
-        
-        _queue.pop();
+      if (request -> currentCycle > (*_simulatorCycle))
+        return false;
 
-        if (_currentCycle > (*_simulatorCycle)) {
-          request -> currentCycle = _currentCycle;
-          _queue.push(request);
-        }
+      _queue.pop();
 
-        // else process the request
-        else {
-          // get actual current time
-          cycles_t now = max(request -> currentCycle, _currentCycle);
-          _currentCycle = now;
-          // if request is serviced, process return of request
-          if (request -> serviced) {
-            // CHECK
-            cycles_t busyCycles = ProcessReturn(request);
-            _currentCycle += busyCycles;
-            SendToNextComponent(request);
-          }
+      if (_currentCycle > (*_simulatorCycle)) {
+        request -> currentCycle = _currentCycle;
+        _queue.push(request);
+        return false;
+      }
+
+      // get actual current time
+      cycles_t now = max(request -> currentCycle, _currentCycle);
+      _currentCycle = now;
+      // if request is serviced, process return of request
+      if (request -> serviced) {
+        // CHECK
+        cycles_t busyCycles = ProcessReturn(request);
+        _currentCycle += busyCycles;
+        PassToNextComponent(request);
+      }
 	// request is yet to be serviced
-          else {
+      else {
 
 	   // Check if it's a CLEAN request
            // if true, check for other READ requests, if present, then return 
@@ -624,48 +654,37 @@ protected:
 		if(ReadsPresent){
 		request -> currentCycle += 1;
 		_queue.push(request);
-		goto pick;
+		return true;
 		}
 	   }
 
-            request -> currentCycle = now;
-            cycles_t busyCycles = ProcessRequest(request);
-            _currentCycle += busyCycles;
-            SendToNextComponent(request);
-          }
-
-          // if queue is empty, return
-          if (_queue.empty()) {
-            _processing = false;
-            return;
-          }
-
-          // get the request on top of the queue
-          request = _queue.top();
-        }
+        request -> currentCycle = now;
+        cycles_t busyCycles = ProcessRequest(request);
+        _currentCycle += busyCycles;
+        PassToNextComponent(request);
       }
 
-      _processing = false;
+      return true;
     }
 
   // -------------------------------------------------------------------------
   // Function to insert a block into the cache
-  // Should check for DBI evictions also
+  // Should check for DBI evictions also. block is the handle from the tag
+  // store lookup that missed.
   // -------------------------------------------------------------------------
 
-  void INSERT_BLOCK(addr_t ctag, bool dirty, MemoryRequest *request) {
+  void INSERT_BLOCK(set_dueling_tagstore_t <addr_t, TagEntry>::handle &block,
+                    addr_t ctag, bool dirty, MemoryRequest *request) {
 
     INCREMENT(insertions);
 
     table_t <addr_t, TagEntry>::entry tagentry;
     table_t <addr_t, DBIEntry>::entry dbientry;
     
-    bool DBIevictedEntry;			// indicates if dbientry is evicted or was already present, true if evicted
-
     addr_t logicalRow = ctag / _granularity;	
 
     
-    DBIevictedEntry = !(_dbi.lookup(logicalRow));
+    generic_tagstore_t <addr_t, DBIEntry>::handle row = _dbi.find(logicalRow);
 
 /*
 The following FSM has been implemented :
@@ -681,7 +700,7 @@ The following FSM has been implemented :
 
 // How to differentiate between evicted and already present, use evictedEntry and lookup
 
-if(dirty)	HANDLE_DBI_INSERTION(ctag, request, dbientry, DBIevictedEntry);
+if(dirty)	HANDLE_DBI_INSERTION(ctag, request, dbientry, row);
     
 // 3. and 4.
 
@@ -689,7 +708,7 @@ if(dirty)	HANDLE_DBI_INSERTION(ctag, request, dbientry, DBIevictedEntry);
 // If policy is plain fucking lru, then _pval is always POLICY_HIGH
 // With dip, _pval is chosen between POLICY_HIGH and POLICY_BIMODAL
 
-tagentry = _tags.insert(request -> cpuID, ctag, TagEntry(), ~dirty);				// insertion for dynamic bypass
+tagentry = _tags.insert(block, request -> cpuID, ctag, TagEntry(), ~dirty);				// insertion for dynamic bypass
 
 //tagentry = _tags.insert(ctag, TagEntry());						// insertion for lru bypass, always with POLICY_HIGH
 
@@ -698,9 +717,9 @@ tagentry = _tags.insert(request -> cpuID, ctag, TagEntry(), ~dirty);				// inser
 // this has to be an eviction always
 
     
-    _tags[ctag].vcla = BLOCK_ADDRESS(VADDR(request), _blockSize);
-    _tags[ctag].pcla = BLOCK_ADDRESS(PADDR(request), _blockSize);
-    _tags[ctag].appID = request -> cpuID;
+    block -> vcla = BLOCK_ADDRESS(VADDR(request), _blockSize);
+    block -> pcla = BLOCK_ADDRESS(PADDR(request), _blockSize);
+    block -> appID = request -> cpuID;
        
     if (tagentry.valid) {
 
@@ -715,7 +734,9 @@ bool specialCase = false;
 // specialCase is that when the evicted dbientry contains the dirty bit info for the evicted tagstore entry(which happens to be 
 // dirty) as well
 
-    if (((_dbi.lookup((tagentry.key) / _granularity))&&(_dbi[(tagentry.key) / _granularity].dirtyBits[(tagentry.key) % _granularity])) || specialCase){
+    generic_tagstore_t <addr_t, DBIEntry>::handle evictedRow = _dbi.find((tagentry.key) / _granularity);
+
+    if (((evictedRow.valid)&&(evictedRow -> dirtyBits[(tagentry.key) % _granularity])) || specialCase){
 // this checks if evicted tagentry has entry in dbi			
 // dbientry is generated only in case of dirty = true 
 // check if evicted tagentry still has its dirty info in dbi OR
@@ -725,12 +746,12 @@ bool specialCase = false;
         INCREMENT(dirty_evictions);
 
         // We should check if the dbientry is still present in the DBI, only then clean the corresponding bit
-	if(_dbi.lookup((tagentry.key) / _granularity))	
-	_dbi[(tagentry.key) / _granularity].dirtyBits.reset((tagentry.key) % _granularity);
+	if(evictedRow.valid)	
+	evictedRow -> dirtyBits.reset((tagentry.key) % _granularity);
         // This is a cleaning operation, clean entry in DBI if present
 
         // ********   also invalidate row if it was the last set bit
-        if(!(_dbi[(tagentry.key) / _granularity].dirtyBits.any()))	_dbi.invalidate((tagentry.key) / _granularity);
+        if(!(evictedRow -> dirtyBits.any()))	_dbi.invalidate(evictedRow);
 
         MemoryRequest *writeback =
           new MemoryRequest(MemoryRequest::COMPONENT, request -> cpuID, this,
@@ -744,7 +765,7 @@ bool specialCase = false;
 	writeback -> teEviction = true;
         SendToNextComponent(writeback);
         // Generate CLEAN request if no clean requests for previous rows pending and most importantly, if aggressive writeback is enabled
-        if(_cleanFlag && (_dbi.lookup((tagentry.key) / _granularity)) && _doAWB){
+        if(_cleanFlag && (evictedRow.valid) && _doAWB){
         // we would not want to generate clean request when we have inserted new dbientry, as it will be a clean row
         MemoryRequest *clean =
           new MemoryRequest(MemoryRequest::COMPONENT, request -> cpuID, this,
@@ -765,9 +786,13 @@ bool specialCase = false;
   
   }
 
-void HANDLE_DBI_INSERTION(addr_t ctag, MemoryRequest *request, table_t <addr_t, DBIEntry>::entry &dbientry, bool DBIevictedEntry){
+// row is the handle from the DBI lookup of the block's logical row
+
+void HANDLE_DBI_INSERTION(addr_t ctag, MemoryRequest *request, table_t <addr_t, DBIEntry>::entry &dbientry, generic_tagstore_t <addr_t, DBIEntry>::handle &row){
 
     INCREMENT(dbi_insertions);
+
+    bool DBIevictedEntry = !row.valid;			// indicates if dbientry is evicted or was already present, true if evicted
  
     addr_t logicalRow = ctag / _granularity;	
 
@@ -788,6 +813,7 @@ void HANDLE_DBI_INSERTION(addr_t ctag, MemoryRequest *request, table_t <addr_t,
 			        _dbi.insert(logicalRow, DBIEntry());
 			}
 			else dbientry = _dbi.insert(logicalRow, DBIEntry());
+			row = _dbi.find(logicalRow);
 		}
 
 
@@ -807,12 +833,14 @@ void HANDLE_DBI_INSERTION(addr_t ctag, MemoryRequest *request, table_t <addr_t,
 			        _dbi.insert(logicalRow, DBIEntry());
 			}
 			else dbientry = _dbi.insert(logicalRow, DBIEntry());
+			row = _dbi.find(logicalRow);
 		}
 
 
-    else dbientry = _dbi.insert(logicalRow, DBIEntry(), _dbipval);
+    else if (row.valid) dbientry = _dbi.entry_at_location(row.set, row.slot);
+    else dbientry = _dbi.insert(row, logicalRow, DBIEntry(), _dbipval);
    
-    _dbi[logicalRow].dirtyBits.set(ctag % _granularity);
+    row -> dirtyBits.set(ctag % _granularity);
 
   
 // 2. 
@@ -826,7 +854,8 @@ void HANDLE_DBI_INSERTION(addr_t ctag, MemoryRequest *request, table_t <addr_t,
 	          
 	  // now check if the corresponding block is present in the tagstore
 	  // if not, no need to generate writebacks
-	  if(_tags.lookup(discardtag)){
+	  set_dueling_tagstore_t <addr_t, TagEntry>::handle discard = _tags.find(discardtag);
+	  if(discard.valid){
           
 	  // we have to generate writebacks and remove tagstore entries too
 	  // if we do not remove the tagstore entries, we may have cases where tagentry is there but dbientry is not
@@ -834,7 +863,7 @@ void HANDLE_DBI_INSERTION(addr_t ctag, MemoryRequest *request, table_t <addr_t,
 	  //table_t <addr_t, TagEntry>::entry discardentry;
 	  //discardentry = _tags.invalidate(discardtag); // Shouldn't do this ?
           
-	  TagEntry discardentry = _tags[discardtag]; 
+	  TagEntry discardentry = *discard.value; 
           MemoryRequest *writeback =
           new MemoryRequest(MemoryRequest::COMPONENT, request -> cpuID, this,
                             MemoryRequest::WRITEBACK, request -> cmpID, 
@@ -108,6 +108,38 @@ class CmpMSHR : public MemoryComponent {
     }
 
 
+    // -------------------------------------------------------------------------
+    // Function to save or restore the state of the component
+    // -------------------------------------------------------------------------
+
+    void CheckpointState(CheckpointFile &cp) {
+      MemoryComponent::CheckpointState(cp);
+      CHECKPOINT(_missed);
+      CHECKPOINT(_waitQ);
+      CHECKPOINT(_outstanding);
+      CHECKPOINT(_handler);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to access the component in functional mode. A miss sent in
+    // functional mode returns before the access is over, so only a miss left
+    // from the timing model can still be outstanding: a request for its block
+    // does not wait for it (the block is filled when it returns). The number
+    // of misses is not limited.
+    // -------------------------------------------------------------------------
+
+    void FunctionalAccess(MemoryRequest *request) {
+      addr_t blockAddr = ((request -> physicalAddress)/_blockSize)*_blockSize;
+      if (!request -> serviced && request -> type != MemoryRequest::WRITEBACK &&
+          _missed.find(blockAddr) != _missed.end()) {
+        request -> serviced = true;
+        return;
+      }
+      MemoryComponent::FunctionalAccess(request);
+    }
+
+
   // override earliest request
   MemoryRequest *EarliestRequest() {
 
@@ -197,7 +229,7 @@ class CmpMSHR : public MemoryComponent {
       }
 
       // if there are no free MSHRs, stall the request
-      if (_count != 0) {
+      if (_count != 0 && !_functional) {
         if (_missed.size() == _count) {
           request -> stalling = true;
           _waitQ.push_back(request);
@@ -14,6 +14,7 @@
 
 #include "MemoryComponent.h"
 #include "Types.h"
+#include "DRAMAddressMapping.h"
 
 // -----------------------------------------------------------------------------
 // Standard includes
@@ -38,6 +39,11 @@ protected:
   uint32 _numBanks;
   uint32 _rowSize;
 
+  // address mapping (see DRAMAddressMapping.h). The row size is in bytes:
+  // a column is a byte
+  string _addressMapping;
+  string _addressHash;
+
   string _schedAlgo;
 
   
@@ -64,6 +70,8 @@ protected:
   // last operation type
   MemoryRequest::Type _lastOp;
 
+  DRAMAddressMapping _mapping;
+
   // open row in each bank
   vector <addr_t> _openRow;
 
@@ -98,6 +106,8 @@ public:
 
     _numBanks = 8;
     _rowSize = 8192;
+    _addressMapping = "rbc";
+    _addressHash = "";
     _rowHitLatency = 14;
     _rowConflictLatency = 34;
     _readToWriteLatency = 2;
@@ -124,6 +134,8 @@ public:
       // Add the list of parameters to the component here
       CMP_PARAMETER_UINT("num-banks", _numBanks)
       CMP_PARAMETER_UINT("row-size", _rowSize)
+      CMP_PARAMETER_STRING("address-mapping", _addressMapping)
+      CMP_PARAMETER_STRING("address-hash", _addressHash)
       CMP_PARAMETER_UINT("num-write-buffer-entries", _numWriteBufferEntries)
       CMP_PARAMETER_STRING("scheduling-algo", _schedAlgo)
       CMP_PARAMETER_UINT("row-hit-latency", _rowHitLatency)
@@ -163,6 +175,12 @@ public:
 
   void StartSimulation() {
     _openRow.resize(_numBanks, 0);
+    addr_t entries[NUM_DRAM_FIELDS];
+    for (int i = 0; i < NUM_DRAM_FIELDS; i ++)
+      entries[i] = 1;
+    entries[DRAM_BANK] = _numBanks;
+    entries[DRAM_COLUMN] = _rowSize;
+    _mapping.Initialize(_addressMapping, _addressHash, entries, 1);
     NextRequest = GetSchedulingAlgorithmFunction(_schedAlgo);
     _drain = false;
     _lastOp = MemoryRequest::READ;
@@ -185,6 +203,33 @@ public:
   }
 
 
+  // -------------------------------------------------------------------------
+  // Function to save or restore the state of the component
+  // -------------------------------------------------------------------------
+
+  void CheckpointState(CheckpointFile &cp) {
+    MemoryComponent::CheckpointState(cp);
+    CHECKPOINT(_readQ);
+    CHECKPOINT(_writeQ);
+    CHECKPOINT(_writeQdwb);
+    CHECKPOINT(_lastOp);
+    CHECKPOINT(_openRow);
+    CHECKPOINT(_drain);
+    CHECKPOINT(_writeRowHits);
+    CHECKPOINT(_readRowHits);
+    CHECKPOINT(openWriteBuffer);
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to access the component in functional mode. Nothing is
+  // scheduled: the request is serviced at once.
+  // -------------------------------------------------------------------------
+
+  void FunctionalAccess(MemoryRequest *request) {
+  }
+
+
   void EndSimulation() {
     DUMP_STATISTICS;
     CLOSE_ALL_LOGS;
@@ -246,9 +291,10 @@ protected:
 
       
     // Get the row address of the request
-    addr_t logicalRow = (request -> virtualAddress) / _rowSize;
-    uint32 bankIndex = logicalRow % _numBanks;
-    uint32 rowID = logicalRow / _numBanks;
+    addr_t fields[NUM_DRAM_FIELDS];
+    _mapping.Map(request -> virtualAddress, fields);
+    uint32 bankIndex = fields[DRAM_BANK];
+    uint32 rowID = fields[DRAM_ROW];
 
     // check if the access is a row hit or conflict
     if (_openRow[bankIndex] == rowID) {
@@ -279,21 +325,34 @@ protected:
 
 
   // -------------------------------------------------------------------------
-  // Overriding process pending requests. To do batch processing
+  // Overriding the wake-up cycle: the next request to take in, or the
+  // current cycle if the scheduler has a request to pick. Writes wait in the
+  // write queue until it is full, so they alone do not wake the controller.
   // -------------------------------------------------------------------------
 
+  cycles_t NextWakeUpCycle() {
+    cycles_t wake = WAKE_UP_NEVER;
+    if (!_queue.empty())
+      wake = _queue.top() -> currentCycle;
+    if (!_readQ.empty() || (_drain && !_writeQ.empty()) ||
+        _writeQ.size() >= _numWriteBufferEntries)
+      wake = min(wake, _currentCycle);
+    return wake;
+  }
+
 
-  void ProcessPendingRequests() {
+  // -------------------------------------------------------------------------
+  // Overriding process next request. To do batch processing: a step takes
+  // all the requests up to the simulator cycle, so there is never a next one
+  // -------------------------------------------------------------------------
 
-    // if processing return
-    if (_processing) return;
-    _processing = true;
+
+  bool ProcessNextRequest() {
 
     // if the request queue is empty return
     if (_queue.empty() && _readQ.empty() && _writeQ.empty() 
         && _readRowHits.empty() && _writeRowHits.empty()) {
-      _processing = false;
-      return;
+      return false;
     }
 
     MemoryRequest *request;
@@ -360,7 +419,7 @@ protected:
       SendToNextComponent(request);
     }
 
-    _processing = false;
+    return false;
   }
 
 
@@ -369,9 +428,10 @@ protected:
   // -------------------------------------------------------------------------
 
   bool IsRowBufferHit(MemoryRequest *request) {
-    addr_t logicalRow = (request -> virtualAddress) / _rowSize;
-    uint32 bankIndex = logicalRow % _numBanks;
-    addr_t rowID = logicalRow / _numBanks;
+    addr_t fields[NUM_DRAM_FIELDS];
+    _mapping.Map(request -> virtualAddress, fields);
+    uint32 bankIndex = fields[DRAM_BANK];
+    addr_t rowID = fields[DRAM_ROW];
     if (_openRow[bankIndex] == rowID)
       return true;
     return false;
@@ -39,6 +39,7 @@ protected:
   uint32 _blockSize;
   uint32 _associativity;
   string _policy;
+  bool _flatTagStore;				// use the flat (structure of arrays) tag store
   uint32 _policyVal;
 
   uint32 _tagStoreLatency;
@@ -140,6 +141,7 @@ public:
     _tagStoreLatency = 6;
     _dataStoreLatency = 15;
     _policy = "lru";
+    _flatTagStore = true;
     _policyVal = 0;
     _pselThreshold = 1024;
     _pacmanH = true;
@@ -164,6 +166,7 @@ public:
       CMP_PARAMETER_UINT("block-size", _blockSize)
       CMP_PARAMETER_UINT("associativity", _associativity)
       CMP_PARAMETER_STRING("policy", _policy)
+      CMP_PARAMETER_BOOLEAN("flat-tag-store", _flatTagStore)
       CMP_PARAMETER_UINT("policy-value", _policyVal)
       CMP_PARAMETER_UINT("tag-store-latency", _tagStoreLatency)
       CMP_PARAMETER_UINT("data-store-latency", _dataStoreLatency)
@@ -211,7 +214,8 @@ public:
 
     // compute number of sets
     _numSets = (_size * 1024) / (_blockSize * _associativity);
-    _tags.SetTagStoreParameters(_numSets, _associativity, _policy);
+    _tags.SetTagStoreParameters(_numSets, _associativity, _policy,
+                                _flatTagStore);
     _missCounter.resize(_numSets, 0);
     _procMisses.resize(_numCPUs, 0);
 
@@ -247,6 +251,21 @@ public:
   void HeartBeat(cycles_t hbCount) {
   }
 
+
+  // -------------------------------------------------------------------------
+  // Function to save or restore the state of the component
+  // -------------------------------------------------------------------------
+
+  void CheckpointState(CheckpointFile &cp) {
+    MemoryComponent::CheckpointState(cp);
+    _tags.CheckpointState(cp);
+    CHECKPOINT(_pval);
+    CHECKPOINT(_duelInfo);
+    CHECKPOINT(_psel);
+    CHECKPOINT(_missCounter);
+    CHECKPOINT(_procMisses);
+  }
+
   void EndProcWarmUp(uint32 cpuID) {
     _procMisses[cpuID] = 0;
   }
@@ -283,6 +302,7 @@ protected:
     // compute the cache block tag
     addr_t ctag = VADDR(request) / _blockSize;
     uint32 index = _tags.index(ctag);
+    generic_tagstore_t <addr_t, TagEntry>::handle block = _tags.find(ctag);
 
     // check if its a read or write back
     switch (request -> type) {
@@ -293,16 +313,16 @@ protected:
 
       INCREMENT(reads);
           
-      if (_tags.lookup(ctag)) {
+      if (block.valid) {
 
         request -> serviced = true;
         request -> AddLatency(_tagStoreLatency + _dataStoreLatency);
 
         // read to update replacement policy
-        _tags.read(ctag);
+        _tags.read(block);
         
         // read to update state
-        TagEntry &tagentry = _tags[ctag];
+        TagEntry &tagentry = *block.value;
 
         tagentry.lowPriority = false;
         
@@ -357,15 +377,15 @@ protected:
 
       INCREMENT(prefetches);
       
-      if (_tags.lookup(ctag)) {
+      if (block.valid) {
         request -> serviced = true;
         request -> AddLatency(_tagStoreLatency + _dataStoreLatency);
         
-        _tags[ctag].lowPriority = false;
+        block -> lowPriority = false;
 
         // read to update replacement policy
         if (!_pacmanH)
-          _tags.read(ctag);
+          _tags.read(block);
       }
       else {
         INCREMENT(prefetch_misses);
@@ -381,10 +401,10 @@ protected:
 
       INCREMENT(writebacks);
 
-      if (_tags.lookup(ctag))
-        _tags[ctag].dirty = true;
+      if (block.valid)
+        block -> dirty = true;
       else
-        INSERT_BLOCK(ctag, true, request);
+        INSERT_BLOCK(block, ctag, true, request);
 
       request -> serviced = true;
       return _tagStoreLatency;
@@ -410,20 +430,23 @@ protected:
     addr_t ctag = VADDR(request) / _blockSize;
 
     // if the block is already present, return
-    if (_tags.lookup(ctag))
+    generic_tagstore_t <addr_t, TagEntry>::handle block = _tags.find(ctag);
+    if (block.valid)
       return 0;
 
-    INSERT_BLOCK(ctag, false, request);
+    INSERT_BLOCK(block, ctag, false, request);
 
     return 0;
   }
 
 
   // -------------------------------------------------------------------------
-  // Function to insert a block into the cache
+  // Function to insert a block into the cache. block is the handle from the
+  // lookup that missed.
   // -------------------------------------------------------------------------
 
-  void INSERT_BLOCK(addr_t ctag, bool dirty, MemoryRequest *request) {
+  void INSERT_BLOCK(generic_tagstore_t <addr_t, TagEntry>::handle &block,
+                    addr_t ctag, bool dirty, MemoryRequest *request) {
 
     table_t <addr_t, TagEntry>::entry tagentry;
 
@@ -440,24 +463,24 @@ protected:
     }
     
     // insert the block into the cache
-    tagentry = _tags.insert(ctag, TagEntry(), priority);
-    _tags[ctag].vcla = BLOCK_ADDRESS(VADDR(request), _blockSize);
-    _tags[ctag].pcla = BLOCK_ADDRESS(PADDR(request), _blockSize);
-    _tags[ctag].dirty = dirty;
-    _tags[ctag].appID = request -> cpuID;
-    _tags[ctag].prefState = NOT_PREFETCHED;
+    tagentry = _tags.insert(block, ctag, TagEntry(), priority);
+    block -> vcla = BLOCK_ADDRESS(VADDR(request), _blockSize);
+    block -> pcla = BLOCK_ADDRESS(PADDR(request), _blockSize);
+    block -> dirty = dirty;
+    block -> appID = request -> cpuID;
+    block -> prefState = NOT_PREFETCHED;
 
     if (priority == POLICY_LOW) {
-      _tags[ctag].lowPriority = true;
+      block -> lowPriority = true;
     }
 
     uint32 index = _tags.index(ctag);
 
     // Handle prefetch
     if (request -> type == MemoryRequest::PREFETCH) {
-      _tags[ctag].prefState = PREFETCHED_UNUSED;
-      _tags[ctag].prefetchCycle = request -> currentCycle;
-      _tags[ctag].prefetchMiss = _missCounter[index];
+      block -> prefState = PREFETCHED_UNUSED;
+      block -> prefetchCycle = request -> currentCycle;
+      block -> prefetchMiss = _missCounter[index];
     }
 
     // if the evicted tag entry is valid
@@ -40,6 +40,7 @@ protected:
   uint32 _blockSize;
   uint32 _associativity;
   string _policy;
+  bool _flatTagStore;				// use the flat (structure of arrays) tag store
   uint32 _shctMax;
   bool _useBimodal;
   bool _noIncrement;
@@ -113,6 +114,7 @@ public:
     _tagStoreLatency = 6;
     _dataStoreLatency = 15;
     _policy = "drrip";
+    _flatTagStore = true;
     _shctMax = 3;
     _useBimodal = false;
     _numDuelingSets = 32;
@@ -138,6 +140,7 @@ public:
       CMP_PARAMETER_UINT("block-size", _blockSize)
       CMP_PARAMETER_UINT("associativity", _associativity)
       CMP_PARAMETER_STRING("policy", _policy)
+      CMP_PARAMETER_BOOLEAN("flat-tag-store", _flatTagStore)
       CMP_PARAMETER_UINT("tag-store-latency", _tagStoreLatency)
       CMP_PARAMETER_UINT("data-store-latency", _dataStoreLatency)
       CMP_PARAMETER_UINT("shct-max", _shctMax)
@@ -172,7 +175,8 @@ public:
 
     // compute number of sets
     _numSets = (_size * 1024) / (_blockSize * _associativity);
-    _tags.SetTagStoreParameters(_numSets, _associativity, _policy);
+    _tags.SetTagStoreParameters(_numSets, _associativity, _policy,
+                                _flatTagStore);
     _occupancy.resize(_numCPUs, 0);
 
     _sets.resize(_numSets);
@@ -217,6 +221,20 @@ public:
   }
 
 
+  // -------------------------------------------------------------------------
+  // Function to save or restore the state of the component
+  // -------------------------------------------------------------------------
+
+  void CheckpointState(CheckpointFile &cp) {
+    MemoryComponent::CheckpointState(cp);
+    _tags.CheckpointState(cp);
+    CHECKPOINT(_ipTable);
+    CHECKPOINT(_occupancy);
+    CHECKPOINT(_sets);
+    CHECKPOINT(_psel);
+  }
+
+
 protected:
 
   // -------------------------------------------------------------------------
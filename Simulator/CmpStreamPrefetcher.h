@@ -194,6 +194,18 @@ public:
   }
 
 
+  // -------------------------------------------------------------------------
+  // Function to save or restore the state of the component
+  // -------------------------------------------------------------------------
+
+  void CheckpointState(CheckpointFile &cp) {
+    MemoryComponent::CheckpointState(cp);
+    CHECKPOINT(_appCounter);
+    _streamTable.CheckpointState(cp);
+    CHECKPOINT(_runningIndex);
+  }
+
+
 protected:
 
   // -------------------------------------------------------------------------
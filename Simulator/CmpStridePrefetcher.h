@@ -159,6 +159,16 @@ public:
   }
 
 
+  // -------------------------------------------------------------------------
+  // Function to save or restore the state of the component
+  // -------------------------------------------------------------------------
+
+  void CheckpointState(CheckpointFile &cp) {
+    MemoryComponent::CheckpointState(cp);
+    _strideTable.CheckpointState(cp);
+  }
+
+
 protected:
 
   // -------------------------------------------------------------------------
@@ -1,7 +1,9 @@
 // -----------------------------------------------------------------------------
 // File: CmpTrace.h
 // Description:
-//    A sample component to dump traces.
+//    A sample component to dump traces. Traces are written in the text format
+//    or, with trace-format binary, in the binary format with one file per
+//    core (see TraceFormat.h).
 // -----------------------------------------------------------------------------
 
 #ifndef __CMP_TRACE_H__
@@ -12,6 +14,7 @@
 // -----------------------------------------------------------------------------
 
 #include "MemoryComponent.h"
+#include "TraceFormat.h"
 #include "Types.h"
 
 // -----------------------------------------------------------------------------
@@ -19,6 +22,8 @@
 // -----------------------------------------------------------------------------
 
 #include <zlib.h>
+#include <cstdio>
+#include <vector>
 
 
 // -----------------------------------------------------------------------------
@@ -36,12 +41,16 @@ class CmpTrace : public MemoryComponent {
     // -------------------------------------------------------------------------
 
     string _traceFileName;
+    string _traceFormat;
+    uint32 _blockSize;
 
     // -------------------------------------------------------------------------
     // Private members
     // -------------------------------------------------------------------------
 
     gzFile _trace;
+    bool _binary;
+    vector <BinaryTraceWriter *> _writers;
 
 
   public:
@@ -52,6 +61,8 @@ class CmpTrace : public MemoryComponent {
 
     CmpTrace() {
       _traceFileName = "trace";
+      _traceFormat = "text";
+      _blockSize = 64;
     }
 
 
@@ -74,6 +85,8 @@ class CmpTrace : public MemoryComponent {
     void AddParameter(string pname, string pvalue) {
       CMP_PARAMETER_BEGIN
       CMP_PARAMETER_STRING("trace-file-name", _traceFileName)
+      CMP_PARAMETER_STRING("trace-format", _traceFormat)
+      CMP_PARAMETER_UINT("block-size", _blockSize)
       CMP_PARAMETER_END
     }
 
@@ -82,6 +95,32 @@ class CmpTrace : public MemoryComponent {
     // -------------------------------------------------------------------------
 
     void StartSimulation() {
+
+      if (_traceFormat.compare("binary") == 0) {
+        _binary = true;
+        _writers.resize(_numCPUs);
+        for (uint32 i = 0; i < _numCPUs; i ++) {
+          char suffix[32];
+          sprintf(suffix, "-%u.bin.gz", i);
+          string fileName = _simulationFolderName + "/" + _traceFileName +
+            suffix;
+          TraceHeader header;
+          header.blockSize = _blockSize;
+          header.coreID = i;
+          _writers[i] = new BinaryTraceWriter();
+          bool opened = _writers[i] -> Open(fileName, header);
+          assert(opened);
+        }
+        return;
+      }
+
+      if (_traceFormat.compare("text") != 0) {
+        fprintf(stderr, "Error: Unknown trace format `%s'\n",
+            _traceFormat.c_str());
+        exit(-1);
+      }
+
+      _binary = false;
       string fileName = _simulationFolderName + "/" + _traceFileName + ".gz";
       _trace = gzopen64(fileName.c_str(), "w");
       assert (_trace != Z_NULL);
@@ -93,6 +132,12 @@ class CmpTrace : public MemoryComponent {
     // -------------------------------------------------------------------------
 
     void EndSimulation() {
+      if (_binary) {
+        for (uint32 i = 0; i < _writers.size(); i ++)
+          delete _writers[i];
+        _writers.clear();
+        return;
+      }
       gzclose(_trace);
     }
 
@@ -114,7 +159,17 @@ class CmpTrace : public MemoryComponent {
     // -------------------------------------------------------------------------
 
     cycles_t ProcessRequest(MemoryRequest *request) {
-      if (!_warmUp) {
+      if (!_warmUp && _binary) {
+        TraceRecord record;
+        record.icount = request -> icount;
+        record.ip = request -> ip;
+        record.virtualAddress = request -> virtualAddress;
+        record.physicalAddress = request -> physicalAddress;
+        record.size = request -> size;
+        record.type = request -> type;
+        _writers[request -> cpuID] -> Write(record);
+      }
+      else if (!_warmUp) {
         gzprintf(_trace, "%llu %llu %llu %llu %u %u\n", request -> icount,
             request -> ip, request -> virtualAddress, 
             request -> physicalAddress, request -> size, request -> type);
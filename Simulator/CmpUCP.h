@@ -191,6 +191,24 @@ class CmpUCP : public MemoryComponent {
     }
 
 
+    // -------------------------------------------------------------------------
+    // Function to save or restore the state of the component
+    // -------------------------------------------------------------------------
+
+    void CheckpointState(CheckpointFile &cp) {
+      MemoryComponent::CheckpointState(cp);
+      CHECKPOINT(_target);
+      CHECKPOINT(_current);
+      CHECKPOINT(_hits);
+      CHECKPOINT(_misses);
+      CHECKPOINT(_free);
+      CHECKPOINT(_tags);
+      CHECKPOINT(_utility);
+      CHECKPOINT(_previousPartitionCycle);
+      CHECKPOINT(_occupancy);
+    }
+
+
   protected:
 
     // -------------------------------------------------------------------------
@@ -8,6 +8,9 @@
 #include "MemoryRequest.h"
 
 #include <cstring>
+#include <map>
+
+using namespace std;
 
 // List of DRAM Commands
 enum DRAMCommand {
@@ -15,6 +18,7 @@ enum DRAMCommand {
   CMD_READ,
   CMD_WRITE,
   CMD_PRE,
+  CMD_REF,
   NUM_CMDS
 };
 
@@ -35,10 +39,16 @@ enum DRAMBankState {
 };
 
 // forward declaration
+struct DRAMBankGroup;
 struct DRAMRank;
 struct DRAMChannel;
 
 
+// Requests waiting in the controller, in order of arrival (keyed by the
+// arrival number given by the channel)
+typedef map <uint64, MemoryRequest *> DRAMRequestQueue;
+
+
 // DRAM Bank Structure
 struct DRAMBank {
 
@@ -48,23 +58,54 @@ struct DRAMBank {
   cycles_t lastIssueCycle[NUM_CMDS];
   cycles_t nextIssueCycle[NUM_CMDS];
 
+  DRAMBankGroup *group;
   DRAMRank *rank;
   DRAMChannel *channel;
 
+  // requests waiting for the bank, for each channel mode, and the same
+  // requests by row (the requests of the open row are its row hits)
+  DRAMRequestQueue pending[NUM_CMODES];
+  map <addr_t, DRAMRequestQueue> rows[NUM_CMODES];
+
+  // refresh. refreshed is set once the bank is refreshed in the current
+  // round of per-bank refreshes. A bank blocked for a refresh takes no
+  // other command until it is refreshed (blocked since refreshBlockedSince)
+  bool refreshed;
+  bool refreshBlocked;
+  cycles_t refreshBlockedSince;
+
   // stats
   uint64 numCmds[NUM_CMDS];
   uint64 numActs[NUM_CMODES];
+  uint64 refreshBlockedCycles;
 
   DRAMBank() {
     state = BANK_PRECHARGED;
     memset(lastIssueCycle, 0, sizeof(lastIssueCycle));
     memset(nextIssueCycle, 0, sizeof(nextIssueCycle));
+    refreshed = false;
+    refreshBlocked = false;
+    refreshBlockedSince = 0;
 
+    group = NULL;
     rank = NULL;
     channel = NULL;
 
     memset(numCmds, 0, sizeof(numCmds));
     memset(numActs, 0, sizeof(numActs));
+    refreshBlockedCycles = 0;
+  }
+};
+
+
+// DRAM Bank Group Structure. The timing constraints between banks of the
+// same group (tCCD_L, tRRD_L and tWTR_L) are kept here
+struct DRAMBankGroup {
+
+  cycles_t nextIssueCycle[NUM_CMDS];
+
+  DRAMBankGroup() {
+    memset(nextIssueCycle, 0, sizeof(nextIssueCycle));
   }
 };
 
@@ -73,14 +114,21 @@ struct DRAMBank {
 struct DRAMRank {
 
   DRAMBank *banks;
+  DRAMBankGroup *bankGroups;
   DRAMChannel *channel;
 
-  // for tFAW
+  // for tFAW (and tRRD between bank groups)
   list <cycles_t> lastActivates;
   cycles_t nextActivate;
 
+  // refresh. refreshesOwed is the number of refreshes that fell due and are
+  // not issued yet (negative if refreshes were pulled in)
+  cycles_t nextRefresh;
+  int32 refreshesOwed;
+
   DRAMRank() {
     banks = NULL;
+    bankGroups = NULL;
     channel = NULL;
     lastActivates.clear();
     lastActivates.push_back(0);
@@ -88,10 +136,28 @@ struct DRAMRank {
     lastActivates.push_back(0);
     lastActivates.push_back(0);
     nextActivate = 0;
+    nextRefresh = 0;
+    refreshesOwed = 0;
   }
 
   ~DRAMRank() {
     if (banks != NULL) delete [] banks;
+    if (bankGroups != NULL) delete [] bankGroups;
+  }
+};
+
+
+// DRAM Command Bus Structure. The pseudo-channels of a channel share its
+// command bus, which takes one row command (activate, precharge, refresh)
+// and one column command per memory cycle
+struct DRAMCommandBus {
+
+  cycles_t nextRowCommand;
+  cycles_t nextColumnCommand;
+
+  DRAMCommandBus() {
+    nextRowCommand = 0;
+    nextColumnCommand = 0;
   }
 };
 
@@ -99,6 +165,7 @@ struct DRAMRank {
 // DRAM Channel Structure
 struct DRAMChannel {
   DRAMRank *ranks;
+  DRAMCommandBus *bus;
 
   int32 lastRank;
   
@@ -107,7 +174,8 @@ struct DRAMChannel {
   cycles_t lastIssueCycle[NUM_CMDS];
   cycles_t nextIssueCycle[NUM_CMDS];
 
-  list <MemoryRequest *> queue[NUM_CMODES]; // one queue for each channel mode
+  DRAMRequestQueue queue[NUM_CMODES]; // one queue for each channel mode
+  uint64 arrivals; // number of requests queued so far
   DRAMChannelMode mode;
 
   // stats
@@ -116,6 +184,7 @@ struct DRAMChannel {
 
   DRAMChannel() {
     ranks = NULL;
+    bus = NULL;
     lastRank = -1;
     lastOp = NUM_CMDS;
     lastColumnOp = NUM_CMDS;
@@ -123,6 +192,7 @@ struct DRAMChannel {
     memset(nextIssueCycle, 0, sizeof(nextIssueCycle));
     mode = CMODE_READ;
     for (int i = 0; i < NUM_CMODES; i ++) queue[i].clear();
+    arrivals = 0;
     numReadToWrites = 0;
     numWriteToReads = 0;
   }
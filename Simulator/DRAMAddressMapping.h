@@ -0,0 +1,335 @@
+// -----------------------------------------------------------------------------
+// File: DRAMAddressMapping.h
+// Description:
+//    Defines the mapping of addresses to DRAM channel, rank, bank group,
+//    bank, row and column, used by the memory controllers.
+//
+//    A mapping is a string of fields from the most significant bits of the
+//    address to the least significant ones: r (row), R (rank), g (bank
+//    group), b (bank), c (column) and C (channel). The bits of a column
+//    (the column size) are below the lowest field. A field can be split by
+//    giving the number of bits of each part: "rbRc4Cc3" puts the 3 low bits
+//    of the column below the channel and the other 4 above it. A field
+//    without a number takes its remaining bits, and the row takes all the
+//    bits above the other fields, so it comes first unless it is split.
+//    Fields with a single entry can be left out.
+//
+//    The bank, bank group, rank and channel can be hashed: a hash is a list
+//    of terms separated by commas, each a field, `^' and either a field (its
+//    low bits) or the lowest address bit of a group of address bits, which
+//    are XORed into the field. "b^r" gives permutation based interleaving
+//    (the low bits of the row are XORed into the bank), "C^r,C^20" hashes
+//    the channel with the row and with address bits 20 and up.
+//
+//    The masks and shifts are computed once, so mapping an address takes a
+//    few bit operations per field. If the numbers of entries are not all
+//    powers of two, the fields are taken by division instead, which allows
+//    neither split fields nor hashing.
+// -----------------------------------------------------------------------------
+
+#ifndef __DRAM_ADDRESS_MAPPING_H__
+#define __DRAM_ADDRESS_MAPPING_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "Types.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+
+using namespace std;
+
+
+// Fields of a DRAM address
+enum DRAMAddressField {
+  DRAM_CHANNEL,
+  DRAM_RANK,
+  DRAM_BANK_GROUP,
+  DRAM_BANK,
+  DRAM_ROW,
+  DRAM_COLUMN,
+  NUM_DRAM_FIELDS
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: DRAMAddressMapping
+// Description:
+//    Maps addresses to DRAM fields
+// -----------------------------------------------------------------------------
+
+class DRAMAddressMapping {
+
+  protected:
+
+    // a part of a field: the bits of the address it takes, and where they go
+    // in the field
+    struct Piece {
+      DRAMAddressField field;
+      uint32 addressShift;
+      uint32 fieldShift;
+      addr_t mask;
+    };
+
+    // a hash term: the bits XORed into the field come from another field if
+    // source is a field, else from the address
+    struct Hash {
+      DRAMAddressField field;
+      int32 source;
+      uint32 addressShift;
+      addr_t mask;
+    };
+
+    string _mapping;
+
+    // the fields, from the lowest bits of the address up
+    vector <DRAMAddressField> _order;
+    addr_t _entries[NUM_DRAM_FIELDS];
+    addr_t _columnSize;
+
+    // bit mapping (all the numbers of entries are powers of two)
+    bool _bits;
+    uint32 _offsetBits;
+    vector <Piece> _pieces;
+    vector <Hash> _hashes;
+
+
+    // -------------------------------------------------------------------------
+    // Function to report an error in the mapping and stop
+    // -------------------------------------------------------------------------
+
+    void Error(const char *message) {
+      fprintf(stderr, "Error: address mapping `%s': %s\n", _mapping.c_str(),
+          message);
+      exit(-1);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to get the field of a letter (NUM_DRAM_FIELDS if none)
+    // -------------------------------------------------------------------------
+
+    static DRAMAddressField Field(char letter) {
+      switch (letter) {
+        case 'C': return DRAM_CHANNEL;
+        case 'R': return DRAM_RANK;
+        case 'g': return DRAM_BANK_GROUP;
+        case 'b': return DRAM_BANK;
+        case 'r': return DRAM_ROW;
+        case 'c': return DRAM_COLUMN;
+      }
+      return NUM_DRAM_FIELDS;
+    }
+
+    // log2 of a power of two (-1 if it is not one)
+    static int32 Log2(addr_t value) {
+      if (value == 0 || (value & (value - 1)) != 0)
+        return -1;
+      int32 bits = 0;
+      while (value > 1) {
+        value >>= 1;
+        bits ++;
+      }
+      return bits;
+    }
+
+    static addr_t Mask(uint32 bits) {
+      return bits >= 64 ? ~(addr_t)0 : ((addr_t)1 << bits) - 1;
+    }
+
+    // read a number at pos (-1 if there is none)
+    static int32 Number(const string &text, size_t &pos) {
+      if (pos >= text.size() || !isdigit(text[pos]))
+        return -1;
+      int32 number = 0;
+      while (pos < text.size() && isdigit(text[pos]))
+        number = number * 10 + (text[pos ++] - '0');
+      return number;
+    }
+
+
+  public:
+
+    // -------------------------------------------------------------------------
+    // Constructor
+    // -------------------------------------------------------------------------
+
+    DRAMAddressMapping() {
+      _bits = false;
+      _offsetBits = 0;
+      _columnSize = 1;
+      for (int i = 0; i < NUM_DRAM_FIELDS; i ++)
+        _entries[i] = 1;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to set up the mapping, given the number of entries of each
+    // field (the row is not used) and the size of a column in bytes
+    // -------------------------------------------------------------------------
+
+    void Initialize(string mapping, string hash,
+        const addr_t entries[NUM_DRAM_FIELDS], addr_t columnSize) {
+      _mapping = mapping;
+      _columnSize = columnSize;
+      for (int i = 0; i < NUM_DRAM_FIELDS; i ++)
+        _entries[i] = entries[i];
+      _order.clear();
+      _pieces.clear();
+      _hashes.clear();
+
+      // read the fields and their widths, from the most significant one
+      vector <DRAMAddressField> fields;
+      vector <int32> widths;
+      size_t pos = 0;
+      while (pos < mapping.size()) {
+        DRAMAddressField field = Field(mapping[pos ++]);
+        if (field == NUM_DRAM_FIELDS)
+          Error("unknown field");
+        fields.push_back(field);
+        widths.push_back(Number(mapping, pos));
+      }
+
+      // a field is split if it comes several times or with a width
+      bool split = false;
+      uint32 count[NUM_DRAM_FIELDS] = { 0 };
+      for (uint32 j = 0; j < fields.size(); j ++) {
+        count[fields[j]] ++;
+        if (widths[j] >= 0 || count[fields[j]] > 1)
+          split = true;
+      }
+      _bits = Log2(columnSize) >= 0;
+      for (int i = 0; i < NUM_DRAM_FIELDS; i ++) {
+        if (i == DRAM_ROW && count[i] == 0)
+          Error("there is no row");
+        if (i != DRAM_ROW && count[i] == 0 && entries[i] > 1)
+          Error("a field with several entries is missing");
+        if (i != DRAM_ROW && Log2(entries[i]) < 0)
+          _bits = false;
+      }
+
+      // fields taken by division
+      if (!_bits) {
+        if (split || !hash.empty())
+          Error("split fields and hashing need powers of two");
+        if (fields[0] != DRAM_ROW)
+          Error("the row must come first");
+        for (uint32 j = fields.size(); j > 0; j --)
+          _order.push_back(fields[j - 1]);
+        return;
+      }
+
+      // bit mapping: the pieces from the lowest bits up
+      _offsetBits = Log2(columnSize);
+      uint32 shift = _offsetBits;
+      int32 assigned[NUM_DRAM_FIELDS] = { 0 };
+      for (uint32 j = fields.size(); j > 0; j --) {
+        DRAMAddressField field = fields[j - 1];
+        int32 width = widths[j - 1];
+        int32 remaining = (field == DRAM_ROW) ? 64 - shift :
+          Log2(entries[field]) - assigned[field];
+        if (width < 0) {
+          if (field == DRAM_ROW && j > 1)
+            Error("the row must come first unless it is split");
+          width = remaining;
+        }
+        if (width > remaining || shift + width > 64)
+          Error("a field has more bits than its entries");
+        Piece piece;
+        piece.field = field;
+        piece.addressShift = shift;
+        piece.fieldShift = assigned[field];
+        piece.mask = Mask(width);
+        if (width > 0)
+          _pieces.push_back(piece);
+        assigned[field] += width;
+        shift += width;
+      }
+      for (int i = 0; i < NUM_DRAM_FIELDS; i ++) {
+        if (i != DRAM_ROW && assigned[i] != Log2(entries[i]))
+          Error("a field has fewer bits than its entries");
+      }
+
+      // hash terms
+      pos = 0;
+      while (pos < hash.size()) {
+        Hash term;
+        term.field = Field(hash[pos ++]);
+        if (term.field == NUM_DRAM_FIELDS || term.field == DRAM_ROW ||
+            term.field == DRAM_COLUMN)
+          Error("only the channel, rank, bank group and bank can be hashed");
+        if (pos >= hash.size() || hash[pos ++] != '^')
+          Error("a hash term must be a field, `^' and a field or a bit");
+        term.mask = Mask(Log2(entries[term.field]));
+        int32 bit = Number(hash, pos);
+        if (bit >= 0) {
+          if (bit >= 64)
+            Error("a hash bit is past the address");
+          term.source = -1;
+          term.addressShift = bit;
+        }
+        else {
+          if (pos >= hash.size() || Field(hash[pos]) == NUM_DRAM_FIELDS)
+            Error("a hash term must be a field, `^' and a field or a bit");
+          term.source = Field(hash[pos ++]);
+          term.addressShift = 0;
+        }
+        if (pos < hash.size() && hash[pos ++] != ',')
+          Error("hash terms must be separated by commas");
+        _hashes.push_back(term);
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to map an address to its fields
+    // -------------------------------------------------------------------------
+
+    void Map(addr_t address, addr_t fields[NUM_DRAM_FIELDS]) {
+      for (int i = 0; i < NUM_DRAM_FIELDS; i ++)
+        fields[i] = 0;
+
+      if (!_bits) {
+        address /= _columnSize;
+        for (uint32 j = 0; j < _order.size(); j ++) {
+          DRAMAddressField field = _order[j];
+          if (field == DRAM_ROW) {
+            fields[field] = address;
+            break;
+          }
+          fields[field] = address % _entries[field];
+          address /= _entries[field];
+        }
+        return;
+      }
+
+      for (uint32 j = 0; j < _pieces.size(); j ++) {
+        const Piece &piece = _pieces[j];
+        fields[piece.field] |=
+          ((address >> piece.addressShift) & piece.mask) << piece.fieldShift;
+      }
+
+      if (_hashes.empty())
+        return;
+      addr_t plain[NUM_DRAM_FIELDS];
+      for (int i = 0; i < NUM_DRAM_FIELDS; i ++)
+        plain[i] = fields[i];
+      for (uint32 j = 0; j < _hashes.size(); j ++) {
+        const Hash &term = _hashes[j];
+        addr_t bits = (term.source >= 0) ? plain[term.source] :
+          address >> term.addressShift;
+        fields[term.field] ^= bits & term.mask;
+      }
+    }
+};
+
+#endif // __DRAM_ADDRESS_MAPPING_H__
@@ -0,0 +1,684 @@
+// -----------------------------------------------------------------------------
+// File: FlatPolicy.h
+// Description:
+//    Replacement policies for the flat tag store. Unlike the table policies,
+//    a single policy object holds the replacement state of every set in
+//    contiguous per-way arrays. Each policy mirrors the victim choices of the
+//    table policy with the same name.
+//
+//    The policies are not virtual. Each one is a template on the number of
+//    ways (0 meaning the associativity is only known at run time), and the
+//    flat tag store is instantiated for a policy and an associativity so
+//    that the policy code is inlined into the tag store (see
+//    CreateFlatTagArray in FlatTagStore.h).
+// -----------------------------------------------------------------------------
+
+#ifndef __FLAT_POLICY_H__
+#define __FLAT_POLICY_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "Types.h"
+#include "Table.h"
+#include "TableLRU.h"
+#include "TableRRIP.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+
+using namespace std;
+
+
+// -----------------------------------------------------------------------------
+// Set of operations seen by a flat policy (same as table_t::operation)
+// -----------------------------------------------------------------------------
+
+enum flat_op_t {
+  FLAT_INSERT,
+  FLAT_REPLACE,
+  FLAT_READ,
+  FLAT_UPDATE,
+  FLAT_INVALIDATE
+};
+
+
+// -----------------------------------------------------------------------------
+// Number of ways of a policy: the template argument if it is known at compile
+// time, the run time associativity otherwise
+// -----------------------------------------------------------------------------
+
+template <uint32 Ways>
+inline uint32 FlatWays(uint32 numWays) {
+  return (Ways != 0) ? Ways : numWays;
+}
+
+
+// -----------------------------------------------------------------------------
+// Class: flat_policy_t
+// Description:
+//    Common state of a replacement policy for all the sets of a flat tag
+//    store. Each policy provides
+//      void Update(uint32 set, uint32 way, flat_op_t op, policy_value_t pval)
+//        to update the replacement state of a way, and
+//      uint32 Victim(uint32 set, uint64 valid)
+//        to return the victim way of a set (valid is the bitmask of valid
+//        ways in the set), and
+//      void CheckpointState(CheckpointFile &cp)
+//        to save or restore its state (see Checkpoint.h).
+// -----------------------------------------------------------------------------
+
+class flat_policy_t {
+
+protected:
+
+  uint32 _numSets;
+  uint32 _numWays;
+
+public:
+
+  flat_policy_t(uint32 numSets, uint32 numWays) {
+    _numSets = numSets;
+    _numWays = numWays;
+  }
+
+  void CheckpointState(CheckpointFile &cp) {}
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: flat_lru_policy_t
+// Description:
+//    LRU keeping one rank byte per way, as lru_table_t does: 0 is the MRU way
+//    and LRU_RANK_NONE marks a way that is not in the recency order. The
+//    victim is the valid way with the highest rank, which is the head of the
+//    lru_table_t list.
+// -----------------------------------------------------------------------------
+
+template <uint32 Ways>
+class flat_lru_policy_t : public flat_policy_t {
+
+protected:
+
+  vector <uint8> _rank;
+
+public:
+
+  flat_lru_policy_t(uint32 numSets, uint32 numWays) :
+    flat_policy_t(numSets, numWays) {
+    _rank.resize(numSets * numWays, LRU_RANK_NONE);
+  }
+
+  void CheckpointState(CheckpointFile &cp) {
+    CheckpointTransfer(cp, _rank);
+  }
+
+  void Update(uint32 set, uint32 way, flat_op_t op, policy_value_t pval) {
+    const uint32 ways = FlatWays <Ways> (_numWays);
+    uint8 *rank = &_rank[set * ways];
+    uint8 old = rank[way];
+
+    // ways less recent than the invalidated way move up by one
+    if (op == FLAT_INVALIDATE) {
+      if (old == LRU_RANK_NONE) return;
+      for (uint32 i = 0; i < ways; i ++)
+        rank[i] -= (rank[i] > old && rank[i] != LRU_RANK_NONE);
+      rank[way] = LRU_RANK_NONE;
+      return;
+    }
+
+    // ways more recent than the promoted way age by one
+    for (uint32 i = 0; i < ways; i ++)
+      rank[i] += (rank[i] < old);
+    rank[way] = 0;
+  }
+
+  uint32 Victim(uint32 set, uint64 valid) {
+    assert(valid != 0);
+    const uint32 ways = FlatWays <Ways> (_numWays);
+    uint8 *rank = &_rank[set * ways];
+    uint32 victim = ways;
+    for (uint32 i = 0; i < ways; i ++) {
+      if (!((valid >> i) & 1)) continue;
+      if (victim == ways || rank[i] > rank[victim])
+        victim = i;
+    }
+    return victim;
+  }
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: flat_plru_policy_t
+// Description:
+//    Tree pseudo-LRU with the tree of each set in one word, laid out as in
+//    plru_table_t (bit n is node n, node 1 is the root).
+// -----------------------------------------------------------------------------
+
+template <uint32 Ways>
+class flat_plru_policy_t : public flat_policy_t {
+
+protected:
+
+  vector <uint64> _bits;
+
+public:
+
+  flat_plru_policy_t(uint32 numSets, uint32 numWays) :
+    flat_policy_t(numSets, numWays) {
+    if ((numWays & (numWays - 1)) != 0) {
+      fprintf(stderr, "Error: plru needs a power of two size (got %u)\n", numWays);
+      exit(-1);
+    }
+    _bits.resize(numSets, 0);
+  }
+
+  void CheckpointState(CheckpointFile &cp) {
+    CheckpointTransfer(cp, _bits);
+  }
+
+  void Update(uint32 set, uint32 way, flat_op_t op, policy_value_t pval) {
+    if (op == FLAT_INVALIDATE)
+      return;
+    uint64 bits = _bits[set];
+    for (uint32 node = FlatWays <Ways> (_numWays) + way; node > 1; node >>= 1) {
+      if (node & 1) bits &= ~(1ULL << (node >> 1));
+      else bits |= (1ULL << (node >> 1));
+    }
+    _bits[set] = bits;
+  }
+
+  uint32 Victim(uint32 set, uint64 valid) {
+    const uint32 ways = FlatWays <Ways> (_numWays);
+    uint64 bits = _bits[set];
+    uint32 node = 1;
+    while (node < ways)
+      node = 2 * node + ((bits >> node) & 1);
+    return node - ways;
+  }
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: flat_dip_policy_t
+// Description:
+//    LRU with low priority (LRU position) and bimodal insertions. Inserting at
+//    the MRU end takes a stamp above every stamp handed out so far and
+//    inserting at the LRU end takes one below.
+// -----------------------------------------------------------------------------
+
+template <uint32 Ways>
+class flat_dip_policy_t : public flat_policy_t {
+
+protected:
+
+  vector <int64> _stamp;
+  int64 _mru;
+  int64 _lru;
+
+  // counter for BIP, one per set
+  vector <cyclic_pointer> _bipCounter;
+
+public:
+
+  flat_dip_policy_t(uint32 numSets, uint32 numWays) :
+    flat_policy_t(numSets, numWays) {
+    _stamp.resize(numSets * numWays, 0);
+    _bipCounter.resize(numSets, cyclic_pointer(64));
+    _mru = 0;
+    _lru = 0;
+  }
+
+  void CheckpointState(CheckpointFile &cp) {
+    CheckpointTransfer(cp, _stamp);
+    CheckpointTransfer(cp, _mru);
+    CheckpointTransfer(cp, _lru);
+    cp.Size(_bipCounter.size(), "a policy");
+    for (uint32 i = 0; i < _bipCounter.size(); i ++)
+      CheckpointTransfer(cp, _bipCounter[i]);
+  }
+
+  void Update(uint32 set, uint32 way, flat_op_t op, policy_value_t pval) {
+
+    if (op == FLAT_INVALIDATE)
+      return;
+
+    int64 &stamp = _stamp[set * FlatWays <Ways> (_numWays) + way];
+    switch (pval) {
+    case POLICY_HIGH: stamp = ++ _mru; break;
+    case POLICY_LOW: stamp = -- _lru; break;
+    case POLICY_BIMODAL:
+      if (_bipCounter[set]) stamp = -- _lru;
+      else stamp = ++ _mru;
+      break;
+    }
+  }
+
+  uint32 Victim(uint32 set, uint64 valid) {
+    assert(valid != 0);
+    _bipCounter[set].increment();
+    const uint32 ways = FlatWays <Ways> (_numWays);
+    int64 *stamp = &_stamp[set * ways];
+    uint32 victim = ways;
+    for (uint32 i = 0; i < ways; i ++) {
+      if (!((valid >> i) & 1)) continue;
+      if (victim == ways || stamp[i] < stamp[victim])
+        victim = i;
+    }
+    return victim;
+  }
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: flat_fifo_policy_t
+// Description:
+//    FIFO using a per-way insertion stamp.
+// -----------------------------------------------------------------------------
+
+template <uint32 Ways>
+class flat_fifo_policy_t : public flat_policy_t {
+
+protected:
+
+  vector <uint64> _stamp;
+  uint64 _clock;
+
+public:
+
+  flat_fifo_policy_t(uint32 numSets, uint32 numWays) :
+    flat_policy_t(numSets, numWays) {
+    _stamp.resize(numSets * numWays, 0);
+    _clock = 0;
+  }
+
+  void CheckpointState(CheckpointFile &cp) {
+    CheckpointTransfer(cp, _stamp);
+    CheckpointTransfer(cp, _clock);
+  }
+
+  void Update(uint32 set, uint32 way, flat_op_t op, policy_value_t pval) {
+    if (op == FLAT_INSERT || op == FLAT_REPLACE)
+      _stamp[set * FlatWays <Ways> (_numWays) + way] = ++ _clock;
+  }
+
+  uint32 Victim(uint32 set, uint64 valid) {
+    assert(valid != 0);
+    const uint32 ways = FlatWays <Ways> (_numWays);
+    uint64 *stamp = &_stamp[set * ways];
+    uint32 victim = ways;
+    for (uint32 i = 0; i < ways; i ++) {
+      if (!((valid >> i) & 1)) continue;
+      if (victim == ways || stamp[i] < stamp[victim])
+        victim = i;
+    }
+    return victim;
+  }
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: flat_rrip_policy_t
+// Description:
+//    Common state for the RRIP family. Note that these tables use the
+//    inverted convention: an RRPV of 0 is the eviction candidate and hits
+//    move the RRPV towards the max.
+// -----------------------------------------------------------------------------
+
+template <uint32 Ways>
+class flat_rrip_policy_t : public flat_policy_t {
+
+protected:
+
+  vector <uint8> _rrpv;
+  uint8 _max;
+
+  void Increment(uint8 &rrpv) {
+    if (rrpv < _max) rrpv ++;
+  }
+
+  uint32 AgeAndFind(uint32 set) {
+    const uint32 ways = FlatWays <Ways> (_numWays);
+    return RRIPAgeAndFind(&_rrpv[set * ways], ways);
+  }
+
+public:
+
+  flat_rrip_policy_t(uint32 numSets, uint32 numWays) :
+    flat_policy_t(numSets, numWays) {
+    _max = 7;
+    _rrpv.resize(numSets * numWays, 0);
+  }
+
+  void CheckpointState(CheckpointFile &cp) {
+    CheckpointTransfer(cp, _rrpv);
+  }
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: flat_srrip_policy_t
+// -----------------------------------------------------------------------------
+
+template <uint32 Ways>
+class flat_srrip_policy_t : public flat_rrip_policy_t <Ways> {
+
+public:
+
+  flat_srrip_policy_t(uint32 numSets, uint32 numWays) :
+    flat_rrip_policy_t <Ways> (numSets, numWays) {}
+
+  void Update(uint32 set, uint32 way, flat_op_t op, policy_value_t pval) {
+    uint8 &rrpv = this -> _rrpv[set * FlatWays <Ways> (this -> _numWays) + way];
+    switch (op) {
+    case FLAT_INSERT: rrpv = 1; break;
+    case FLAT_READ: this -> Increment(rrpv); break;
+    case FLAT_UPDATE: this -> Increment(rrpv); break;
+    case FLAT_REPLACE: rrpv = 1; break;
+    case FLAT_INVALIDATE: rrpv = 0; break;
+    }
+  }
+
+  uint32 Victim(uint32 set, uint64 valid) {
+    return this -> AgeAndFind(set);
+  }
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: flat_drrip_policy_t
+// Description:
+//    DRRIP and DRRIP-HP. The only differences are the promotion on a hit and
+//    the period of the bimodal counter.
+// -----------------------------------------------------------------------------
+
+template <uint32 Ways>
+class flat_drrip_policy_t : public flat_rrip_policy_t <Ways> {
+
+protected:
+
+  // BRRIP counter, one per set
+  vector <cyclic_pointer> _brripCounter;
+
+  // hit priority: promote to max on a hit
+  bool _hitPromotion;
+
+public:
+
+  flat_drrip_policy_t(uint32 numSets, uint32 numWays, uint32 period = 67,
+                      bool hitPromotion = false) :
+    flat_rrip_policy_t <Ways> (numSets, numWays) {
+    _brripCounter.resize(numSets, cyclic_pointer(period));
+    _hitPromotion = hitPromotion;
+  }
+
+  void CheckpointState(CheckpointFile &cp) {
+    flat_rrip_policy_t <Ways>::CheckpointState(cp);
+    cp.Size(_brripCounter.size(), "a policy");
+    for (uint32 i = 0; i < _brripCounter.size(); i ++)
+      CheckpointTransfer(cp, _brripCounter[i]);
+  }
+
+  void Update(uint32 set, uint32 way, flat_op_t op, policy_value_t pval) {
+
+    uint8 &rrpv = this -> _rrpv[set * FlatWays <Ways> (this -> _numWays) + way];
+    uint8 max = this -> _max;
+    cyclic_pointer &brripCounter = _brripCounter[set];
+
+    // Invalidate: do nothing
+    if (op == FLAT_INVALIDATE) return;
+
+    // if read or update, promotion policy based on pval (the fall through
+    // from POLICY_LOW is kept from the table policy)
+    else if (op == FLAT_READ || op == FLAT_UPDATE) {
+      switch (pval) {
+      case POLICY_HIGH:
+        if (_hitPromotion) rrpv = max;
+        else this -> Increment(rrpv);
+        break;
+      case POLICY_LOW: rrpv = 0;
+      case POLICY_BIMODAL:
+        if (brripCounter) rrpv = 0;
+        else if (_hitPromotion) rrpv = max;
+        else this -> Increment(rrpv);
+        break;
+      }
+    }
+
+    // if insert or replace, promotion policy based on pval
+    else if (op == FLAT_INSERT || op == FLAT_REPLACE) {
+      switch (pval) {
+      case POLICY_HIGH: rrpv = 1; break;
+      case POLICY_LOW: rrpv = 0;
+      case POLICY_BIMODAL:
+        if (brripCounter) rrpv = 0;
+        else rrpv = 1;
+        break;
+      }
+    }
+  }
+
+  uint32 Victim(uint32 set, uint64 valid) {
+    _brripCounter[set].increment();
+    return this -> AgeAndFind(set);
+  }
+};
+
+template <uint32 Ways>
+class flat_drrip_hp_policy_t : public flat_drrip_policy_t <Ways> {
+
+public:
+
+  flat_drrip_hp_policy_t(uint32 numSets, uint32 numWays) :
+    flat_drrip_policy_t <Ways> (numSets, numWays, 64, true) {}
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: flat_nru_policy_t
+// -----------------------------------------------------------------------------
+
+template <uint32 Ways>
+class flat_nru_policy_t : public flat_policy_t {
+
+protected:
+
+  vector <uint8> _referenced;
+  vector <uint32> _hand;
+
+public:
+
+  flat_nru_policy_t(uint32 numSets, uint32 numWays) :
+    flat_policy_t(numSets, numWays) {
+    _referenced.resize(numSets * numWays, 0);
+    _hand.resize(numSets, 0);
+  }
+
+  void CheckpointState(CheckpointFile &cp) {
+    CheckpointTransfer(cp, _referenced);
+    CheckpointTransfer(cp, _hand);
+  }
+
+  void Update(uint32 set, uint32 way, flat_op_t op, policy_value_t pval) {
+    _referenced[set * FlatWays <Ways> (_numWays) + way] = (op != FLAT_INVALIDATE);
+  }
+
+  uint32 Victim(uint32 set, uint64 valid) {
+    const uint32 ways = FlatWays <Ways> (_numWays);
+    uint8 *referenced = &_referenced[set * ways];
+    uint32 &hand = _hand[set];
+    while (referenced[hand]) {
+      referenced[hand] = 0;
+      hand ++;
+      if (hand == ways)
+        hand = 0;
+    }
+    return hand;
+  }
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: flat_reuse_policy_t
+// -----------------------------------------------------------------------------
+
+template <uint32 Ways>
+class flat_reuse_policy_t : public flat_policy_t {
+
+protected:
+
+  vector <uint8> _reuse;
+  vector <uint32> _hand;
+  uint8 _max;
+
+public:
+
+  flat_reuse_policy_t(uint32 numSets, uint32 numWays) :
+    flat_policy_t(numSets, numWays) {
+    _reuse.resize(numSets * numWays, 0);
+    _hand.resize(numSets, 0);
+    _max = 3;
+  }
+
+  void CheckpointState(CheckpointFile &cp) {
+    CheckpointTransfer(cp, _reuse);
+    CheckpointTransfer(cp, _hand);
+  }
+
+  void Update(uint32 set, uint32 way, flat_op_t op, policy_value_t pval) {
+    const uint32 ways = FlatWays <Ways> (_numWays);
+    uint8 &reuse = _reuse[set * ways + way];
+    switch (op) {
+    case FLAT_INSERT:
+    case FLAT_REPLACE:
+      reuse = 0;
+      _hand[set] = way + 1;
+      if (_hand[set] == ways) _hand[set] = 0;
+      break;
+    case FLAT_READ:
+    case FLAT_UPDATE:
+      if (reuse != _max) reuse ++;
+      break;
+    case FLAT_INVALIDATE:
+      reuse = 0;
+      break;
+    }
+  }
+
+  uint32 Victim(uint32 set, uint64 valid) {
+    const uint32 ways = FlatWays <Ways> (_numWays);
+    uint8 *reuse = &_reuse[set * ways];
+    uint32 &hand = _hand[set];
+    while (reuse[hand] != 0) {
+      reuse[hand] --;
+      hand ++;
+      if (hand == ways)
+        hand = 0;
+    }
+    return hand;
+  }
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: flat_generation_policy_t
+// -----------------------------------------------------------------------------
+
+template <uint32 Ways>
+class flat_generation_policy_t : public flat_policy_t {
+
+protected:
+
+  vector <uint8> _generation;
+  vector <uint8> _referenced;
+  vector <uint32> _hand;
+  uint8 _maxGeneration;
+
+public:
+
+  flat_generation_policy_t(uint32 numSets, uint32 numWays) :
+    flat_policy_t(numSets, numWays) {
+    _generation.resize(numSets * numWays, 0);
+    _referenced.resize(numSets * numWays, 0);
+    _hand.resize(numSets, 0);
+    _maxGeneration = 3;
+  }
+
+  void CheckpointState(CheckpointFile &cp) {
+    CheckpointTransfer(cp, _generation);
+    CheckpointTransfer(cp, _referenced);
+    CheckpointTransfer(cp, _hand);
+  }
+
+  void Update(uint32 set, uint32 way, flat_op_t op, policy_value_t pval) {
+    uint32 slot = set * FlatWays <Ways> (_numWays) + way;
+    switch (op) {
+    case FLAT_INSERT:
+    case FLAT_REPLACE:
+      _generation[slot] = pval;
+      _referenced[slot] = 0;
+      break;
+    case FLAT_READ:
+    case FLAT_UPDATE:
+      _referenced[slot] = 1;
+      break;
+    case FLAT_INVALIDATE:
+      _generation[slot] = 0;
+      _referenced[slot] = 0;
+      break;
+    }
+  }
+
+  uint32 Victim(uint32 set, uint64 valid) {
+    const uint32 ways = FlatWays <Ways> (_numWays);
+    uint8 *generation = &_generation[set * ways];
+    uint8 *referenced = &_referenced[set * ways];
+    uint32 &hand = _hand[set];
+    while (!(generation[hand] == 0 && !referenced[hand] &&
+             ((valid >> hand) & 1))) {
+      if (referenced[hand]) {
+        referenced[hand] = 0;
+        if (generation[hand] < _maxGeneration) generation[hand] ++;
+      }
+      else if (generation[hand] > 0) {
+        generation[hand] --;
+      }
+      hand ++;
+      if (hand == ways) hand = 0;
+    }
+    return hand;
+  }
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: flat_way0_policy_t
+// Description:
+//    Placeholder matching the maxw and minw tables, which always evict the
+//    first way.
+// -----------------------------------------------------------------------------
+
+template <uint32 Ways>
+class flat_way0_policy_t : public flat_policy_t {
+
+public:
+
+  flat_way0_policy_t(uint32 numSets, uint32 numWays) :
+    flat_policy_t(numSets, numWays) {}
+
+  void Update(uint32 set, uint32 way, flat_op_t op, policy_value_t pval) {}
+
+  uint32 Victim(uint32 set, uint64 valid) {
+    return 0;
+  }
+};
+
+#endif // __FLAT_POLICY_H__
@@ -0,0 +1,679 @@
+// -----------------------------------------------------------------------------
+// File: FlatTagStore.h
+// Description:
+//    A set-associative tag store laid out as a structure of arrays. The tags,
+//    values and valid bits of all the sets are kept in contiguous arrays, so a
+//    lookup touches one short run of tags that is compared a vector at a time
+//    instead of walking a per-set map. Produces the same hits, victims and
+//    evicted entries as the table based tag store with the same policy.
+//    The policy and the associativity are compiled into the tag store and
+//    picked from the policy name when the tag store is created.
+// -----------------------------------------------------------------------------
+
+#ifndef __FLAT_TAG_STORE_H__
+#define __FLAT_TAG_STORE_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "Types.h"
+#include "Table.h"
+#include "FlatPolicy.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <vector>
+#include <string>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+
+// -----------------------------------------------------------------------------
+// Tag compare. Returns a bitmask with bit i set if keys[i] == key. The key
+// array is padded to a multiple of 4 entries.
+// -----------------------------------------------------------------------------
+
+template <class key_t>
+inline uint64 FlatTagMatch(const key_t *keys, uint32 numKeys, key_t key) {
+  uint64 match = 0;
+  for (uint32 i = 0; i < numKeys; i ++)
+    if (keys[i] == key) match |= (1ULL << i);
+  return match;
+}
+
+// 64 bit tags (addr_t): compare two (SSE2) or four (AVX2) tags at a time
+template <>
+inline uint64 FlatTagMatch<uint64>(const uint64 *keys, uint32 numKeys,
+                                   uint64 key) {
+  uint64 match = 0;
+#if defined(__AVX2__)
+  __m256i k = _mm256_set1_epi64x((long long)key);
+  for (uint32 i = 0; i < numKeys; i += 4) {
+    __m256i t = _mm256_loadu_si256((const __m256i *)(keys + i));
+    __m256i eq = _mm256_cmpeq_epi64(t, k);
+    match |= ((uint64)_mm256_movemask_pd(_mm256_castsi256_pd(eq))) << i;
+  }
+#elif defined(__SSE2__)
+  __m128i k = _mm_set1_epi64x((long long)key);
+  for (uint32 i = 0; i < numKeys; i += 2) {
+    __m128i t = _mm_loadu_si128((const __m128i *)(keys + i));
+    // 32 bit compare, then require both halves of each tag to match
+    __m128i eq = _mm_cmpeq_epi32(t, k);
+    eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+    match |= ((uint64)_mm_movemask_pd(_mm_castsi128_pd(eq))) << i;
+  }
+#else
+  for (uint32 i = 0; i < numKeys; i ++)
+    if (keys[i] == key) match |= (1ULL << i);
+#endif
+  return match;
+}
+
+
+// -----------------------------------------------------------------------------
+// Class: flat_tag_array_t
+// Description:
+//    Tags, valid bits and free ways of a flat tag store. The search and
+//    everything that touches the replacement state is implemented by
+//    flat_tag_array_impl_t for one policy and associativity, so each access
+//    costs a single virtual call. The tag array does not depend on the value
+//    type, which keeps the number of instantiations down.
+// -----------------------------------------------------------------------------
+
+template <class key_t>
+class flat_tag_array_t {
+
+protected:
+
+  // -------------------------------------------------------------------------
+  // Parameters
+  // -------------------------------------------------------------------------
+
+  uint32 _numSets;
+  uint32 _numWays;
+  uint32 _stride;                       // ways rounded up to the SIMD width
+
+  // -------------------------------------------------------------------------
+  // Tags (set major), per-set valid mask and free way ring. Free ways are
+  // handed out in the same order as the free list of table_t.
+  // -------------------------------------------------------------------------
+
+  vector <key_t> _keys;
+  vector <uint64> _valid;
+  vector <uint8> _freeWays;
+  vector <uint8> _freeHead;
+  vector <uint8> _freeCount;
+
+
+  uint32 PopFreeWay(uint32 set) {
+    uint32 way = _freeWays[set * _numWays + _freeHead[set]];
+    _freeHead[set] = (_freeHead[set] + 1) % _numWays;
+    _freeCount[set] --;
+    return way;
+  }
+
+  void PushFreeWay(uint32 set, uint32 way) {
+    uint32 tail = (_freeHead[set] + _freeCount[set]) % _numWays;
+    _freeWays[set * _numWays + tail] = way;
+    _freeCount[set] ++;
+  }
+
+  void InvalidateWay(uint32 set, uint32 way) {
+    if ((_valid[set] >> way) & 1) {
+      _valid[set] &= ~(1ULL << way);
+      PushFreeWay(set, way);
+    }
+  }
+
+
+public:
+
+  flat_tag_array_t(uint32 numSets, uint32 numWays) {
+    assert(numWays > 0 && numWays <= 64);
+    _numSets = numSets;
+    _numWays = numWays;
+    _stride = (numWays + 3) & ~3U;
+
+    _keys.resize(_numSets * _stride, key_t());
+    _valid.resize(_numSets, 0);
+    _freeWays.resize(_numSets * _numWays);
+    _freeHead.resize(_numSets, 0);
+    _freeCount.resize(_numSets, _numWays);
+    for (uint32 i = 0; i < _numSets; i ++)
+      for (uint32 j = 0; j < _numWays; j ++)
+        _freeWays[i * _numWays + j] = j;
+  }
+
+  virtual ~flat_tag_array_t() {}
+
+  uint32 stride() { return _stride; }
+  bool valid(uint32 set, uint32 way) { return (_valid[set] >> way) & 1; }
+  uint64 valid(uint32 set) { return _valid[set]; }
+  key_t key(uint32 set, uint32 way) { return _keys[set * _stride + way]; }
+
+
+  // -------------------------------------------------------------------------
+  // Function to search for a key in a set. Returns the number of ways on a
+  // miss.
+  // -------------------------------------------------------------------------
+
+  virtual uint32 find(uint32 set, key_t key) = 0;
+
+  // -------------------------------------------------------------------------
+  // Function to search for a key and apply op (FLAT_READ, FLAT_UPDATE or
+  // FLAT_INVALIDATE) to it if present. Returns the way, or the number of
+  // ways on a miss.
+  // -------------------------------------------------------------------------
+
+  virtual uint32 access(uint32 set, key_t key, flat_op_t op,
+                        policy_value_t pval) = 0;
+
+  // -------------------------------------------------------------------------
+  // Function to apply op to a valid way
+  // -------------------------------------------------------------------------
+
+  virtual void access_at(uint32 set, uint32 way, flat_op_t op,
+                         policy_value_t pval) = 0;
+
+  // -------------------------------------------------------------------------
+  // Function to insert a key that is known to be absent. Returns the way
+  // used; replaced is set if a valid key (returned in evictedKey) was evicted
+  // from it.
+  // -------------------------------------------------------------------------
+
+  virtual uint32 insert(uint32 set, key_t key, policy_value_t pval,
+                        bool &replaced, key_t &evictedKey) = 0;
+
+  // -------------------------------------------------------------------------
+  // Function to return the victim way of a full set
+  // -------------------------------------------------------------------------
+
+  virtual uint32 victim(uint32 set) = 0;
+
+  // -------------------------------------------------------------------------
+  // Function to save or restore the tags and the policy state
+  // -------------------------------------------------------------------------
+
+  virtual void CheckpointState(CheckpointFile &cp) {
+    CheckpointTransfer(cp, _keys);
+    CheckpointTransfer(cp, _valid);
+    CheckpointTransfer(cp, _freeWays);
+    CheckpointTransfer(cp, _freeHead);
+    CheckpointTransfer(cp, _freeCount);
+  }
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: flat_tag_array_impl_t
+// Description:
+//    Tag array for a replacement policy and an associativity known at compile
+//    time (Ways = 0 takes the associativity at run time). The policy is held
+//    by value, so its updates are inlined into each operation.
+// -----------------------------------------------------------------------------
+
+template <class key_t, template <uint32> class policy_t, uint32 Ways>
+class flat_tag_array_impl_t : public flat_tag_array_t <key_t> {
+
+protected:
+
+  typedef flat_tag_array_t <key_t> base;
+
+  // -------------------------------------------------------------------------
+  // Replacement policy for all the sets
+  // -------------------------------------------------------------------------
+
+  policy_t <Ways> _policy;
+
+
+  uint32 NumWays() {
+    return FlatWays <Ways> (this -> _numWays);
+  }
+
+  uint32 Stride() {
+    return (Ways != 0) ? ((Ways + 3) & ~3U) : this -> _stride;
+  }
+
+  uint32 SearchForKey(uint32 set, key_t key) {
+    uint64 hits = FlatTagMatch <key_t> (&this -> _keys[set * Stride()],
+                                        Stride(), key);
+    hits &= this -> _valid[set];
+    if (hits == 0)
+      return NumWays();
+    return __builtin_ctzll(hits);
+  }
+
+  void Apply(uint32 set, uint32 way, flat_op_t op, policy_value_t pval) {
+    _policy.Update(set, way, op, pval);
+    if (op == FLAT_INVALIDATE)
+      this -> InvalidateWay(set, way);
+  }
+
+
+public:
+
+  flat_tag_array_impl_t(uint32 numSets, uint32 numWays) :
+    base(numSets, numWays), _policy(numSets, numWays) {
+    assert(Ways == 0 || Ways == numWays);
+  }
+
+  uint32 find(uint32 set, key_t key) {
+    return SearchForKey(set, key);
+  }
+
+  uint32 access(uint32 set, key_t key, flat_op_t op, policy_value_t pval) {
+    uint32 way = SearchForKey(set, key);
+    if (way != NumWays())
+      Apply(set, way, op, pval);
+    return way;
+  }
+
+  void access_at(uint32 set, uint32 way, flat_op_t op, policy_value_t pval) {
+    Apply(set, way, op, pval);
+  }
+
+  uint32 insert(uint32 set, key_t key, policy_value_t pval, bool &replaced,
+                key_t &evictedKey) {
+    uint32 way;
+
+    // check if there is a free way
+    if (this -> _freeCount[set] != 0) {
+      way = this -> PopFreeWay(set);
+      _policy.Update(set, way, FLAT_INSERT, pval);
+      replaced = false;
+    }
+
+    // get a replacement way
+    else {
+      way = _policy.Victim(set, this -> _valid[set]);
+      _policy.Update(set, way, FLAT_REPLACE, pval);
+      replaced = ((this -> _valid[set] >> way) & 1);
+      evictedKey = this -> _keys[set * Stride() + way];
+    }
+
+    this -> _keys[set * Stride() + way] = key;
+    this -> _valid[set] |= (1ULL << way);
+    return way;
+  }
+
+  uint32 victim(uint32 set) {
+    return _policy.Victim(set, this -> _valid[set]);
+  }
+
+  void CheckpointState(CheckpointFile &cp) {
+    base::CheckpointState(cp);
+    _policy.CheckpointState(cp);
+  }
+};
+
+
+// -----------------------------------------------------------------------------
+// Function to instantiate a flat tag array for a policy. The common
+// associativities get their own instantiation, anything else falls back to
+// the run time associativity.
+// -----------------------------------------------------------------------------
+
+template <class key_t, template <uint32> class policy_t>
+flat_tag_array_t <key_t> *NewFlatTagArray(uint32 numSets, uint32 numWays) {
+  switch (numWays) {
+  case 2: return new flat_tag_array_impl_t <key_t, policy_t, 2> (numSets, numWays);
+  case 4: return new flat_tag_array_impl_t <key_t, policy_t, 4> (numSets, numWays);
+  case 8: return new flat_tag_array_impl_t <key_t, policy_t, 8> (numSets, numWays);
+  case 16: return new flat_tag_array_impl_t <key_t, policy_t, 16> (numSets, numWays);
+  case 32: return new flat_tag_array_impl_t <key_t, policy_t, 32> (numSets, numWays);
+  default: return new flat_tag_array_impl_t <key_t, policy_t, 0> (numSets, numWays);
+  }
+}
+
+
+// -----------------------------------------------------------------------------
+// Macros for including more policies
+// -----------------------------------------------------------------------------
+
+#define FLAT_POLICY_BEGIN                       \
+  if (false) { }
+
+#define FLAT_POLICY_END                                                 \
+  else {                                                                \
+    fprintf(stderr, "Error: Unknown table policy `%s'\n", policy.c_str()); \
+    exit(-1);                                                           \
+  }                                                                     \
+  return NULL;
+
+#define FLAT_POLICY(name,ptype)                                 \
+  else if (policy.compare(name) == 0) {                         \
+    return NewFlatTagArray <key_t, ptype> (numSets, numWays);   \
+  }
+
+
+// -----------------------------------------------------------------------------
+// Function to create the flat tag array for a policy name
+// -----------------------------------------------------------------------------
+
+template <class key_t>
+flat_tag_array_t <key_t> *CreateFlatTagArray(string policy, uint32 numSets,
+                                             uint32 numWays) {
+
+  // ---------------------------------------------------------------------------
+  // ADD AN ENTRY FOR EACH POLICY HERE (same names as PolicyList.h)
+  // ---------------------------------------------------------------------------
+
+  FLAT_POLICY_BEGIN
+  FLAT_POLICY("lru", flat_lru_policy_t)
+  FLAT_POLICY("plru", flat_plru_policy_t)
+  FLAT_POLICY("fifo", flat_fifo_policy_t)
+  FLAT_POLICY("reuse", flat_reuse_policy_t)
+  FLAT_POLICY("srrip", flat_srrip_policy_t)
+  FLAT_POLICY("nru", flat_nru_policy_t)
+  FLAT_POLICY("generation", flat_generation_policy_t)
+  FLAT_POLICY("dip", flat_dip_policy_t)
+  FLAT_POLICY("drrip", flat_drrip_policy_t)
+  FLAT_POLICY("drrip-hp", flat_drrip_hp_policy_t)
+  FLAT_POLICY("maxw", flat_way0_policy_t)
+  FLAT_POLICY("minw", flat_way0_policy_t)
+  FLAT_POLICY_END
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to check whether there is a flat tag array for a policy name (the
+// policies of CreateFlatTagArray) and an associativity
+// -----------------------------------------------------------------------------
+
+inline bool FlatTagStoreSupports(string policy, uint32 numWays) {
+  static const char *policies[] = {
+    "lru", "plru", "fifo", "reuse", "srrip", "nru", "generation", "dip",
+    "drrip", "drrip-hp", "maxw", "minw", NULL
+  };
+  if (numWays == 0 || numWays > 64)
+    return false;
+  for (uint32 i = 0; policies[i] != NULL; i ++) {
+    if (policy.compare(policies[i]) == 0)
+      return true;
+  }
+  return false;
+}
+
+
+// -----------------------------------------------------------------------------
+// Class: flat_tagstore_t
+// Description:
+//    Flat set-associative tag store (up to 64 ways): a tag array plus the
+//    values of all the ways.
+// -----------------------------------------------------------------------------
+
+template <class key_t, class value_t>
+class flat_tagstore_t {
+
+public:
+
+  typedef typename table_t <key_t, value_t>::entry entry;
+
+protected:
+
+  uint32 _numSets;
+  uint32 _numWays;
+  uint32 _stride;
+
+  flat_tag_array_t <key_t> *_tags;
+  value_t *_values;                     // array (not vector) so that
+                                        // value_at can return a reference
+
+  entry Entry(uint32 set, uint32 way) {
+    entry e(way, _tags -> key(set, way), _values[set * _stride + way]);
+    e.valid = _tags -> valid(set, way);
+    return e;
+  }
+
+
+public:
+
+  // -------------------------------------------------------------------------
+  // Constructor
+  // -------------------------------------------------------------------------
+
+  flat_tagstore_t(uint32 numSets, uint32 numWays, string policy) {
+    _numSets = numSets;
+    _numWays = numWays;
+    _tags = CreateFlatTagArray <key_t> (policy, numSets, numWays);
+    _stride = _tags -> stride();
+    _values = new value_t [_numSets * _stride]();
+  }
+
+  ~flat_tagstore_t() {
+    delete _tags;
+    delete [] _values;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to compute the index of a set
+  // -------------------------------------------------------------------------
+
+  uint32 index(key_t key) {
+    return key % _numSets;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to return a count of number of entries in the tag store
+  // -------------------------------------------------------------------------
+
+  uint32 count() {
+    uint32 ret = 0;
+    for (uint32 i = 0; i < _numSets; i ++)
+      ret += count(i);
+    return ret;
+  }
+
+  uint32 count(uint32 set) {
+    return __builtin_popcountll(_tags -> valid(set));
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to look up if a key is present
+  // -------------------------------------------------------------------------
+
+  bool lookup(key_t key) {
+    return _tags -> find(index(key), key) != _numWays;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to insert a key-value pair. Returns the existing entry if the
+  // key is present, an invalid entry if a free way was used and the evicted
+  // entry otherwise.
+  // -------------------------------------------------------------------------
+
+  entry insert(key_t key, value_t value, policy_value_t pval = POLICY_HIGH) {
+    uint32 set = index(key);
+    uint32 way;
+
+    // check if the key is already present
+    if ((way = _tags -> find(set, key)) != _numWays)
+      return Entry(set, way);
+
+    return insert_new(set, key, value, pval);
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to read a key
+  // -------------------------------------------------------------------------
+
+  entry read(key_t key, policy_value_t pval = POLICY_HIGH) {
+    uint32 set = index(key);
+    uint32 way = _tags -> access(set, key, FLAT_READ, pval);
+    if (way == _numWays)
+      return entry();
+    return Entry(set, way);
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to update a key
+  // -------------------------------------------------------------------------
+
+  entry update(key_t key, value_t value, policy_value_t pval = POLICY_HIGH) {
+    uint32 set = index(key);
+    uint32 way = _tags -> access(set, key, FLAT_UPDATE, pval);
+    if (way == _numWays)
+      return entry();
+    _values[set * _stride + way] = value;
+    return Entry(set, way);
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to silently update a key
+  // -------------------------------------------------------------------------
+
+  entry silentupdate(key_t key, policy_value_t pval = POLICY_HIGH) {
+    uint32 set = index(key);
+    uint32 way = _tags -> access(set, key, FLAT_UPDATE, pval);
+    if (way == _numWays)
+      return entry();
+    return Entry(set, way);
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to invalidate an entry
+  // -------------------------------------------------------------------------
+
+  entry invalidate(key_t key) {
+    uint32 set = index(key);
+    uint32 way = _tags -> access(set, key, FLAT_INVALIDATE, POLICY_HIGH);
+    if (way == _numWays)
+      return entry();
+    entry evicted = Entry(set, way);
+    evicted.valid = true;
+    return evicted;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Way based access, for callers that have already searched for the key.
+  // find returns the number of ways if the key is not present.
+  // -------------------------------------------------------------------------
+
+  uint32 find(uint32 set, key_t key) {
+    return _tags -> find(set, key);
+  }
+
+  entry insert_new(uint32 set, key_t key, value_t value,
+                   policy_value_t pval = POLICY_HIGH) {
+    bool replaced;
+    key_t evictedKey;
+    uint32 way = _tags -> insert(set, key, pval, replaced, evictedKey);
+    value_t &slot = _values[set * _stride + way];
+    entry evicted(way);
+    if (replaced) {
+      evicted = entry(way, evictedKey, slot);
+      evicted.valid = true;
+    }
+    slot = value;
+    return evicted;
+  }
+
+  void read_at(uint32 set, uint32 way, policy_value_t pval = POLICY_HIGH) {
+    assert(_tags -> valid(set, way));
+    _tags -> access_at(set, way, FLAT_READ, pval);
+  }
+
+  void silentupdate_at(uint32 set, uint32 way,
+                       policy_value_t pval = POLICY_HIGH) {
+    assert(_tags -> valid(set, way));
+    _tags -> access_at(set, way, FLAT_UPDATE, pval);
+  }
+
+  entry invalidate_at(uint32 set, uint32 way) {
+    assert(_tags -> valid(set, way));
+    entry evicted = Entry(set, way);
+    _tags -> access_at(set, way, FLAT_INVALIDATE, POLICY_HIGH);
+    return evicted;
+  }
+
+  value_t & value_at(uint32 set, uint32 way) {
+    return _values[set * _stride + way];
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to get an entry by location
+  // -------------------------------------------------------------------------
+
+  entry entry_at_location(uint32 set, uint32 way) {
+    assert(way < _numWays);
+    return Entry(set, way);
+  }
+
+
+  // -------------------------------------------------------------------------
+  // operator [] . Provide simple access to value at some key
+  // -------------------------------------------------------------------------
+
+  value_t & operator[] (key_t key) {
+    uint32 set = index(key);
+    uint32 way = _tags -> find(set, key);
+    assert(way != _numWays);
+    return _values[set * _stride + way];
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Simply return the entry corresponding to the tag
+  // -------------------------------------------------------------------------
+
+  entry get(key_t key) {
+    uint32 set = index(key);
+    uint32 way = _tags -> find(set, key);
+    if (way == _numWays)
+      return entry();
+    return Entry(set, way);
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to force eviction from a set
+  // -------------------------------------------------------------------------
+
+  entry force_evict(uint32 set) {
+    uint32 way = _tags -> victim(set);
+    entry evicted = Entry(set, way);
+    _tags -> access_at(set, way, FLAT_INVALIDATE, POLICY_HIGH);
+    return evicted;
+  }
+
+  key_t to_be_evicted(uint32 set) {
+    return _tags -> key(set, _tags -> victim(set));
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to save or restore the tag store
+  // -------------------------------------------------------------------------
+
+  void CheckpointState(CheckpointFile &cp) {
+    _tags -> CheckpointState(cp);
+    cp.Size(_numSets * _stride, "a tag store");
+    for (uint32 i = 0; i < _numSets * _stride; i ++)
+      CheckpointTransfer(cp, _values[i]);
+  }
+};
+
+#endif // __FLAT_TAG_STORE_H__
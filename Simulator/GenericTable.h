@@ -167,6 +167,43 @@ public:
   }
 
 
+  // -------------------------------------------------------------------------
+  // Index based access (see table_t). find returns the size of the table if
+  // the key is not present.
+  // -------------------------------------------------------------------------
+
+  uint32 find(key_t key) {
+    assert(_table != NULL);
+    return _table -> SearchForKey(key);
+  }
+
+  TableEntry insert_new(key_t key, value_t value,
+                        policy_value_t pval = POLICY_HIGH) {
+    assert(_table != NULL);
+    return _table -> insert_new(key, value, pval);
+  }
+
+  void read_at(uint32 index, policy_value_t pval = POLICY_HIGH) {
+    assert(_table != NULL);
+    _table -> read_at(index, pval);
+  }
+
+  void silentupdate_at(uint32 index, policy_value_t pval = POLICY_HIGH) {
+    assert(_table != NULL);
+    _table -> silentupdate_at(index, pval);
+  }
+
+  TableEntry invalidate_at(uint32 index) {
+    assert(_table != NULL);
+    return _table -> invalidate_at(index);
+  }
+
+  value_t & value_at(uint32 index) {
+    assert(_table != NULL);
+    return _table -> value_at(index);
+  }
+
+
   // -------------------------------------------------------------------------
   // Function to get an entry by index
   // -------------------------------------------------------------------------
@@ -195,11 +232,42 @@ public:
     assert(_table != NULL);
     return _table -> get(key);
   }
+
+
+  // -------------------------------------------------------------------------
+  // Function to save or restore the table (nothing if it is not used)
+  // -------------------------------------------------------------------------
+
+  void CheckpointState(CheckpointFile &cp) {
+    if (_table != NULL)
+      _table -> CheckpointState(cp);
+  }
 };
 
 
 // All the functions till here were just functions of the table class
 
+
+// -----------------------------------------------------------------------------
+// Handle to the slot holding a key in a tag store, returned by find. The
+// handle stays usable until the next insert or invalidate in its set, so a
+// request can search the tag store once and then update the replacement
+// state and the value through the handle.
+// -----------------------------------------------------------------------------
+
+template <class value_t> struct tag_handle_t {
+  bool valid;                                   // key is present
+  uint32 set;
+  uint32 slot;
+  value_t *value;
+
+  value_t * operator -> () {
+    assert(valid);
+    return value;
+  }
+};
+
+
 // -----------------------------------------------------------------------------
 // Macros for including more policies
 // -----------------------------------------------------------------------------
@@ -17,6 +17,7 @@
 
 #include "Types.h"
 #include "GenericTable.h"
+#include "FlatTagStore.h"
 
 // -----------------------------------------------------------------------------
 // Standard includes
@@ -58,6 +59,8 @@ public:
 
   generic_table_t <key_t, value_t> *_sets;      // generic table is a flexible wrapper for table incorporating policies
 
+  flat_tagstore_t <key_t, value_t> *_flat;      // flat (structure of arrays) tag store, used instead of _sets if set
+
     
   // -------------------------------------------------------------------------
   // Constructor
@@ -68,6 +71,7 @@ public:
     _numSlotsPerSet = 0;
     _policy = "";
     _sets = NULL;
+    _flat = NULL;
   }
 
 
@@ -75,22 +79,33 @@ public:
   // Constructor with details
   // -------------------------------------------------------------------------
 
-  generic_tagstore_t(uint32 numSets, uint32 numSlotsPerSet, string policy) {
-    SetTagStoreParameters(numSets, numSlotsPerSet, policy);
+  generic_tagstore_t(uint32 numSets, uint32 numSlotsPerSet, string policy,
+                     bool flat = false) {
+    _sets = NULL;
+    _flat = NULL;
+    SetTagStoreParameters(numSets, numSlotsPerSet, policy, flat);
   }
 
 
   // -------------------------------------------------------------------------
-  // Function to set the tag store parameters
+  // Function to set the tag store parameters. If flat is set and there is a
+  // flat tag store for the policy and associativity, the sets are kept in a
+  // single flat_tagstore_t instead of one table per set.
   // -------------------------------------------------------------------------
 
   void SetTagStoreParameters(uint32 numSets, uint32 numSlotsPerSet,
-                             string policy) {
+                             string policy, bool flat = false) {
     // set the members
     _numSets = numSets;
     _numSlotsPerSet = numSlotsPerSet;
     _policy = policy;
 
+    if (flat && FlatTagStoreSupports(_policy, _numSlotsPerSet)) {
+      _flat = new flat_tagstore_t <key_t, value_t> (_numSets, _numSlotsPerSet,
+                                                     _policy);
+      return;
+    }
+
     // set the table values
     _sets = new generic_table_t <key_t, value_t> [_numSets];
 
@@ -108,11 +123,97 @@ public:
   }
 
 
+  // -------------------------------------------------------------------------
+  // Handle to the slot of a key (see tag_handle_t)
+  // -------------------------------------------------------------------------
+
+  typedef tag_handle_t <value_t> handle;
+
+
+  // -------------------------------------------------------------------------
+  // Function to search for a key and return its handle
+  // -------------------------------------------------------------------------
+
+  handle find(key_t key) {
+    handle h;
+    h.set = index(key);
+    if (_flat != NULL) {
+      h.slot = _flat -> find(h.set, key);
+      h.valid = (h.slot != _numSlotsPerSet);
+      h.value = (h.valid ? &(_flat -> value_at(h.set, h.slot)) : NULL);
+    }
+    else {
+      assert(_sets != NULL);
+      h.slot = _sets[h.set].find(key);
+      h.valid = (h.slot != _numSlotsPerSet);
+      h.value = (h.valid ? &(_sets[h.set].value_at(h.slot)) : NULL);
+    }
+    return h;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Functions to read (update the replacement state) or silently update a
+  // key through a valid handle
+  // -------------------------------------------------------------------------
+
+  void read(handle &h, policy_value_t pval = POLICY_HIGH) {
+    assert(h.valid);
+    if (_flat != NULL) _flat -> read_at(h.set, h.slot, pval);
+    else _sets[h.set].read_at(h.slot, pval);
+  }
+
+  void silentupdate(handle &h, policy_value_t pval = POLICY_HIGH) {
+    assert(h.valid);
+    if (_flat != NULL) _flat -> silentupdate_at(h.set, h.slot, pval);
+    else _sets[h.set].silentupdate_at(h.slot, pval);
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to insert a key through the handle returned by a find that
+  // missed. Returns the evicted entry, and the handle then refers to the
+  // inserted key.
+  // -------------------------------------------------------------------------
+
+  TableEntry insert(handle &h, key_t key, value_t value,
+                    policy_value_t pval = POLICY_HIGH) {
+    assert(!h.valid);
+    TableEntry evicted;
+    if (_flat != NULL) {
+      evicted = _flat -> insert_new(h.set, key, value, pval);
+      h.slot = evicted.index;
+      h.value = &(_flat -> value_at(h.set, h.slot));
+    }
+    else {
+      evicted = _sets[h.set].insert_new(key, value, pval);
+      h.slot = evicted.index;
+      h.value = &(_sets[h.set].value_at(h.slot));
+    }
+    h.valid = true;
+    return evicted;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to invalidate a key through a valid handle
+  // -------------------------------------------------------------------------
+
+  TableEntry invalidate(handle &h) {
+    assert(h.valid);
+    h.valid = false;
+    h.value = NULL;
+    if (_flat != NULL) return _flat -> invalidate_at(h.set, h.slot);
+    return _sets[h.set].invalidate_at(h.slot);
+  }
+
+
   // -------------------------------------------------------------------------
   // Function to return a count of number of entries in the tag store
   // -------------------------------------------------------------------------
 
   uint32 count() {
+    if (_flat != NULL) return _flat -> count();
     assert(_sets != NULL);
     uint32 ret = 0;
     for (uint32 i = 0; i < _numSets; i ++)
@@ -121,6 +222,7 @@ public:
   }
 
   uint32 count(uint32 index) {
+    if (_flat != NULL) return _flat -> count(index);
     assert(_sets != NULL);
     return _sets[index].count();
   }
@@ -131,6 +233,7 @@ public:
   // -------------------------------------------------------------------------
 
   bool lookup(key_t key) {
+    if (_flat != NULL) return _flat -> lookup(key);
     assert(_sets != NULL);
     return _sets[index(key)].lookup(key);
   }
@@ -142,6 +245,7 @@ public:
 
   virtual TableEntry insert(key_t key, value_t value,
                             policy_value_t pval = POLICY_HIGH) {
+    if (_flat != NULL) return _flat -> insert(key, value, pval);
     assert(_sets != NULL);
     return _sets[index(key)].insert(key, value, pval);
   }
@@ -152,6 +256,7 @@ public:
   // -------------------------------------------------------------------------
 
   virtual TableEntry read(key_t key, policy_value_t pval = POLICY_HIGH) {
+    if (_flat != NULL) return _flat -> read(key, pval);
     assert(_sets != NULL);
     return _sets[index(key)].read(key, pval);
   }
@@ -163,6 +268,7 @@ public:
 
   virtual TableEntry update(key_t key, value_t value,
                             policy_value_t pval = POLICY_HIGH) {
+    if (_flat != NULL) return _flat -> update(key, value, pval);
     assert(_sets != NULL);
     return _sets[index(key)].update(key, value, pval);
   }
@@ -173,6 +279,7 @@ public:
   // -------------------------------------------------------------------------
 
   virtual TableEntry silentupdate(key_t key, policy_value_t pval = POLICY_HIGH) {
+    if (_flat != NULL) return _flat -> silentupdate(key, pval);
     assert(_sets != NULL);
     return _sets[index(key)].silentupdate(key, pval);
   }
@@ -183,6 +290,7 @@ public:
   // -------------------------------------------------------------------------
 
   virtual TableEntry invalidate(key_t key) {
+    if (_flat != NULL) return _flat -> invalidate(key);
     assert(_sets != NULL);
     return _sets[index(key)].invalidate(key);
   }
@@ -193,6 +301,7 @@ public:
   // -------------------------------------------------------------------------
 
   TableEntry entry_at_location(uint32 setindex, uint32 slotindex) {
+    if (_flat != NULL) return _flat -> entry_at_location(setindex, slotindex);
     assert(_sets != NULL);
     return _sets[setindex].entry_at_index(slotindex);
   }
@@ -203,6 +312,7 @@ public:
   // -------------------------------------------------------------------------
 
   value_t & operator[] (key_t key) {
+    if (_flat != NULL) return (*_flat)[key];
     assert(_sets != NULL);
     return (_sets[index(key)])[key];
   }
@@ -213,6 +323,7 @@ public:
   // -------------------------------------------------------------------------
 
   TableEntry get(key_t key) {
+    if (_flat != NULL) return _flat -> get(key);
     return _sets[index(key)].get(key);
   }
 
@@ -222,12 +333,31 @@ public:
   // -------------------------------------------------------------------------
 
   TableEntry force_evict(uint32 index) {
+    if (_flat != NULL) return _flat -> force_evict(index);
     return _sets[index].force_evict();
   }
 
   key_t to_be_evicted(uint32 index) {
+    if (_flat != NULL) return _flat -> to_be_evicted(index);
     return _sets[index].to_be_evicted();
   }
+
+
+  // -------------------------------------------------------------------------
+  // Function to save or restore the tag store
+  // -------------------------------------------------------------------------
+
+  virtual void CheckpointState(CheckpointFile &cp) {
+    cp.Size(_numSets, "a tag store");
+    cp.Marker(_policy);
+    if (_flat != NULL) {
+      _flat -> CheckpointState(cp);
+      return;
+    }
+    assert(_sets != NULL);
+    for (uint32 i = 0; i < _numSets; i ++)
+      _sets[i].CheckpointState(cp);
+  }
 };
 
 #endif // __GENERIC_TAG_STORE_H__
@@ -13,6 +13,9 @@
 // -----------------------------------------------------------------------------
 
 #include "MemoryRequest.h"
+#include "RequestQueue.h"
+#include "WakeUpQueue.h"
+#include "Checkpoint.h"
 #include "Types.h"
 
 // -----------------------------------------------------------------------------
@@ -196,10 +199,38 @@ using namespace std;
 // Priority queue definition
 // -----------------------------------------------------------------------------
 
-typedef priority_queue <MemoryRequest *, vector <MemoryRequest *>,
-          MemoryRequest::ComparePointers> RequestPriorityQueue;
+// queue of requests ordered by current cycle (see RequestQueue.h)
+typedef RequestHeap RequestPriorityQueue;
 
-// priority_queue is a pre-existing type, present in the std namespace
+
+class MemoryComponent;
+
+// -----------------------------------------------------------------------------
+// Work list of the components processing requests, innermost last (see
+// MemoryComponent::ProcessPendingRequests). There is one per simulator, or
+// per domain if the simulation is split.
+// -----------------------------------------------------------------------------
+
+typedef vector <MemoryComponent *> RequestWorkList;
+
+
+// -----------------------------------------------------------------------------
+// Class: RequestExchange
+// Description:
+//    Takes requests that cross from one simulation domain to another (see
+//    MemorySimulator.h). Requests posted to it are delivered to the target
+//    component later, when the domains are in step.
+// -----------------------------------------------------------------------------
+
+class RequestExchange {
+
+  public:
+
+    virtual ~RequestExchange() { }
+
+    virtual void Post(uint32 fromDomain, MemoryComponent *to,
+        MemoryRequest *request) = 0;
+};
 
 // -----------------------------------------------------------------------------
 // Class: MemoryComponent
@@ -229,12 +260,23 @@ class MemoryComponent {
     bool _processing;
     // warm up flag, true if in warm up phase
     bool _warmUp;
+    // functional flag, true if requests are passed through without timing
+    bool _functional;
     // pointer to the simulator cycle
     cycles_t *_simulatorCycle;
     // pointer to the memory hierarchy
     vector <vector <MemoryComponent *> > *_hier;
     // number of cpus
     uint32 _numCPUs;
+    // simulator wake-up queue and index of the component in it
+    WakeUpQueue *_wakeUp;
+    uint32 _wakeUpIndex;
+    // domain of the component and the exchange that takes requests to other
+    // domains (NULL if the simulation is not split into domains)
+    uint32 _domain;
+    RequestExchange *_exchange;
+    // work list the component processes its requests on
+    RequestWorkList *_workList;
 
   bitset <128> _done;
 
@@ -270,10 +312,16 @@ class MemoryComponent {
       _currentCycle = 0;
       _processing = false;
       _warmUp = true;
+      _functional = false;
       _stats.clear();
       _statsOrder.clear();
       _logs.clear();
       _done.reset();
+      _wakeUp = NULL;
+      _wakeUpIndex = 0;
+      _domain = 0;
+      _exchange = NULL;
+      _workList = NULL;
     }
 
 
@@ -298,6 +346,7 @@ class MemoryComponent {
 	_queue.pop();
 	(request -> currentCycle) += 10;
 	_queue.push(request);
+	WakeUp(NextWakeUpCycle());
     }
 
 
@@ -335,6 +384,52 @@ class MemoryComponent {
     }
 
 
+    // -------------------------------------------------------------------------
+    // Function to set the simulator wake-up queue
+    // -------------------------------------------------------------------------
+
+    void SetWakeUpQueue(WakeUpQueue *wakeUp, uint32 index) {
+      _wakeUp = wakeUp;
+      _wakeUpIndex = index;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to set the work list the component processes requests on
+    // -------------------------------------------------------------------------
+
+    void SetWorkList(RequestWorkList *workList) {
+      _workList = workList;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to place the component in a simulation domain, with its own
+    // clock
+    // -------------------------------------------------------------------------
+
+    void SetDomain(uint32 domain, RequestExchange *exchange,
+        cycles_t *simCycle) {
+      _domain = domain;
+      _exchange = exchange;
+      _simulatorCycle = simCycle;
+    }
+
+    uint32 Domain() {
+      return _domain;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to tell the simulator that the component has work by a cycle
+    // -------------------------------------------------------------------------
+
+    void WakeUp(cycles_t cycle) {
+      if (_wakeUp != NULL && cycle != WAKE_UP_NEVER)
+        _wakeUp -> Wake(_wakeUpIndex, cycle);
+    }
+
+
     // -------------------------------------------------------------------------
     // Function to set the log details of the request
     // -------------------------------------------------------------------------
@@ -352,17 +447,36 @@ class MemoryComponent {
 
     void AddRequest(MemoryRequest *request) {
       _queue.push(request);
+      if (_functional) {
+        if (!_processing)
+          ProcessFunctionally();
+        return;
+      }
+      WakeUp(NextWakeUpCycle());
       if (!_processing)
         ProcessPendingRequests();
 
     }
 
 
+    // -------------------------------------------------------------------------
+    // Function to switch the component to functional mode and back. In
+    // functional mode requests are processed as soon as they arrive, at the
+    // cycle they arrive, by FunctionalAccess. Requests left in the queue by
+    // the timing model are processed the same way with the next one.
+    // -------------------------------------------------------------------------
+
+    void SetFunctional(bool functional) {
+      _functional = functional;
+    }
+
+
     // ------------------------------------------------------------------------
     // Function to add request without doing progress
     // ------------------------------------------------------------------------
     void SimpleAddRequest(MemoryRequest *request) {
       _queue.push(request);
+      WakeUp(NextWakeUpCycle());
 
     }
 
@@ -381,6 +495,35 @@ class MemoryComponent {
     }
 
 
+    // -------------------------------------------------------------------------
+    // Function to return the earliest cycle the simulator has to advance to
+    // for the component (WAKE_UP_NEVER if it has no request). The default is
+    // the cycle of the earliest request. Components whose requests wait for
+    // more than their cycle return the cycle they can act at instead.
+    // -------------------------------------------------------------------------
+
+    virtual cycles_t EarliestCycle() {
+      MemoryRequest *request = EarliestRequest();
+      if (request == NULL)
+        return WAKE_UP_NEVER;
+      return request -> currentCycle;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to return the earliest cycle at which processing the pending
+    // requests can do anything (WAKE_UP_NEVER if there are none). Components
+    // that override ProcessPendingRequests with other conditions should
+    // override this as well.
+    // -------------------------------------------------------------------------
+
+    virtual cycles_t NextWakeUpCycle() {
+      if (_queue.empty())
+        return WAKE_UP_NEVER;
+      return _queue.top() -> currentCycle;
+    }
+
+
     // -------------------------------------------------------------------------
     // Virtual functions to be implemented by the components
     // -------------------------------------------------------------------------
@@ -447,87 +590,163 @@ class MemoryComponent {
 
 
     // -------------------------------------------------------------------------
-    // Function to process pending requests. Different components can choose to
-    // override this function. The default implementation processes one request
-    // at a time.
+    // Function to save or restore the state of the component (see
+    // Checkpoint.h). Components with state of their own extend it and call
+    // this first. Checkpoints are taken when the processors have no request
+    // in flight; the requests still held (writebacks, prefetches) are saved.
     // -------------------------------------------------------------------------
 
-    virtual void ProcessPendingRequests() {
+    virtual void CheckpointState(CheckpointFile &cp) {
+      cp.Marker(_name);
+      _queue.CheckpointState(cp);
+      CHECKPOINT(_currentCycle);
+      CHECKPOINT(_warmUp);
+      CHECKPOINT(_done);
+      list <string>::iterator it;
+      for (it = _statsOrder.begin(); it != _statsOrder.end(); it ++)
+        CHECKPOINT(*(_stats[*it].ptr));
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to add the statistics of the component to a snapshot, as
+    // (component:statistic, value) in the order they are dumped
+    // -------------------------------------------------------------------------
+
+    void SnapshotCounters(vector <pair <string, uint64> > &snapshot) {
+      list <string>::iterator it;
+      for (it = _statsOrder.begin(); it != _statsOrder.end(); it ++)
+        snapshot.push_back(make_pair(_name + ":" + *it, *(_stats[*it].ptr)));
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to process pending requests. The component goes on the work
+    // list, which is run until the component is done. Each step processes a
+    // request of the innermost component (ProcessNextRequest); a request it
+    // passes on puts the next component on the list instead of calling it.
+    // Components are stepped in the order the calls would have nested in,
+    // without the depth. Requests sent from inside ProcessRequest (misses,
+    // writebacks, prefetches) run the list from there, so they are through
+    // before the caller goes on, as before.
+    // -------------------------------------------------------------------------
+
+    void ProcessPendingRequests() {
 
       // if already processing, return
       if (_processing) return;
       _processing = true;
 
-      // if the queue is empty, return
-      if (_queue.empty()) {
-        _processing = false;
-        return;
+      RequestWorkList &work = *_workList;
+      size_t mark = work.size();
+      work.push_back(this);
+      while (work.size() > mark) {
+        MemoryComponent *component = work.back();
+        if (!component -> ProcessNextRequest()) {
+          assert(work.back() == component);
+          component -> _processing = false;
+          work.pop_back();
+        }
       }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to access the component in functional mode (see
+    // SetFunctional). The default processes the request as the timing model
+    // would and drops the latency, so caches and predictors are updated
+    // (an MSHR still holds a request until its miss returns, which happens
+    // before the access is over). Components whose state only matters for
+    // timing (memory controllers) override it to let the request pass.
+    // -------------------------------------------------------------------------
+
+    virtual void FunctionalAccess(MemoryRequest *request) {
+      if (request -> serviced)
+        ProcessReturn(request);
+      else
+        ProcessRequest(request);
+    }
+
+
+  protected:
+
+    // -------------------------------------------------------------------------
+    // Function to process the next pending request (a step of
+    // ProcessPendingRequests). Returns false when there is nothing to do by
+    // the simulator cycle. Different components can choose to override this
+    // function. The default implementation processes one request at a time,
+    // in the order of their current cycle.
+    // -------------------------------------------------------------------------
+
+    virtual bool ProcessNextRequest() {
+
+      // if the queue is empty, return
+      if (_queue.empty())
+        return false;
 
       // get the request on the top of the queue
       MemoryRequest *request = _queue.top();
 
-/*
-Process till the currentcycle of request reaches global simulator cycles
-and do this for all the request that are in the queue.
-Access the request according to age.
-*/
-      // process till component (or request ??) reaches simulator cycles
+      // process till the request reaches the simulator cycle
+      if (request -> currentCycle > (*_simulatorCycle))
+        return false;
 
-	// What if the currentCycle of request is more than _simulatorCycle ?, as is the case when a request is returned by a cb
-      while (request -> currentCycle <= (*_simulatorCycle)) {
-
-        _queue.pop();
+      _queue.pop();
 
-        // if component is past the simulator (When can this scenario arise?)
-	// this if block ensures that request is in sync with whichever component it arrives at
-        if (_currentCycle > (*_simulatorCycle)) {
-          request -> currentCycle = _currentCycle;
-          _queue.push(request);
-        }
+      // if component is past the simulator, the request waits for it
+      if (_currentCycle > (*_simulatorCycle)) {
+        request -> currentCycle = _currentCycle;
+        _queue.push(request);
+        return false;
+      }
 
-        // else process the request
-        else {
-          // get actual current time
-          cycles_t now = max(request -> currentCycle, _currentCycle);
-          _currentCycle = now;
-          // if request is serviced, process return of request
-          if (request -> serviced) {
-            // CHECK
-            cycles_t busyCycles = ProcessReturn(request);
-            _currentCycle += busyCycles;
-            SendToNextComponent(request);
-          }
-	// request is yet to be serviced
-          else {
-            request -> currentCycle = now;
-            cycles_t busyCycles = ProcessRequest(request);
-            _currentCycle += busyCycles;
-            SendToNextComponent(request);
-          }
-
-          // if queue is empty, return
-          if (_queue.empty()) {
-            _processing = false;
-            return;
-          }
-
-          // get the request on top of the queue
-          request = _queue.top();
-        }
+      // get actual current time
+      cycles_t now = max(request -> currentCycle, _currentCycle);
+      _currentCycle = now;
+      // if request is serviced, process return of request
+      if (request -> serviced) {
+        cycles_t busyCycles = ProcessReturn(request);
+        _currentCycle += busyCycles;
       }
+      // request is yet to be serviced
+      else {
+        request -> currentCycle = now;
+        cycles_t busyCycles = ProcessRequest(request);
+        _currentCycle += busyCycles;
+      }
+      PassToNextComponent(request);
+      return true;
+    }
+
 
+    // -------------------------------------------------------------------------
+    // Function to process the requests in functional mode. Requests that come
+    // back while the component is busy (the return of its own miss, its
+    // writebacks) are queued and processed after the current one, so
+    // FunctionalAccess is never reentered.
+    // -------------------------------------------------------------------------
+
+    void ProcessFunctionally() {
+      _processing = true;
+      while (!_queue.empty()) {
+        MemoryRequest *request = _queue.top();
+        _queue.pop();
+        _currentCycle = max(request -> currentCycle, _currentCycle);
+        request -> currentCycle = _currentCycle;
+        FunctionalAccess(request);
+        request -> currentCycle = _currentCycle;
+        SendToNextComponent(request);
+      }
       _processing = false;
     }
 
-  protected:
 
     // -------------------------------------------------------------------------
     // Function to process a request. Return value indicates number of busy
     // cycles for the component.
     // -------------------------------------------------------------------------
 
-    virtual cycles_t ProcessRequest(MemoryRequest *request) { return 0; }
+    virtual cycles_t ProcessRequest(MemoryRequest *) { return 0; }
 
 
     // -------------------------------------------------------------------------
@@ -535,7 +754,7 @@ Access the request according to age.
     // number of busy cycles for the component.
     // -------------------------------------------------------------------------
 
-    virtual cycles_t ProcessReturn(MemoryRequest *request) { return 0; }
+    virtual cycles_t ProcessReturn(MemoryRequest *) { return 0; }
 
 
     // -------------------------------------------------------------------------
@@ -544,30 +763,75 @@ Access the request according to age.
     // -------------------------------------------------------------------------
 
     void SendToNextComponent(MemoryRequest *request) {
+      MemoryComponent *next = NextComponent(request);
+      if (next != NULL)
+        next -> AddRequest(request);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to pass the request on at the end of a step of
+    // ProcessNextRequest. Same as SendToNextComponent, except that the next
+    // component is put on the work list rather than called.
+    // -------------------------------------------------------------------------
+
+    void PassToNextComponent(MemoryRequest *request) {
+      MemoryComponent *next = NextComponent(request);
+      if (next != NULL)
+        next -> QueueRequest(request);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to add a request to the queue and put the component on the
+    // work list (if it is not processing already)
+    // -------------------------------------------------------------------------
+
+    void QueueRequest(MemoryRequest *request) {
+      _queue.push(request);
+      if (_functional) {
+        if (!_processing)
+          ProcessFunctionally();
+        return;
+      }
+      WakeUp(NextWakeUpCycle());
+      if (!_processing) {
+        _processing = true;
+        _workList -> push_back(this);
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to find the component the request goes to next. Returns NULL
+    // if the request goes nowhere (deleted, stalling, finished, or posted to
+    // another domain).
+    // -------------------------------------------------------------------------
+
+    MemoryComponent *NextComponent(MemoryRequest *request) {
 
       // if the request should be destroyed, delete it
       if (request -> destroy) {
         delete request;
-        return;
+        return NULL;
       }
 
       if(request -> type == MemoryRequest::CLEAN){
-         this -> AddRequest(request);
-         return;
+         return this;
       }
 
       // if the request is stalling, set its current cycle to
       // one past the component's currenct cycle (ensure progress)
       // add it back to the component's queue. (This doesn't seem to have been done)
       if (request -> stalling) {
-        return;
+        return NULL;
       }
 
       // else if request is serviced, send it to previous component
       if (request -> serviced) {
         if (request -> cmpID == 0) {
           request -> finished = true;
-          return;
+          return NULL;
         }
         request -> cmpID --;
       }
@@ -580,7 +844,12 @@ Access the request according to age.
         else
           request -> cmpID ++;
       }
-      ((*_hier)[request -> cpuID])[request -> cmpID] -> AddRequest(request);
+      MemoryComponent *next = ((*_hier)[request -> cpuID])[request -> cmpID];
+      if (_exchange != NULL && !_functional && next -> _domain != _domain) {
+        _exchange -> Post(_domain, next, request);
+        return NULL;
+      }
+      return next;
     }
 };
 
@@ -13,11 +13,16 @@
 // -----------------------------------------------------------------------------
 
 #include "Types.h"
+#include "RequestPool.h"
+#include "Checkpoint.h"
 
 // -----------------------------------------------------------------------------
 // Standard includes
 // -----------------------------------------------------------------------------
 
+#include <cstddef>
+#include <pthread.h>
+
 
 // -----------------------------------------------------------------------------
 // Structure: MemoryRequest
@@ -119,6 +124,21 @@ struct MemoryRequest {
   bool reuseVictim;
   uint32 victimSetID;
 
+  // ---------------------------------------------------------------------------
+  // Ownership. Number of holders of the request; the last one to release it
+  // deletes it. Requests start with one owner (their creator).
+  // ---------------------------------------------------------------------------
+
+  uint32 owners;
+
+  // ---------------------------------------------------------------------------
+  // Parallel engine. away is set while the request is outside its core's
+  // domain, parked while its core is not waiting on it because of that.
+  // ---------------------------------------------------------------------------
+
+  bool away;
+  bool parked;
+
   // ---------------------------------------------------------------------------
   // Constructor
   // ---------------------------------------------------------------------------
@@ -133,6 +153,9 @@ struct MemoryRequest {
     d_prefetched = false;
     d_hit = false;
     s_f_d = false;
+    owners = 1;
+    away = false;
+    parked = false;
   }
 
   // ---------------------------------------------------------------------------
@@ -159,6 +182,30 @@ struct MemoryRequest {
     d_prefetched = false;
     d_hit = false;
     s_f_d = false;
+    owners = 1;
+    away = false;
+    parked = false;
+  }
+
+  // ---------------------------------------------------------------------------
+  // Allocation from the current request pool of the thread
+  // ---------------------------------------------------------------------------
+
+  static void *operator new(size_t size);
+  static void operator delete(void *ptr);
+
+  // ---------------------------------------------------------------------------
+  // Functions to take and release a reference to the request. Release returns
+  // true if this was the last owner.
+  // ---------------------------------------------------------------------------
+
+  void Acquire() {
+    owners ++;
+  }
+
+  bool Release() {
+    assert(owners > 0);
+    return (-- owners) == 0;
   }
 
   // ---------------------------------------------------------------------------
@@ -182,6 +229,91 @@ struct MemoryRequest {
 };
 
 
+// -----------------------------------------------------------------------------
+// Pools from which the requests are allocated. Each thread allocates from its
+// current pool (simulations running side by side keep their requests to
+// themselves, and a request freed by another thread goes back to the pool it
+// came from). A simulation owns the pools of the threads it runs on and makes
+// them current with SetMemoryRequestPool, since its requests outlive those
+// threads. A thread that was given no pool gets one of its own, which is
+// freed when the thread exits if none of its requests is still live.
+// -----------------------------------------------------------------------------
+
+inline void ReleaseThreadRequestPool(void *pool) {
+  if (((RequestPool *)pool) -> Live() == 0)
+    delete (RequestPool *)pool;
+}
+
+struct ThreadRequestPoolKey {
+  pthread_key_t key;
+  ThreadRequestPoolKey() {
+    pthread_key_create(&key, ReleaseThreadRequestPool);
+  }
+};
+
+inline RequestPool *&CurrentRequestPool() {
+  static __thread RequestPool *pool = NULL;
+  return pool;
+}
+
+inline RequestPool &MemoryRequestPool() {
+  RequestPool *&pool = CurrentRequestPool();
+  if (pool == NULL) {
+    static ThreadRequestPoolKey own;
+    pool = (RequestPool *)pthread_getspecific(own.key);
+    if (pool == NULL) {
+      pool = new RequestPool(sizeof(MemoryRequest));
+      pthread_setspecific(own.key, pool);
+    }
+  }
+  return *pool;
+}
+
+// makes a pool owned by the caller current for the calling thread (NULL goes
+// back to the thread's own pool)
+inline void SetMemoryRequestPool(RequestPool *pool) {
+  CurrentRequestPool() = pool;
+}
+
+inline void *MemoryRequest::operator new(size_t size) {
+  return MemoryRequestPool().Allocate(size);
+}
+
+inline void MemoryRequest::operator delete(void *ptr) {
+  MemoryRequestPool().Free(ptr);
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to save or restore a request held by the memory system (see
+// Checkpoint.h). A request held by several structures is restored once and
+// shared. Requests of the processors cannot be saved: checkpoints are taken
+// when they have all finished.
+// -----------------------------------------------------------------------------
+
+inline void CheckpointTransfer(CheckpointFile &cp, MemoryRequest *&request) {
+  void *ptr = request;
+  if (!cp.Reference(ptr)) {
+    request = (MemoryRequest *)ptr;
+    return;
+  }
+  if (cp.Restoring()) {
+    request = new MemoryRequest();
+    cp.AddObject(request);
+  }
+  else if (request -> iniType == MemoryRequest::CPU) {
+    fprintf(stderr, "Error: a request of processor %d is still in flight "
+        "at the checkpoint\n", request -> cpuID);
+    exit(-1);
+  }
+  void *initiator = request -> iniPtr;
+  request -> iniPtr = NULL;
+  cp.Bytes(request, sizeof(MemoryRequest));
+  request -> iniPtr = initiator;
+  cp.Pointer(request -> iniPtr, "the initiator of a request");
+}
+
+
 // -----------------------------------------------------------------------------
 // Some macros
 // -----------------------------------------------------------------------------
@@ -3,6 +3,13 @@
 // Description:
 //    Defines the memory simulator class. The interface is independent of the
 //    front-end used to drive the simulator.
+//
+//    For the parallel engine the components are split into domains, each
+//    with its own clock: a component used by only one cpu belongs to that
+//    cpu's domain, all the others to the shared domain. A request going to a
+//    component of another domain is posted, and the posted requests are
+//    delivered by Exchange, in an order that does not depend on how the
+//    domains were scheduled.
 // -----------------------------------------------------------------------------
 
 #ifndef __MEMORY_SIMULATOR_H__
@@ -21,6 +28,8 @@
 // -----------------------------------------------------------------------------
 
 #include <list>
+#include <vector>
+#include <algorithm>
 #include <cstdio>
 #include <cassert>
 #include <sstream>
@@ -34,10 +43,36 @@ using namespace std;
 //    Defines a memory simulator
 // -----------------------------------------------------------------------------
 
-class MemorySimulator {
+class MemorySimulator : public RequestExchange {
 
   protected:
 
+    // a request posted to another domain
+    struct Posted {
+      MemoryComponent *to;
+      MemoryRequest *request;
+    };
+
+    struct ComparePosted {
+      bool operator() (const Posted &a, const Posted &b) const {
+        return a.request -> currentCycle < b.request -> currentCycle;
+      }
+    };
+
+    // a simulation domain
+    struct Domain {
+      cycles_t clock;
+      vector <MemoryComponent *> byIndex;
+      WakeUpQueue wakeUp;
+      RequestWorkList workList;
+      // requests posted by the domain
+      vector <Posted> outbox;
+      // requests delivered to the domain
+      vector <Posted> inbox;
+      // parked requests of the cpu that are back in its domain
+      vector <MemoryRequest *> returned;
+    };
+
     // list of memory components
     list <MemoryComponent *> _components;
     // number of cpus
@@ -53,6 +88,50 @@ class MemorySimulator {
     // current time of the simulator
     cycles_t _currentCycle;
 
+    // components by index, and the queue of their wake-up cycles
+    vector <MemoryComponent *> _byIndex;
+    WakeUpQueue _wakeUp;
+    // components processing requests (see ProcessPendingRequests)
+    RequestWorkList _workList;
+
+    // domains (one per cpu, then the shared domain) if split
+    bool _parallel;
+    vector <Domain> _domains;
+
+    // request pools used by the simulation (the current thread's if empty)
+    vector <RequestPool *> _pools;
+
+
+    // -------------------------------------------------------------------------
+    // Function to split the components into domains. Returns the domain of
+    // each component.
+    // -------------------------------------------------------------------------
+
+    vector <uint32> SplitDomains() {
+      vector <uint32> domainOf(_byIndex.size(), _numCPUs);
+      vector <uint32> sizes(_numCPUs + 1, 0);
+      for (uint32 i = 0; i < _byIndex.size(); i ++) {
+        uint32 users = 0;
+        uint32 user = 0;
+        for (uint32 cpu = 0; cpu < _numCPUs; cpu ++) {
+          if (find(_hier[cpu].begin(), _hier[cpu].end(), _byIndex[i]) !=
+              _hier[cpu].end()) {
+            users ++;
+            user = cpu;
+          }
+        }
+        if (users == 1)
+          domainOf[i] = user;
+        sizes[domainOf[i]] ++;
+      }
+      _domains.resize(_numCPUs + 1);
+      for (uint32 d = 0; d <= _numCPUs; d ++) {
+        _domains[d].clock = _currentCycle;
+        _domains[d].wakeUp.Resize(sizes[d]);
+      }
+      return domainOf;
+    }
+
 
   public:
 
@@ -66,6 +145,7 @@ class MemorySimulator {
       _hier.clear();
       _numCPUs = 0;
       _currentCycle = 0;
+      _parallel = false;
     }
 
 
@@ -101,15 +181,35 @@ class MemorySimulator {
 
 
     // -------------------------------------------------------------------------
-    // Function to start the simulation for all the components
+    // Function to start the simulation for all the components. If parallel
+    // is set, the components are split into domains.
     // -------------------------------------------------------------------------
 
-    void StartSimulation() {
+    void StartSimulation(bool parallel = false) {
       // for each component, send the log folder, log file and pointer to the
       // hierarchy and current cycle
+      _byIndex.assign(_components.begin(), _components.end());
+      _wakeUp.Resize(_byIndex.size());
+      _parallel = parallel;
+      vector <uint32> domainOf;
+      if (_parallel)
+        domainOf = SplitDomains();
+      uint32 index = 0;
       list <MemoryComponent *>::iterator cmp;
       for (cmp = _components.begin(); cmp != _components.end(); cmp ++) {
         (*cmp) -> SetBackPointers(&_hier, &_currentCycle);
+        if (_parallel) {
+          Domain &domain = _domains[domainOf[index]];
+          (*cmp) -> SetWakeUpQueue(&domain.wakeUp, domain.byIndex.size());
+          (*cmp) -> SetDomain(domainOf[index], this, &domain.clock);
+          (*cmp) -> SetWorkList(&domain.workList);
+          domain.byIndex.push_back(*cmp);
+        }
+        else {
+          (*cmp) -> SetWakeUpQueue(&_wakeUp, index);
+          (*cmp) -> SetWorkList(&_workList);
+        }
+        index ++;
         (*cmp) -> SetLogDetails(_simulationFolderName, _simulationLog);
         (*cmp) -> InitializeStatistics();
         (*cmp) -> StartSimulation();
@@ -133,10 +233,14 @@ class MemorySimulator {
         // }
       }
 
-      // Process pending requests of all the components
-      list <MemoryComponent *>::iterator cmp;
-      for (cmp = _components.begin(); cmp != _components.end(); cmp ++) {
-        (*cmp) -> ProcessPendingRequests();
+      // Process pending requests of the components that have work by now,
+      // in the order of the definition
+      uint32 index;
+      _wakeUp.BeginPass(_currentCycle);
+      while (_wakeUp.NextDue(index)) {
+        MemoryComponent *component = _byIndex[index];
+        component -> ProcessPendingRequests();
+        _wakeUp.Reset(index, component -> NextWakeUpCycle());
       }
     }
 
@@ -147,24 +251,25 @@ class MemorySimulator {
 
     void AutoAdvance() {
       
-      // For each component, find the earliest request that can be processed.
-      // Take the min of all and advance simulation to that point.
+      // For each component with work, find the earliest cycle at which it can
+      // process a request, not before it wakes up. Take the min of all and
+      // advance simulation to that point.
       
       cycles_t min;
       bool flag = false;
 
-      MemoryRequest *request;
-      list <MemoryComponent *>::iterator cmp;
-      for (cmp = _components.begin(); cmp != _components.end(); cmp ++) {
-        request = (*cmp) -> EarliestRequest();
-        if (request != NULL) {
+      const vector <uint32> &active = _wakeUp.Active();
+      for (uint32 i = 0; i < active.size(); i ++) {
+        cycles_t cycle = _byIndex[active[i]] -> EarliestCycle();
+        if (cycle != WAKE_UP_NEVER) {
+          cycle = max(cycle, _wakeUp.Registered(active[i]));
           if (!flag) {
             flag = true;
-            min = request -> currentCycle;
+            min = cycle;
           }
           else {
-            if (min > request -> currentCycle) {
-              min = request -> currentCycle;
+            if (min > cycle) {
+              min = cycle;
             }
           }
         }
@@ -182,6 +287,113 @@ class MemorySimulator {
       AdvanceSimulation(min);
     }
 
+
+    // -------------------------------------------------------------------------
+    // Domains. The domain of cpu i is i; SharedDomain() is the domain of the
+    // components used by several cpus.
+    // -------------------------------------------------------------------------
+
+    uint32 SharedDomain() {
+      return _numCPUs;
+    }
+
+    // advance a domain to the given time
+    void AdvanceDomain(uint32 d, cycles_t now) {
+      Domain &domain = _domains[d];
+      if (now > domain.clock)
+        domain.clock = now;
+      uint32 index;
+      domain.wakeUp.BeginPass(domain.clock);
+      while (domain.wakeUp.NextDue(index)) {
+        MemoryComponent *component = domain.byIndex[index];
+        component -> ProcessPendingRequests();
+        domain.wakeUp.Reset(index, component -> NextWakeUpCycle());
+      }
+    }
+
+    // earliest cycle at which a component of a domain can process a request
+    // (WAKE_UP_NEVER if there is none). This is AutoAdvance's target within
+    // the domain.
+    cycles_t DomainEarliestCycle(uint32 d) {
+      Domain &domain = _domains[d];
+      cycles_t earliest = WAKE_UP_NEVER;
+      const vector <uint32> &active = domain.wakeUp.Active();
+      for (uint32 i = 0; i < active.size(); i ++) {
+        cycles_t cycle = domain.byIndex[active[i]] -> EarliestCycle();
+        if (cycle == WAKE_UP_NEVER)
+          continue;
+        cycle = max(cycle, domain.wakeUp.Registered(active[i]));
+        if (cycle < earliest)
+          earliest = cycle;
+      }
+      return earliest;
+    }
+
+    // true if no component of the domain has work
+    bool DomainIdle(uint32 d) {
+      return _domains[d].wakeUp.Active().empty();
+    }
+
+    // post a request to a component of another domain. Called by the thread
+    // running the posting domain only.
+    void Post(uint32 fromDomain, MemoryComponent *to, MemoryRequest *request) {
+      Posted posted;
+      posted.to = to;
+      posted.request = request;
+      request -> away = true;
+      _domains[fromDomain].outbox.push_back(posted);
+    }
+
+    // deliver the posted requests, while no domain is running. The requests
+    // to a domain are taken in the order of the posting domains, then stably
+    // sorted by cycle, so the order does not depend on the threads. Returns
+    // the number of requests delivered.
+    uint64 Exchange() {
+      uint64 delivered = 0;
+      for (uint32 d = 0; d < _domains.size(); d ++) {
+        vector <Posted> &outbox = _domains[d].outbox;
+        for (uint32 i = 0; i < outbox.size(); i ++)
+          _domains[outbox[i].to -> Domain()].inbox.push_back(outbox[i]);
+        delivered += outbox.size();
+        outbox.clear();
+      }
+      for (uint32 d = 0; d < _domains.size(); d ++) {
+        vector <Posted> &inbox = _domains[d].inbox;
+        stable_sort(inbox.begin(), inbox.end(), ComparePosted());
+        for (uint32 i = 0; i < inbox.size(); i ++) {
+          MemoryRequest *request = inbox[i].request;
+          request -> away = (d != (uint32)request -> cpuID);
+          if (!request -> away && request -> parked) {
+            request -> parked = false;
+            _domains[d].returned.push_back(request);
+          }
+          inbox[i].to -> SimpleAddRequest(request);
+        }
+        inbox.clear();
+      }
+      return delivered;
+    }
+
+    // parked requests of a cpu that are back in its domain; the caller
+    // clears the list
+    vector <MemoryRequest *> &ReturnedRequests(uint32 cpuID) {
+      return _domains[cpuID].returned;
+    }
+
+    // set the time of the simulator (the end of a quantum)
+    void SetCurrentCycle(cycles_t now) {
+      _currentCycle = now;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to add a request pool to the ones reported at the end
+    // -------------------------------------------------------------------------
+
+    void AddRequestPool(RequestPool *pool) {
+      _pools.push_back(pool);
+    }
+
     // -------------------------------------------------------------------------
     // Function to end the simulation
     // -------------------------------------------------------------------------
@@ -191,6 +403,20 @@ class MemorySimulator {
       list <MemoryComponent *>::iterator cmp;
       for (cmp = _components.begin(); cmp != _components.end(); cmp ++)
         (*cmp) -> EndSimulation();
+      // report the request pool usage. Requests still live are either in
+      // flight (in the front-end window or the components) or leaked. With
+      // several pools, the high-water is the sum of their peaks.
+      if (_pools.empty())
+        _pools.push_back(&MemoryRequestPool());
+      uint64 allocations = 0, highWater = 0, live = 0;
+      for (uint32 i = 0; i < _pools.size(); i ++) {
+        allocations += _pools[i] -> Allocations();
+        highWater += _pools[i] -> HighWater();
+        live += _pools[i] -> Live();
+      }
+      fprintf(_simulationLog, "requests:allocations = %llu\n", allocations);
+      fprintf(_simulationLog, "requests:high-water = %llu\n", highWater);
+      fprintf(_simulationLog, "requests:live = %llu\n", live);
       // close the simulation log
       fclose(_simulationLog);
     }
@@ -228,6 +454,18 @@ class MemorySimulator {
     }
 
 
+    // -------------------------------------------------------------------------
+    // Function to take a snapshot of the statistics of all the components
+    // -------------------------------------------------------------------------
+
+    void SnapshotCounters(vector <pair <string, uint64> > &snapshot) {
+      snapshot.clear();
+      list <MemoryComponent *>::iterator cmp;
+      for (cmp = _components.begin(); cmp != _components.end(); cmp ++)
+        (*cmp) -> SnapshotCounters(snapshot);
+    }
+
+
     // -------------------------------------------------------------------------
     // Function to handle heart beat
     // -------------------------------------------------------------------------
@@ -239,6 +477,61 @@ class MemorySimulator {
     }
 
 
+    // -------------------------------------------------------------------------
+    // Function to save or restore the state of the memory system. The
+    // checkpoint must come from the same hierarchy; it can be restored into
+    // a simulator split into domains (the domains start at the saved cycle).
+    // -------------------------------------------------------------------------
+
+    void CheckpointState(CheckpointFile &cp) {
+
+      // the hierarchy
+      ostringstream hierarchy;
+      hierarchy << _numCPUs << " cpus";
+      for (uint32 cpu = 0; cpu < _numCPUs; cpu ++) {
+        hierarchy << ";";
+        for (uint32 i = 0; i < _hier[cpu].size(); i ++)
+          hierarchy << " " << _hier[cpu][i] -> Name();
+      }
+      cp.Marker(hierarchy.str());
+      cp.Size(_byIndex.size(), "the memory system");
+      CHECKPOINT(_currentCycle);
+
+      // the components (requests refer to them)
+      for (uint32 i = 0; i < _byIndex.size(); i ++)
+        cp.AddTarget(_byIndex[i]);
+      for (uint32 i = 0; i < _byIndex.size(); i ++)
+        _byIndex[i] -> CheckpointState(cp);
+
+      // the wake-ups
+      vector <cycles_t> wake(_byIndex.size(), WAKE_UP_NEVER);
+      if (!cp.Restoring()) {
+        assert(!_parallel);
+        for (uint32 i = 0; i < _byIndex.size(); i ++)
+          wake[i] = _wakeUp.Registered(i);
+      }
+      CHECKPOINT(wake);
+      if (!cp.Restoring())
+        return;
+      if (!_parallel) {
+        for (uint32 i = 0; i < _byIndex.size(); i ++)
+          if (wake[i] != WAKE_UP_NEVER)
+            _wakeUp.Reset(i, wake[i]);
+        return;
+      }
+      for (uint32 d = 0; d < _domains.size(); d ++)
+        _domains[d].clock = _currentCycle;
+      for (uint32 i = 0; i < _byIndex.size(); i ++) {
+        if (wake[i] == WAKE_UP_NEVER)
+          continue;
+        Domain &domain = _domains[_byIndex[i] -> Domain()];
+        uint32 local = find(domain.byIndex.begin(), domain.byIndex.end(),
+            _byIndex[i]) - domain.byIndex.begin();
+        domain.wakeUp.Reset(local, wake[i]);
+      }
+    }
+
+
     // -------------------------------------------------------------------------
     // Function to process a memory request. It initalizes some of the dynamic
     // parameters of the request and sends it to the first component of the cpu
@@ -269,6 +562,21 @@ class MemorySimulator {
       // set the requests component ID and add it to the 
       // corresponding component's request
       request -> cmpID = 0;
+
+      // split into domains: the request goes in the cpu's domain (or is
+      // posted to the first component's)
+      if (_parallel) {
+        MemoryComponent *first = (_hier[request -> cpuID])[0];
+        if (first -> Domain() != (uint32)request -> cpuID) {
+          Post(request -> cpuID, first, request);
+          return;
+        }
+        first -> AddRequest(request);
+        if (request -> currentCycle > _domains[request -> cpuID].clock)
+          AdvanceDomain(request -> cpuID, request -> currentCycle);
+        return;
+      }
+
       (_hier[request -> cpuID])[0] -> AddRequest(request);
 
       // advance simulation if needed
@@ -277,6 +585,45 @@ class MemorySimulator {
     }
 
 
+    // -------------------------------------------------------------------------
+    // Functions for functional mode, where requests go through the hierarchy
+    // without timing (see MemoryComponent::SetFunctional). FunctionalAccess
+    // returns with the request finished. The processors must have no request
+    // in flight when the mode is switched; requests the memory controllers
+    // still hold are scheduled when the timing model resumes. The domains of
+    // a split simulator start at the current cycle when it is switched off.
+    // -------------------------------------------------------------------------
+
+    void SetFunctional(bool functional) {
+      list <MemoryComponent *>::iterator cmp;
+      for (cmp = _components.begin(); cmp != _components.end(); cmp ++)
+        (*cmp) -> SetFunctional(functional);
+      if (!functional && _parallel) {
+        for (uint32 d = 0; d < _domains.size(); d ++)
+          _domains[d].clock = _currentCycle;
+      }
+    }
+
+    void FunctionalAccess(MemoryRequest *request) {
+
+      assert(request -> issued == false);
+      assert(request -> iniType == MemoryRequest::CPU);
+      assert((uint32)request -> cpuID < _numCPUs);
+
+      request -> issued = true;
+      if (request -> currentCycle > _currentCycle)
+        _currentCycle = request -> currentCycle;
+
+      if (_hier.size() == 0 || _hier[request -> cpuID].size() == 0) {
+        request -> finished = true;
+        return;
+      }
+
+      request -> cmpID = 0;
+      (_hier[request -> cpuID])[0] -> AddRequest(request);
+    }
+
+
     // -------------------------------------------------------------------------
     // Function to parse the simulator configuration
     // -------------------------------------------------------------------------
@@ -2,7 +2,15 @@
 // File: OoOTraceSimulator.cc
 // Description:
 //    This file defines the trace based simulator. Traces can be generated
-//    through the trace module for simics.
+//    through the trace module for simics. Several configurations (each with
+//    its own folder) can be simulated in one run: each one gets a thread and
+//    the traces are decoded once for all of them. With --parallel, each
+//    simulation runs its processors on threads of their own (see
+//    OoOTraceSimulator.h). With --save-checkpoint, the warmed up state is
+//    saved; with --restore-checkpoint, the simulation starts from it instead
+//    of warming up. With --functional-warm-up, the warm up runs without
+//    timing. With --sample-period, the main run is sampled: it is fast
+//    forwarded functionally and only short windows are simulated in detail.
 // -----------------------------------------------------------------------------
 
 
@@ -11,6 +19,7 @@
 // -----------------------------------------------------------------------------
 
 #include "OoOTraceSimulator.h"
+#include "TraceBroadcast.h"
 
 
 // -----------------------------------------------------------------------------
@@ -23,9 +32,36 @@
 #include <iostream>
 #include <vector>
 #include <getopt.h>
+#include <pthread.h>
 
 using namespace std;
 
+
+// -----------------------------------------------------------------------------
+// Simulation run on a thread of its own
+// -----------------------------------------------------------------------------
+
+struct SimulationThread {
+  OoOTraceSimulator *simulator;
+  uint64 warmUp;
+  uint64 runTime;
+  uint64 heartBeat;
+  vector <BroadcastTraceSource *> sources;
+  pthread_t thread;
+};
+
+void *RunSimulationThread(void *arg) {
+  SimulationThread *sim = (SimulationThread *)arg;
+  sim -> simulator -> StartTraces();
+  sim -> simulator -> RunSimulation(sim -> warmUp, sim -> runTime,
+      sim -> heartBeat);
+
+  // let the other simulations go on without this one
+  for (uint32 i = 0; i < sim -> sources.size(); i ++)
+    sim -> sources[i] -> Detach();
+  return NULL;
+}
+
 // -----------------------------------------------------------------------------
 // Function: main
 // -----------------------------------------------------------------------------
@@ -37,8 +73,8 @@ int main(int argc, char **argv) {
   // ---------------------------------------------------------------------------
   
   string simulatorDefinition("");
-  string simulatorConfiguration("");
-  string folder("");
+  vector <string> simulatorConfigurations;
+  vector <string> folders;
   uint32 numCPUs = 0;
   uint32 oooWindow = 1;
   uint64 warmUp = 0;
@@ -48,6 +84,16 @@ int main(int argc, char **argv) {
   bool synthetic = false;
   uint32 workingSetSize = 0;
   uint32 memGap = 50;
+  TraceReaderOptions traceOptions;
+  bool parallel = false;
+  cycles_t quantum = DEFAULT_QUANTUM;
+  string saveCheckpoint("");
+  string restoreCheckpoint("");
+  bool functionalWarmUp = false;
+  uint64 samplePeriod = 0;
+  uint64 sampleWindow = DEFAULT_SAMPLE_WINDOW;
+  uint64 sampleWarming = DEFAULT_SAMPLE_WARMING;
+  double sampleError = DEFAULT_SAMPLE_ERROR;
   
 
   struct option cmd_options[] = {
@@ -62,6 +108,19 @@ int main(int argc, char **argv) {
     {"ooo-window", required_argument, 0, 'i'},
     {"synthetic", required_argument, 0, 'k'},
     {"mem-gap", required_argument, 0, 'm'},
+    {"async-trace", no_argument, 0, 'n'},
+    {"trace-cache", required_argument, 0, 'o'},
+    {"fast-forward", required_argument, 0, 'p'},
+    {"parallel", no_argument, 0, 'q'},
+    {"quantum", required_argument, 0, 'r'},
+    {"save-checkpoint", required_argument, 0, 's'},
+    {"restore-checkpoint", required_argument, 0, 't'},
+    {"functional-warm-up", no_argument, 0, 'u'},
+    {"sample-period", required_argument, 0, 'v'},
+    {"sample-window", required_argument, 0, 'w'},
+    {"sample-warming", required_argument, 0, 'x'},
+    {"sample-error", required_argument, 0, 'y'},
+    {0, 0, 0, 0}
   };
 
   int c = 0;
@@ -88,14 +147,14 @@ int main(int argc, char **argv) {
       // parameter file
       // -----------------------------------------------------------------------
       case 'b':
-        simulatorConfiguration = optarg;
+        simulatorConfigurations.push_back(optarg);
         break;
 
       // -----------------------------------------------------------------------
       // simulation folder
       // -----------------------------------------------------------------------
       case 'c':
-        folder = optarg;
+        folders.push_back(optarg);
         break;
 
       // -----------------------------------------------------------------------
@@ -157,6 +216,80 @@ int main(int argc, char **argv) {
       memGap = atoi(optarg);
       break;
 
+      // -----------------------------------------------------------------------
+      // decode traces on helper threads
+      // -----------------------------------------------------------------------
+      case 'n':
+        traceOptions.async = true;
+        break;
+
+      // -----------------------------------------------------------------------
+      // decoded trace cache folder
+      // -----------------------------------------------------------------------
+      case 'o':
+        traceOptions.cacheFolder = optarg;
+        break;
+
+      // -----------------------------------------------------------------------
+      // instructions to skip at the start of the traces
+      // -----------------------------------------------------------------------
+      case 'p':
+        traceOptions.skip = strtoull(optarg, NULL, 10);
+        break;
+
+      // -----------------------------------------------------------------------
+      // parallel engine and its quantum in cycles
+      // -----------------------------------------------------------------------
+      case 'q':
+        parallel = true;
+        break;
+
+      case 'r':
+        quantum = strtoull(optarg, NULL, 10);
+        if (quantum == 0) {
+          cerr << "The quantum must be at least one cycle" << endl;
+          return 1;
+        }
+        break;
+
+      // -----------------------------------------------------------------------
+      // checkpoint to save after the warm up, or to start from
+      // -----------------------------------------------------------------------
+      case 's':
+        saveCheckpoint = optarg;
+        break;
+
+      case 't':
+        restoreCheckpoint = optarg;
+        break;
+
+      // -----------------------------------------------------------------------
+      // warm up without timing
+      // -----------------------------------------------------------------------
+      case 'u':
+        functionalWarmUp = true;
+        break;
+
+      // -----------------------------------------------------------------------
+      // sampling: period, window and detailed warming in instructions, and
+      // target error of the estimates
+      // -----------------------------------------------------------------------
+      case 'v':
+        samplePeriod = strtoull(optarg, NULL, 10);
+        break;
+
+      case 'w':
+        sampleWindow = strtoull(optarg, NULL, 10);
+        break;
+
+      case 'x':
+        sampleWarming = strtoull(optarg, NULL, 10);
+        break;
+
+      case 'y':
+        sampleError = atof(optarg);
+        break;
+
       // -----------------------------------------------------------------------
       // wrong option
       // -----------------------------------------------------------------------
@@ -169,11 +302,136 @@ int main(int argc, char **argv) {
     c = getopt_long(argc, argv, "a:b:c:d:e:", cmd_options, &optindex);
   }
 
-  OoOTraceSimulator traceSim(numCPUs, simulatorDefinition, 
-                             simulatorConfiguration, oooWindow, traceFiles,
-                             folder, synthetic, workingSetSize, memGap);
+  if (simulatorConfigurations.size() == 0)
+    simulatorConfigurations.push_back("");
+  if (folders.size() == 0)
+    folders.push_back("");
+  if (!parallel)
+    quantum = 0;
+
+  if (saveCheckpoint.size() > 0 && (parallel || restoreCheckpoint.size() > 0 ||
+        simulatorConfigurations.size() > 1)) {
+    cerr << "A checkpoint is saved by a single serial simulation that "
+         << "warms up" << endl;
+    return 1;
+  }
+
+  if (functionalWarmUp && restoreCheckpoint.size() > 0) {
+    cerr << "A restored simulation does not warm up" << endl;
+    return 1;
+  }
+
+  // a sampled simulation warms up functionally (unless it is restored)
+  if (samplePeriod > 0) {
+    if (sampleWindow == 0 || samplePeriod < sampleWindow + sampleWarming) {
+      cerr << "The sample period must hold the window and its warming" << endl;
+      return 1;
+    }
+    if (parallel) {
+      cerr << "Sampling is done by the serial engine" << endl;
+      return 1;
+    }
+    if (restoreCheckpoint.size() == 0)
+      functionalWarmUp = true;
+  }
+
+  // ---------------------------------------------------------------------------
+  // a single configuration
+  // ---------------------------------------------------------------------------
+
+  if (simulatorConfigurations.size() == 1) {
+
+    if (folders.size() != 1) {
+      cerr << "Give one folder per configuration" << endl;
+      return 1;
+    }
+
+    OoOTraceSimulator traceSim(numCPUs, simulatorDefinition, 
+                               simulatorConfigurations[0], oooWindow,
+                               traceFiles, folders[0], synthetic,
+                               workingSetSize, memGap);
+    traceSim.SetTraceOptions(traceOptions);
+    traceSim.SetParallel(quantum);
+    traceSim.SetSaveCheckpoint(saveCheckpoint);
+    traceSim.SetRestoreCheckpoint(restoreCheckpoint);
+    traceSim.SetFunctionalWarmUp(functionalWarmUp);
+    traceSim.SetSampling(samplePeriod, sampleWindow, sampleWarming,
+                         sampleError);
+
+    traceSim.StartSimulation();
+    traceSim.RunSimulation(warmUp, runTime, heartBeat);
+    return 0;
+  }
+
+  // ---------------------------------------------------------------------------
+  // several configurations, each on its own thread
+  // ---------------------------------------------------------------------------
+
+  uint32 numSims = simulatorConfigurations.size();
+  if (folders.size() != numSims) {
+    cerr << "Give one folder per configuration" << endl;
+    return 1;
+  }
+
+  // decode each trace once for all the simulations (fast forwarding is done
+  // by the decoder, and the decoder already reads ahead on a thread)
+  vector <TraceBroadcast *> broadcasts;
+  if (!synthetic) {
+    for (uint32 i = 0; i < numCPUs; i ++) {
+      TraceReaderOptions options = traceOptions;
+      options.async = false;
+      TraceSource *source = OpenTraceReaderSource(traceFiles[i], options);
+      if (source == NULL) {
+        cerr << "Error: cannot open `" << traceFiles[i] << "'" << endl;
+        return 1;
+      }
+      broadcasts.push_back(new TraceBroadcast(source, traceFiles[i], numSims,
+                                              traceOptions));
+    }
+  }
+
+  TraceReaderOptions readerOptions;
+  vector <SimulationThread> sims(numSims);
+
+  // the hierarchies are built one after the other
+  for (uint32 s = 0; s < numSims; s ++) {
+    sims[s].simulator = new OoOTraceSimulator(numCPUs, simulatorDefinition,
+        simulatorConfigurations[s], oooWindow, traceFiles, folders[s],
+        synthetic, workingSetSize, memGap);
+    sims[s].simulator -> SetTraceOptions(readerOptions);
+    sims[s].simulator -> SetParallel(quantum);
+    sims[s].simulator -> SetRestoreCheckpoint(restoreCheckpoint);
+    sims[s].simulator -> SetFunctionalWarmUp(functionalWarmUp);
+    sims[s].simulator -> SetSampling(samplePeriod, sampleWindow,
+        sampleWarming, sampleError);
+    if (!synthetic) {
+      vector <TraceSource *> sources;
+      for (uint32 i = 0; i < numCPUs; i ++) {
+        sims[s].sources.push_back(broadcasts[i] -> Consumer(s));
+        sources.push_back(broadcasts[i] -> Consumer(s));
+      }
+      sims[s].simulator -> SetTraceSources(sources);
+    }
+    sims[s].simulator -> StartMemorySimulator();
+    sims[s].warmUp = warmUp;
+    sims[s].runTime = runTime;
+    sims[s].heartBeat = heartBeat;
+  }
+
+  for (uint32 s = 0; s < numSims; s ++) {
+    if (pthread_create(&sims[s].thread, NULL, RunSimulationThread,
+          &sims[s]) != 0) {
+      cerr << "Error: cannot create a simulation thread" << endl;
+      return 1;
+    }
+  }
+
+  for (uint32 s = 0; s < numSims; s ++) {
+    pthread_join(sims[s].thread, NULL);
+    delete sims[s].simulator;
+  }
 
-  traceSim.StartSimulation();
-  traceSim.RunSimulation(warmUp, runTime, heartBeat);
+  for (uint32 i = 0; i < broadcasts.size(); i ++)
+    delete broadcasts[i];
   return 0;
 }
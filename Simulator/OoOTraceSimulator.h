@@ -5,6 +5,29 @@
 //    instructions are independent. All non-memory instructions take 1 cycle to
 //    complete and the latency of the memory instruction is determined by the
 //    memory simulator.
+//
+//    The parallel engine runs in quanta, bound-weave style. In the bound
+//    phase each processor, with the components only it uses, runs up to the
+//    end of the quantum on a thread of its own; requests to the shared
+//    components are posted. In the weave phase the shared components run up
+//    to the same point on the main thread, and the requests crossing between
+//    the two are exchanged in a fixed order. Results do not depend on thread
+//    scheduling; a request crossing between the phases may be late by up to
+//    a quantum, so they do depend on the quantum.
+//
+//    A checkpoint of the warmed up state can be saved and other simulations
+//    started from it. When all the processors have warmed up, the windows
+//    stop being refilled until the processors have no request in flight; the
+//    checkpoint is saved there and the simulation goes on as a restored one
+//    would. The main run is measured from the checkpoint.
+//
+//    The warm up can also be functional: requests go through the caches and
+//    predictors one at a time, without timing, which is much faster. The
+//    processors have nothing in flight at its end, so a checkpoint is saved
+//    there directly. Sampling builds on it: the main run is fast forwarded
+//    functionally, with short windows simulated in detail, and the IPC and
+//    the statistics are estimated from the windows with confidence
+//    intervals (SMARTS style).
 // -----------------------------------------------------------------------------
 
 
@@ -27,6 +50,7 @@
 // -----------------------------------------------------------------------------
 
 #include <algorithm>
+#include <cstring>
 #include <set>
 #include <vector>
 #include <string>
@@ -34,10 +58,27 @@
 #include <queue>
 #include <list>
 #include <iostream>
+#include <cmath>
+#include <pthread.h>
 
 #define WARM_UP 0
 #define HEART_BEAT 1
 #define END_SIMULATION 2
+#define PROGRESS 3
+#define SAMPLE_BEGIN 4
+#define SAMPLE_END 5
+
+// default quantum of the parallel engine
+#define DEFAULT_QUANTUM 100
+
+// sampling: default window and detailed warming (instructions) and target
+// error, the windows taken before the error is checked, and the confidence
+// of the intervals (three standard errors)
+#define DEFAULT_SAMPLE_WINDOW 10000
+#define DEFAULT_SAMPLE_WARMING 2000
+#define DEFAULT_SAMPLE_ERROR 0.03
+#define SAMPLE_MIN_WINDOWS 10
+#define SAMPLE_Z 3.0
 
 
 using namespace std;
@@ -72,6 +113,9 @@ class OoOTraceSimulator {
   bool _synthetic;
   uint32 _workingSetSize;
   uint32 _memGap;
+    TraceReaderOptions _traceOptions;
+    // already open trace sources (one per processor, none if empty)
+    vector <TraceSource *> _traceSources;
 
     // -------------------------------------------------------------------------
     // Private members
@@ -90,6 +134,11 @@ class OoOTraceSimulator {
       // checkpoint at finish
       uint64 finishIcount;
       cycles_t finishCycle;
+      // start of the current sampling window, and the windows so far
+      uint64 windowIcount;
+      cycles_t windowCycle;
+      uint64 sampledIcount;
+      cycles_t sampledCycles;
       // list of outstanding requests
       list <MemoryRequest *> outstanding;
     };
@@ -97,27 +146,480 @@ class OoOTraceSimulator {
     MemorySimulator _simulator;
     vector <ProcInfo> _procs;
 
+    // pool of the requests of the thread running the simulation (the
+    // processor threads of the parallel engine have theirs in _cores)
+    RequestPool *_pool;
+
     cycles_t _nextHeartBeatCycle;
 
     cycles_t _hbCount;
     vector <pair <cycles_t, uint32> > _milestones;
     vector <uint32> _mIndex;
+    bitset <128> _finished;
+    bitset <128> _warmedUp;
 
     // queue of currently outstanding request
-    priority_queue <MemoryRequest *, vector <MemoryRequest *>,
-        MemoryRequest::ComparePointers> _queue;
-
-    // ref count for garbage collection
-    set <MemoryRequest *> _ref;
+    RequestPriorityQueue _queue;
 
     // IPC file
     FILE *_ipcFile;
 
     // progress file
     FILE *_progress;
+    uint64 _progressIcount[64];
 
 #define PROGRESS_LEAP 10000000
 
+    // checkpoint to save at the end of the warm up and checkpoint to start
+    // from (none if empty)
+    string _saveCheckpoint;
+    string _restoreCheckpoint;
+    // the windows are draining before the checkpoint is saved
+    bool _draining;
+    // warm up functionally
+    bool _functionalWarmUp;
+
+    // -------------------------------------------------------------------------
+    // Sampling
+    // -------------------------------------------------------------------------
+
+    // sum and sum of squares of a quantity measured once per window
+    struct SampleStat {
+      double sum;
+      double sumSquares;
+    };
+
+    // period, measured window and detailed warming before the window in
+    // instructions (no sampling if the period is 0), and the target error
+    uint64 _samplePeriod;
+    uint64 _sampleWindow;
+    uint64 _sampleWarming;
+    double _sampleError;
+    // processors that have begun and ended the current window
+    bitset <128> _windowBegun;
+    bitset <128> _windowEnded;
+    // statistics and instructions when the window began (all the processors
+    // in it)
+    vector <pair <string, uint64> > _windowCounters;
+    uint64 _windowInstructions;
+    // windows so far, cycles per instruction of each processor, and
+    // statistics per kilo-instruction
+    uint32 _numWindows;
+    vector <SampleStat> _cpiStats;
+    vector <string> _counterNames;
+    vector <SampleStat> _counterStats;
+
+    // -------------------------------------------------------------------------
+    // Parallel engine
+    // -------------------------------------------------------------------------
+
+    // milestone or progress of a processor, reported at the end of the
+    // quantum
+    struct CoreEvent {
+      uint32 type;
+      uint64 icount;
+      cycles_t cycles;
+    };
+
+    // state of a processor run on its own thread
+    struct CoreState {
+      OoOTraceSimulator *owner;
+      uint32 cpuID;
+      pthread_t thread;
+      // pool of the requests of the thread, owned by the engine
+      RequestPool *pool;
+      // requests of the processor being simulated
+      RequestPriorityQueue queue;
+      // stalling requests with nothing to wait for in the processor's domain
+      vector <MemoryRequest *> blocked;
+      vector <CoreEvent> events;
+      bool warmUp;
+      bool finished;
+    };
+
+    // quantum in cycles (0 for the serial engine)
+    cycles_t _quantum;
+    vector <CoreState *> _cores;
+    pthread_barrier_t _barrier;
+    cycles_t _quantumEnd;
+    bool _stopCores;
+
+
+    // -------------------------------------------------------------------------
+    // Function to get the next request of a processor's trace
+    // -------------------------------------------------------------------------
+
+    MemoryRequest *NextTraceRequest(uint32 cpuID) {
+      MemoryRequest *request;
+      if (_synthetic)
+        request = _procs[cpuID].sreader -> NextRequest();
+      else
+        request = _procs[cpuID].reader -> NextRequest();
+      if (request == NULL) {
+        fprintf(stderr, "No requests from processor %u\n", cpuID);
+        exit(1);
+      }
+      return request;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to fill the out-of-order window of a processor. The issued
+    // requests go to the given queue (the simulator's for the serial engine,
+    // the processor's for the parallel one).
+    // -------------------------------------------------------------------------
+
+    void RefillWindow(uint32 cpuID, RequestPriorityQueue &queue) {
+
+      ProcInfo &proc = _procs[cpuID];
+
+      // check if any more requests can be added to the queue
+      while ((proc.outstanding.back() -> icount) -
+          (proc.outstanding.front() -> icount) < _oooWindow) {
+
+        MemoryRequest *back = proc.outstanding.back();
+        back -> issueCycle = proc.currentCycle + back -> icount -
+          proc.currentIcount - _oooWindow;
+        back -> currentCycle = back -> issueCycle;
+
+        // push it to the queue and send to the simulator
+        back -> Acquire();
+        queue.push(back);
+        _simulator.ProcessMemoryRequest(back);
+
+        // get the next request for the processor
+        proc.outstanding.push_back(NextTraceRequest(cpuID));
+      }
+    }
+
+    void RefillWindows() {
+      for (uint32 i = 0; i < _numCPUs; i ++)
+        RefillWindow(i, _queue);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to save or restore the state of the simulation. It is saved
+    // when the processors have no request in flight: each window only holds
+    // the next request, which has not been issued.
+    // -------------------------------------------------------------------------
+
+    void CheckpointState(CheckpointFile &cp) {
+
+      // the traces
+      ostringstream traces;
+      if (_synthetic)
+        traces << "synthetic " << _workingSetSize << " " << _memGap;
+      else {
+        for (uint32 i = 0; i < _numCPUs; i ++)
+          traces << _traceFiles[i] << ";";
+      }
+      cp.Marker(traces.str());
+
+      _simulator.CheckpointState(cp);
+
+      // the processors
+      for (uint32 i = 0; i < _numCPUs; i ++) {
+        ProcInfo &proc = _procs[i];
+        CHECKPOINT(proc.currentIcount);
+        CHECKPOINT(proc.currentCycle);
+        CHECKPOINT(proc.checkpointIcount);
+        CHECKPOINT(proc.checkpointCycle);
+        CHECKPOINT(proc.finishIcount);
+        CHECKPOINT(proc.finishCycle);
+        if (cp.Restoring())
+          proc.outstanding.push_back(new MemoryRequest());
+        assert(proc.outstanding.size() == 1);
+        assert(!proc.outstanding.back() -> issued);
+        cp.Bytes(proc.outstanding.back(), sizeof(MemoryRequest));
+        if (_synthetic)
+          proc.sreader -> CheckpointState(cp);
+        else
+          proc.reader -> CheckpointState(cp);
+      }
+
+      CHECKPOINT(_milestones[0].first);
+      CHECKPOINT(_mIndex);
+      CHECKPOINT(_finished);
+      CHECKPOINT(_warmedUp);
+      CHECKPOINT(_nextHeartBeatCycle);
+      CHECKPOINT(_progressIcount);
+    }
+
+    void SaveCheckpoint() {
+      CheckpointFile cp;
+      if (!cp.OpenForSave(_saveCheckpoint)) {
+        fprintf(stderr, "Error: cannot create the checkpoint `%s'\n",
+            _saveCheckpoint.c_str());
+        exit(-1);
+      }
+      CheckpointState(cp);
+      cp.Close();
+    }
+
+    void RestoreCheckpoint() {
+      CheckpointFile cp;
+      if (!cp.OpenForRestore(_restoreCheckpoint)) {
+        fprintf(stderr, "Error: `%s' is not a checkpoint\n",
+            _restoreCheckpoint.c_str());
+        exit(-1);
+      }
+      CheckpointState(cp);
+      cp.Close();
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to end the warm up when the processors have no request in
+    // flight. The main run is measured from here and the checkpoint (if any)
+    // is saved; the caller refills the windows.
+    // -------------------------------------------------------------------------
+
+    void EndDrainedWarmUp() {
+      for (uint32 i = 0; i < _numCPUs; i ++) {
+        _procs[i].checkpointIcount = _procs[i].currentIcount;
+        _procs[i].checkpointCycle = _procs[i].currentCycle;
+      }
+      _simulator.EndWarmUp();
+      if (_saveCheckpoint.size() > 0)
+        SaveCheckpoint();
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to run the processors functionally until they are past an
+    // instruction count. Each processor runs at one instruction per cycle and
+    // its requests go through the memory system one at a time, without
+    // timing (see MemorySimulator::FunctionalAccess). The processor furthest
+    // behind goes first, so the shared components see the traces
+    // interleaved. The windows must hold only the next request, not issued;
+    // a processor that gets past its warm up milestone ends its warm up.
+    // -------------------------------------------------------------------------
+
+    void RunFunctionally(uint64 target) {
+
+      uint64 *checkpoint = _progressIcount;
+      bitset <128> done;
+
+      for (uint32 i = 0; i < _numCPUs; i ++) {
+        if (_procs[i].currentIcount > target)
+          done.set(i);
+      }
+
+      _simulator.SetFunctional(true);
+      while (done.count() < _numCPUs) {
+
+        // the processor furthest behind
+        uint32 cpuID = _numCPUs;
+        for (uint32 i = 0; i < _numCPUs; i ++) {
+          if (!done.test(i) && (cpuID == _numCPUs ||
+                _procs[i].outstanding.front() -> icount <
+                _procs[cpuID].outstanding.front() -> icount))
+            cpuID = i;
+        }
+        ProcInfo &proc = _procs[cpuID];
+
+        MemoryRequest *request = proc.outstanding.front();
+        proc.outstanding.pop_front();
+        if (request -> icount > proc.currentIcount) {
+          proc.currentCycle += request -> icount - proc.currentIcount;
+          proc.currentIcount = request -> icount;
+        }
+        request -> issueCycle = proc.currentCycle;
+        request -> currentCycle = proc.currentCycle;
+        _simulator.FunctionalAccess(request);
+        assert(request -> finished);
+        delete request;
+        proc.outstanding.push_back(NextTraceRequest(cpuID));
+
+        // check if a heart beat should be issued
+        if (_hbCount > 0) {
+          if (_simulator.CurrentCycle() > _nextHeartBeatCycle) {
+            _simulator.HeartBeat(_hbCount);
+            _nextHeartBeatCycle += _hbCount;
+          }
+        }
+
+        if (proc.currentIcount > checkpoint[cpuID]) {
+          fprintf(_progress, "P%u, %llu\n",
+              cpuID, checkpoint[cpuID]/PROGRESS_LEAP);
+          fflush(_progress);
+          checkpoint[cpuID] += PROGRESS_LEAP;
+        }
+
+        if (proc.currentIcount > target) {
+          done.set(cpuID);
+          if (!_warmedUp.test(cpuID) &&
+              proc.currentIcount > _milestones[_mIndex[cpuID]].first) {
+            _mIndex[cpuID] ++;
+            _warmedUp.set(cpuID);
+            _simulator.EndProcWarmUp(cpuID);
+          }
+        }
+      }
+      _simulator.SetFunctional(false);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to warm up functionally (see RunFunctionally). The processors
+    // stop at the warm up milestone and the simulation goes on as a restored
+    // one would.
+    // -------------------------------------------------------------------------
+
+    void WarmUpFunctionally() {
+      for (uint32 i = 0; i < _numCPUs; i ++) {
+        _procs[i].currentIcount = 0;
+        _procs[i].currentCycle = 0;
+        _procs[i].outstanding.push_back(NextTraceRequest(i));
+      }
+      RunFunctionally(_milestones[0].first);
+      EndDrainedWarmUp();
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Functions for sampling. After the warm up, every period the processors
+    // are run functionally up to the detailed warming of the window, then
+    // with the timing model through the window (SAMPLE_BEGIN to SAMPLE_END
+    // milestones), until they have no request in flight. Each window gives
+    // the cycles per instruction of every processor and the statistics of
+    // the components per kilo-instruction, from which the means and their
+    // confidence intervals are estimated. Sampling stops at the end of the
+    // run, or earlier once the error of every processor's estimate is within
+    // the target.
+    // -------------------------------------------------------------------------
+
+    void AddSampleMilestones() {
+      vector <pair <cycles_t, uint32> > windows;
+      uint64 end;
+      for (end = _milestones[0].first + _samplePeriod;
+          end <= _milestones[1].first; end += _samplePeriod) {
+        windows.push_back(make_pair(end - _sampleWindow, SAMPLE_BEGIN));
+        windows.push_back(make_pair(end, SAMPLE_END));
+      }
+      // the run ends with the last window, not at the milestone
+      _milestones[1].first = (cycles_t)(-1);
+      _milestones.insert(_milestones.begin() + 1, windows.begin(),
+          windows.end());
+    }
+
+    // snapshot of the statistics when every processor is in the window
+    // (begin) or past it (end)
+    void SnapshotWindow(bool begin) {
+      uint64 instructions = 0;
+      for (uint32 i = 0; i < _numCPUs; i ++)
+        instructions += _procs[i].currentIcount;
+      if (begin) {
+        _simulator.SnapshotCounters(_windowCounters);
+        _windowInstructions = instructions;
+        return;
+      }
+
+      vector <pair <string, uint64> > counters;
+      _simulator.SnapshotCounters(counters);
+      assert(counters.size() == _windowCounters.size());
+      if (_counterStats.empty()) {
+        _counterStats.resize(counters.size());
+        for (uint32 i = 0; i < counters.size(); i ++)
+          _counterNames.push_back(counters[i].first);
+      }
+      instructions -= _windowInstructions;
+      for (uint32 i = 0; i < counters.size(); i ++) {
+        double pki = (double)(counters[i].second - _windowCounters[i].second) *
+          1000.0 / (double)max(instructions, (uint64)1);
+        _counterStats[i].sum += pki;
+        _counterStats[i].sumSquares += pki * pki;
+      }
+    }
+
+    // mean and half width of the confidence interval
+    double SampleMean(SampleStat &stat) {
+      return stat.sum / _numWindows;
+    }
+
+    double SampleHalfWidth(SampleStat &stat) {
+      if (_numWindows < 2)
+        return 0;
+      double n = _numWindows;
+      double variance = (stat.sumSquares - stat.sum * stat.sum / n) / (n - 1);
+      return SAMPLE_Z * sqrt(max(variance, 0.0) / n);
+    }
+
+    bool SampleConverged() {
+      if (_numWindows < SAMPLE_MIN_WINDOWS)
+        return false;
+      for (uint32 i = 0; i < _numCPUs; i ++) {
+        if (SampleHalfWidth(_cpiStats[i]) >
+            _sampleError * SampleMean(_cpiStats[i]))
+          return false;
+      }
+      return true;
+    }
+
+    void SimulateSampled() {
+
+      _numWindows = 0;
+      _cpiStats.assign(_numCPUs, SampleStat());
+      for (uint32 i = 0; i < _numCPUs; i ++) {
+        _procs[i].sampledIcount = 0;
+        _procs[i].sampledCycles = 0;
+      }
+
+      while (_milestones[_mIndex[0]].second == SAMPLE_BEGIN) {
+
+        // fast forward to the detailed warming, then run the window
+        uint64 begin = _milestones[_mIndex[0]].first;
+        RunFunctionally(begin > _sampleWarming ? begin - _sampleWarming : 0);
+        _windowBegun.reset();
+        _windowEnded.reset();
+        RefillWindows();
+        Simulate();
+
+        _numWindows ++;
+        if (SampleConverged())
+          break;
+      }
+
+      // the estimates
+      string samplingFileName = _simulationFolder + "/sampling";
+      FILE *sampling = fopen(samplingFileName.c_str(), "w");
+      if (sampling == NULL)
+        sampling = stdout;
+      fprintf(sampling, "windows = %u\n", _numWindows);
+      fprintf(sampling, "window = %llu\n", _sampleWindow);
+      fprintf(sampling, "period = %llu\n", _samplePeriod);
+      fprintf(sampling, "confidence = %.1f%%\n",
+          100.0 * erf(SAMPLE_Z / sqrt(2.0)));
+
+      for (uint32 i = 0; i < _numCPUs; i ++) {
+        ProcInfo &proc = _procs[i];
+        double cpi = _numWindows > 0 ? SampleMean(_cpiStats[i]) : 0;
+        double error = cpi > 0 ? SampleHalfWidth(_cpiStats[i]) / cpi : 0;
+        fprintf(sampling, "P%u:ipc = %.6f +- %.2f%%\n", i,
+            cpi > 0 ? 1.0 / cpi : 0, 100.0 * error);
+
+        proc.finishIcount = proc.currentIcount;
+        proc.finishCycle = proc.currentCycle;
+        _finished.set(i);
+        _simulator.EndProcSimulation(i);
+        fprintf(_ipcFile, "%u %llu %llu\n", i, proc.sampledIcount,
+            proc.sampledCycles);
+      }
+      fflush(_ipcFile);
+
+      for (uint32 i = 0; i < _counterStats.size(); i ++) {
+        double mean = SampleMean(_counterStats[i]);
+        if (mean == 0)
+          continue;
+        fprintf(sampling, "%s-pki = %.4f +- %.2f%%\n",
+            _counterNames[i].c_str(), mean,
+            100.0 * SampleHalfWidth(_counterStats[i]) / mean);
+      }
+      if (sampling != stdout)
+        fclose(sampling);
+    }
+
 
     // -------------------------------------------------------------------------
     // Simulate Function
@@ -125,18 +627,23 @@ class OoOTraceSimulator {
 
     void Simulate() {
 
-      bitset <128> finished;
-      bitset <128> warmUp;
-      finished.reset();
-      warmUp.reset();
-
       MemoryRequest *request;
-      static uint64 checkpoint[64];
+      uint64 *checkpoint = _progressIcount;
 
       // until all processors have finished
-      while (finished.count() < _numCPUs) {
+      while (_finished.count() < _numCPUs) {
 	//if((_procs[0].currentIcount) % 1000 == 0)	cout << "Current cycle is " << _procs[0].currentCycle << endl;
 
+        // the processors have drained: end the warm up, save the checkpoint
+        // and go on from it
+        if (_draining && _queue.empty()) {
+          _draining = false;
+          if (_samplePeriod > 0)
+            return;
+          EndDrainedWarmUp();
+          RefillWindows();
+        }
+
         if (_queue.empty()) {
           printf("What the hell!");
           return;
@@ -175,14 +682,10 @@ class OoOTraceSimulator {
         else {
           uint32 cpuID = request -> cpuID;
 
-          // check if the request is out of the outstanging queue
-          if (_ref.find(request) != _ref.end()) {
-            _ref.erase(request);
+          // release the queue's reference (delete the request if it is out
+          // of the outstanding queue too)
+          if (request -> Release())
             delete request;
-          }
-          else {
-            _ref.insert(request);
-          }
 
           // until the oldest instruction has not finished
           while (_procs[cpuID].outstanding.front() -> finished) {
@@ -208,74 +711,79 @@ class OoOTraceSimulator {
 
             // printf("%llu %llu\n", oldest -> icount, oldest -> currentCycle);
 
-            // check if the request is out of the request queue
-            if (_ref.find(oldest) != _ref.end()) {
-              _ref.erase(oldest);
+            // release the outstanding queue's reference (delete the request
+            // if it is out of the request queue too)
+            if (oldest -> Release())
               delete oldest;
-            }
             else if (_queue.top() == oldest) {
               _queue.pop();
               delete oldest;
             }
-            else {
-              _ref.insert(oldest);
-            }
 
-            // check if any more requests can be added to the queue
-            while (((_procs[cpuID].outstanding.back() -> icount) - 
-                  (_procs[cpuID].outstanding.front() -> icount)) < _oooWindow) {
-
-              _procs[cpuID].outstanding.back() -> issueCycle =
-                _procs[cpuID].currentCycle + 
-                _procs[cpuID].outstanding.back() -> icount - 
-                _procs[cpuID].currentIcount - _oooWindow;
-
-              _procs[cpuID].outstanding.back() -> currentCycle = 
-                _procs[cpuID].outstanding.back() -> issueCycle;
-
-              // push it to the queue and send to the simulator
-              _queue.push(_procs[cpuID].outstanding.back());
-              _simulator.ProcessMemoryRequest(_procs[cpuID].outstanding.back());
-
-              // get the next request for the processor
-              if (_synthetic)
-                request = _procs[cpuID].sreader -> NextRequest();
-              else 
-                request = _procs[cpuID].reader -> NextRequest();
-              if (request == NULL) {
-                fprintf(stderr, "No requests from processor %u\n", cpuID);
-                exit(1);
-              }
-
-              // push the request to the outstanding queue
-              _procs[cpuID].outstanding.push_back(request);
-            }
+            // refill the window (not while draining for a checkpoint)
+            if (!_draining)
+              RefillWindow(cpuID, _queue);
 
             // check if the processor has completed run
             if (_procs[cpuID].currentIcount > _milestones[_mIndex[cpuID]].first) {
-              bool warmUpMilestone = false;
-              if (!finished.test(cpuID)) {
+              bool keepRetiring = false;
+              if (!_finished.test(cpuID)) {
 
                 switch (_milestones[_mIndex[cpuID]].second) {
 
                   case WARM_UP:
                     _procs[cpuID].checkpointIcount = _procs[cpuID].currentIcount;
                     _procs[cpuID].checkpointCycle = _procs[cpuID].currentCycle;
-                    warmUpMilestone = true;
+                    keepRetiring = true;
                     _mIndex[cpuID] ++;
-                    warmUp.set(cpuID);
+                    _warmedUp.set(cpuID);
                     _simulator.EndProcWarmUp(cpuID);
-                    if (warmUp.count() == _numCPUs) {
-                      _simulator.EndWarmUp();
+                    if (_warmedUp.count() == _numCPUs) {
+                      if (_saveCheckpoint.size() > 0)
+                        _draining = true;
+                      else
+                        _simulator.EndWarmUp();
                     }
                     
                     break;
 
+                  case SAMPLE_BEGIN:
+                    keepRetiring = true;
+                    // the next window waits for the next fast forward
+                    if (_windowEnded.test(cpuID))
+                      break;
+                    _procs[cpuID].windowIcount = _procs[cpuID].currentIcount;
+                    _procs[cpuID].windowCycle = _procs[cpuID].currentCycle;
+                    _mIndex[cpuID] ++;
+                    _windowBegun.set(cpuID);
+                    if (_windowBegun.count() == _numCPUs)
+                      SnapshotWindow(true);
+                    break;
+
+                  case SAMPLE_END: {
+                    keepRetiring = true;
+                    ProcInfo &proc = _procs[cpuID];
+                    uint64 instructions = proc.currentIcount - proc.windowIcount;
+                    cycles_t cycles = proc.currentCycle - proc.windowCycle;
+                    double cpi = (double)cycles / (double)instructions;
+                    _cpiStats[cpuID].sum += cpi;
+                    _cpiStats[cpuID].sumSquares += cpi * cpi;
+                    proc.sampledIcount += instructions;
+                    proc.sampledCycles += cycles;
+                    _mIndex[cpuID] ++;
+                    _windowEnded.set(cpuID);
+                    if (_windowEnded.count() == _numCPUs) {
+                      SnapshotWindow(false);
+                      _draining = true;
+                    }
+                    break;
+                  }
+
                   case END_SIMULATION:
-                    if (!finished.test(cpuID)) {
+                    if (!_finished.test(cpuID)) {
                       _procs[cpuID].finishIcount = _procs[cpuID].currentIcount;
                       _procs[cpuID].finishCycle = _procs[cpuID].currentCycle;
-                      finished.set(cpuID);
+                      _finished.set(cpuID);
                       _simulator.EndProcSimulation(cpuID);
                       fprintf(_ipcFile, "%u %llu %llu\n", cpuID, 
                           _procs[cpuID].currentIcount - 
@@ -287,12 +795,288 @@ class OoOTraceSimulator {
                     break;
                 }
               }
-              if (!warmUpMilestone)
+              if (!keepRetiring)
+                break;
+            }
+          }
+        }
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to retire the finished requests at the head of a processor's
+    // window and refill it (parallel engine). Milestones and progress are
+    // recorded in the processor's events.
+    // -------------------------------------------------------------------------
+
+    void RetireParallel(CoreState &core) {
+
+      uint32 cpuID = core.cpuID;
+      ProcInfo &proc = _procs[cpuID];
+      uint64 *checkpoint = _progressIcount;
+      CoreEvent event;
+      event.icount = 0;
+      event.cycles = 0;
+
+      // until the oldest instruction has not finished
+      while (proc.outstanding.front() -> finished) {
+
+        MemoryRequest *oldest = proc.outstanding.front();
+        proc.outstanding.pop_front();
+
+        // compute the current cycle of the oldest request
+        oldest -> currentCycle = max(oldest -> currentCycle,
+            proc.currentCycle + oldest -> icount - proc.currentIcount);
+
+        if (oldest -> icount > checkpoint[cpuID]) {
+          event.type = PROGRESS;
+          event.icount = checkpoint[cpuID] / PROGRESS_LEAP;
+          core.events.push_back(event);
+          checkpoint[cpuID] += PROGRESS_LEAP;
+        }
+
+        // update the current cycle and icount of the processor
+        proc.currentIcount = oldest -> icount;
+        proc.currentCycle = oldest -> currentCycle;
+
+        // release the outstanding queue's reference
+        if (oldest -> Release())
+          delete oldest;
+        else if (!core.queue.empty() && core.queue.top() == oldest) {
+          core.queue.pop();
+          delete oldest;
+        }
+
+        // refill the window
+        RefillWindow(cpuID, core.queue);
+
+        // check if the processor has reached a milestone
+        if (proc.currentIcount > _milestones[_mIndex[cpuID]].first) {
+          bool warmUpMilestone = false;
+          if (!core.finished) {
+            switch (_milestones[_mIndex[cpuID]].second) {
+
+              case WARM_UP:
+                proc.checkpointIcount = proc.currentIcount;
+                proc.checkpointCycle = proc.currentCycle;
+                warmUpMilestone = true;
+                _mIndex[cpuID] ++;
+                core.warmUp = true;
+                event.type = WARM_UP;
+                core.events.push_back(event);
+                break;
+
+              case END_SIMULATION:
+                proc.finishIcount = proc.currentIcount;
+                proc.finishCycle = proc.currentCycle;
+                core.finished = true;
+                event.type = END_SIMULATION;
+                event.icount = proc.currentIcount - proc.checkpointIcount;
+                event.cycles = proc.currentCycle - proc.checkpointCycle;
+                core.events.push_back(event);
+                break;
+            }
+          }
+          if (!warmUpMilestone)
+            break;
+        }
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to run a processor and its domain up to the end of the
+    // quantum (the bound phase)
+    // -------------------------------------------------------------------------
+
+    void RunQuantum(CoreState &core, cycles_t end) {
+
+      uint32 cpuID = core.cpuID;
+      MemoryRequest *request;
+
+      // requests back from the shared components, and the ones that were
+      // waiting for them
+      vector <MemoryRequest *> &returned =
+        _simulator.ReturnedRequests(cpuID);
+      for (uint32 i = 0; i < returned.size(); i ++)
+        core.queue.push(returned[i]);
+      returned.clear();
+      for (uint32 i = 0; i < core.blocked.size(); i ++)
+        core.queue.push(core.blocked[i]);
+      core.blocked.clear();
+
+      while (!core.queue.empty() && core.queue.top() -> currentCycle < end) {
+
+        request = core.queue.top();
+        core.queue.pop();
+
+        // out of the domain: wait for it to come back
+        if (request -> away) {
+          request -> parked = true;
+          continue;
+        }
+
+        // advance the domain to the request's cycle, or to the next thing
+        // it can wait for in the domain
+        if (!request -> stalling)
+          _simulator.AdvanceDomain(cpuID, request -> currentCycle);
+        else {
+          cycles_t next = _simulator.DomainEarliestCycle(cpuID);
+          if (next >= end) {
+            core.blocked.push_back(request);
+            continue;
+          }
+          _simulator.AdvanceDomain(cpuID, next);
+        }
+
+        if (!(request -> finished)) {
+          if (request -> away)
+            request -> parked = true;
+          else
+            core.queue.push(request);
+          continue;
+        }
+
+        // release the queue's reference and retire what has finished
+        if (request -> Release())
+          delete request;
+        RetireParallel(core);
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Processor thread: runs a quantum between each pair of barriers
+    // -------------------------------------------------------------------------
+
+    static void *RunCore(void *arg) {
+      CoreState *core = (CoreState *)arg;
+      SetMemoryRequestPool(core -> pool);
+      core -> owner -> CoreLoop(*core);
+      SetMemoryRequestPool(NULL);
+      return NULL;
+    }
+
+    void CoreLoop(CoreState &core) {
+      while (true) {
+        pthread_barrier_wait(&_barrier);
+        if (_stopCores)
+          break;
+        RunQuantum(core, _quantumEnd);
+        pthread_barrier_wait(&_barrier);
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Simulate function of the parallel engine
+    // -------------------------------------------------------------------------
+
+    void SimulateParallel() {
+
+      uint32 shared = _simulator.SharedDomain();
+
+      // hand the requests issued at the start to their processors
+      _cores.resize(_numCPUs);
+      for (uint32 i = 0; i < _numCPUs; i ++) {
+        _cores[i] = new CoreState;
+        _cores[i] -> owner = this;
+        _cores[i] -> cpuID = i;
+        _cores[i] -> pool = new RequestPool(sizeof(MemoryRequest));
+        _cores[i] -> warmUp = _warmedUp.test(i);
+        _cores[i] -> finished = false;
+      }
+      while (!_queue.empty()) {
+        MemoryRequest *request = _queue.top();
+        _queue.pop();
+        _cores[request -> cpuID] -> queue.push(request);
+      }
+
+      _stopCores = false;
+      pthread_barrier_init(&_barrier, NULL, _numCPUs + 1);
+      for (uint32 i = 0; i < _numCPUs; i ++) {
+        if (pthread_create(&_cores[i] -> thread, NULL, RunCore,
+              _cores[i]) != 0) {
+          fprintf(stderr, "Error: cannot create a processor thread\n");
+          exit(-1);
+        }
+      }
+
+      uint32 warmedUp = _warmedUp.count();
+      uint32 finished = 0;
+      cycles_t end = _simulator.CurrentCycle() + _quantum;
+
+      while (finished < _numCPUs) {
+
+        // bound: the processors run up to the end of the quantum
+        _quantumEnd = end;
+        pthread_barrier_wait(&_barrier);
+        pthread_barrier_wait(&_barrier);
+
+        // weave: the shared components run up to the same point
+        _simulator.Exchange();
+        _simulator.AdvanceDomain(shared, end - 1);
+        _simulator.Exchange();
+        _simulator.SetCurrentCycle(end);
+
+        // report milestones and progress, processor by processor
+        bool idle = _simulator.DomainIdle(shared);
+        for (uint32 i = 0; i < _numCPUs; i ++) {
+          CoreState &core = *_cores[i];
+          for (uint32 e = 0; e < core.events.size(); e ++) {
+            CoreEvent &event = core.events[e];
+            switch (event.type) {
+
+              case PROGRESS:
+                fprintf(_progress, "P%u, %llu\n", i, event.icount);
+                fflush(_progress);
+                break;
+
+              case WARM_UP:
+                _simulator.EndProcWarmUp(i);
+                if (++ warmedUp == _numCPUs)
+                  _simulator.EndWarmUp();
+                break;
+
+              case END_SIMULATION:
+                finished ++;
+                _simulator.EndProcSimulation(i);
+                fprintf(_ipcFile, "%u %llu %llu\n", i, event.icount,
+                    event.cycles);
+                fflush(_ipcFile);
                 break;
             }
           }
+          core.events.clear();
+          idle = idle && core.queue.empty() && _simulator.DomainIdle(i);
+        }
+
+        // check if a heart beat should be issued
+        if (_hbCount > 0) {
+          if (end > _nextHeartBeatCycle) {
+            _simulator.HeartBeat(_hbCount);
+            _nextHeartBeatCycle += _hbCount;
+          }
+        }
+
+        if (idle && finished < _numCPUs) {
+          fprintf(stderr, "Request is waiting for nothing?\n");
+          exit(0);
         }
+
+        end += _quantum;
+      }
+
+      // stop the processor threads
+      _stopCores = true;
+      pthread_barrier_wait(&_barrier);
+      for (uint32 i = 0; i < _numCPUs; i ++) {
+        pthread_join(_cores[i] -> thread, NULL);
+        _simulator.AddRequestPool(_cores[i] -> pool);
       }
+      _simulator.AddRequestPool(_pool);
+      pthread_barrier_destroy(&_barrier);
     }
 
   public:
@@ -315,6 +1099,18 @@ class OoOTraceSimulator {
       _synthetic = synthetic;
       _workingSetSize = workingSetSize;
       _memGap = memGap;
+      memset(_progressIcount, 0, sizeof(_progressIcount));
+      _quantum = 0;
+      _finished.reset();
+      _warmedUp.reset();
+      _draining = false;
+      _functionalWarmUp = false;
+      _samplePeriod = 0;
+      _sampleWindow = DEFAULT_SAMPLE_WINDOW;
+      _sampleWarming = DEFAULT_SAMPLE_WARMING;
+      _sampleError = DEFAULT_SAMPLE_ERROR;
+      _numWindows = 0;
+      _pool = new RequestPool(sizeof(MemoryRequest));
 
       if (!synthetic) {
         _traceFiles.resize(_numCPUs);
@@ -342,41 +1138,148 @@ class OoOTraceSimulator {
     }
 
 
+    // -------------------------------------------------------------------------
+    // Destructor. The request pools go with the simulation: the requests it
+    // still holds are not used any more.
+    // -------------------------------------------------------------------------
+
+    ~OoOTraceSimulator() {
+      if (CurrentRequestPool() == _pool)
+        SetMemoryRequestPool(NULL);
+      for (uint32 i = 0; i < _cores.size(); i ++) {
+        delete _cores[i] -> pool;
+        delete _cores[i];
+      }
+      delete _pool;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to set the trace reader options (before starting)
+    // -------------------------------------------------------------------------
+
+    void SetTraceOptions(const TraceReaderOptions &options) {
+      _traceOptions = options;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to read the traces from already open sources, one per
+    // processor, instead of opening the trace files (before starting). The
+    // readers take over the sources.
+    // -------------------------------------------------------------------------
+
+    void SetTraceSources(const vector <TraceSource *> &sources) {
+      _traceSources = sources;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to use the parallel engine with the given quantum (before
+    // starting)
+    // -------------------------------------------------------------------------
+
+    void SetParallel(cycles_t quantum) {
+      _quantum = quantum;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Functions to save a checkpoint at the end of the warm up, or to start
+    // from one instead of warming up (before starting). Checkpoints are saved
+    // by the serial engine only.
+    // -------------------------------------------------------------------------
+
+    void SetSaveCheckpoint(string fileName) {
+      _saveCheckpoint = fileName;
+    }
+
+    void SetRestoreCheckpoint(string fileName) {
+      _restoreCheckpoint = fileName;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to warm up functionally instead of with the timing model
+    // (before starting)
+    // -------------------------------------------------------------------------
+
+    void SetFunctionalWarmUp(bool functional) {
+      _functionalWarmUp = functional;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to sample the main run (before starting): a window of the
+    // given instructions, after the given detailed warming, every period.
+    // Sampling is done by the serial engine after a functional warm up (or
+    // from a checkpoint).
+    // -------------------------------------------------------------------------
+
+    void SetSampling(uint64 period, uint64 window, uint64 warming,
+        double error) {
+      _samplePeriod = period;
+      _sampleWindow = window;
+      _sampleWarming = warming;
+      _sampleError = error;
+    }
+
+
     // -------------------------------------------------------------------------
     // Function to start the simulation
     // -------------------------------------------------------------------------
 
     void StartSimulation() {
+      StartMemorySimulator();
+      StartTraces();
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to start the memory simulator (the first half of starting)
+    // -------------------------------------------------------------------------
 
-      // start the simulator
+    void StartMemorySimulator() {
       _simulator.SetStartCycle(0);
-      _simulator.StartSimulation();
+      _simulator.StartSimulation(_quantum > 0);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to open the traces and fill the out-of-order windows (the
+    // second half of starting). The windows of a restored simulation are
+    // filled when the checkpoint is restored, those of a functionally warmed
+    // one after the warm up.
+    // -------------------------------------------------------------------------
+
+    void StartTraces() {
+
+      SetMemoryRequestPool(_pool);
 
       // open the trace readers
       if (!_synthetic) {
-        for (uint32 i = 0; i < _numCPUs; i ++)
-          _procs[i].reader = new TraceReader(_traceFiles[i], i, true);
+        for (uint32 i = 0; i < _numCPUs; i ++) {
+          if (_traceSources.size() > 0)
+            _procs[i].reader = new TraceReader(_traceSources[i],
+                _traceFiles[i], i, true, _traceOptions);
+          else
+            _procs[i].reader = new TraceReader(_traceFiles[i], i, true,
+                                               _traceOptions);
+        }
       }
       else {
         for (uint32 i = 0; i < _numCPUs; i ++)
           _procs[i].sreader = new SyntheticTrace(_workingSetSize, _memGap, i);
       }
 
+      if (_restoreCheckpoint.size() > 0 || _functionalWarmUp)
+        return;
 
       // for each processor, fill its outstanding queue
       for (uint32 i = 0; i < _numCPUs; i ++) {
 
-        MemoryRequest *request;
-
         // get the first request from the reader
-        if (_synthetic)
-          request = _procs[i].sreader -> NextRequest();
-        else 
-          request = _procs[i].reader -> NextRequest();
-        if (request == NULL) {
-          fprintf(stderr, "No requests from processor %u\n", i);
-          exit(1);
-        }
+        MemoryRequest *request = NextTraceRequest(i);
 
         // set the current cycle and icount of the processor
         _procs[i].currentIcount = 0;
@@ -392,6 +1295,7 @@ class OoOTraceSimulator {
         while (((_procs[i].outstanding.back() -> icount) - 
             (_procs[i].outstanding.front() -> icount)) < _oooWindow) {
 
+          _procs[i].outstanding.back() -> Acquire();
           _queue.push(_procs[i].outstanding.back());
           _simulator.ProcessMemoryRequest(_procs[i].outstanding.back());
 
@@ -400,13 +1304,7 @@ class OoOTraceSimulator {
 
 
           // get the next request 
-          if (_synthetic)
-            request = _procs[i].sreader -> NextRequest();
-          else 
-            request = _procs[i].reader -> NextRequest();
-          if (request == NULL) {
-            assert(false && "No requests from processor");
-          }
+          request = NextTraceRequest(i);
 
           request -> issueCycle = request -> icount;
           request -> currentCycle = request -> issueCycle;
@@ -422,6 +1320,7 @@ class OoOTraceSimulator {
     
     void RunSimulation(uint64 warmUp, uint64 mainRun, uint64 hbCount) {
     
+      SetMemoryRequestPool(_pool);
       _hbCount = hbCount;
       _nextHeartBeatCycle = _hbCount;
       uint64 current;
@@ -432,7 +1331,26 @@ class OoOTraceSimulator {
       current = warmUp + mainRun;
       _milestones.push_back(make_pair(current, END_SIMULATION));
 
-      Simulate();
+      // start from the checkpoint (its warm up replaces the given one)
+      if (_restoreCheckpoint.size() > 0) {
+        RestoreCheckpoint();
+        _milestones[1].first = _milestones[0].first + mainRun;
+      }
+      else if (_functionalWarmUp)
+        WarmUpFunctionally();
+
+      if (_samplePeriod > 0) {
+        AddSampleMilestones();
+        SimulateSampled();
+      }
+      else {
+        if (_restoreCheckpoint.size() > 0 || _functionalWarmUp)
+          RefillWindows();
+        if (_quantum > 0)
+          SimulateParallel();
+        else
+          Simulate();
+      }
       
       _simulator.EndSimulation();
 
@@ -3,6 +3,7 @@
 // -----------------------------------------------------------------------------
 
 #include "TableLRU.h"
+#include "TablePLRU.h"
 #include "TableFIFO.h"
 #include "TableReuse.h"
 #include "TableSRRIP.h"
@@ -25,6 +26,7 @@ void generic_table_t <key_t, value_t>::SetTableParameters(
   
   TABLE_POLICY_BEGIN
   TABLE_POLICY("lru", lru_table_t)
+  TABLE_POLICY("plru", plru_table_t)
   TABLE_POLICY("fifo", fifo_table_t)
   TABLE_POLICY("reuse", reuse_table_t)
   TABLE_POLICY("srrip", srrip_table_t)
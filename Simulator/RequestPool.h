@@ -0,0 +1,190 @@
+// -----------------------------------------------------------------------------
+// File: RequestPool.h
+// Description:
+//    Defines a slab allocator for memory requests. Requests are carved out of
+//    large slabs and recycled through a free list, so creating and destroying
+//    requests does not go to malloc. The pool also keeps the counts reported
+//    at the end of the simulation (peak and live requests).
+//
+//    A pool is allocated from by one thread at a time, the thread it is
+//    current for (see MemoryRequestPool in MemoryRequest.h). Every object
+//    remembers its pool, and an object freed by any other thread is pushed
+//    onto the pool's remote list, which is taken back when the free list
+//    runs out.
+// -----------------------------------------------------------------------------
+
+#ifndef __REQUEST_POOL_H__
+#define __REQUEST_POOL_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "Types.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+using namespace std;
+
+// number of objects in a slab
+#define REQUEST_POOL_SLAB 4096
+
+
+// -----------------------------------------------------------------------------
+// Class: RequestPool
+// Description:
+//    Fixed size object pool. Free objects are linked through their first
+//    word. Objects are handed out zeroed, so fields a constructor does not
+//    set start out the same every time.
+// -----------------------------------------------------------------------------
+
+class RequestPool {
+
+  protected:
+
+    struct FreeObject {
+      FreeObject *next;
+    };
+
+    // header in front of every object (keeps objects 8 byte aligned)
+    struct Header {
+      RequestPool *owner;
+    };
+
+    // size of an object and of its slot (header and object)
+    size_t _objectSize;
+    size_t _slotSize;
+    // slabs and free objects
+    vector <char *> _slabs;
+    FreeObject *_free;
+    // objects freed by other threads
+    FreeObject *_remote;
+
+    // statistics
+    uint64 _allocations;
+    uint64 _live;
+    uint64 _remoteFrees;
+    uint64 _highWater;
+
+
+    // -------------------------------------------------------------------------
+    // Function to add a slab to the free list
+    // -------------------------------------------------------------------------
+
+    void Grow() {
+      char *slab = (char *)malloc(_slotSize * REQUEST_POOL_SLAB);
+      if (slab == NULL) throw bad_alloc();
+      _slabs.push_back(slab);
+      for (uint32 i = REQUEST_POOL_SLAB; i > 0; i --) {
+        char *slot = slab + (i - 1) * _slotSize;
+        ((Header *)slot) -> owner = this;
+        FreeObject *object = (FreeObject *)(slot + sizeof(Header));
+        object -> next = _free;
+        _free = object;
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to push an object freed by another thread
+    // -------------------------------------------------------------------------
+
+    void RemoteFree(FreeObject *object) {
+      FreeObject *head = __atomic_load_n(&_remote, __ATOMIC_RELAXED);
+      do {
+        object -> next = head;
+      } while (!__atomic_compare_exchange_n(&_remote, &head, object, true,
+            __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+      __atomic_add_fetch(&_remoteFrees, 1, __ATOMIC_RELAXED);
+    }
+
+
+  public:
+
+    // -------------------------------------------------------------------------
+    // Constructor
+    // -------------------------------------------------------------------------
+
+    RequestPool(size_t objectSize) {
+      _objectSize = objectSize < sizeof(FreeObject) ?
+        sizeof(FreeObject) : objectSize;
+      _objectSize = (_objectSize + 7) & ~(size_t)7;
+      _slotSize = sizeof(Header) + _objectSize;
+      _free = NULL;
+      _remote = NULL;
+      _allocations = 0;
+      _live = 0;
+      _remoteFrees = 0;
+      _highWater = 0;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Destructor
+    // -------------------------------------------------------------------------
+
+    ~RequestPool() {
+      for (uint32 i = 0; i < _slabs.size(); i ++)
+        free(_slabs[i]);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to get an object
+    // -------------------------------------------------------------------------
+
+    void *Allocate(size_t size) {
+      assert(size <= _objectSize);
+      if (_free == NULL)
+        _free = __atomic_exchange_n(&_remote, (FreeObject *)NULL,
+            __ATOMIC_ACQUIRE);
+      if (_free == NULL) Grow();
+      FreeObject *object = _free;
+      _free = object -> next;
+      memset(object, 0, _objectSize);
+
+      _allocations ++;
+      _live ++;
+      if (Live() > _highWater) _highWater = Live();
+      return object;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to return an object
+    // -------------------------------------------------------------------------
+
+    void Free(void *ptr) {
+      if (ptr == NULL) return;
+      FreeObject *object = (FreeObject *)ptr;
+      RequestPool *owner = ((Header *)((char *)ptr - sizeof(Header))) -> owner;
+      if (owner != this) {
+        owner -> RemoteFree(object);
+        return;
+      }
+      object -> next = _free;
+      _free = object;
+      _live --;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Statistics
+    // -------------------------------------------------------------------------
+
+    uint64 Allocations() { return _allocations; }
+    uint64 Live() {
+      return _live - __atomic_load_n(&_remoteFrees, __ATOMIC_RELAXED);
+    }
+    uint64 HighWater() { return _highWater; }
+    uint64 Slabs() { return _slabs.size(); }
+};
+
+#endif // __REQUEST_POOL_H__
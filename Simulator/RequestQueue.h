@@ -0,0 +1,53 @@
+// -----------------------------------------------------------------------------
+// File: RequestQueue.h
+// Description:
+//    Defines the priority queue of memory requests ordered by current cycle
+//    used by the components and the simulator.
+// -----------------------------------------------------------------------------
+
+#ifndef __REQUEST_QUEUE_H__
+#define __REQUEST_QUEUE_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "MemoryRequest.h"
+#include "Types.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <vector>
+#include <queue>
+
+using namespace std;
+
+
+// -----------------------------------------------------------------------------
+// Class: RequestHeap
+// Description:
+//    Binary heap of requests (earliest current cycle first). The current
+//    cycle is compared live, so a request whose cycle changes while queued
+//    is not moved; the simulator's results depend on this order.
+// -----------------------------------------------------------------------------
+
+class RequestHeap : public priority_queue <MemoryRequest *,
+    vector <MemoryRequest *>, MemoryRequest::ComparePointers> {
+
+  public:
+
+    // -------------------------------------------------------------------------
+    // Function to save or restore the queue (see Checkpoint.h). The heap
+    // array is saved as it is, so the requests come out of a restored queue
+    // in the same order.
+    // -------------------------------------------------------------------------
+
+    void CheckpointState(CheckpointFile &cp) {
+      CheckpointTransfer(cp, c);
+    }
+};
+
+
+#endif // __REQUEST_QUEUE_H__
@@ -179,30 +179,84 @@ public:
 
 
   // -------------------------------------------------------------------------
-  // Function to insert a key-value pair into the list
+  // Handle to the slot of a key (see tag_handle_t)
   // -------------------------------------------------------------------------
 
-  virtual TableEntry insert(uint32 appID, key_t key, value_t value, 
-                            bool updatePSEL = true, policy_value_t pval0 = POLICY_HIGH,
-                            policy_value_t pval1 = POLICY_BIMODAL) {
-    uint32 setIndex = index(key);
+  typedef tag_handle_t <value_t> handle;
+
+
+  // -------------------------------------------------------------------------
+  // Function to search for a key and return its handle
+  // -------------------------------------------------------------------------
+
+  handle find(key_t key) {
+    assert(_sets != NULL);
+    handle h;
+    h.set = index(key);
+    h.slot = _sets[h.set].find(key);
+    h.valid = (h.slot != _numSlotsPerSet);
+    h.value = (h.valid ? &(_sets[h.set].value_at(h.slot)) : NULL);
+    return h;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to pick the insertion policy for a set (updates the PSEL
+  // counter on the application's leader sets)
+  // -------------------------------------------------------------------------
+
+  policy_value_t insertion_policy(uint32 appID, uint32 setIndex,
+                                  bool updatePSEL, policy_value_t pval0,
+                                  policy_value_t pval1) {
     if (updatePSEL && _type[setIndex].leader && 
         _type[setIndex].appID == appID) {
       if (_type[setIndex].policy == POLICY_HIGH) {
         _psel[appID].decrement();
-        return _sets[setIndex].insert(key, value, pval0);
+        return pval0;
       }
       else {
         _psel[appID].increment();
-        return _sets[setIndex].insert(key, value, pval1);
+        return pval1;
       }
     }
 
-    assert(_sets != NULL);
     if (_psel[appID] > _threshold)
-      return _sets[setIndex].insert(key, value, pval0);
+      return pval0;
     else 
-      return _sets[setIndex].insert(key, value, pval1);
+      return pval1;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to insert a key-value pair into the list
+  // -------------------------------------------------------------------------
+
+  virtual TableEntry insert(uint32 appID, key_t key, value_t value, 
+                            bool updatePSEL = true, policy_value_t pval0 = POLICY_HIGH,
+                            policy_value_t pval1 = POLICY_BIMODAL) {
+    assert(_sets != NULL);
+    uint32 setIndex = index(key);
+    return _sets[setIndex].insert(key, value,
+      insertion_policy(appID, setIndex, updatePSEL, pval0, pval1));
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to insert a key through the handle returned by a find that
+  // missed. Returns the evicted entry, and the handle then refers to the
+  // inserted key.
+  // -------------------------------------------------------------------------
+
+  TableEntry insert(handle &h, uint32 appID, key_t key, value_t value,
+                    bool updatePSEL = true, policy_value_t pval0 = POLICY_HIGH,
+                    policy_value_t pval1 = POLICY_BIMODAL) {
+    assert(!h.valid);
+    TableEntry evicted = _sets[h.set].insert_new(key, value,
+      insertion_policy(appID, h.set, updatePSEL, pval0, pval1));
+    h.slot = evicted.index;
+    h.value = &(_sets[h.set].value_at(h.slot));
+    h.valid = true;
+    return evicted;
   }
 
 
@@ -216,6 +270,16 @@ public:
   }
 
    
+  // -------------------------------------------------------------------------
+  // Function to read a key through a valid handle
+  // -------------------------------------------------------------------------
+
+  void read(handle &h, policy_value_t pval = POLICY_HIGH) {
+    assert(h.valid);
+    _sets[h.set].read_at(h.slot, pval);
+  }
+
+   
   // -------------------------------------------------------------------------
   // Function to update a key
   // -------------------------------------------------------------------------
@@ -283,6 +347,19 @@ public:
   TableEntry force_evict(uint32 index) {
     return _sets[index].force_evict();
   }
+
+
+  // -------------------------------------------------------------------------
+  // Function to save or restore the tag store and the psel counters
+  // -------------------------------------------------------------------------
+
+  void CheckpointState(CheckpointFile &cp) {
+    cp.Size(_numSets, "a tag store");
+    cp.Marker(_dynamicPolicy);
+    for (uint32 i = 0; i < _numSets; i ++)
+      _sets[i].CheckpointState(cp);
+    CheckpointTransfer(cp, _psel);
+  }
 };
 
 #endif // __SET_DUELING_TAG_STORE_H__
@@ -0,0 +1,311 @@
+// -----------------------------------------------------------------------------
+// File: SharedTraceRing.h
+// Description:
+//    Defines a single-producer/single-consumer ring of trace records in POSIX
+//    shared memory, so that a producer process (an instrumentation tool, or
+//    trace-stream) can feed the simulator without writing the trace to disk.
+//    A trace file name of the form shm:<name> reads the ring <name>; there is
+//    one ring per simulated core.
+//
+//    The producer creates the ring and writes records at the head, waiting
+//    while the ring is full. The consumer attaches to it (waiting for it to
+//    appear), removes the name and reads records at the tail. The producer
+//    marks the end of the stream by closing the ring; if the producer dies
+//    without closing it, the consumer treats the stream as ended. If the
+//    consumer goes away (the simulation is over), the producer stops.
+// -----------------------------------------------------------------------------
+
+#ifndef __SHARED_TRACE_RING_H__
+#define __SHARED_TRACE_RING_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "Types.h"
+#include "TraceFormat.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sched.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+#define SHARED_TRACE_MAGIC "MSSTREAM"
+#define SHARED_TRACE_VERSION 1
+#define SHARED_TRACE_PREFIX "shm:"
+// default number of records in a ring (a power of two)
+#define SHARED_TRACE_CAPACITY (1 << 16)
+// records consumed before the tail is published
+#define SHARED_TRACE_PUBLISH 256
+
+
+// -----------------------------------------------------------------------------
+// Structure: SharedTraceHeader
+// Description:
+//    Header of a ring. The head and the tail are on their own cache lines;
+//    head and closed are written by the producer only, tail by the consumer
+//    only. The magic is written last, once the rest is set up.
+// -----------------------------------------------------------------------------
+
+struct SharedTraceHeader {
+  char magic[8];
+  uint32 version;
+  uint32 recordSize;
+  uint64 capacity;
+  uint64 producer;
+  uint64 consumer;
+  char pad0[24];
+
+  uint64 head;
+  uint32 closed;
+  char pad1[52];
+
+  uint64 tail;
+  char pad2[56];
+};
+
+
+// -----------------------------------------------------------------------------
+// Function to wait a little, yielding first and sleeping on long waits
+// -----------------------------------------------------------------------------
+
+inline void SharedTraceWait(uint32 &spins) {
+  if (spins ++ < 1000)
+    sched_yield();
+  else
+    usleep(100);
+}
+
+
+// -----------------------------------------------------------------------------
+// Class: SharedTraceRing
+// Description:
+//    One end of a ring
+// -----------------------------------------------------------------------------
+
+class SharedTraceRing {
+
+  protected:
+
+    SharedTraceHeader *_header;
+    TraceRecord *_records;
+    size_t _length;
+    uint64 _mask;
+
+    // local copies of the indices
+    uint64 _head;
+    uint64 _tail;
+    uint64 _otherEnd;
+
+
+    // -------------------------------------------------------------------------
+    // Function to map a ring of the given length
+    // -------------------------------------------------------------------------
+
+    bool Map(int fd, size_t length) {
+      void *map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      close(fd);
+      if (map == MAP_FAILED)
+        return false;
+      _header = (SharedTraceHeader *)map;
+      _records = (TraceRecord *)(_header + 1);
+      _length = length;
+      return true;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to check whether a process is still running
+    // -------------------------------------------------------------------------
+
+    static bool Alive(pid_t pid) {
+      return kill(pid, 0) == 0 || errno != ESRCH;
+    }
+
+  public:
+
+    SharedTraceRing() {
+      _header = NULL;
+    }
+
+    ~SharedTraceRing() {
+      if (_header != NULL)
+        munmap(_header, _length);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to create a ring as the producer. Returns false on failure.
+    // -------------------------------------------------------------------------
+
+    bool Create(string name, uint64 capacity = SHARED_TRACE_CAPACITY) {
+
+      if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+        return false;
+
+      string shmName = "/" + name;
+      shm_unlink(shmName.c_str());
+      int fd = shm_open(shmName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+      if (fd < 0)
+        return false;
+
+      size_t length = sizeof(SharedTraceHeader) + capacity * sizeof(TraceRecord);
+      if (ftruncate(fd, length) != 0 || !Map(fd, length)) {
+        shm_unlink(shmName.c_str());
+        return false;
+      }
+
+      // the mapping is zeroed by ftruncate
+      _header -> version = SHARED_TRACE_VERSION;
+      _header -> recordSize = sizeof(TraceRecord);
+      _header -> capacity = capacity;
+      _header -> producer = getpid();
+      _mask = capacity - 1;
+      _head = _tail = _otherEnd = 0;
+      __atomic_thread_fence(__ATOMIC_RELEASE);
+      memcpy(_header -> magic, SHARED_TRACE_MAGIC, 8);
+      return true;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to attach to a ring as the consumer, waiting for the producer
+    // to create it. The name is removed once attached. Returns false if the
+    // ring is not a trace ring.
+    // -------------------------------------------------------------------------
+
+    bool Attach(string name) {
+
+      string shmName = "/" + name;
+      uint32 spins = 0;
+      bool told = false;
+      int fd;
+      struct stat info;
+
+      // wait for the ring to be created and set up
+      while (true) {
+        fd = shm_open(shmName.c_str(), O_RDWR, 0);
+        if (fd >= 0 && fstat(fd, &info) == 0 &&
+            (size_t)info.st_size > sizeof(SharedTraceHeader)) {
+          if (!Map(fd, info.st_size))
+            return false;
+          if (memcmp(_header -> magic, SHARED_TRACE_MAGIC, 8) == 0)
+            break;
+          munmap(_header, _length);
+          _header = NULL;
+        }
+        else if (fd >= 0)
+          close(fd);
+        if (!told) {
+          fprintf(stderr, "Waiting for a trace producer on `%s'\n",
+              name.c_str());
+          told = true;
+        }
+        SharedTraceWait(spins);
+      }
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      shm_unlink(shmName.c_str());
+      __atomic_store_n(&_header -> consumer, getpid(), __ATOMIC_RELEASE);
+
+      if (_header -> version != SHARED_TRACE_VERSION ||
+          _header -> recordSize != sizeof(TraceRecord) ||
+          _length != sizeof(SharedTraceHeader) +
+          _header -> capacity * sizeof(TraceRecord))
+        return false;
+
+      _mask = _header -> capacity - 1;
+      _tail = __atomic_load_n(&_header -> tail, __ATOMIC_RELAXED);
+      _otherEnd = _tail;
+      return true;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to add a record (producer), waiting while the ring is full.
+    // Returns false if the consumer has gone away.
+    // -------------------------------------------------------------------------
+
+    bool Put(const TraceRecord &record) {
+      if (_head - _otherEnd > _mask) {
+        uint32 spins = 0;
+        while (true) {
+          _otherEnd = __atomic_load_n(&_header -> tail, __ATOMIC_ACQUIRE);
+          if (_head - _otherEnd <= _mask)
+            break;
+          // let the consumer see what has been written so far
+          __atomic_store_n(&_header -> head, _head, __ATOMIC_RELEASE);
+          pid_t consumer = __atomic_load_n(&_header -> consumer,
+              __ATOMIC_ACQUIRE);
+          if (spins % 1000 == 999 && consumer != 0 && !Alive(consumer))
+            return false;
+          SharedTraceWait(spins);
+        }
+      }
+      _records[_head & _mask] = record;
+      _head ++;
+      if ((_head & (SHARED_TRACE_PUBLISH - 1)) == 0)
+        __atomic_store_n(&_header -> head, _head, __ATOMIC_RELEASE);
+      return true;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to mark the end of the stream (producer)
+    // -------------------------------------------------------------------------
+
+    void Close() {
+      if (_header == NULL) return;
+      __atomic_store_n(&_header -> head, _head, __ATOMIC_RELEASE);
+      __atomic_store_n(&_header -> closed, 1, __ATOMIC_RELEASE);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to get the next record (consumer). Waits for the producer and
+    // returns false at the end of the stream.
+    // -------------------------------------------------------------------------
+
+    bool Get(TraceRecord &record) {
+      if (_tail == _otherEnd) {
+        // give the producer the free space before waiting
+        __atomic_store_n(&_header -> tail, _tail, __ATOMIC_RELEASE);
+        uint32 spins = 0;
+        while (true) {
+          // read closed before head, so that no record is missed
+          uint32 closed = __atomic_load_n(&_header -> closed, __ATOMIC_ACQUIRE);
+          _otherEnd = __atomic_load_n(&_header -> head, __ATOMIC_ACQUIRE);
+          if (_tail != _otherEnd)
+            break;
+          if (closed)
+            return false;
+          if (spins % 1000 == 999 && !Alive(_header -> producer)) {
+            fprintf(stderr, "Warning: trace producer exited without closing "
+                "the stream\n");
+            __atomic_store_n(&_header -> closed, 1, __ATOMIC_RELEASE);
+            return false;
+          }
+          SharedTraceWait(spins);
+        }
+      }
+      record = _records[_tail & _mask];
+      _tail ++;
+      if ((_tail & (SHARED_TRACE_PUBLISH - 1)) == 0)
+        __atomic_store_n(&_header -> tail, _tail, __ATOMIC_RELEASE);
+      return true;
+    }
+};
+
+#endif // __SHARED_TRACE_RING_H__
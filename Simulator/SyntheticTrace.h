@@ -61,6 +61,13 @@ public:
 
     return request;
   }
+
+
+  // save or restore the position in the working set
+  void CheckpointState(CheckpointFile &cp) {
+    CHECKPOINT(_icount);
+    CHECKPOINT(_index);
+  }
   
 };
 
@@ -15,6 +15,7 @@
 // -----------------------------------------------------------------------------
 
 #include "Types.h"
+#include "Checkpoint.h"
 
 // -----------------------------------------------------------------------------
 // Standard includes
@@ -224,6 +225,19 @@ public:
 public:
 
 
+  // -------------------------------------------------------------------------
+  // Function to save or restore the table (see Checkpoint.h). Policies with
+  // state of their own extend it.
+  // -------------------------------------------------------------------------
+
+  virtual void CheckpointState(CheckpointFile &cp) {
+    cp.Size(_size, "a table");
+    CheckpointTransfer(cp, _table);
+    CheckpointTransfer(cp, _keyIndex);
+    CheckpointTransfer(cp, _freeList);
+  }
+
+
   // -------------------------------------------------------------------------
   // Table constructor
   // -------------------------------------------------------------------------
@@ -286,6 +300,18 @@ public:
       return entry(index);						// valid will be false
     }
 
+    return insert_new(key, value, pval);
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to insert a key that is known to be absent. The index of the
+  // returned entry is the slot the key went into.
+  // -------------------------------------------------------------------------
+
+  entry insert_new(key_t key, value_t value, policy_value_t pval = POLICY_HIGH) {
+    uint32 index;
+
     // check if there is a free slot
     if ((index = GetFreeEntry()) != _size) {
       // update with replacement policy
@@ -369,6 +395,35 @@ public:
   }
 
 
+  // -------------------------------------------------------------------------
+  // Functions to access an entry by index, for callers that have already
+  // searched for the key. The index must hold a valid entry.
+  // -------------------------------------------------------------------------
+
+  void read_at(uint32 index, policy_value_t pval = POLICY_HIGH) {
+    assert(index < _size && _table[index].valid);
+    UpdateReplacementPolicy(index, T_READ, pval);
+  }
+
+  void silentupdate_at(uint32 index, policy_value_t pval = POLICY_HIGH) {
+    assert(index < _size && _table[index].valid);
+    UpdateReplacementPolicy(index, T_UPDATE, pval);
+  }
+
+  entry invalidate_at(uint32 index) {
+    assert(index < _size && _table[index].valid);
+    UpdateReplacementPolicy(index, T_INVALIDATE, POLICY_HIGH);
+    entry evicted = _table[index];
+    InvalidateEntry(evicted);
+    return evicted;
+  }
+
+  value_t & value_at(uint32 index) {
+    assert(index < _size);
+    return _table[index].value;
+  }
+
+
   // -------------------------------------------------------------------------
   // Function to get an entry by index
   // -------------------------------------------------------------------------
@@ -167,6 +167,28 @@ public:
     for (uint32 i = 0; i < _size; i ++)
       delete _nodes[i];
   }
+
+
+  // ---------------------------------------------------------------------------
+  // Function to save or restore the policy state
+  // ---------------------------------------------------------------------------
+
+  // (the list is saved as the indices from head to tail)
+  void CheckpointState(CheckpointFile &cp) {
+    TableClass::CheckpointState(cp);
+    CheckpointTransfer(cp, _bipCounter);
+    vector <uint32> order;
+    for (ListNode *node = _head; node != NULL; node = node -> next)
+      order.push_back(node -> index);
+    CheckpointTransfer(cp, order);
+    if (cp.Restoring()) {
+      _head = _tail = NULL;
+      for (uint32 i = 0; i < _size; i ++)
+        _nodes[i] -> prev = _nodes[i] -> next = NULL;
+      for (uint32 i = 0; i < order.size(); i ++)
+        _push_back(order[i]);
+    }
+  }
 };
 
 #endif // __TABLE_DIP_H__
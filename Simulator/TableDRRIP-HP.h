@@ -13,6 +13,7 @@
 
 #include "Types.h"
 #include "Table.h"
+#include "TableRRIP.h"
 
 // -----------------------------------------------------------------------------
 // Standard includes
@@ -33,8 +34,8 @@ protected:
   // members from the table class
   using TableClass::_size;
 
-  // list of rrpvs
-  vector <saturating_counter> _rrpv;
+  // list of rrpvs (packed)
+  vector <uint8> _rrpv;
 
   // max value
   uint32 _max;
@@ -58,11 +59,11 @@ protected:
     // if read or update, promotion policy based on pval
     else if (op == TABLE_READ || op == TABLE_UPDATE) {
       switch (pval) {
-      case POLICY_HIGH: _rrpv[index].set(_max); break;
-      case POLICY_LOW: _rrpv[index].set(0);
+      case POLICY_HIGH: _rrpv[index] = _max; break;
+      case POLICY_LOW: _rrpv[index] = 0;
       case POLICY_BIMODAL:
-        if (_brripCounter) _rrpv[index].set(0);
-        else _rrpv[index].set(_max);
+        if (_brripCounter) _rrpv[index] = 0;
+        else _rrpv[index] = _max;
         break;
       }
     }
@@ -70,11 +71,11 @@ protected:
     // if insert or replace, promotion policy based on pval
     else if (op == TABLE_INSERT || op == TABLE_REPLACE) {
       switch (pval) {
-      case POLICY_HIGH: _rrpv[index].set(1); break;
-      case POLICY_LOW: _rrpv[index].set(0);
+      case POLICY_HIGH: _rrpv[index] = 1; break;
+      case POLICY_LOW: _rrpv[index] = 0;
       case POLICY_BIMODAL:
-        if (_brripCounter) _rrpv[index].set(0);
-        else _rrpv[index].set(1);
+        if (_brripCounter) _rrpv[index] = 0;
+        else _rrpv[index] = 1;
         break;
       }
     }
@@ -87,16 +88,7 @@ protected:
 
   uint32 GetReplacementIndex() {
     _brripCounter.increment();
-    while (1) {
-      for (uint32 i = 0; i < _size; i ++) {
-        if (_rrpv[i] == 0)
-          return i;
-      }
-
-      for (uint32 i = 0; i < _size; i ++) {
-        _rrpv[i].decrement();
-      }
-    }
+    return RRIPAgeAndFind(&_rrpv[0], _size);
   }
 
 
@@ -108,7 +100,18 @@ public:
 
   drrip_hp_table_t(uint32 size) : TableClass(size), _brripCounter(64) {
     _max = 7;
-    _rrpv.resize(size, saturating_counter(_max));
+    _rrpv.resize(size, 0);
+  }
+
+
+  // ---------------------------------------------------------------------------
+  // Function to save or restore the policy state
+  // ---------------------------------------------------------------------------
+
+  void CheckpointState(CheckpointFile &cp) {
+    TableClass::CheckpointState(cp);
+    CheckpointTransfer(cp, _rrpv);
+    CheckpointTransfer(cp, _brripCounter);
   }
 };
 
@@ -13,6 +13,7 @@
 
 #include "Types.h"
 #include "Table.h"
+#include "TableRRIP.h"
 
 // -----------------------------------------------------------------------------
 // Standard includes
@@ -33,8 +34,8 @@ protected:
   // members from the table class
   using TableClass::_size;
 
-  // list of rrpvs
-  vector <saturating_counter> _rrpv;
+  // list of rrpvs (packed, saturating at _max)
+  vector <uint8> _rrpv;
 
   // max value
   uint32 _max;
@@ -42,6 +43,11 @@ protected:
   // BRRIP counter
   cyclic_pointer _brripCounter;
 
+  // increment an rrpv, saturating at _max
+  void _increment(uint32 index) {
+    if (_rrpv[index] < _max) _rrpv[index] ++;
+  }
+
   // -------------------------------------------------------------------------
   // Implementing virtual functions from the base table class
   // -------------------------------------------------------------------------
@@ -58,11 +64,11 @@ protected:
     // if read or update, promotion policy based on pval
     else if (op == TABLE_READ || op == TABLE_UPDATE) {
       switch (pval) {
-      case POLICY_HIGH: _rrpv[index].increment(); break;
-      case POLICY_LOW: _rrpv[index].set(0);
+      case POLICY_HIGH: _increment(index); break;
+      case POLICY_LOW: _rrpv[index] = 0;
       case POLICY_BIMODAL:
-        if (_brripCounter) _rrpv[index].set(0);
-        else _rrpv[index].increment();
+        if (_brripCounter) _rrpv[index] = 0;
+        else _increment(index);
         break;
       }
     }
@@ -70,11 +76,11 @@ protected:
     // if insert or replace, promotion policy based on pval
     else if (op == TABLE_INSERT || op == TABLE_REPLACE) {
       switch (pval) {
-      case POLICY_HIGH: _rrpv[index].set(1); break;
-      case POLICY_LOW: _rrpv[index].set(0);
+      case POLICY_HIGH: _rrpv[index] = 1; break;
+      case POLICY_LOW: _rrpv[index] = 0;
       case POLICY_BIMODAL:
-        if (_brripCounter) _rrpv[index].set(0);
-        else _rrpv[index].set(1);
+        if (_brripCounter) _rrpv[index] = 0;
+        else _rrpv[index] = 1;
         break;
       }
     }
@@ -87,16 +93,7 @@ protected:
 
   uint32 GetReplacementIndex() {
     _brripCounter.increment();
-    while (1) {
-      for (uint32 i = 0; i < _size; i ++) {
-        if (_rrpv[i] == 0)
-          return i;
-      }
-
-      for (uint32 i = 0; i < _size; i ++) {
-        _rrpv[i].decrement();
-      }
-    }
+    return RRIPAgeAndFind(&_rrpv[0], _size);
   }
 
 
@@ -108,7 +105,18 @@ public:
 
   drrip_table_t(uint32 size) : TableClass(size), _brripCounter(67) {
     _max = 7;
-    _rrpv.resize(size, saturating_counter(_max));
+    _rrpv.resize(size, 0);
+  }
+
+
+  // ---------------------------------------------------------------------------
+  // Function to save or restore the policy state
+  // ---------------------------------------------------------------------------
+
+  void CheckpointState(CheckpointFile &cp) {
+    TableClass::CheckpointState(cp);
+    CheckpointTransfer(cp, _rrpv);
+    CheckpointTransfer(cp, _brripCounter);
   }
 };
 
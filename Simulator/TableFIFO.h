@@ -87,6 +87,16 @@ KVTemplate class fifo_table_t : public TableClass {
     fifo_table_t(uint32 size) : TableClass(size) {
       _queue.clear();
     }
+
+
+    // -------------------------------------------------------------------------
+    // Function to save or restore the policy state
+    // -------------------------------------------------------------------------
+
+    void CheckpointState(CheckpointFile &cp) {
+      TableClass::CheckpointState(cp);
+      CheckpointTransfer(cp, _queue);
+    }
 };
 
 #endif // __TABLE_FIFO_H__
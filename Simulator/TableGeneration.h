@@ -120,6 +120,19 @@ KVTemplate class generation_table_t : public TableClass {
       _maxGeneration = 3;
       _nodes.resize(size, Generation(_maxGeneration));
     }
+
+
+    // -------------------------------------------------------------------------
+    // Function to save or restore the policy state
+    // -------------------------------------------------------------------------
+
+    void CheckpointState(CheckpointFile &cp) {
+      TableClass::CheckpointState(cp);
+      cp.Size(_nodes.size(), "a table");
+      for (uint32 i = 0; i < _nodes.size(); i ++)
+        CheckpointTransfer(cp, _nodes[i]);
+      CheckpointTransfer(cp, _hand);
+    }
 };
 
 #endif // __TABLE_GENERATION_H__
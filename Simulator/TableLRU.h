@@ -20,12 +20,28 @@
 
 
 
+// -----------------------------------------------------------------------------
+// Maximum size of a table that keeps its recency as packed rank bytes. Larger
+// tables (fully associative structures) use an index linked list instead.
+// -----------------------------------------------------------------------------
+
+#define LRU_RANK_MAX_SIZE 32
+
+
 // -----------------------------------------------------------------------------
 // Class: lru_table_t
 // Description:
-//    Extends the table class with lru replacement policy.
+//    Extends the table class with lru replacement policy. Small tables (the
+//    sets of a tag store) keep one rank byte per entry: 0 is the MRU entry,
+//    count - 1 the LRU entry and LRU_RANK_NONE marks an entry that is not in
+//    the recency order. Promoting or removing an entry shifts the ranks on
+//    one side of it, which is a single pass over a few contiguous bytes.
+//    Larger tables keep a doubly linked list threaded through two index
+//    arrays. Both give the same victims as the original pointer based list.
 // -----------------------------------------------------------------------------
 
+#define LRU_RANK_NONE 0xFF
+
 KVTemplate class lru_table_t : public TableClass {
 
   protected:
@@ -33,51 +49,67 @@ KVTemplate class lru_table_t : public TableClass {
     // members from the table class
     using TableClass::_size;
 
-    // list of node containers
-    struct ListNode {
-      ListNode *prev;
-      uint32 index;
-      ListNode *next;
-    };
+    // rank mode: rank of each entry and the number of ranked entries
+    bool _useRanks;
+    vector <uint8> _rank;
+    uint32 _ranked;
 
-    // array of nodes
-    vector <ListNode *> _nodes;
-
-    ListNode *_head;
-    ListNode *_tail;
+    // list mode: links between entries (_size is the null link)
+    vector <uint32> _prev;
+    vector <uint32> _next;
+    uint32 _head;
+    uint32 _tail;
 
     // -------------------------------------------------------------------------
     // Macros
     // -------------------------------------------------------------------------
 
     void _push_back(uint32 index) {
-      if (_head == NULL) {
-        _head = _tail = _nodes[index];
+      if (_useRanks) {
+        // entries more recent than index age by one (all the ranked entries
+        // if index is not ranked)
+        uint8 *rank = &_rank[0];
+        uint8 old = rank[index];
+        for (uint32 i = 0; i < _size; i ++)
+          rank[i] += (rank[i] < old);
+        if (old == LRU_RANK_NONE) _ranked ++;
+        rank[index] = 0;
+        return;
+      }
+
+      if (_head == _size) {
+        _head = _tail = index;
       }
       else {
-        _tail -> next = _nodes[index];
-        _nodes[index] -> prev = _tail;
-        _tail = _nodes[index];
+        _next[_tail] = index;
+        _prev[index] = _tail;
+        _tail = index;
       }
     }
 
     uint32 _pop_front() {
-      ListNode *node = _head;
-      _head = _head -> next;
-      if (_head != NULL)
-        _head -> prev = NULL;
-      node -> prev = NULL;
-      node -> next = NULL;
-      return node -> index;
+      uint32 index = GetReplacementIndex();
+      _remove(index);
+      return index;
     }
 
     void _remove(uint32 index) {
-      ListNode *node = _nodes[index];
-      if (node -> prev != NULL) node -> prev -> next = node -> next;
-      else _head = _head -> next;
-      if (node -> next != NULL) node -> next -> prev = node -> prev;
-      else _tail = _tail -> prev;
-      node -> next = node -> prev = NULL;
+      if (_useRanks) {
+        // entries less recent than index move up by one
+        uint8 *rank = &_rank[0];
+        uint8 old = rank[index];
+        for (uint32 i = 0; i < _size; i ++)
+          rank[i] -= (rank[i] > old && rank[i] != LRU_RANK_NONE);
+        rank[index] = LRU_RANK_NONE;
+        _ranked --;
+        return;
+      }
+
+      if (_prev[index] != _size) _next[_prev[index]] = _next[index];
+      else _head = _next[_head];
+      if (_next[index] != _size) _prev[_next[index]] = _prev[index];
+      else _tail = _prev[_tail];
+      _next[index] = _prev[index] = _size;
     }
 
 
@@ -124,8 +156,24 @@ KVTemplate class lru_table_t : public TableClass {
     // -------------------------------------------------------------------------
 
     uint32 GetReplacementIndex() {
-      assert(_head != NULL);
-      return _head -> index;
+      if (_useRanks) {
+        // the LRU entry has rank _ranked - 1. Should the ranks ever not
+        // count down to it, the ranked entry with the highest rank is
+        // returned instead
+        assert(_ranked != 0);
+        uint8 lru = _ranked - 1;
+        uint32 victim = _size;
+        for (uint32 i = 0; i < _size; i ++) {
+          if (_rank[i] == lru) return i;
+          if (_rank[i] != LRU_RANK_NONE &&
+              (victim == _size || _rank[i] > _rank[victim]))
+            victim = i;
+        }
+        assert(victim != _size);
+        return victim;
+      }
+      assert(_head != _size);
+      return _head;
     }
 
 
@@ -136,23 +184,31 @@ KVTemplate class lru_table_t : public TableClass {
     // -------------------------------------------------------------------------
 
     lru_table_t(uint32 size) : TableClass(size) {
-      _head = _tail = NULL;
-      _nodes.resize(size);
-      for (uint32 i = 0; i < size; i ++) {
-        _nodes[i] = new ListNode;
-        _nodes[i] -> index = i;
-        _nodes[i] -> next = NULL;
-        _nodes[i] -> prev = NULL;
+      _useRanks = (size <= LRU_RANK_MAX_SIZE);
+      if (_useRanks) {
+        _rank.resize(size, LRU_RANK_NONE);
+        _ranked = 0;
+      }
+      else {
+        _prev.resize(size, size);
+        _next.resize(size, size);
+        _head = _tail = size;
       }
     }
 
+
     // -------------------------------------------------------------------------
-    // Destructor
+    // Function to save or restore the policy state
     // -------------------------------------------------------------------------
 
-    ~lru_table_t() {
-      for (uint32 i = 0; i < _size; i ++)
-        delete _nodes[i];
+    void CheckpointState(CheckpointFile &cp) {
+      TableClass::CheckpointState(cp);
+      CheckpointTransfer(cp, _rank);
+      CheckpointTransfer(cp, _ranked);
+      CheckpointTransfer(cp, _prev);
+      CheckpointTransfer(cp, _next);
+      CheckpointTransfer(cp, _head);
+      CheckpointTransfer(cp, _tail);
     }
 };
 
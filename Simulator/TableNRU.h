@@ -97,6 +97,18 @@ KVTemplate class nru_table_t : public TableClass {
 
     nru_table_t(uint32 size) : TableClass(size) {
       _referenced.resize(size, false);
+      _hand = 0;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to save or restore the policy state
+    // -------------------------------------------------------------------------
+
+    void CheckpointState(CheckpointFile &cp) {
+      TableClass::CheckpointState(cp);
+      CheckpointTransfer(cp, _referenced);
+      CheckpointTransfer(cp, _hand);
     }
 };
 
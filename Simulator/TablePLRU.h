@@ -0,0 +1,118 @@
+// -----------------------------------------------------------------------------
+// File: TablePLRU.h
+// Description:
+//    Extends the table class with tree pseudo-lru replacement policy
+// -----------------------------------------------------------------------------
+
+#ifndef __TABLE_PLRU_H__
+#define __TABLE_PLRU_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "Types.h"
+#include "Table.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+
+
+// -----------------------------------------------------------------------------
+// Class: plru_table_t
+// Description:
+//    Extends the table class with tree pseudo-lru replacement policy. The
+//    size must be a power of two. The tree is stored heap style: node 1 is
+//    the root, the children of node n are 2n and 2n + 1 and entry i is the
+//    leaf size + i. The bit of a node points (0 left, 1 right) towards the
+//    half to evict from.
+// -----------------------------------------------------------------------------
+
+KVTemplate class plru_table_t : public TableClass {
+
+  protected:
+
+    // members from the table class
+    using TableClass::_size;
+
+    // tree bits
+    vector <uint8> _bits;
+
+
+    // -------------------------------------------------------------------------
+    // Function to point the tree away from an entry
+    // -------------------------------------------------------------------------
+
+    void _touch(uint32 index) {
+      for (uint32 node = _size + index; node > 1; node >>= 1)
+        _bits[node >> 1] = !(node & 1);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Implementing virtual functions from the base table class
+    // -------------------------------------------------------------------------
+
+    // -------------------------------------------------------------------------
+    // Function to update the replacement policy
+    // -------------------------------------------------------------------------
+
+    void UpdateReplacementPolicy(uint32 index, TableOp op, policy_value_t pval) {
+
+      switch(op) {
+
+        case TABLE_INSERT:
+        case TABLE_READ:
+        case TABLE_UPDATE:
+        case TABLE_REPLACE:
+          _touch(index);
+          break;
+
+        case TABLE_INVALIDATE:
+          break;
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to return a replacement index
+    // -------------------------------------------------------------------------
+
+    uint32 GetReplacementIndex() {
+      uint32 node = 1;
+      while (node < _size)
+        node = 2 * node + _bits[node];
+      return node - _size;
+    }
+
+
+  public:
+
+    // -------------------------------------------------------------------------
+    // Constructor
+    // -------------------------------------------------------------------------
+
+    plru_table_t(uint32 size) : TableClass(size) {
+      if (size == 0 || (size & (size - 1)) != 0) {
+        fprintf(stderr, "Error: plru needs a power of two size (got %u)\n", size);
+        exit(-1);
+      }
+      _bits.resize(size, 0);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to save or restore the policy state
+    // -------------------------------------------------------------------------
+
+    void CheckpointState(CheckpointFile &cp) {
+      TableClass::CheckpointState(cp);
+      CheckpointTransfer(cp, _bits);
+    }
+};
+
+#endif // __TABLE_PLRU_H__
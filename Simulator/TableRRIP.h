@@ -0,0 +1,86 @@
+// -----------------------------------------------------------------------------
+// File: TableRRIP.h
+// Description:
+//    Victim search shared by the RRIP family of policies (the srrip, drrip
+//    and drrip-hp tables and their flat tag store counterparts)
+// -----------------------------------------------------------------------------
+
+#ifndef __TABLE_RRIP_H__
+#define __TABLE_RRIP_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "Types.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+// -----------------------------------------------------------------------------
+// Function to age a set of RRPVs and return the victim. The RRIP tables use
+// an RRPV of 0 for the eviction candidate and age by decrementing every RRPV
+// until one reaches 0, picking the first such entry. That is the same as
+// finding the smallest RRPV, subtracting it from every entry and picking the
+// first entry that held it, which is what this does in one pass each.
+// -----------------------------------------------------------------------------
+
+inline uint32 RRIPAgeAndFind(uint8 *rrpv, uint32 size) {
+
+  uint32 i = 0;
+  uint8 min = 0xFF;
+
+  // smallest RRPV
+#ifdef __SSE2__
+  if (size >= 16) {
+    __m128i m = _mm_set1_epi8((char)0xFF);
+    for (; i + 16 <= size; i += 16)
+      m = _mm_min_epu8(m, _mm_loadu_si128((const __m128i *)(rrpv + i)));
+    m = _mm_min_epu8(m, _mm_srli_si128(m, 8));
+    m = _mm_min_epu8(m, _mm_srli_si128(m, 4));
+    m = _mm_min_epu8(m, _mm_srli_si128(m, 2));
+    m = _mm_min_epu8(m, _mm_srli_si128(m, 1));
+    min = (uint8)_mm_cvtsi128_si32(m);
+  }
+#endif
+  for (; i < size; i ++)
+    if (rrpv[i] < min) min = rrpv[i];
+
+  // first entry with the smallest RRPV (the vector loop stops at the block
+  // that holds it)
+  i = 0;
+#ifdef __SSE2__
+  __m128i target = _mm_set1_epi8((char)min);
+  for (; i + 16 <= size; i += 16) {
+    __m128i eq = _mm_cmpeq_epi8(
+      _mm_loadu_si128((const __m128i *)(rrpv + i)), target);
+    if (_mm_movemask_epi8(eq) != 0) break;
+  }
+#endif
+  while (rrpv[i] != min) i ++;
+  uint32 victim = i;
+
+  // age all the entries
+  if (min != 0) {
+    i = 0;
+#ifdef __SSE2__
+    __m128i gap = _mm_set1_epi8((char)min);
+    for (; i + 16 <= size; i += 16) {
+      __m128i *p = (__m128i *)(rrpv + i);
+      _mm_storeu_si128(p, _mm_sub_epi8(_mm_loadu_si128(p), gap));
+    }
+#endif
+    for (; i < size; i ++)
+      rrpv[i] -= min;
+  }
+
+  return victim;
+}
+
+#endif // __TABLE_RRIP_H__
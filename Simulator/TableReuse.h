@@ -108,6 +108,17 @@ KVTemplate class reuse_table_t : public TableClass {
       _hand = 0;
       _max = 3;
     }
+
+
+    // -------------------------------------------------------------------------
+    // Function to save or restore the policy state
+    // -------------------------------------------------------------------------
+
+    void CheckpointState(CheckpointFile &cp) {
+      TableClass::CheckpointState(cp);
+      CheckpointTransfer(cp, _reuse);
+      CheckpointTransfer(cp, _hand);
+    }
 };
 
 #endif // __TABLE_REUSE_H__
@@ -13,6 +13,7 @@
 
 #include "Types.h"
 #include "Table.h"
+#include "TableRRIP.h"
 
 // -----------------------------------------------------------------------------
 // Standard includes
@@ -33,12 +34,17 @@ KVTemplate class srrip_table_t : public TableClass {
     // members from the table class
     using TableClass::_size;
 
-    // list of rrpvs
-    vector <saturating_counter> _rrpv;
+    // list of rrpvs (packed, saturating at _max)
+    vector <uint8> _rrpv;
 
     // max value
     uint32 _max;
 
+    // increment an rrpv, saturating at _max
+    void _increment(uint32 index) {
+      if (_rrpv[index] < _max) _rrpv[index] ++;
+    }
+
     // -------------------------------------------------------------------------
     // Implementing virtual functions from the base table class
     // -------------------------------------------------------------------------
@@ -52,23 +58,23 @@ KVTemplate class srrip_table_t : public TableClass {
       switch(op) {
         
         case TABLE_INSERT:
-          _rrpv[index].set(1);
+          _rrpv[index] = 1;
           break;
 
         case TABLE_READ:
-          _rrpv[index].increment();
+          _increment(index);
           break;
 
         case TABLE_UPDATE:
-          _rrpv[index].increment();
+          _increment(index);
           break;
 
         case TABLE_REPLACE:
-          _rrpv[index].set(1);
+          _rrpv[index] = 1;
           break;
 
         case TABLE_INVALIDATE:
-          _rrpv[index].set(0);
+          _rrpv[index] = 0;
           break;
       }
     }
@@ -79,16 +85,7 @@ KVTemplate class srrip_table_t : public TableClass {
     // -------------------------------------------------------------------------
 
     uint32 GetReplacementIndex() {
-      while (1) {
-        for (uint32 i = 0; i < _size; i ++) {
-          if (_rrpv[i] == 0)
-            return i;
-        }
-
-        for (uint32 i = 0; i < _size; i ++) {
-          _rrpv[i].decrement();
-        }
-      }
+      return RRIPAgeAndFind(&_rrpv[0], _size);
     }
 
 
@@ -100,7 +97,17 @@ KVTemplate class srrip_table_t : public TableClass {
 
     srrip_table_t(uint32 size) : TableClass(size) {
       _max = 7;
-      _rrpv.resize(size, saturating_counter(_max));
+      _rrpv.resize(size, 0);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to save or restore the policy state
+    // -------------------------------------------------------------------------
+
+    void CheckpointState(CheckpointFile &cp) {
+      TableClass::CheckpointState(cp);
+      CheckpointTransfer(cp, _rrpv);
     }
 };
 
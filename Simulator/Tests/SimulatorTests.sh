@@ -0,0 +1,210 @@
+#!/bin/bash
+# ------------------------------------------------------------------------------
+# File: SimulatorTests.sh
+#
+# Runs the simulator on a small generated trace and checks that:
+#   - a run restored from a checkpoint gives the same results as the run that
+#     saved it, also when the restored run decodes the trace on a helper;
+#   - an all-bank refresh that is never due (huge trefi, nothing pulled in)
+#     gives the same results as no refresh, and a real one does not;
+#   - two cores sharing the memory controller give the same results on every
+#     run of the parallel engine.
+#
+# Usage: SimulatorTests.sh <simulator binary>
+# ------------------------------------------------------------------------------
+
+SIMULATOR=$(readlink -f "$1")
+SIMULATOR_DIR=$(cd "$(dirname "$0")/.." && pwd)
+
+if [ ! -x "$SIMULATOR" ]; then
+    echo "Usage: $0 <simulator binary>" >&2
+    exit 1
+fi
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK"
+
+# the component files are read from Simulator/Components
+ln -s "$SIMULATOR_DIR" Simulator
+
+
+# ------------------------------------------------------------------------------
+# Trace, definition and configurations
+# ------------------------------------------------------------------------------
+
+# a stream of loads and stores over a few megabytes, partly sequential:
+# trace <seed> <file>
+trace() {
+    awk -v seed=$1 'BEGIN {
+        icount = 0; address = 1048576;
+        for (i = 0; i < 60000; i ++) {
+            seed = (seed * 1103515245 + 12345) % 2147483648;
+            icount += 1 + seed % 7;
+            if (seed % 4 == 0)
+                address = 1048576 + (seed % 65536) * 64;
+            else
+                address += 64;
+            printf "%d %d %d %d 8 %d\n", icount, 4194304 + seed % 4096,
+                address, address, (seed % 3 == 0);
+        }
+    }' | gzip > $2
+}
+
+trace 1 trace.gz
+trace 2 trace2.gz
+
+cat > definition <<END
+component cache l1
+component mshr l1-mshr
+component cache l2
+component mshr l2-mshr
+component dram-ctlr mc
+
+0 l1 l1-mshr l2 l2-mshr mc
+END
+
+cat > shared <<END
+component cache l1-1
+component mshr l1-mshr-1
+component cache l2-1
+component mshr l2-mshr-1
+component cache l1-2
+component mshr l1-mshr-2
+component cache l2-2
+component mshr l2-mshr-2
+component dram-ctlr mc
+
+0 l1-1 l1-mshr-1 l2-1 l2-mshr-1
+1 l1-2 l1-mshr-2 l2-2 l2-mshr-2
+all mc
+END
+
+cat > none <<END
+l1 32k64b2wayLRU
+l1-mshr 32-64b
+l2 256k64b8wayLRU
+l2-mshr 32-64b
+mc normal
+END
+
+cp none refresh
+echo "override mc refresh all-bank" >> refresh
+
+cp refresh never
+echo "override mc trefi 1000000000" >> never
+echo "override mc max-pulled-in-refreshes 0" >> never
+
+cat > shared-none <<END
+l1-1 32k64b2wayLRU
+l1-mshr-1 32-64b
+l2-1 256k64b8wayLRU
+l2-mshr-1 32-64b
+l1-2 32k64b2wayLRU
+l1-mshr-2 32-64b
+l2-2 256k64b8wayLRU
+l2-mshr-2 32-64b
+mc normal
+END
+
+
+# ------------------------------------------------------------------------------
+# Function to run the simulator: run <configuration> <folder> [options]
+# (on the definition, cores and traces below)
+# ------------------------------------------------------------------------------
+
+DEFINITION=definition
+CPUS=1
+TRACES=trace.gz
+
+run() {
+    local configuration=$1 folder=$2
+    shift 2
+    mkdir -p "$folder"
+    "$SIMULATOR" --definition "$DEFINITION" --configuration "$configuration" \
+        --folder "$folder" --num-cpus $CPUS --trace-files "$TRACES" \
+        --warm-up 20000 --run-time 40000 --ooo-window 128 "$@" \
+        > "$folder.out" 2>&1
+    if [ ! -s "$folder/sim.ipc" ]; then
+        echo "$folder: the simulation failed:" >&2
+        cat "$folder.out" >&2
+        return 1
+    fi
+}
+
+# results of a run, without the request pool statistics (a restored run
+# allocates fewer requests) and the refresh counters (only logged with
+# refresh)
+results() {
+    sort "$1/sim.ipc"
+    grep -v -e '^requests:' -e '-refresh-blocked-cycles =' -e '-refs =' \
+        "$1/SimulationLog" | sort
+}
+
+FAILED=0
+RUN=0
+
+# check <name> <yes if the results must be the same, else no> <folder> <folder>
+check() {
+    local name=$1 expected=$2 first=$3 second=$4 same=no
+    RUN=$((RUN + 1))
+    if [ ! -s "$first/sim.ipc" ] || [ ! -s "$second/sim.ipc" ]; then
+        echo "$name: failed, a simulation did not finish" >&2
+        FAILED=$((FAILED + 1))
+        return
+    fi
+    if cmp -s <(results "$first") <(results "$second"); then
+        same=yes
+    fi
+    if [ "$same" != "$expected" ]; then
+        echo "$name: failed" >&2
+        diff <(results "$first") <(results "$second") | head -20 >&2
+        FAILED=$((FAILED + 1))
+    fi
+}
+
+
+# ------------------------------------------------------------------------------
+# Checkpoints
+# ------------------------------------------------------------------------------
+
+run none saved --save-checkpoint checkpoint.gz &&
+    run none restored --restore-checkpoint checkpoint.gz
+check "checkpoint restore" yes saved restored
+
+run none restored-async --restore-checkpoint checkpoint.gz --async-trace
+check "checkpoint restore with --async-trace" yes saved restored-async
+
+run refresh saved-refresh --save-checkpoint checkpoint-refresh.gz &&
+    run refresh restored-refresh --restore-checkpoint checkpoint-refresh.gz
+check "checkpoint restore with refresh" yes saved-refresh restored-refresh
+
+
+# ------------------------------------------------------------------------------
+# Refresh
+# ------------------------------------------------------------------------------
+
+run none no-refresh
+run never never-refresh
+run refresh all-bank-refresh
+check "refresh never due" yes no-refresh never-refresh
+check "refresh" no no-refresh all-bank-refresh
+
+
+# ------------------------------------------------------------------------------
+# Parallel engine
+# ------------------------------------------------------------------------------
+
+DEFINITION=shared
+CPUS=2
+TRACES=trace.gz,trace2.gz
+
+for i in 1 2 3; do
+    run shared-none parallel-$i --parallel
+done
+check "parallel runs" yes parallel-1 parallel-2
+check "parallel runs" yes parallel-1 parallel-3
+
+
+echo "simulator: $((RUN - FAILED)) of $RUN cases passed"
+[ $FAILED -eq 0 ]
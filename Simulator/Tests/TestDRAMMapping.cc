@@ -0,0 +1,179 @@
+// -----------------------------------------------------------------------------
+// File: TestDRAMMapping.cc
+// Description:
+//    Checks the DRAM address mapping against fields computed by hand for a
+//    plain mapping, a mapping taken by division, split fields and XOR hashes.
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "../DRAMAddressMapping.h"
+#include "../Types.h"
+
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <cstdio>
+#include <string>
+
+using namespace std;
+
+
+#define NUM_ADDRESSES 100000
+
+static const char *fieldNames[NUM_DRAM_FIELDS] = {
+  "channel", "rank", "bank group", "bank", "row", "column"
+};
+
+
+// -----------------------------------------------------------------------------
+// A mapping to check: the mapping and the hash, the numbers of entries (the
+// row is not used), the column size and the function giving the expected
+// fields
+// -----------------------------------------------------------------------------
+
+struct MappingCase {
+  const char *mapping;
+  const char *hash;
+  addr_t entries[NUM_DRAM_FIELDS];
+  addr_t columnSize;
+  void (*expected)(addr_t address, addr_t fields[NUM_DRAM_FIELDS]);
+};
+
+
+// "rbc", 8 banks of 128 columns of 64 bytes
+void PlainRBC(addr_t a, addr_t f[NUM_DRAM_FIELDS]) {
+  f[DRAM_COLUMN] = (a >> 6) & 127;
+  f[DRAM_BANK] = (a >> 13) & 7;
+  f[DRAM_ROW] = a >> 16;
+}
+
+// "rbc", 6 banks: taken by division
+void DividedRBC(addr_t a, addr_t f[NUM_DRAM_FIELDS]) {
+  a /= 64;
+  f[DRAM_COLUMN] = a % 128;
+  a /= 128;
+  f[DRAM_BANK] = a % 6;
+  f[DRAM_ROW] = a / 6;
+}
+
+// "rCRgbc", 2 channels, 2 ranks, 4 bank groups, 4 banks, 1024 columns
+void PlainAllFields(addr_t a, addr_t f[NUM_DRAM_FIELDS]) {
+  f[DRAM_COLUMN] = (a >> 6) & 1023;
+  f[DRAM_BANK] = (a >> 16) & 3;
+  f[DRAM_BANK_GROUP] = (a >> 18) & 3;
+  f[DRAM_RANK] = (a >> 20) & 1;
+  f[DRAM_CHANNEL] = (a >> 21) & 1;
+  f[DRAM_ROW] = a >> 22;
+}
+
+// "rbRc4Cc3", 2 channels, 2 ranks, 8 banks, 128 columns: the 3 low bits of
+// the column are below the channel and the other 4 above it
+void SplitColumn(addr_t a, addr_t f[NUM_DRAM_FIELDS]) {
+  f[DRAM_COLUMN] = ((a >> 6) & 7) | (((a >> 10) & 15) << 3);
+  f[DRAM_CHANNEL] = (a >> 9) & 1;
+  f[DRAM_RANK] = (a >> 14) & 1;
+  f[DRAM_BANK] = (a >> 15) & 7;
+  f[DRAM_ROW] = a >> 18;
+}
+
+// "rb2c7b1r4", 8 banks, 128 columns: the 4 low bits of the row are below the
+// other fields and the bank is split around the column
+void SplitRow(addr_t a, addr_t f[NUM_DRAM_FIELDS]) {
+  f[DRAM_ROW] = ((a >> 6) & 15) | ((a >> 20) << 4);
+  f[DRAM_BANK] = ((a >> 10) & 1) | (((a >> 18) & 3) << 1);
+  f[DRAM_COLUMN] = (a >> 11) & 127;
+}
+
+// "rbc" with "b^r": the low bits of the row are XORed into the bank
+void HashBankRow(addr_t a, addr_t f[NUM_DRAM_FIELDS]) {
+  PlainRBC(a, f);
+  f[DRAM_BANK] ^= f[DRAM_ROW] & 7;
+}
+
+// "rbRc4Cc3" with "C^r,C^20,b^R": the channel is hashed with the plain row
+// and address bit 20, the bank with the plain rank
+void HashSplit(addr_t a, addr_t f[NUM_DRAM_FIELDS]) {
+  SplitColumn(a, f);
+  f[DRAM_CHANNEL] ^= (f[DRAM_ROW] & 1) ^ ((a >> 20) & 1);
+  f[DRAM_BANK] ^= f[DRAM_RANK];
+}
+
+// "rCRgbc" with "g^14,b^g": the bank is hashed with the plain bank group
+void HashAllFields(addr_t a, addr_t f[NUM_DRAM_FIELDS]) {
+  PlainAllFields(a, f);
+  addr_t group = f[DRAM_BANK_GROUP];
+  f[DRAM_BANK_GROUP] ^= (a >> 14) & 3;
+  f[DRAM_BANK] ^= group;
+}
+
+
+//                   C  R  g  b  r  c
+static MappingCase cases[] = {
+  { "rbc", "", { 1, 1, 1, 8, 0, 128 }, 64, PlainRBC },
+  { "rbc", "", { 1, 1, 1, 6, 0, 128 }, 64, DividedRBC },
+  { "rCRgbc", "", { 2, 2, 4, 4, 0, 1024 }, 64, PlainAllFields },
+  { "rbRc4Cc3", "", { 2, 2, 1, 8, 0, 128 }, 64, SplitColumn },
+  { "rb2c7b1r4", "", { 1, 1, 1, 8, 0, 128 }, 64, SplitRow },
+  { "rbc", "b^r", { 1, 1, 1, 8, 0, 128 }, 64, HashBankRow },
+  { "rbRc4Cc3", "C^r,C^20,b^R", { 2, 2, 1, 8, 0, 128 }, 64, HashSplit },
+  { "rCRgbc", "g^14,b^g", { 2, 2, 4, 4, 0, 1024 }, 64, HashAllFields },
+  { NULL, NULL, { 0 }, 0, NULL }
+};
+
+
+// -----------------------------------------------------------------------------
+// Function to check a mapping on random addresses. Returns false on a
+// mismatch.
+// -----------------------------------------------------------------------------
+
+bool Check(const MappingCase &c) {
+  DRAMAddressMapping mapping;
+  mapping.Initialize(c.mapping, c.hash, c.entries, c.columnSize);
+
+  uint64 seed = 7;
+  for (uint32 i = 0; i < NUM_ADDRESSES; i ++) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    // addresses up to 2^40, and a few with the top bits set
+    addr_t address = (i % 64 == 0) ? seed : (seed >> 24);
+
+    addr_t fields[NUM_DRAM_FIELDS];
+    addr_t expected[NUM_DRAM_FIELDS] = { 0 };
+    mapping.Map(address, fields);
+    c.expected(address, expected);
+
+    for (int f = 0; f < NUM_DRAM_FIELDS; f ++) {
+      if (fields[f] != expected[f]) {
+        fprintf(stderr, "`%s' hashed `%s': address %llx: %s is %llu, "
+            "expected %llu\n", c.mapping, c.hash, address, fieldNames[f],
+            fields[f], expected[f]);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function: main
+// -----------------------------------------------------------------------------
+
+int main() {
+  uint32 failed = 0;
+  uint32 run = 0;
+
+  for (uint32 i = 0; cases[i].mapping != NULL; i ++) {
+    if (!Check(cases[i]))
+      failed ++;
+    run ++;
+  }
+
+  printf("DRAM mapping: %u of %u cases passed\n", run - failed, run);
+  return failed == 0 ? 0 : 1;
+}
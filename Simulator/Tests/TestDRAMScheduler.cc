@@ -0,0 +1,366 @@
+// -----------------------------------------------------------------------------
+// File: TestDRAMScheduler.cc
+// Description:
+//    Checks the DRAM controller scheduler against a scan of the whole channel
+//    queue run on every memory cycle, as the scheduler was before the queues
+//    were indexed by bank and row. Both controllers get the same requests;
+//    the scan is stepped on every cycle and the indexed one on the cycles
+//    requests arrive and at random otherwise. Every request must be served
+//    at the same cycle and every bank must issue the same commands, with
+//    plain timing, bank groups, pseudo-channels and refresh.
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "../CmpDRAMCtlr.h"
+#include "../MemoryRequest.h"
+#include "../Types.h"
+
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <set>
+
+using namespace std;
+
+
+#define NUM_REQUESTS 20000
+#define DRAIN_CYCLES 100000
+
+static uint64 seed;
+
+static uint64 Random() {
+  seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return seed >> 33;
+}
+
+
+// -----------------------------------------------------------------------------
+// The controller under test, with access to its banks
+// -----------------------------------------------------------------------------
+
+class TestDRAMCtlr : public CmpDRAMCtlr {
+
+public:
+
+  uint32 NumBanks() {
+    return _numChannels * _numRanks * _numBanks;
+  }
+
+  DRAMBank *Bank(uint32 index) {
+    DRAMChannel *channel = &_channels[index / (_numRanks * _numBanks)];
+    index %= _numRanks * _numBanks;
+    return &(channel -> ranks[index / _numBanks].banks[index % _numBanks]);
+  }
+
+  uint64 ModeSwitches() {
+    uint64 switches = 0;
+    FOR_EACH_CHANNEL {
+      switches += channel -> numReadToWrites + channel -> numWriteToReads;
+    }
+    return switches;
+  }
+};
+
+
+// -----------------------------------------------------------------------------
+// The reference: each pass goes through the queue of the channel in order of
+// arrival. A pass issues the first row hit or activate that is ready; if
+// there is none (and no refresh), it precharges the bank of the first
+// request that can be precharged, in a bank with no row hit. The request
+// cycles are brought up to the cycle a command can be issued as they are
+// looked at, and they keep it.
+// -----------------------------------------------------------------------------
+
+class ScanDRAMCtlr : public TestDRAMCtlr {
+
+protected:
+
+  bool ProcessNextRequest() {
+    if (Idle())
+      return false;
+
+    while (_currentCycle < (*_simulatorCycle)) {
+      FOR_EACH_CHANNEL {
+        Scan(channel);
+      }
+      _currentCycle += _memProcessorRatio;
+    }
+
+    // takes the requests in (no pass is left to run)
+    return CmpDRAMCtlr::ProcessNextRequest();
+  }
+
+  void Scan(DRAMChannel *channel) {
+
+    if (channel -> mode == CMODE_READ &&
+        channel -> queue[CMODE_WRITE].size() >= _numWriteBuffers) {
+      channel -> mode = CMODE_WRITE;
+      channel -> numReadToWrites ++;
+    }
+    else if (channel -> mode == CMODE_WRITE &&
+             channel -> queue[CMODE_WRITE].empty()) {
+      channel -> mode = CMODE_READ;
+      channel -> numWriteToReads ++;
+    }
+
+    cycles_t ready = WAKE_UP_NEVER;
+    if (_refreshEnabled) {
+      UpdateRefresh(channel, ready);
+      if (IssueRefresh(channel, true, ready))
+        return;
+    }
+
+    DRAMChannelMode mode = channel -> mode;
+    DRAMRequestQueue &queue = channel -> queue[mode];
+    if (queue.empty()) {
+      if (_refreshEnabled)
+        IssueRefresh(channel, false, ready);
+      return;
+    }
+    DRAMCommand colCmd = mode == CMODE_READ ? CMD_READ : CMD_WRITE;
+
+    // row hits and activates
+    set <DRAMBank *> rowHitPresent;
+    FOR_EACH_REQUEST(queue) {
+      MemoryRequest *request = req -> second;
+      DRAMRank *rank = &(channel -> ranks[request -> dramRankID]);
+      DRAMBank *bank = &(rank -> banks[request -> dramBankID]);
+      if (bank -> refreshBlocked)
+        continue;
+
+      if (bank -> state == BANK_ACTIVATED &&
+          bank -> openRow == request -> dramRowID) {
+        UPDATE_MAX(request -> currentCycle, bank -> nextIssueCycle[colCmd]);
+        UPDATE_MAX(request -> currentCycle, channel -> nextIssueCycle[colCmd]);
+        UPDATE_MAX(request -> currentCycle,
+                   bank -> group -> nextIssueCycle[colCmd]);
+        UPDATE_MAX(request -> currentCycle, BusIssueCycle(channel, colCmd));
+        if (request -> currentCycle <= _currentCycle) {
+          ScheduleRequest(bank, colCmd, request);
+          if (colCmd == CMD_READ)
+            request -> currentCycle = _currentCycle + _tCL + _tBL;
+          else
+            request -> currentCycle = _currentCycle + _tCWL + _tBL;
+          request -> serviced = true;
+          DequeueRequest(mode, req -> first, request);
+          SendToNextComponent(request);
+          return;
+        }
+        rowHitPresent.insert(bank);
+      }
+
+      else if (bank -> state == BANK_PRECHARGED) {
+        UPDATE_MAX(request -> currentCycle, bank -> nextIssueCycle[CMD_ACT]);
+        UPDATE_MAX(request -> currentCycle, rank -> nextActivate);
+        UPDATE_MAX(request -> currentCycle,
+                   bank -> group -> nextIssueCycle[CMD_ACT]);
+        UPDATE_MAX(request -> currentCycle, BusIssueCycle(channel, CMD_ACT));
+        if (request -> currentCycle <= _currentCycle) {
+          ScheduleRequest(bank, CMD_ACT, request);
+          return;
+        }
+      }
+    }
+
+    if (_refreshEnabled && IssueRefresh(channel, false, ready))
+      return;
+
+    // precharges
+    FOR_EACH_REQUEST(queue) {
+      MemoryRequest *request = req -> second;
+      DRAMRank *rank = &(channel -> ranks[request -> dramRankID]);
+      DRAMBank *bank = &(rank -> banks[request -> dramBankID]);
+      if (bank -> refreshBlocked)
+        continue;
+
+      if (rowHitPresent.count(bank) == 0) {
+        UPDATE_MAX(request -> currentCycle, bank -> nextIssueCycle[CMD_PRE]);
+        UPDATE_MAX(request -> currentCycle, BusIssueCycle(channel, CMD_PRE));
+        if (request -> currentCycle <= _currentCycle) {
+          ScheduleRequest(bank, CMD_PRE, request);
+          return;
+        }
+      }
+      else if (request -> currentCycle <= _currentCycle) {
+        request -> currentCycle = _currentCycle + _memProcessorRatio;
+      }
+    }
+  }
+};
+
+
+// -----------------------------------------------------------------------------
+// Function to set up a controller with the parameters of a case
+// -----------------------------------------------------------------------------
+
+struct SchedulerCase {
+  const char *name;
+  const char *parameters[8];
+};
+
+static void SetUp(CmpDRAMCtlr &controller, const SchedulerCase &c,
+                  vector <vector <MemoryComponent *> > &hier,
+                  RequestWorkList &work, cycles_t *cycle) {
+  controller.SetName("mc");
+  for (uint32 i = 0; c.parameters[i] != NULL; i += 2)
+    controller.AddParameter(c.parameters[i], c.parameters[i + 1]);
+  hier.assign(1, vector <MemoryComponent *> (1, &controller));
+  controller.SetBackPointers(&hier, cycle);
+  controller.SetWorkList(&work);
+  controller.StartSimulation();
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to run the same requests through the scan and the indexed
+// scheduler. Requests come in bursts, mostly to a few rows; a third are
+// writebacks, and some arrive a few cycles after their cycle. The writebacks
+// left when the write buffers are not full are never served, by either.
+// -----------------------------------------------------------------------------
+
+bool Compare(const SchedulerCase &c) {
+  ScanDRAMCtlr scan;
+  TestDRAMCtlr indexed;
+  vector <vector <MemoryComponent *> > scanHier, indexedHier;
+  RequestWorkList scanWork, indexedWork;
+  cycles_t scanCycle = 0, indexedCycle = 0;
+  SetUp(scan, c, scanHier, scanWork, &scanCycle);
+  SetUp(indexed, c, indexedHier, indexedWork, &indexedCycle);
+
+  vector <MemoryRequest *> scanRequests, indexedRequests;
+  vector <cycles_t> arrivals;
+  cycles_t now = 0;
+  addr_t address = 0;
+  for (uint32 i = 0; i < NUM_REQUESTS; i ++) {
+    uint64 r = Random();
+    now += ((r & 7) == 0) ? r % 2000 : (r >> 3) % 24;
+    r = Random();
+    if ((r & 3) == 0)
+      address = (Random() % 64) << 20 | (Random() % 4096) << 6;
+    else
+      address += 64;
+    MemoryRequest::Type type = ((r >> 2) % 3 == 0) ?
+      MemoryRequest::WRITEBACK : MemoryRequest::READ;
+    cycles_t cycle = now - min(now, (cycles_t)((r >> 4) % 4));
+    scanRequests.push_back(new MemoryRequest(MemoryRequest::COMPONENT, 0,
+        NULL, type, 0, address, address, 64, cycle));
+    indexedRequests.push_back(new MemoryRequest(MemoryRequest::COMPONENT, 0,
+        NULL, type, 0, address, address, 64, cycle));
+    arrivals.push_back(now);
+  }
+
+  uint32 next = 0;
+  uint32 finished = 0;
+  cycles_t cycle;
+  cycles_t end = arrivals.back() + DRAIN_CYCLES;
+  for (cycle = 0; finished < NUM_REQUESTS && cycle < end; cycle ++) {
+    scanCycle = cycle;
+    indexedCycle = cycle;
+    bool arrived = false;
+    for (; next < NUM_REQUESTS && arrivals[next] == cycle; next ++) {
+      scan.SimpleAddRequest(scanRequests[next]);
+      indexed.SimpleAddRequest(indexedRequests[next]);
+      arrived = true;
+    }
+    scan.ProcessPendingRequests();
+    uint64 r = Random();
+    if (arrived || (r & 15) == 0 ||
+        ((r & 16) == 0 && indexed.NextWakeUpCycle() <= cycle))
+      indexed.ProcessPendingRequests();
+    if (((r >> 5) & 3) == 0)
+      indexed.EarliestCycle();
+
+    // the requests are counted now and then, once they have all arrived
+    if (next == NUM_REQUESTS && (cycle & 1023) == 0) {
+      finished = 0;
+      for (uint32 i = 0; i < NUM_REQUESTS; i ++) {
+        if (scanRequests[i] -> finished && indexedRequests[i] -> finished)
+          finished ++;
+      }
+    }
+  }
+
+  uint32 errors = 0;
+  for (uint32 i = 0; i < NUM_REQUESTS && errors < 10; i ++) {
+    if (scanRequests[i] -> finished != indexedRequests[i] -> finished ||
+        scanRequests[i] -> currentCycle != indexedRequests[i] -> currentCycle) {
+      fprintf(stderr, "%s: request %u (%s %llx, arrived at %llu) served at "
+          "%llu, %llu with the scan\n", c.name, i,
+          scanRequests[i] -> type == MemoryRequest::READ ? "read" : "write",
+          scanRequests[i] -> physicalAddress, arrivals[i],
+          indexedRequests[i] -> currentCycle, scanRequests[i] -> currentCycle);
+      errors ++;
+    }
+  }
+  for (uint32 b = 0; b < scan.NumBanks() && errors < 10; b ++) {
+    for (int cmd = 0; cmd < NUM_CMDS; cmd ++) {
+      if (scan.Bank(b) -> numCmds[cmd] != indexed.Bank(b) -> numCmds[cmd]) {
+        fprintf(stderr, "%s: bank %u issued %llu of command %d, %llu with "
+            "the scan\n", c.name, b, indexed.Bank(b) -> numCmds[cmd], cmd,
+            scan.Bank(b) -> numCmds[cmd]);
+        errors ++;
+      }
+    }
+  }
+  if (scan.ModeSwitches() != indexed.ModeSwitches()) {
+    fprintf(stderr, "%s: %llu mode switches, %llu with the scan\n", c.name,
+        indexed.ModeSwitches(), scan.ModeSwitches());
+    errors ++;
+  }
+
+  for (uint32 i = 0; i < NUM_REQUESTS; i ++) {
+    delete scanRequests[i];
+    delete indexedRequests[i];
+  }
+  return errors == 0;
+}
+
+
+// -----------------------------------------------------------------------------
+// Cases: the default timing, the standard presets (bank groups and, for
+// HBM2, pseudo-channels sharing a command bus), two ranks and two channels,
+// and refresh with a short interval so that refreshes are forced
+// -----------------------------------------------------------------------------
+
+static SchedulerCase cases[] = {
+  { "normal", { NULL } },
+  { "ddr3-1600", { "preset", "ddr3-1600", NULL } },
+  { "ddr4-3200", { "preset", "ddr4-3200", NULL } },
+  { "ddr5-4800", { "preset", "ddr5-4800", NULL } },
+  { "hbm2", { "preset", "hbm2", NULL } },
+  { "ranks and channels", { "num-ranks", "2", "num-channels", "2", NULL } },
+  { "all-bank refresh", { "refresh", "all-bank", "trefi", "1000", NULL } },
+  { "per-bank refresh", { "refresh", "per-bank", "trefi", "1000",
+                          "max-postponed-refreshes", "2", NULL } },
+  { NULL, { NULL } }
+};
+
+
+// -----------------------------------------------------------------------------
+// Function: main
+// -----------------------------------------------------------------------------
+
+int main() {
+  uint32 failed = 0;
+  uint32 run = 0;
+
+  for (uint32 i = 0; cases[i].name != NULL; i ++) {
+    seed = 12345 + i;
+    if (!Compare(cases[i]))
+      failed ++;
+    run ++;
+  }
+
+  printf("DRAM scheduler: %u of %u cases passed\n", run - failed, run);
+  return failed == 0 ? 0 : 1;
+}
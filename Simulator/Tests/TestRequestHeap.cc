@@ -0,0 +1,227 @@
+// -----------------------------------------------------------------------------
+// File: TestRequestHeap.cc
+// Description:
+//    Checks the queue of requests ordered by current cycle: requests come out
+//    in the same order as from a plain priority queue given the same pushes,
+//    pops and changes of queued cycles, and a queue restored from a
+//    checkpoint gives the requests back in the order the saved one would
+//    have. The checkpoint is written to the folder given on the command line
+//    (the current one by default) and removed afterwards.
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "../RequestQueue.h"
+#include "../MemoryRequest.h"
+#include "../Checkpoint.h"
+#include "../Types.h"
+
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <queue>
+#include <unistd.h>
+
+using namespace std;
+
+
+#define NUM_OPERATIONS 200000
+#define NUM_SAVED 5000
+
+typedef priority_queue <MemoryRequest *, vector <MemoryRequest *>,
+        MemoryRequest::ComparePointers> reference_t;
+
+static string checkpointName;
+static uint64 seed = 12345;
+
+static uint64 Random() {
+  seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return seed >> 33;
+}
+
+// a request of a component (requests of the processors are not saved)
+static MemoryRequest *NewRequest(uint32 id, cycles_t cycle) {
+  return new MemoryRequest(MemoryRequest::COMPONENT, 0, NULL,
+      MemoryRequest::READ, 0, id, id, 64, cycle);
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to run the same operations on the queue and on a plain priority
+// queue. Queued requests get a later cycle now and then (the queue compares
+// the current cycle live), so the order checked is not only the sorted one.
+// -----------------------------------------------------------------------------
+
+bool TestOrder() {
+  RequestHeap heap;
+  reference_t reference;
+  vector <MemoryRequest *> queued;
+  uint32 errors = 0;
+  cycles_t now = 0;
+
+  for (uint32 i = 0; i < NUM_OPERATIONS && errors < 10; i ++) {
+    uint64 r = Random();
+    if ((r & 3) != 0 || heap.empty()) {
+      MemoryRequest *request = NewRequest(i, now + (r >> 2) % 1000);
+      heap.push(request);
+      reference.push(request);
+      queued.push_back(request);
+    }
+    else if (((r >> 2) & 7) == 0) {
+      queued[(r >> 5) % queued.size()] -> currentCycle += (r >> 12) % 500;
+    }
+    else {
+      MemoryRequest *a = heap.top();
+      MemoryRequest *b = reference.top();
+      heap.pop();
+      reference.pop();
+      if (a != b) {
+        fprintf(stderr, "operation %u: request %llu out of the queue, %llu "
+            "out of the priority queue\n", i, a -> physicalAddress,
+            b -> physicalAddress);
+        errors ++;
+      }
+      now = a -> currentCycle;
+    }
+    if (heap.size() != reference.size())
+      errors ++;
+  }
+
+  for (uint32 i = 0; i < queued.size(); i ++)
+    delete queued[i];
+  return errors == 0;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to save a queue and restore it. Two queues share some requests,
+// which must be shared again after the restore. If change is set, queued
+// requests get a later cycle before the queues are saved.
+// -----------------------------------------------------------------------------
+
+bool TestCheckpoint(bool change) {
+  RequestHeap first, second;
+  vector <MemoryRequest *> requests;
+
+  for (uint32 i = 0; i < NUM_SAVED; i ++) {
+    MemoryRequest *request = NewRequest(i, Random() % 1000);
+    requests.push_back(request);
+    first.push(request);
+    if ((i % 3) == 0)
+      second.push(request);
+  }
+  if (change) {
+    for (uint32 i = 0; i < NUM_SAVED / 10; i ++)
+      requests[Random() % NUM_SAVED] -> currentCycle += Random() % 500;
+  }
+
+  CheckpointFile save;
+  if (!save.OpenForSave(checkpointName)) {
+    fprintf(stderr, "Error: cannot create `%s'\n", checkpointName.c_str());
+    return false;
+  }
+  first.CheckpointState(save);
+  second.CheckpointState(save);
+  save.Close();
+
+  RequestHeap restoredFirst, restoredSecond;
+  CheckpointFile restore;
+  if (!restore.OpenForRestore(checkpointName)) {
+    fprintf(stderr, "Error: cannot read `%s'\n", checkpointName.c_str());
+    return false;
+  }
+  restoredFirst.CheckpointState(restore);
+  restoredSecond.CheckpointState(restore);
+  restore.Close();
+
+  uint32 errors = 0;
+  if (restoredFirst.size() != first.size() ||
+      restoredSecond.size() != second.size()) {
+    fprintf(stderr, "restored queues have %u and %u requests instead of %u "
+        "and %u\n", (uint32)restoredFirst.size(),
+        (uint32)restoredSecond.size(), (uint32)first.size(),
+        (uint32)second.size());
+    errors ++;
+  }
+
+  // the requests of the second queue, as restored with the first
+  vector <MemoryRequest *> restored(NUM_SAVED, (MemoryRequest *)NULL);
+  vector <MemoryRequest *> restoredRequests;
+  while (errors == 0 && !first.empty()) {
+    MemoryRequest *a = first.top();
+    MemoryRequest *b = restoredFirst.top();
+    first.pop();
+    restoredFirst.pop();
+    if (a -> physicalAddress != b -> physicalAddress ||
+        a -> currentCycle != b -> currentCycle) {
+      fprintf(stderr, "request %llu (cycle %llu) out of the restored queue "
+          "instead of %llu (cycle %llu)\n", b -> physicalAddress,
+          b -> currentCycle, a -> physicalAddress, a -> currentCycle);
+      errors ++;
+    }
+    restored[a -> physicalAddress] = b;
+    restoredRequests.push_back(b);
+  }
+  while (errors == 0 && !second.empty()) {
+    MemoryRequest *a = second.top();
+    MemoryRequest *b = restoredSecond.top();
+    second.pop();
+    restoredSecond.pop();
+    if (restored[a -> physicalAddress] != b) {
+      fprintf(stderr, "request %llu of the second queue is not shared after "
+          "the restore\n", a -> physicalAddress);
+      errors ++;
+    }
+  }
+
+  while (!restoredFirst.empty()) {
+    restoredRequests.push_back(restoredFirst.top());
+    restoredFirst.pop();
+  }
+  for (uint32 i = 0; i < restoredRequests.size(); i ++)
+    delete restoredRequests[i];
+  for (uint32 i = 0; i < requests.size(); i ++)
+    delete requests[i];
+  return errors == 0;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function: main
+// -----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  string folder = (argc > 1) ? argv[1] : ".";
+  checkpointName = folder + "/test-request-heap.gz";
+
+  uint32 failed = 0;
+  uint32 run = 0;
+
+  if (!TestOrder()) { fprintf(stderr, "order: failed\n"); failed ++; }
+  run ++;
+
+  if (!TestCheckpoint(false)) {
+    fprintf(stderr, "checkpoint: failed\n");
+    failed ++;
+  }
+  run ++;
+
+  if (!TestCheckpoint(true)) {
+    fprintf(stderr, "checkpoint after cycle changes: failed\n");
+    failed ++;
+  }
+  run ++;
+
+  unlink(checkpointName.c_str());
+  printf("request heap: %u of %u cases passed\n", run - failed, run);
+  return failed == 0 ? 0 : 1;
+}
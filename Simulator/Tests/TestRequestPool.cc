@@ -0,0 +1,278 @@
+// -----------------------------------------------------------------------------
+// File: TestRequestPool.cc
+// Description:
+//    Checks the request pool: freed objects are handed out again, objects
+//    come out zeroed, objects freed by other threads go back to the pool
+//    they came from (also while that pool is allocating), and a request
+//    deleted by a thread with another current pool returns to its own.
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "../RequestPool.h"
+#include "../MemoryRequest.h"
+#include "../Types.h"
+
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <pthread.h>
+
+using namespace std;
+
+
+#define OBJECT_SIZE 40
+#define NUM_OBJECTS (4 * REQUEST_POOL_SLAB)
+#define NUM_ROUNDS 50
+#define NUM_FREERS 2
+
+
+// -----------------------------------------------------------------------------
+// Freeing threads: each frees every NUM_FREERS-th object of its list from a
+// pool of its own
+// -----------------------------------------------------------------------------
+
+struct Freer {
+  vector <void *> *objects;
+  uint32 first;
+};
+
+static void *FreeObjects(void *arg) {
+  Freer *freer = (Freer *)arg;
+  RequestPool own(OBJECT_SIZE);
+  for (uint32 i = freer -> first; i < freer -> objects -> size();
+      i += NUM_FREERS)
+    own.Free((*(freer -> objects))[i]);
+  // nothing was allocated from or returned to this thread's pool
+  if (own.Allocations() != 0 || own.Live() != 0 || own.Slabs() != 0)
+    return NULL;
+  return arg;
+}
+
+// frees the objects on NUM_FREERS threads; returns false if a thread's own
+// pool was touched
+static bool FreeRemotely(vector <void *> &objects) {
+  pthread_t threads[NUM_FREERS];
+  Freer freers[NUM_FREERS];
+  for (uint32 t = 0; t < NUM_FREERS; t ++) {
+    freers[t].objects = &objects;
+    freers[t].first = t;
+    pthread_create(&threads[t], NULL, FreeObjects, &freers[t]);
+  }
+  bool ok = true;
+  for (uint32 t = 0; t < NUM_FREERS; t ++) {
+    void *result;
+    pthread_join(threads[t], &result);
+    if (result == NULL) ok = false;
+  }
+  return ok;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to check that freed objects are reused and come out zeroed
+// -----------------------------------------------------------------------------
+
+bool TestLocal() {
+  RequestPool pool(OBJECT_SIZE);
+  vector <void *> objects;
+  for (uint32 i = 0; i < NUM_OBJECTS; i ++) {
+    void *object = pool.Allocate(OBJECT_SIZE);
+    memset(object, 0xff, OBJECT_SIZE);
+    objects.push_back(object);
+  }
+  uint64 slabs = pool.Slabs();
+  for (uint32 i = 0; i < objects.size(); i ++)
+    pool.Free(objects[i]);
+  if (pool.Live() != 0) {
+    fprintf(stderr, "%llu objects live after freeing all\n", pool.Live());
+    return false;
+  }
+
+  for (uint32 i = 0; i < NUM_OBJECTS; i ++) {
+    char *object = (char *)pool.Allocate(OBJECT_SIZE);
+    for (uint32 b = 0; b < OBJECT_SIZE; b ++) {
+      if (object[b] != 0) {
+        fprintf(stderr, "object %u handed out again without being "
+            "zeroed\n", i);
+        return false;
+      }
+    }
+  }
+  if (pool.Slabs() != slabs || pool.Live() != NUM_OBJECTS ||
+      pool.HighWater() != NUM_OBJECTS) {
+    fprintf(stderr, "%llu slabs, %llu live, %llu at most after reusing the "
+        "objects (expected %llu, %u, %u)\n", pool.Slabs(), pool.Live(),
+        pool.HighWater(), slabs, NUM_OBJECTS, NUM_OBJECTS);
+    return false;
+  }
+  return true;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to check objects freed by other threads: they are counted back
+// and handed out again by their pool without new slabs
+// -----------------------------------------------------------------------------
+
+bool TestRemote() {
+  RequestPool pool(OBJECT_SIZE);
+  vector <void *> objects;
+  for (uint32 i = 0; i < NUM_OBJECTS; i ++)
+    objects.push_back(pool.Allocate(OBJECT_SIZE));
+  uint64 slabs = pool.Slabs();
+
+  if (!FreeRemotely(objects)) {
+    fprintf(stderr, "objects freed into the pool of the freeing thread\n");
+    return false;
+  }
+  if (pool.Live() != 0) {
+    fprintf(stderr, "%llu objects live after other threads freed all\n",
+        pool.Live());
+    return false;
+  }
+
+  for (uint32 i = 0; i < NUM_OBJECTS; i ++)
+    pool.Allocate(OBJECT_SIZE);
+  if (pool.Slabs() != slabs) {
+    fprintf(stderr, "%llu slabs instead of %llu after reusing objects freed "
+        "by other threads\n", pool.Slabs(), slabs);
+    return false;
+  }
+  return true;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to check objects freed by other threads while the pool keeps
+// allocating: each round is freed remotely while the next one is allocated
+// -----------------------------------------------------------------------------
+
+struct Round {
+  vector <void *> objects;
+  bool ok;
+};
+
+static void *FreeRound(void *arg) {
+  Round *round = (Round *)arg;
+  round -> ok = FreeRemotely(round -> objects);
+  return NULL;
+}
+
+bool TestConcurrent() {
+  RequestPool pool(OBJECT_SIZE);
+  Round rounds[2];
+  for (uint32 i = 0; i < NUM_OBJECTS; i ++)
+    rounds[0].objects.push_back(pool.Allocate(OBJECT_SIZE));
+
+  for (uint32 r = 1; r < NUM_ROUNDS; r ++) {
+    Round &previous = rounds[(r - 1) % 2];
+    Round &current = rounds[r % 2];
+    pthread_t thread;
+    pthread_create(&thread, NULL, FreeRound, &previous);
+    current.objects.clear();
+    for (uint32 i = 0; i < NUM_OBJECTS; i ++) {
+      uint64 *object = (uint64 *)pool.Allocate(OBJECT_SIZE);
+      object[0] = r;
+      current.objects.push_back(object);
+    }
+    pthread_join(thread, NULL);
+    if (!previous.ok) {
+      fprintf(stderr, "round %u: objects freed into the pool of the freeing "
+          "thread\n", r);
+      return false;
+    }
+    // no object of this round is still held by the previous one (freeing
+    // it would have overwritten its first word) or handed out twice
+    vector <void *> sorted(current.objects);
+    sort(sorted.begin(), sorted.end());
+    if (unique(sorted.begin(), sorted.end()) != sorted.end()) {
+      fprintf(stderr, "round %u: an object handed out twice\n", r);
+      return false;
+    }
+    for (uint32 i = 0; i < NUM_OBJECTS; i ++) {
+      if (*(uint64 *)current.objects[i] != r) {
+        fprintf(stderr, "round %u: object %u freed while in use\n", r, i);
+        return false;
+      }
+    }
+    if (pool.Live() != NUM_OBJECTS) {
+      fprintf(stderr, "round %u: %llu objects live instead of %u\n", r,
+          pool.Live(), NUM_OBJECTS);
+      return false;
+    }
+  }
+
+  // two rounds live at most, plus a slab per round that found the remote
+  // list empty while it was being filled
+  if (pool.Slabs() * REQUEST_POOL_SLAB > 2 * NUM_OBJECTS +
+      NUM_ROUNDS * REQUEST_POOL_SLAB) {
+    fprintf(stderr, "%llu slabs for %u objects in use\n", pool.Slabs(),
+        2 * NUM_OBJECTS);
+    return false;
+  }
+  return true;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to check that a request deleted while another pool is current
+// goes back to the pool it was allocated from
+// -----------------------------------------------------------------------------
+
+bool TestRequests() {
+  RequestPool first(sizeof(MemoryRequest));
+  RequestPool second(sizeof(MemoryRequest));
+  vector <MemoryRequest *> requests;
+
+  SetMemoryRequestPool(&first);
+  for (uint32 i = 0; i < NUM_OBJECTS; i ++)
+    requests.push_back(new MemoryRequest());
+  SetMemoryRequestPool(&second);
+  for (uint32 i = 0; i < requests.size(); i ++)
+    delete requests[i];
+  SetMemoryRequestPool(NULL);
+
+  if (first.Live() != 0 || second.Live() != 0 ||
+      second.Allocations() != 0) {
+    fprintf(stderr, "%llu and %llu requests live in the pools after "
+        "deleting all\n", first.Live(), second.Live());
+    return false;
+  }
+  return true;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function: main
+// -----------------------------------------------------------------------------
+
+int main() {
+  uint32 failed = 0;
+  uint32 run = 0;
+
+  if (!TestLocal()) { fprintf(stderr, "local: failed\n"); failed ++; }
+  run ++;
+  if (!TestRemote()) { fprintf(stderr, "remote: failed\n"); failed ++; }
+  run ++;
+  if (!TestConcurrent()) {
+    fprintf(stderr, "concurrent: failed\n");
+    failed ++;
+  }
+  run ++;
+  if (!TestRequests()) { fprintf(stderr, "requests: failed\n"); failed ++; }
+  run ++;
+
+  printf("request pool: %u of %u cases passed\n", run - failed, run);
+  return failed == 0 ? 0 : 1;
+}
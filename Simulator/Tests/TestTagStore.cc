@@ -0,0 +1,135 @@
+// -----------------------------------------------------------------------------
+// File: TestTagStore.cc
+// Description:
+//    Checks that the flat tag store behaves as the table based one: the same
+//    stream of accesses is run on both for every policy the flat tag store
+//    supports, and the hits, the evicted keys and the number of entries must
+//    match.
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "../GenericTagStore.h"
+#include "../Types.h"
+
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace std;
+
+
+// -----------------------------------------------------------------------------
+// Policies with a flat implementation
+// -----------------------------------------------------------------------------
+
+static const char *policies[] = {
+  "lru", "plru", "fifo", "reuse", "srrip", "nru", "generation", "dip",
+  "drrip", "drrip-hp", "maxw", "minw", NULL
+};
+
+static const uint32 associativities[] = { 2, 4, 8, 16, 0 };
+
+#define NUM_SETS 64
+#define NUM_ACCESSES 200000
+
+
+// -----------------------------------------------------------------------------
+// Function to run the accesses on both tag stores. Returns the number of
+// mismatches.
+// -----------------------------------------------------------------------------
+
+uint32 Compare(string policy, uint32 ways) {
+
+  typedef generic_tagstore_t <addr_t, uint32> tagstore_t;
+
+  tagstore_t table(NUM_SETS, ways, policy, false);
+  tagstore_t flat(NUM_SETS, ways, policy, true);
+
+  // keys from a range a few times larger than the tag store, with some reuse
+  addr_t range = NUM_SETS * ways * 3;
+  uint64 seed = 12345;
+  uint32 errors = 0;
+
+  for (uint32 i = 0; i < NUM_ACCESSES && errors < 10; i ++) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    addr_t key = (seed >> 33) % range;
+    policy_value_t pval = ((seed >> 20) & 7) == 0 ? POLICY_LOW : POLICY_HIGH;
+    bool silent = ((seed >> 24) & 3) == 0;
+
+    tagstore_t::handle a = table.find(key);
+    tagstore_t::handle b = flat.find(key);
+
+    if (a.valid != b.valid) {
+      fprintf(stderr, "%s/%u: access %u to %llu: %s in the table, %s in the "
+          "flat tag store\n", policy.c_str(), ways, i, key,
+          a.valid ? "hit" : "miss", b.valid ? "hit" : "miss");
+      errors ++;
+      continue;
+    }
+
+    if (a.valid) {
+      if (*(a.value) != *(b.value)) {
+        fprintf(stderr, "%s/%u: access %u to %llu: values %u and %u\n",
+            policy.c_str(), ways, i, key, *(a.value), *(b.value));
+        errors ++;
+      }
+      if (silent) {
+        table.silentupdate(a, pval);
+        flat.silentupdate(b, pval);
+      }
+      else {
+        table.read(a, pval);
+        flat.read(b, pval);
+      }
+      continue;
+    }
+
+    table_t <addr_t, uint32>::entry x = table.insert(a, key, i, pval);
+    table_t <addr_t, uint32>::entry y = flat.insert(b, key, i, pval);
+    if (x.valid != y.valid || (x.valid && x.key != y.key)) {
+      fprintf(stderr, "%s/%u: access %u to %llu: evicted %lld from the table, "
+          "%lld from the flat tag store\n", policy.c_str(), ways, i, key,
+          x.valid ? (long long)x.key : -1LL,
+          y.valid ? (long long)y.key : -1LL);
+      errors ++;
+    }
+  }
+
+  if (table.count() != flat.count()) {
+    fprintf(stderr, "%s/%u: %u entries in the table, %u in the flat tag "
+        "store\n", policy.c_str(), ways, table.count(), flat.count());
+    errors ++;
+  }
+
+  return errors;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function: main
+// -----------------------------------------------------------------------------
+
+int main() {
+  uint32 failed = 0;
+  uint32 run = 0;
+
+  for (uint32 p = 0; policies[p] != NULL; p ++) {
+    for (uint32 a = 0; associativities[a] != 0; a ++) {
+      if (Compare(policies[p], associativities[a]) != 0)
+        failed ++;
+      run ++;
+    }
+  }
+
+  printf("tag store: %u of %u cases passed\n", run - failed, run);
+  return failed == 0 ? 0 : 1;
+}
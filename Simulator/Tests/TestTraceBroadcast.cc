@@ -0,0 +1,237 @@
+// -----------------------------------------------------------------------------
+// File: TestTraceBroadcast.cc
+// Description:
+//    Checks the trace broadcast: every consumer reads every pass of the
+//    trace, a detached consumer reads nothing more and does not hold the
+//    others back, and a consumer left behind by more batches than the
+//    broadcast may hold goes on with its own reader from where it was, with
+//    and without instructions to skip. The trace is written to the folder
+//    given on the command line (the current one by default) and removed
+//    afterwards.
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "../TraceBroadcast.h"
+#include "../TraceFormat.h"
+#include "../Types.h"
+
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+// more records than the broadcast may hold, and records with the same
+// icount on batch boundaries
+#define NUM_RECORDS ((TRACE_BROADCAST_MAX_BATCHES + 40) * TRACE_BROADCAST_BATCH)
+#define SKIP 100000
+
+
+static string traceName;
+static vector <TraceRecord> records;
+
+
+// -----------------------------------------------------------------------------
+// Function to write the trace: a few records per instruction
+// -----------------------------------------------------------------------------
+
+bool WriteTrace() {
+  BinaryTraceWriter writer;
+  TraceHeader header;
+  if (!writer.Open(traceName, header))
+    return false;
+
+  uint64 seed = 3;
+  uint64 icount = 1;
+  records.resize(NUM_RECORDS);
+  for (uint32 i = 0; i < NUM_RECORDS; i ++) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    TraceRecord &record = records[i];
+    if ((seed >> 60) < 10 && (i + 1) % TRACE_BROADCAST_BATCH > 2)
+      icount += 1 + ((seed >> 40) & 3);
+    record.icount = icount;
+    record.ip = 0x400000 + i % 1000;
+    record.virtualAddress = (seed >> 20) << 6;
+    record.physicalAddress = record.virtualAddress;
+    record.size = 8;
+    record.type = (seed >> 30) & 1;
+    writer.Write(record);
+  }
+  writer.Close();
+  return true;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to read up to count records of a consumer and compare them with
+// the records from first on. Returns the number read, or -1 on a mismatch.
+// -----------------------------------------------------------------------------
+
+int64 Read(TraceSource *source, uint32 first, uint32 count,
+    const char *name) {
+  TraceRecord record;
+  uint32 n = 0;
+  while (n < count && source -> Next(record)) {
+    const TraceRecord &expected = records[first + n];
+    if (record.icount != expected.icount || record.ip != expected.ip ||
+        record.virtualAddress != expected.virtualAddress ||
+        record.type != expected.type) {
+      fprintf(stderr, "%s: record %u is %llu %llu, expected %llu %llu\n",
+          name, first + n, record.icount, record.ip, expected.icount,
+          expected.ip);
+      return -1;
+    }
+    n ++;
+  }
+  return n;
+}
+
+// read the rest of a pass, which must end after the last record
+bool ReadPass(TraceSource *source, uint32 first, const char *name) {
+  int64 n = Read(source, first, NUM_RECORDS - first, name);
+  TraceRecord record;
+  if (n >= 0 && source -> Next(record))
+    n ++;
+  if (n != (int64)(NUM_RECORDS - first)) {
+    if (n >= 0)
+      fprintf(stderr, "%s: %lld records from %u, expected %u\n", name, n,
+          first, NUM_RECORDS - first);
+    return false;
+  }
+  return true;
+}
+
+
+// -----------------------------------------------------------------------------
+// Consumers on their own threads, each reading two passes
+// -----------------------------------------------------------------------------
+
+struct Consumer {
+  BroadcastTraceSource *source;
+  bool ok;
+};
+
+void *ReadTwoPasses(void *arg) {
+  Consumer *consumer = (Consumer *)arg;
+  consumer -> ok = ReadPass(consumer -> source, 0, "first pass");
+  consumer -> source -> Rewind();
+  consumer -> ok = consumer -> ok &&
+    ReadPass(consumer -> source, 0, "second pass");
+  consumer -> source -> Detach();
+  return NULL;
+}
+
+
+// -----------------------------------------------------------------------------
+// Tests. Each returns true if it passed.
+// -----------------------------------------------------------------------------
+
+// three consumers read two passes at once, a fourth is detached at once
+bool TestPasses() {
+  TraceBroadcast broadcast(OpenTraceSource(traceName), traceName, 4);
+  BroadcastTraceSource *detached = broadcast.Consumer(3);
+  detached -> Detach();
+  TraceRecord record;
+  bool ok = !detached -> Next(record);
+  if (!ok)
+    fprintf(stderr, "passes: a detached consumer read a record\n");
+
+  Consumer consumers[3];
+  pthread_t threads[3];
+  for (uint32 i = 0; i < 3; i ++) {
+    consumers[i].source = broadcast.Consumer(i);
+    pthread_create(&threads[i], NULL, ReadTwoPasses, &consumers[i]);
+  }
+  for (uint32 i = 0; i < 3; i ++) {
+    pthread_join(threads[i], NULL);
+    ok = ok && consumers[i].ok && !consumers[i].source -> Dropped();
+    delete consumers[i].source;
+  }
+  delete detached;
+  return ok;
+}
+
+// one consumer reads a whole pass while the other waits after `read'
+// records; the other must fall back to its own reader and go on from there
+bool TestFallBack(uint32 read, uint64 skip) {
+  TraceReaderOptions options;
+  options.skip = skip;
+  TraceBroadcast broadcast(OpenTraceSource(traceName), traceName, 2,
+      options);
+  BroadcastTraceSource *fast = broadcast.Consumer(0);
+  BroadcastTraceSource *slow = broadcast.Consumer(1);
+
+  uint32 first = 0;
+  if (skip > 0) {
+    while (records[first].icount < records[0].icount + skip)
+      first ++;
+  }
+
+  bool ok = Read(slow, first, read, "slow consumer") == (int64)read &&
+    ReadPass(fast, first, "fast consumer") &&
+    ReadPass(slow, first + read, "slow consumer") && slow -> Dropped();
+  if (!slow -> Dropped())
+    fprintf(stderr, "fall back: the slow consumer was not dropped\n");
+
+  // the next pass starts from the first record
+  fast -> Rewind();
+  slow -> Rewind();
+  ok = ok && ReadPass(fast, 0, "fast consumer") &&
+    ReadPass(slow, 0, "slow consumer");
+
+  delete fast;
+  delete slow;
+  return ok;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function: main
+// -----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  string folder = (argc > 1) ? argv[1] : ".";
+  traceName = folder + "/test-trace-broadcast.gz";
+  if (!WriteTrace()) {
+    fprintf(stderr, "Error: cannot create `%s'\n", traceName.c_str());
+    return 1;
+  }
+
+  uint32 failed = 0;
+  uint32 run = 0;
+
+  if (!TestPasses()) { fprintf(stderr, "passes: failed\n"); failed ++; }
+  run ++;
+
+  // dropped before the first record, inside a batch, on a batch boundary
+  // and on a run of records with the same icount
+  uint32 reads[] = { 0, 5000, TRACE_BROADCAST_BATCH,
+    2 * TRACE_BROADCAST_BATCH - 1 };
+  for (uint32 i = 0; i < 4; i ++) {
+    for (uint32 s = 0; s < 2; s ++) {
+      if (!TestFallBack(reads[i], s == 0 ? 0 : SKIP)) {
+        fprintf(stderr, "fall back after %u records%s: failed\n", reads[i],
+            s == 0 ? "" : " with a skip");
+        failed ++;
+      }
+      run ++;
+    }
+  }
+
+  unlink(traceName.c_str());
+  printf("trace broadcast: %u of %u cases passed\n", run - failed, run);
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,310 @@
+// -----------------------------------------------------------------------------
+// File: TestTraceFormats.cc
+// Description:
+//    Checks that a trace written in the text, binary and chunked formats reads
+//    back as the records it was written from, one at a time and in batches,
+//    after a rewind, and from a seek into a chunked trace, and that text
+//    lines in any form read as sscanf reads them. The traces are
+//    written to the folder given on the command line (the current one by
+//    default) and removed afterwards.
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "../TraceSource.h"
+#include "../TraceFormat.h"
+#include "../ChunkedTrace.h"
+#include "../Types.h"
+
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <zlib.h>
+
+using namespace std;
+
+
+#define NUM_RECORDS 50000
+#define FRAME_RECORDS 1000
+
+
+// -----------------------------------------------------------------------------
+// Function to generate the records: mostly small steps, with some large
+// jumps and full 64 bit values so that every varint length is coded
+// -----------------------------------------------------------------------------
+
+void Generate(vector <TraceRecord> &records) {
+  uint64 seed = 42;
+  uint64 icount = 0;
+  addr_t address = 0x10000000;
+  records.resize(NUM_RECORDS);
+
+  for (uint32 i = 0; i < NUM_RECORDS; i ++) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    uint64 r = seed >> 11;
+    TraceRecord &record = records[i];
+
+    icount += 1 + (r & 15);
+    if ((r & 0xff) == 0)
+      icount += r >> 20;
+    if ((r & 3) == 0)
+      address = r;
+    else
+      address += ((r >> 4) & 3) * 64 - 64;
+    if (i % 997 == 0)
+      address = ~(addr_t)0 - (r & 0xffff);
+
+    record.icount = icount;
+    record.ip = 0x400000 + ((r >> 8) & 0xfff);
+    record.virtualAddress = address;
+    record.physicalAddress = (i % 3 == 0) ? address : address ^ (r << 12);
+    record.size = 1 << ((r >> 16) & 3);
+    record.type = (r >> 18) & 1;
+  }
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to compare a record with the expected one
+// -----------------------------------------------------------------------------
+
+bool Same(const TraceRecord &a, const TraceRecord &b) {
+  return a.icount == b.icount && a.ip == b.ip &&
+    a.virtualAddress == b.virtualAddress &&
+    a.physicalAddress == b.physicalAddress &&
+    a.size == b.size && a.type == b.type;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to read the records from the given one to the end of a source,
+// alternately with Next and NextBatch, and compare them. Returns false on a
+// mismatch.
+// -----------------------------------------------------------------------------
+
+bool Check(const char *name, TraceSource *source,
+    const vector <TraceRecord> &records, uint32 first) {
+  TraceRecord batch[97];
+  uint32 i = first;
+  bool single = true;
+
+  while (true) {
+    uint32 n;
+    if (single)
+      n = source -> Next(batch[0]) ? 1 : 0;
+    else
+      n = source -> NextBatch(batch, 1 + i % 97);
+    if (n == 0)
+      break;
+    for (uint32 j = 0; j < n; j ++, i ++) {
+      if (i >= records.size()) {
+        fprintf(stderr, "%s: more records than written\n", name);
+        return false;
+      }
+      if (!Same(batch[j], records[i])) {
+        fprintf(stderr, "%s: record %u is %llu %llu %llu %llu %u %u, "
+            "expected %llu %llu %llu %llu %u %u\n", name, i,
+            batch[j].icount, batch[j].ip, batch[j].virtualAddress,
+            batch[j].physicalAddress, batch[j].size, batch[j].type,
+            records[i].icount, records[i].ip, records[i].virtualAddress,
+            records[i].physicalAddress, records[i].size, records[i].type);
+        return false;
+      }
+    }
+    single = !single;
+  }
+
+  if (i != records.size()) {
+    fprintf(stderr, "%s: %u records read, %u written\n", name, i,
+        (uint32)records.size());
+    return false;
+  }
+  return true;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to read back a trace: from the start, after a rewind and after a
+// seek. Returns the number of failed checks.
+// -----------------------------------------------------------------------------
+
+uint32 ReadBack(string name, const vector <TraceRecord> &records) {
+  TraceSource *source = OpenTraceSource(name);
+  if (source == NULL) {
+    fprintf(stderr, "%s: cannot open\n", name.c_str());
+    return 1;
+  }
+
+  uint32 failed = 0;
+  if (!Check(name.c_str(), source, records, 0))
+    failed ++;
+
+  source -> Rewind();
+  if (!Check((name + " (rewound)").c_str(), source, records, 0))
+    failed ++;
+
+  // a seek may land anywhere before the record, so skip up to it
+  uint32 target = records.size() * 2 / 3 + 17;
+  source -> Seek(records[target].icount);
+  TraceRecord record;
+  bool found = false;
+  while (source -> Next(record)) {
+    if (record.icount >= records[target].icount) {
+      found = Same(record, records[target]);
+      break;
+    }
+  }
+  if (!found || !Check((name + " (seek)").c_str(), source, records,
+        target + 1)) {
+    fprintf(stderr, "%s: seek to record %u failed\n", name.c_str(), target);
+    failed ++;
+  }
+
+  delete source;
+  return failed;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to check the text parser on lines in other forms than the
+// documented one: each record must be what sscanf reads from the line as
+// gzgets splits it, as the trace reader did before the parser. Returns false
+// on a mismatch.
+// -----------------------------------------------------------------------------
+
+bool CheckTextLines(string name) {
+  string longLine = "12 34 56 78 8 1";
+  longLine.append(400, ' ');
+  longLine += "99\n";
+  const char *lines[] = {
+    "1 4196160 668972552 668972552 8 0\n",
+    "  2 4196160 668972552 668972552 8 0\n",
+    "3\t4196160 668972552\t668972552 8 1\n",
+    "4  4196160  668972552 668972552  8  0\n",
+    "0005 04196160 000668972552 668972552 08 01\n",
+    "6 4196160 668972552 668972552 8 0\r\n",
+    "7 4196160 668972552 668972552 8 0 trailing text\n",
+    "8 4196160 668972552\n",
+    "\n",
+    "9 18446744073709551615 18446744073709551615 12345678901234567890 8 0\n",
+    "10 99999999999999999999 1 1 8 0\n",
+    "10 1 1 1 4294967295 4294967296\n",
+    "11 4196160 -5 668972552 8 0\n",
+    "12 1234567890123456789 1234567890123456789 1 1234567890 1\n",
+    longLine.c_str(),
+    "13 4196160 668972552 668972552 8 1",
+    NULL
+  };
+
+  gzFile text = gzopen64(name.c_str(), "w");
+  if (text == Z_NULL)
+    return false;
+  for (uint32 i = 0; lines[i] != NULL; i ++)
+    gzputs(text, lines[i]);
+  gzclose(text);
+
+  TraceSource *source = OpenTraceSource(name);
+  gzFile reference = gzopen64(name.c_str(), "r");
+  bool ok = (source != NULL && reference != Z_NULL);
+  char line[300];
+  uint32 n = 0;
+
+  while (ok && gzgets(reference, line, 300) != Z_NULL) {
+    TraceRecord expected, record;
+    memset(&expected, 0, sizeof(expected));
+    sscanf(line, "%llu %llu %llu %llu %u %u", &(expected.icount),
+        &(expected.ip), &(expected.virtualAddress),
+        &(expected.physicalAddress), &(expected.size), &(expected.type));
+    if (!source -> Next(record)) {
+      fprintf(stderr, "%s: line %u is missing\n", name.c_str(), n);
+      ok = false;
+    }
+    else if (!Same(record, expected)) {
+      fprintf(stderr, "%s: line %u is %llu %llu %llu %llu %u %u, sscanf "
+          "reads %llu %llu %llu %llu %u %u\n", name.c_str(), n,
+          record.icount, record.ip, record.virtualAddress,
+          record.physicalAddress, record.size, record.type, expected.icount,
+          expected.ip, expected.virtualAddress, expected.physicalAddress,
+          expected.size, expected.type);
+      ok = false;
+    }
+    n ++;
+  }
+
+  TraceRecord record;
+  if (ok && source -> Next(record)) {
+    fprintf(stderr, "%s: more records than lines\n", name.c_str());
+    ok = false;
+  }
+
+  if (reference != Z_NULL)
+    gzclose(reference);
+  delete source;
+  unlink(name.c_str());
+  return ok;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function: main
+// -----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  string folder = (argc > 1) ? argv[1] : ".";
+  string prefix = folder + "/test-trace-formats.";
+
+  vector <TraceRecord> records;
+  Generate(records);
+
+  TraceHeader header;
+  BinaryTraceWriter binary;
+  ChunkedTraceWriter chunked;
+  gzFile text = gzopen64((prefix + "text.gz").c_str(), "w");
+
+  if (text == Z_NULL || !binary.Open(prefix + "binary.gz", header) ||
+      !chunked.Open(prefix + "chunked", header, FRAME_RECORDS)) {
+    fprintf(stderr, "Error: cannot create the traces in `%s'\n",
+        folder.c_str());
+    return 1;
+  }
+
+  for (uint32 i = 0; i < records.size(); i ++) {
+    const TraceRecord &record = records[i];
+    gzprintf(text, "%llu %llu %llu %llu %u %u\n", record.icount, record.ip,
+        record.virtualAddress, record.physicalAddress, record.size,
+        record.type);
+    binary.Write(record);
+    chunked.Write(record);
+  }
+
+  gzclose(text);
+  binary.Close();
+  chunked.Close();
+
+  const char *formats[] = { "text.gz", "binary.gz", "chunked", NULL };
+  uint32 failed = 0;
+  uint32 run = 0;
+  for (uint32 f = 0; formats[f] != NULL; f ++) {
+    failed += ReadBack(prefix + formats[f], records);
+    run += 3;
+    unlink((prefix + formats[f]).c_str());
+  }
+
+  if (!CheckTextLines(prefix + "lines.gz"))
+    failed ++;
+  run ++;
+
+  printf("trace formats: %u of %u cases passed\n", run - failed, run);
+  return failed == 0 ? 0 : 1;
+}
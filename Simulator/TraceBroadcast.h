@@ -0,0 +1,587 @@
+// -----------------------------------------------------------------------------
+// File: TraceBroadcast.h
+// Description:
+//    Defines a trace decoder shared by several simulations of the same trace.
+//    A helper thread decodes the trace once into shared record batches and
+//    every consumer has its own queue of the batches it has not read yet; a
+//    batch is recycled once every attached consumer is done with it. The
+//    batches held are bounded: a consumer that falls too far behind goes on
+//    with its own reader of the trace.
+// -----------------------------------------------------------------------------
+
+#ifndef __TRACE_BROADCAST_H__
+#define __TRACE_BROADCAST_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "Types.h"
+#include "TraceSource.h"
+#include "TraceReader.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <pthread.h>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <vector>
+
+using namespace std;
+
+// records in a batch, batches the fastest consumer may have queued before
+// the helper waits, and batches a broadcast may hold (about 40 MB)
+#define TRACE_BROADCAST_BATCH 4096
+#define TRACE_BROADCAST_SLOTS 16
+#define TRACE_BROADCAST_MAX_BATCHES 256
+
+
+class BroadcastTraceSource;
+
+
+// -----------------------------------------------------------------------------
+// Class: TraceBroadcast
+// Description:
+//    Decodes a source once for a fixed number of consumers. Like the async
+//    source, the helper goes on with the next pass at the end of the trace
+//    and stops after an empty pass. Instructions to skip are skipped by the
+//    helper before the first pass, as TraceReader::SeekToIcount would.
+//
+//    The helper only waits when every attached consumer has
+//    TRACE_BROADCAST_SLOTS batches queued, so a consumer is never held back
+//    by a slower one (the simulations of a multi-core trace set do not read
+//    their traces at the same relative pace, and a bound on the slowest
+//    consumer deadlocks them). The batches between the slowest and the
+//    fastest consumer stay in memory, up to TRACE_BROADCAST_MAX_BATCHES. When
+//    a consumer runs short with that many batches held, the consumers still
+//    on the oldest batch are dropped: each finishes the batch it is reading
+//    and goes on with its own reader of the trace, opened with the options
+//    of the run (a trace stream cannot be read again, so the run stops
+//    instead). A consumer whose simulation is over detaches and no longer
+//    holds any batch.
+// -----------------------------------------------------------------------------
+
+class TraceBroadcast {
+
+  friend class BroadcastTraceSource;
+
+  protected:
+
+    struct Batch {
+      uint32 count;
+      bool end;
+      TraceRecord records[TRACE_BROADCAST_BATCH];
+    };
+
+    // a consumer's position: the sequence number of its next batch. A
+    // dropped consumer keeps the batch it may be reading (pinned) until it
+    // moves to its own reader.
+    struct Tail {
+      uint64 value;
+      bool attached;
+      bool dropped;
+      Batch *pinned;
+    };
+
+    TraceSource *_source;
+    string _name;
+    TraceReaderOptions _options;
+
+    // batches _base to _head - 1, oldest first, and batches to reuse. All
+    // of the state below is protected by _lock; _notFull wakes the helper
+    // and _notEmpty the consumers.
+    deque <Batch *> _batches;
+    vector <Batch *> _free;
+    uint64 _base;
+    uint64 _head;
+    vector <Tail> _tails;
+    bool _stop;
+    bool _exited;
+    pthread_mutex_t _lock;
+    pthread_cond_t _notFull;
+    pthread_cond_t _notEmpty;
+
+    pthread_t _thread;
+    vector <BroadcastTraceSource *> _consumers;
+
+
+    // -------------------------------------------------------------------------
+    // Helper thread
+    // -------------------------------------------------------------------------
+
+    static void *Run(void *arg) {
+      ((TraceBroadcast *)arg) -> Produce();
+      return NULL;
+    }
+
+    // whether every attached consumer has enough batches queued
+    bool Full() {
+      for (uint32 i = 0; i < _tails.size(); i ++)
+        if (_tails[i].attached &&
+            _head - _tails[i].value < TRACE_BROADCAST_SLOTS)
+          return false;
+      return true;
+    }
+
+    bool Pinned(Batch *batch) {
+      for (uint32 i = 0; i < _tails.size(); i ++)
+        if (_tails[i].pinned == batch)
+          return true;
+      return false;
+    }
+
+    // recycle the batches no attached consumer still needs
+    void Trim() {
+      uint64 slowest = _head;
+      for (uint32 i = 0; i < _tails.size(); i ++)
+        if (_tails[i].attached && _tails[i].value < slowest)
+          slowest = _tails[i].value;
+      while (_base < slowest) {
+        if (!Pinned(_batches.front()))
+          _free.push_back(_batches.front());
+        _batches.pop_front();
+        _base ++;
+      }
+    }
+
+    // drop the consumers on the oldest batch, when the broadcast holds as
+    // many batches as it may
+    void DropSlowest() {
+      if (IsTraceStream(_name)) {
+        fprintf(stderr, "Error: a configuration is more than %u batches "
+            "behind on trace stream `%s', which cannot be read again; "
+            "simulate the configurations separately\n",
+            TRACE_BROADCAST_MAX_BATCHES, _name.c_str());
+        exit(-1);
+      }
+      for (uint32 i = 0; i < _tails.size(); i ++) {
+        if (_tails[i].attached && _tails[i].value == _base) {
+          _tails[i].attached = false;
+          _tails[i].dropped = true;
+          _tails[i].pinned = _batches.front();
+        }
+      }
+      Trim();
+      pthread_cond_broadcast(&_notEmpty);
+    }
+
+    // a batch no longer used by a dropped consumer (several consumers may
+    // have been dropped on the same batch)
+    void Unpin(uint32 index) {
+      Batch *batch = _tails[index].pinned;
+      _tails[index].pinned = NULL;
+      if (batch != NULL && !Pinned(batch))
+        _free.push_back(batch);
+    }
+
+    void Produce() {
+
+      TraceRecord first;
+      bool hasFirst = SkipToStart(_source, _name, _options.skip, first);
+      uint64 passRecords = 0;
+
+      pthread_mutex_lock(&_lock);
+      while (true) {
+
+        // wait until some consumer runs short, and make room for a batch
+        while (!_stop) {
+          if (Full())
+            pthread_cond_wait(&_notFull, &_lock);
+          else if (_head - _base >= TRACE_BROADCAST_MAX_BATCHES)
+            DropSlowest();
+          else
+            break;
+        }
+        if (_stop)
+          break;
+        Batch *batch;
+        if (_free.empty())
+          batch = new Batch;
+        else {
+          batch = _free.back();
+          _free.pop_back();
+        }
+        pthread_mutex_unlock(&_lock);
+
+        // fill the batch
+        batch -> count = 0;
+        batch -> end = false;
+        if (hasFirst) {
+          batch -> records[batch -> count ++] = first;
+          hasFirst = false;
+        }
+        batch -> count += _source -> NextBatch(batch -> records +
+            batch -> count, TRACE_BROADCAST_BATCH - batch -> count);
+        passRecords += batch -> count;
+        if (batch -> count < TRACE_BROADCAST_BATCH)
+          batch -> end = true;
+
+        // start the next pass
+        bool last = false;
+        if (batch -> end) {
+          if (passRecords == 0)
+            last = true;
+          else
+            _source -> Rewind();
+          passRecords = 0;
+        }
+
+        // publish the batch
+        pthread_mutex_lock(&_lock);
+        _batches.push_back(batch);
+        _head ++;
+        pthread_cond_broadcast(&_notEmpty);
+        if (last)
+          break;
+      }
+
+      _exited = true;
+      pthread_cond_broadcast(&_notEmpty);
+      pthread_mutex_unlock(&_lock);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Functions used by the consumers
+    // -------------------------------------------------------------------------
+
+    // wait for the next batch of a consumer; NULL if there is none or the
+    // consumer was dropped
+    Batch *Acquire(uint32 index, bool &dropped) {
+      pthread_mutex_lock(&_lock);
+      while (_head == _tails[index].value && !_exited &&
+          !_tails[index].dropped)
+        pthread_cond_wait(&_notEmpty, &_lock);
+      Batch *batch = NULL;
+      dropped = _tails[index].dropped;
+      if (dropped)
+        Unpin(index);
+      else if (_head != _tails[index].value)
+        batch = _batches[_tails[index].value - _base];
+      pthread_mutex_unlock(&_lock);
+      return batch;
+    }
+
+    // done with the current batch of a consumer; returns true if the
+    // consumer was dropped
+    bool Release(uint32 index) {
+      pthread_mutex_lock(&_lock);
+      bool dropped = _tails[index].dropped;
+      if (dropped)
+        Unpin(index);
+      else {
+        bool slowest = (_tails[index].value == _base);
+        _tails[index].value ++;
+        if (slowest)
+          Trim();
+        pthread_cond_signal(&_notFull);
+      }
+      pthread_mutex_unlock(&_lock);
+      return dropped;
+    }
+
+    void Detach(uint32 index) {
+      pthread_mutex_lock(&_lock);
+      if (_tails[index].attached) {
+        _tails[index].attached = false;
+        Trim();
+        pthread_cond_signal(&_notFull);
+      }
+      Unpin(index);
+      pthread_mutex_unlock(&_lock);
+    }
+
+    // a reader of the trace of its own for a dropped consumer
+    TraceSource *Reopen() {
+      TraceSource *source = OpenTraceReaderSource(_name, _options);
+      if (source == NULL) {
+        fprintf(stderr, "Error: cannot open `%s' again\n", _name.c_str());
+        exit(-1);
+      }
+      return source;
+    }
+
+  public:
+
+    // -------------------------------------------------------------------------
+    // Function to move a source to the first record of the first pass, past
+    // the instructions to skip (as TraceReader::SeekToIcount would). Returns
+    // false if there is no record.
+    // -------------------------------------------------------------------------
+
+    static bool SkipToStart(TraceSource *source, string name, uint64 skip,
+        TraceRecord &first) {
+      if (!source -> Next(first))
+        return false;
+      if (skip == 0)
+        return true;
+      uint64 target = first.icount + skip;
+      source -> Seek(target);
+      while (source -> Next(first))
+        if (first.icount >= target)
+          return true;
+      fprintf(stderr, "Warning: trace `%s' ends before icount %llu\n",
+          name.c_str(), skip);
+      source -> Rewind();
+      return source -> Next(first);
+    }
+
+    // -------------------------------------------------------------------------
+    // Constructor. Takes over the source and starts the helper. The options
+    // give the instructions to skip and are used to open the readers of the
+    // dropped consumers.
+    // -------------------------------------------------------------------------
+
+    TraceBroadcast(TraceSource *source, string name, uint32 numConsumers,
+        const TraceReaderOptions &options = TraceReaderOptions());
+
+    ~TraceBroadcast() {
+      pthread_mutex_lock(&_lock);
+      _stop = true;
+      pthread_cond_signal(&_notFull);
+      pthread_mutex_unlock(&_lock);
+      pthread_join(_thread, NULL);
+      pthread_cond_destroy(&_notEmpty);
+      pthread_cond_destroy(&_notFull);
+      pthread_mutex_destroy(&_lock);
+      for (uint32 i = 0; i < _batches.size(); i ++)
+        delete _batches[i];
+      for (uint32 i = 0; i < _tails.size(); i ++)
+        Unpin(i);
+      for (uint32 i = 0; i < _free.size(); i ++)
+        delete _free[i];
+      delete _source;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to return the source of a consumer. It is owned by the
+    // caller and must not outlive the broadcast.
+    // -------------------------------------------------------------------------
+
+    BroadcastTraceSource *Consumer(uint32 index) {
+      return _consumers[index];
+    }
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: BroadcastTraceSource
+// Description:
+//    One consumer of a broadcast. It cannot go back on its own: rewinding at
+//    the end of the trace moves on to the next pass the helper reads, and
+//    rewinding or seeking anywhere else does nothing (the reader then reads
+//    forward, which is what a seek at the start needs). Once dropped, it
+//    reads its own source from the record after the last one it returned.
+// -----------------------------------------------------------------------------
+
+class BroadcastTraceSource : public TraceSource {
+
+  protected:
+
+    TraceBroadcast *_broadcast;
+    uint32 _index;
+    bool _detached;
+
+    // batch being read
+    TraceBroadcast::Batch *_current;
+    uint32 _pos;
+    bool _atEnd;
+
+    // position in the trace: the pass, the records returned in it, the last
+    // one and how many in a row had its icount
+    uint64 _pass;
+    uint64 _passRecords;
+    TraceRecord _last;
+    uint64 _lastRun;
+
+    // own source once dropped, and a record read ahead from it
+    TraceSource *_own;
+    TraceRecord _pending;
+    bool _hasPending;
+
+
+    // -------------------------------------------------------------------------
+    // Function to open the own source and move it after the last record
+    // returned. Traces are in icount order, so it is past the records with a
+    // lower icount and the first _lastRun records with the same one.
+    // -------------------------------------------------------------------------
+
+    void FallBack() {
+      _own = _broadcast -> Reopen();
+      _current = NULL;
+      _hasPending = false;
+
+      // at the start of a pass (past the skipped instructions in the first)
+      if (_passRecords == 0) {
+        if (_pass == 0)
+          _hasPending = TraceBroadcast::SkipToStart(_own,
+              _broadcast -> _name, _broadcast -> _options.skip, _pending);
+        return;
+      }
+
+      _own -> Seek(_last.icount);
+      uint64 run = 0;
+      while (_own -> Next(_pending)) {
+        if (_pending.icount < _last.icount)
+          continue;
+        if (_pending.icount == _last.icount && run < _lastRun) {
+          run ++;
+          continue;
+        }
+        _hasPending = true;
+        return;
+      }
+    }
+
+    // a record returned from the broadcast
+    void Returned(const TraceRecord &record) {
+      if (_passRecords > 0 && record.icount == _last.icount)
+        _lastRun ++;
+      else
+        _lastRun = 1;
+      _last = record;
+      _passRecords ++;
+    }
+
+  public:
+
+    BroadcastTraceSource(TraceBroadcast *broadcast, uint32 index) {
+      _broadcast = broadcast;
+      _index = index;
+      _detached = false;
+      _current = NULL;
+      _pos = 0;
+      _atEnd = false;
+      _pass = 0;
+      _passRecords = 0;
+      _lastRun = 0;
+      _own = NULL;
+      _hasPending = false;
+    }
+
+    ~BroadcastTraceSource() {
+      Detach();
+      delete _own;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to stop reading the broadcast, when the simulation is over.
+    // Nothing can be read afterwards.
+    // -------------------------------------------------------------------------
+
+    void Detach() {
+      if (_detached) return;
+      _broadcast -> Detach(_index);
+      _detached = true;
+      _current = NULL;
+      _atEnd = true;
+    }
+
+    // whether the consumer reads its own source
+    bool Dropped() {
+      return _own != NULL;
+    }
+
+    bool Next(TraceRecord &record) {
+
+      if (_atEnd)
+        return false;
+
+      if (_own != NULL) {
+        if (_hasPending) {
+          record = _pending;
+          _hasPending = false;
+          return true;
+        }
+        return _own -> Next(record);
+      }
+
+      while (true) {
+
+        // get the next batch
+        if (_current == NULL) {
+          bool dropped;
+          _current = _broadcast -> Acquire(_index, dropped);
+          if (dropped) {
+            FallBack();
+            return Next(record);
+          }
+          if (_current == NULL)
+            return false;
+          _pos = 0;
+        }
+
+        if (_pos < _current -> count) {
+          record = _current -> records[_pos ++];
+          Returned(record);
+          return true;
+        }
+
+        // release the batch
+        bool end = _current -> end;
+        _current = NULL;
+        if (end) {
+          _pass ++;
+          _passRecords = 0;
+          _lastRun = 0;
+        }
+        if (_broadcast -> Release(_index))
+          FallBack();
+        if (end) {
+          _atEnd = true;
+          return false;
+        }
+        if (_own != NULL)
+          return Next(record);
+      }
+    }
+
+    void Rewind() {
+      if (_detached)
+        return;
+      _atEnd = false;
+      if (_own != NULL && !_hasPending)
+        _own -> Rewind();
+    }
+
+    void Seek(uint64) {
+    }
+};
+
+
+// -----------------------------------------------------------------------------
+// TraceBroadcast constructor (needs the consumer class)
+// -----------------------------------------------------------------------------
+
+inline TraceBroadcast::TraceBroadcast(TraceSource *source, string name,
+    uint32 numConsumers, const TraceReaderOptions &options) {
+  _source = source;
+  _name = name;
+  _options = options;
+  _base = 0;
+  _head = 0;
+  _tails.resize(numConsumers);
+  for (uint32 i = 0; i < numConsumers; i ++) {
+    _tails[i].value = 0;
+    _tails[i].attached = true;
+    _tails[i].dropped = false;
+    _tails[i].pinned = NULL;
+    _consumers.push_back(new BroadcastTraceSource(this, i));
+  }
+  _stop = false;
+  _exited = false;
+  pthread_mutex_init(&_lock, NULL);
+  pthread_cond_init(&_notFull, NULL);
+  pthread_cond_init(&_notEmpty, NULL);
+  if (pthread_create(&_thread, NULL, Run, this) != 0) {
+    fprintf(stderr, "Error: cannot create the trace broadcast thread\n");
+    exit(-1);
+  }
+}
+
+#endif // __TRACE_BROADCAST_H__
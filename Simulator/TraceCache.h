@@ -0,0 +1,282 @@
+// -----------------------------------------------------------------------------
+// File: TraceCache.h
+// Description:
+//    Defines the decoded trace cache. The first time a trace is read through
+//    the cache it is decoded once into a file of fixed size records under the
+//    cache folder; later runs map that file read-only and hand out its
+//    records without decompressing or parsing anything. The cache file is
+//    named after the source path, modification time and size, so a changed
+//    trace gets a new entry. Processes reading the same trace share the
+//    mapped pages.
+// -----------------------------------------------------------------------------
+
+#ifndef __TRACE_CACHE_H__
+#define __TRACE_CACHE_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "Types.h"
+#include "TraceFormat.h"
+#include "TraceSource.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <climits>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+#define TRACE_CACHE_MAGIC "MSTCACHE"
+#define TRACE_CACHE_VERSION 1
+// the header takes a page so that the records are page aligned
+#define TRACE_CACHE_HEADER_SIZE 4096
+#define TRACE_CACHE_MAX_PATH (TRACE_CACHE_HEADER_SIZE - 64)
+
+
+// -----------------------------------------------------------------------------
+// Structure: TraceCacheHeader
+// Description:
+//    Header of a cache file. It repeats the key of the entry so that a hash
+//    collision is detected.
+// -----------------------------------------------------------------------------
+
+struct TraceCacheHeader {
+  char magic[8];
+  uint32 version;
+  uint32 recordSize;
+  uint64 count;
+  uint64 mtime;
+  uint64 size;
+  uint32 pathLength;
+  uint32 unused;
+  char path[TRACE_CACHE_MAX_PATH];
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: MappedTraceSource
+// Description:
+//    Hands out the records of a mapped cache file
+// -----------------------------------------------------------------------------
+
+class MappedTraceSource : public TraceSource {
+
+  protected:
+
+    void *_map;
+    size_t _length;
+    const TraceRecord *_records;
+    uint64 _count;
+    uint64 _next;
+
+  public:
+
+    MappedTraceSource(void *map, size_t length) {
+      _map = map;
+      _length = length;
+      const TraceCacheHeader *header = (const TraceCacheHeader *)map;
+      _records = (const TraceRecord *)((char *)map + TRACE_CACHE_HEADER_SIZE);
+      _count = header -> count;
+      _next = 0;
+    }
+
+    ~MappedTraceSource() {
+      munmap(_map, _length);
+    }
+
+    bool Next(TraceRecord &record) {
+      if (_next == _count)
+        return false;
+      record = _records[_next ++];
+      return true;
+    }
+
+    void Rewind() {
+      _next = 0;
+    }
+
+    void Seek(uint64 icount) {
+      // first record with at least the icount
+      uint64 lo = 0, hi = _count;
+      while (lo < hi) {
+        uint64 mid = (lo + hi) / 2;
+        if (_records[mid].icount < icount)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      _next = lo;
+    }
+};
+
+
+// -----------------------------------------------------------------------------
+// Function to fill in the key of a trace. Returns false if the trace cannot
+// be found.
+// -----------------------------------------------------------------------------
+
+inline bool TraceCacheKey(string fileName, TraceCacheHeader &header) {
+
+  char resolved[PATH_MAX];
+  struct stat info;
+  if (realpath(fileName.c_str(), resolved) == NULL ||
+      stat(resolved, &info) != 0 || strlen(resolved) >= TRACE_CACHE_MAX_PATH)
+    return false;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TRACE_CACHE_MAGIC, 8);
+  header.version = TRACE_CACHE_VERSION;
+  header.recordSize = sizeof(TraceRecord);
+  header.mtime = (uint64)info.st_mtim.tv_sec * 1000000000ULL +
+    info.st_mtim.tv_nsec;
+  header.size = info.st_size;
+  header.pathLength = strlen(resolved);
+  memcpy(header.path, resolved, header.pathLength);
+  return true;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to return the cache file name of a key (FNV-1a hash of the key)
+// -----------------------------------------------------------------------------
+
+inline string TraceCacheFileName(string folder, const TraceCacheHeader &key) {
+  uint64 hash = 14695981039346656037ULL;
+  const uint8 *bytes[3] = { (const uint8 *)key.path,
+                            (const uint8 *)&key.mtime,
+                            (const uint8 *)&key.size };
+  uint32 lengths[3] = { key.pathLength, 8, 8 };
+  for (uint32 f = 0; f < 3; f ++)
+    for (uint32 i = 0; i < lengths[f]; i ++) {
+      hash ^= bytes[f][i];
+      hash *= 1099511628211ULL;
+    }
+  char name[32];
+  sprintf(name, "/%016llx.rec", hash);
+  return folder + name;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to map a cache file. Returns NULL if it is missing or does not
+// match the key.
+// -----------------------------------------------------------------------------
+
+inline TraceSource *MapTraceCache(string cacheFileName,
+    const TraceCacheHeader &key) {
+
+  int fd = open(cacheFileName.c_str(), O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size < TRACE_CACHE_HEADER_SIZE) {
+    close(fd);
+    return NULL;
+  }
+
+  size_t length = info.st_size;
+  void *map = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return NULL;
+
+  const TraceCacheHeader *header = (const TraceCacheHeader *)map;
+  if (memcmp(header, &key, offsetof(TraceCacheHeader, count)) != 0 ||
+      header -> mtime != key.mtime || header -> size != key.size ||
+      header -> pathLength != key.pathLength ||
+      memcmp(header -> path, key.path, key.pathLength) != 0 ||
+      length != TRACE_CACHE_HEADER_SIZE + header -> count * sizeof(TraceRecord)) {
+    munmap(map, length);
+    return NULL;
+  }
+
+  madvise(map, length, MADV_SEQUENTIAL);
+  return new MappedTraceSource(map, length);
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to decode a trace into a cache file. The file is written under a
+// temporary name and renamed into place, so concurrent runs never see a
+// partial entry. Returns false on failure.
+// -----------------------------------------------------------------------------
+
+inline bool BuildTraceCache(string fileName, string cacheFileName,
+    TraceCacheHeader key) {
+
+  TraceSource *source = OpenTraceSource(fileName);
+  if (source == NULL)
+    return false;
+
+  char suffix[32];
+  sprintf(suffix, ".tmp.%d", (int)getpid());
+  string tempFileName = cacheFileName + suffix;
+  FILE *file = fopen(tempFileName.c_str(), "wb");
+  if (file == NULL) {
+    delete source;
+    return false;
+  }
+
+  // header (the count is filled in at the end)
+  char page[TRACE_CACHE_HEADER_SIZE];
+  memset(page, 0, sizeof(page));
+  bool ok = fwrite(page, sizeof(page), 1, file) == 1;
+
+  TraceRecord record;
+  key.count = 0;
+  while (ok && source -> Next(record)) {
+    ok = fwrite(&record, sizeof(record), 1, file) == 1;
+    key.count ++;
+  }
+  delete source;
+
+  memcpy(page, &key, sizeof(key));
+  ok = ok && fseek(file, 0, SEEK_SET) == 0 &&
+    fwrite(page, sizeof(page), 1, file) == 1;
+  ok = (fclose(file) == 0) && ok;
+
+  if (!ok || rename(tempFileName.c_str(), cacheFileName.c_str()) != 0) {
+    unlink(tempFileName.c_str());
+    return false;
+  }
+  return true;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to open a trace through the cache. Returns NULL if the cache
+// cannot be used for the trace.
+// -----------------------------------------------------------------------------
+
+inline TraceSource *OpenCachedTraceSource(string fileName, string folder) {
+
+  TraceCacheHeader key;
+  if (!TraceCacheKey(fileName, key))
+    return NULL;
+
+  string cacheFileName = TraceCacheFileName(folder, key);
+  TraceSource *source = MapTraceCache(cacheFileName, key);
+  if (source != NULL)
+    return source;
+
+  mkdir(folder.c_str(), 0777);
+  if (!BuildTraceCache(fileName, cacheFileName, key))
+    return NULL;
+  return MapTraceCache(cacheFileName, key);
+}
+
+#endif // __TRACE_CACHE_H__
@@ -0,0 +1,166 @@
+// -----------------------------------------------------------------------------
+// File: TraceConvert.cc
+// Description:
+//    Converts a trace between the text, binary and chunked formats. The input
+//    format is detected from the file, the output format is given by --to
+//    (binary by default).
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "TraceSource.h"
+#include "TraceFormat.h"
+#include "ChunkedTrace.h"
+#include "Types.h"
+
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <getopt.h>
+#include <zlib.h>
+
+using namespace std;
+
+
+// -----------------------------------------------------------------------------
+// Function: usage
+// -----------------------------------------------------------------------------
+
+void usage(char *name) {
+  cerr << "Usage: " << name << " [--to binary|chunked|text] [--core <id>] "
+       << "[--block-size <bytes>] [--frame-records <n>] <input> <output>"
+       << endl;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function: main
+// -----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+
+  // ---------------------------------------------------------------------------
+  // Get the command line arguments
+  // ---------------------------------------------------------------------------
+
+  string to("binary");
+  TraceHeader header;
+  uint32 frameRecords = CHUNKED_TRACE_FRAME_RECORDS;
+
+  struct option cmd_options[] = {
+    {"to", required_argument, 0, 't'},
+    {"core", required_argument, 0, 'c'},
+    {"block-size", required_argument, 0, 'b'},
+    {"frame-records", required_argument, 0, 'f'},
+    {0, 0, 0, 0}
+  };
+
+  int c;
+  int optindex = 0;
+
+  while ((c = getopt_long(argc, argv, "t:c:b:f:", cmd_options, &optindex)) != -1) {
+
+    switch(c) {
+
+      case 't':
+        to = optarg;
+        break;
+
+      case 'c':
+        header.coreID = atoi(optarg);
+        break;
+
+      case 'b':
+        header.blockSize = atoi(optarg);
+        break;
+
+      case 'f':
+        frameRecords = atoi(optarg);
+        break;
+
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if (argc - optind != 2 || frameRecords == 0 ||
+      (to != "binary" && to != "chunked" && to != "text")) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  string input = argv[optind];
+  string output = argv[optind + 1];
+
+  // ---------------------------------------------------------------------------
+  // Open the input and the output
+  // ---------------------------------------------------------------------------
+
+  TraceSource *source = OpenTraceSource(input);
+  if (source == NULL) {
+    cerr << "Error: cannot open `" << input << "'" << endl;
+    return 1;
+  }
+
+  BinaryTraceWriter writer;
+  ChunkedTraceWriter chunked;
+  gzFile text = Z_NULL;
+
+  if (to == "binary") {
+    if (!writer.Open(output, header)) {
+      cerr << "Error: cannot create `" << output << "'" << endl;
+      return 1;
+    }
+  }
+  else if (to == "chunked") {
+    if (!chunked.Open(output, header, frameRecords)) {
+      cerr << "Error: cannot create `" << output << "'" << endl;
+      return 1;
+    }
+  }
+  else {
+    text = gzopen64(output.c_str(), "w");
+    if (text == Z_NULL) {
+      cerr << "Error: cannot create `" << output << "'" << endl;
+      return 1;
+    }
+  }
+
+  // ---------------------------------------------------------------------------
+  // Copy the records
+  // ---------------------------------------------------------------------------
+
+  TraceRecord record;
+  uint64 count = 0;
+
+  while (source -> Next(record)) {
+    if (to == "binary")
+      writer.Write(record);
+    else if (to == "chunked")
+      chunked.Write(record);
+    else
+      gzprintf(text, "%llu %llu %llu %llu %u %u\n", record.icount,
+          record.ip, record.virtualAddress, record.physicalAddress,
+          record.size, record.type);
+    count ++;
+  }
+
+  writer.Close();
+  chunked.Close();
+  if (text != Z_NULL)
+    gzclose(text);
+  delete source;
+
+  cerr << count << " records written to " << output << endl;
+  return 0;
+}
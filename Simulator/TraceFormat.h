@@ -0,0 +1,342 @@
+// -----------------------------------------------------------------------------
+// File: TraceFormat.h
+// Description:
+//    Defines the raw trace record and the binary trace format. A binary trace
+//    holds the records of one core. It starts with a fixed header (magic,
+//    version, block size and core id) followed by the records, each coded
+//    against the previous one: a control byte, then the icount, IP and
+//    address deltas as zigzag varints and the size and type only when they
+//    change or do not fit the control byte. The whole stream is usually
+//    gzip compressed.
+// -----------------------------------------------------------------------------
+
+#ifndef __TRACE_FORMAT_H__
+#define __TRACE_FORMAT_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "Types.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <zlib.h>
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+
+// -----------------------------------------------------------------------------
+// Structure: TraceRecord
+// Description:
+//    One entry of a trace, as found in the file
+//    (<ICOUNT> <IP> <VADDR> <PADDR> <SIZE> <TYPE> in the text format)
+// -----------------------------------------------------------------------------
+
+struct TraceRecord {
+  uint64 icount;
+  addr_t ip;
+  addr_t virtualAddress;
+  addr_t physicalAddress;
+  uint32 size;
+  uint32 type;
+};
+
+
+// -----------------------------------------------------------------------------
+// Binary format constants
+// -----------------------------------------------------------------------------
+
+#define TRACE_BINARY_MAGIC "MSBTRACE"
+#define TRACE_BINARY_MAGIC_SIZE 8
+#define TRACE_BINARY_VERSION 1
+#define TRACE_BINARY_HEADER_SIZE 24
+
+// largest coded record (control byte, four 10 byte varints, two 5 byte ones)
+#define TRACE_RECORD_MAX_BYTES 51
+
+// control byte
+#define TRACE_CTL_TYPE_MASK 0x0F
+#define TRACE_CTL_TYPE_ESCAPE 0x0F
+#define TRACE_CTL_SAME_SIZE 0x10
+#define TRACE_CTL_SAME_IP 0x20
+#define TRACE_CTL_SAME_OFFSET 0x40
+
+
+// -----------------------------------------------------------------------------
+// Structure: TraceHeader
+// Description:
+//    Header of a binary trace. Fields are stored little endian.
+// -----------------------------------------------------------------------------
+
+struct TraceHeader {
+  uint32 version;
+  uint32 blockSize;
+  uint32 coreID;
+  uint32 flags;
+
+  TraceHeader() {
+    version = TRACE_BINARY_VERSION;
+    blockSize = 64;
+    coreID = 0;
+    flags = 0;
+  }
+
+  void Write(uint8 *out) const {
+    memcpy(out, TRACE_BINARY_MAGIC, TRACE_BINARY_MAGIC_SIZE);
+    uint32 fields[4] = { version, blockSize, coreID, flags };
+    for (uint32 i = 0; i < 4; i ++)
+      for (uint32 b = 0; b < 4; b ++)
+        out[TRACE_BINARY_MAGIC_SIZE + 4 * i + b] = (fields[i] >> (8 * b)) & 0xFF;
+  }
+
+  // returns false if the magic does not match
+  bool Read(const uint8 *in) {
+    if (memcmp(in, TRACE_BINARY_MAGIC, TRACE_BINARY_MAGIC_SIZE) != 0)
+      return false;
+    uint32 fields[4];
+    for (uint32 i = 0; i < 4; i ++) {
+      fields[i] = 0;
+      for (uint32 b = 0; b < 4; b ++)
+        fields[i] |= (uint32)in[TRACE_BINARY_MAGIC_SIZE + 4 * i + b] << (8 * b);
+    }
+    version = fields[0];
+    blockSize = fields[1];
+    coreID = fields[2];
+    flags = fields[3];
+    return true;
+  }
+};
+
+
+// -----------------------------------------------------------------------------
+// Varint helpers
+// -----------------------------------------------------------------------------
+
+inline uint32 PutVarint(uint8 *out, uint64 value) {
+  uint32 n = 0;
+  while (value >= 0x80) {
+    out[n ++] = (uint8)(value | 0x80);
+    value >>= 7;
+  }
+  out[n ++] = (uint8)value;
+  return n;
+}
+
+// returns the number of bytes read, 0 if the varint runs past end
+inline uint32 GetVarint(const uint8 *in, const uint8 *end, uint64 &value) {
+  uint64 result = 0;
+  uint32 shift = 0;
+  const uint8 *p = in;
+  while (p < end && shift < 64) {
+    uint8 byte = *(p ++);
+    result |= (uint64)(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      value = result;
+      return p - in;
+    }
+    shift += 7;
+  }
+  return 0;
+}
+
+inline uint64 ZigZag(uint64 delta) {
+  return (delta << 1) ^ (uint64)((int64)delta >> 63);
+}
+
+inline uint64 UnZigZag(uint64 value) {
+  return (value >> 1) ^ (uint64)(-(int64)(value & 1));
+}
+
+
+// -----------------------------------------------------------------------------
+// Class: TraceDeltaCoder
+// Description:
+//    Codes records against the previous record of the same stream. The
+//    encoder and the decoder must see the same records from a Reset.
+// -----------------------------------------------------------------------------
+
+class TraceDeltaCoder {
+
+  protected:
+
+    TraceRecord _last;
+    uint64 _lastOffset;
+
+  public:
+
+    TraceDeltaCoder() {
+      Reset();
+    }
+
+    void Reset() {
+      memset(&_last, 0, sizeof(_last));
+      _lastOffset = 0;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to code a record. Returns the number of bytes written (at most
+    // TRACE_RECORD_MAX_BYTES).
+    // -------------------------------------------------------------------------
+
+    uint32 Encode(const TraceRecord &record, uint8 *out) {
+
+      uint64 offset = record.physicalAddress - record.virtualAddress;
+      uint8 ctl = (record.type < TRACE_CTL_TYPE_ESCAPE) ? record.type :
+        TRACE_CTL_TYPE_ESCAPE;
+      if (record.size == _last.size) ctl |= TRACE_CTL_SAME_SIZE;
+      if (record.ip == _last.ip) ctl |= TRACE_CTL_SAME_IP;
+      if (offset == _lastOffset) ctl |= TRACE_CTL_SAME_OFFSET;
+
+      uint32 n = 0;
+      out[n ++] = ctl;
+      n += PutVarint(out + n, ZigZag(record.icount - _last.icount));
+      if (!(ctl & TRACE_CTL_SAME_IP))
+        n += PutVarint(out + n, ZigZag(record.ip - _last.ip));
+      n += PutVarint(out + n,
+          ZigZag(record.virtualAddress - _last.virtualAddress));
+      if (!(ctl & TRACE_CTL_SAME_OFFSET))
+        n += PutVarint(out + n, ZigZag(offset - _lastOffset));
+      if (!(ctl & TRACE_CTL_SAME_SIZE))
+        n += PutVarint(out + n, record.size);
+      if ((ctl & TRACE_CTL_TYPE_MASK) == TRACE_CTL_TYPE_ESCAPE)
+        n += PutVarint(out + n, record.type);
+
+      _last = record;
+      _lastOffset = offset;
+      return n;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to decode a record. Returns the number of bytes read, 0 if the
+    // record runs past end.
+    // -------------------------------------------------------------------------
+
+    uint32 Decode(const uint8 *in, const uint8 *end, TraceRecord &record) {
+
+      if (in >= end) return 0;
+
+      const uint8 *p = in;
+      uint8 ctl = *(p ++);
+      uint64 value;
+      uint32 n;
+
+      TraceRecord next = _last;
+      uint64 offset = _lastOffset;
+
+#define TRACE_GET_VARINT \
+      if ((n = GetVarint(p, end, value)) == 0) return 0; \
+      p += n;
+
+      TRACE_GET_VARINT;
+      next.icount = _last.icount + UnZigZag(value);
+      if (!(ctl & TRACE_CTL_SAME_IP)) {
+        TRACE_GET_VARINT;
+        next.ip = _last.ip + UnZigZag(value);
+      }
+      TRACE_GET_VARINT;
+      next.virtualAddress = _last.virtualAddress + UnZigZag(value);
+      if (!(ctl & TRACE_CTL_SAME_OFFSET)) {
+        TRACE_GET_VARINT;
+        offset = _lastOffset + UnZigZag(value);
+      }
+      next.physicalAddress = next.virtualAddress + offset;
+      if (!(ctl & TRACE_CTL_SAME_SIZE)) {
+        TRACE_GET_VARINT;
+        next.size = (uint32)value;
+      }
+      next.type = ctl & TRACE_CTL_TYPE_MASK;
+      if (next.type == TRACE_CTL_TYPE_ESCAPE) {
+        TRACE_GET_VARINT;
+        next.type = (uint32)value;
+      }
+
+#undef TRACE_GET_VARINT
+
+      _last = next;
+      _lastOffset = offset;
+      record = next;
+      return p - in;
+    }
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: BinaryTraceWriter
+// Description:
+//    Writes a binary trace (gzip compressed)
+// -----------------------------------------------------------------------------
+
+class BinaryTraceWriter {
+
+  protected:
+
+    gzFile _trace;
+    TraceDeltaCoder _coder;
+    uint8 _buffer[1 << 16];
+    uint32 _used;
+
+    void Flush() {
+      if (_used > 0)
+        gzwrite(_trace, _buffer, _used);
+      _used = 0;
+    }
+
+  public:
+
+    BinaryTraceWriter() {
+      _trace = Z_NULL;
+      _used = 0;
+    }
+
+    ~BinaryTraceWriter() {
+      Close();
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to open a trace. Returns false if the file cannot be created.
+    // -------------------------------------------------------------------------
+
+    bool Open(string fileName, const TraceHeader &header) {
+      Close();
+      _trace = gzopen64(fileName.c_str(), "wb");
+      if (_trace == Z_NULL)
+        return false;
+      _coder.Reset();
+      header.Write(_buffer);
+      _used = TRACE_BINARY_HEADER_SIZE;
+      return true;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to add a record
+    // -------------------------------------------------------------------------
+
+    void Write(const TraceRecord &record) {
+      if (_used + TRACE_RECORD_MAX_BYTES > sizeof(_buffer))
+        Flush();
+      _used += _coder.Encode(record, _buffer + _used);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to close the trace
+    // -------------------------------------------------------------------------
+
+    void Close() {
+      if (_trace == Z_NULL) return;
+      Flush();
+      gzclose(_trace);
+      _trace = Z_NULL;
+    }
+};
+
+#endif // __TRACE_FORMAT_H__
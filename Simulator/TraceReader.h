@@ -1,7 +1,9 @@
 // -----------------------------------------------------------------------------
 // File: TraceReader.h
 // Description:
-//    Defines a reader for trace files. It can handle trace I generated.
+//    Defines a reader for trace files. It can handle trace I generated, in
+//    the text, binary or chunked format, or streamed from a producer process
+//    (see TraceSource.h).
 // -----------------------------------------------------------------------------
 
 #ifndef __TRACE_READER_H__
@@ -13,6 +15,9 @@
 
 #include "Types.h"
 #include "MemoryRequest.h"
+#include "TraceSource.h"
+#include "AsyncTraceSource.h"
+#include "TraceCache.h"
 
 // -----------------------------------------------------------------------------
 // Standard includes
@@ -22,6 +27,56 @@
 #include <stdio.h>
 #include <string>
 
+// records the reader takes from its source at a time
+#define TRACE_READER_BATCH 256
+
+// -----------------------------------------------------------------------------
+// Structure: TraceReaderOptions
+// Description:
+//    Options for how traces are read
+// -----------------------------------------------------------------------------
+
+struct TraceReaderOptions {
+  // decode the trace on a helper thread
+  bool async;
+  // folder of the decoded trace cache (none if empty)
+  string cacheFolder;
+  // instructions to skip at the start of the trace
+  uint64 skip;
+
+  TraceReaderOptions() {
+    async = false;
+    skip = 0;
+  }
+};
+
+
+// -----------------------------------------------------------------------------
+// Function to open the source of a trace as the options say: through the
+// cache if there is one (a cached trace has nothing left to decode, so it is
+// never read on a helper), else directly and possibly on a helper. Returns
+// NULL if the trace cannot be opened.
+// -----------------------------------------------------------------------------
+
+inline TraceSource *OpenTraceReaderSource(string traceFileName,
+    const TraceReaderOptions &options) {
+
+  if (options.cacheFolder.size() > 0 && !IsTraceStream(traceFileName)) {
+    TraceSource *source = OpenCachedTraceSource(traceFileName,
+        options.cacheFolder);
+    if (source != NULL)
+      return source;
+    fprintf(stderr, "Warning: cannot cache trace `%s' in `%s'\n",
+        traceFileName.c_str(), options.cacheFolder.c_str());
+  }
+
+  TraceSource *source = OpenTraceSource(traceFileName);
+  if (source != NULL && options.async)
+    source = new AsyncTraceSource(source);
+  return source;
+}
+
+
 // -----------------------------------------------------------------------------
 // Class: TraceReader
 // Description:
@@ -45,13 +100,30 @@ class TraceReader {
     // -------------------------------------------------------------------------
 
     bool _noTrace;
-    gzFile _trace;
+    TraceSource *_source;
     uint64 _startIcount;
     uint64 _lastIcount;
     uint64 _icountShift;
     uint64 _cycleShift;
     bool _first;
 
+    // record found by a seek, returned before the source is read again
+    TraceRecord _pending;
+    bool _hasPending;
+
+    // records read ahead from the source, and whether the source has
+    // reached the end of the trace
+    TraceRecord _batch[TRACE_READER_BATCH];
+    uint32 _batchPos;
+    uint32 _batchCount;
+    bool _batchEnd;
+
+    // icount of the last record returned since the start of the pass, and
+    // the number of records returned with it (where a restored reader goes
+    // back to)
+    uint64 _lastRaw;
+    uint32 _lastRawRepeat;
+
     // -------------------------------------------------------------------------
     // Normalize the address
     // -------------------------------------------------------------------------
@@ -60,14 +132,44 @@ class TraceReader {
       return (val + ((addr_t)(_cpuID) << shift));
     }
 
-  public:
+    // -------------------------------------------------------------------------
+    // Function to get the next raw record
+    // -------------------------------------------------------------------------
 
+    bool NextRecord(TraceRecord &record) {
+      if (_hasPending) {
+        _hasPending = false;
+        record = _pending;
+        return true;
+      }
+      if (_batchPos == _batchCount) {
+        if (_batchEnd)
+          return false;
+        _batchCount = _source -> NextBatch(_batch, TRACE_READER_BATCH);
+        _batchPos = 0;
+        _batchEnd = (_batchCount < TRACE_READER_BATCH);
+        if (_batchCount == 0)
+          return false;
+      }
+      record = _batch[_batchPos ++];
+      return true;
+    }
 
     // -------------------------------------------------------------------------
-    // Constructor with options
+    // Function to drop the records read ahead (when the source moves)
+    // -------------------------------------------------------------------------
+
+    void ClearBatch() {
+      _batchPos = _batchCount = 0;
+      _batchEnd = false;
+    }
+
+    // -------------------------------------------------------------------------
+    // Function to initialize the members
     // -------------------------------------------------------------------------
 
-    TraceReader(string traceFileName, uint32 cpuID, bool wrapAround) {
+    void Initialize(string traceFileName, uint32 cpuID, bool wrapAround,
+        TraceSource *source, const TraceReaderOptions &options) {
       // update members
       _traceFileName = traceFileName;
       _cpuID = cpuID;
@@ -77,13 +179,95 @@ class TraceReader {
       _cycleShift = 0;
       _noTrace = false;
       _first = true;
+      _hasPending = false;
+      _lastRaw = 0;
+      _lastRawRepeat = 0;
+      ClearBatch();
 
-      // open the trace file
-      _trace = gzopen64(_traceFileName.c_str(), "r");
-      if (_trace == Z_NULL) {
+      _source = source;
+      if (_source == NULL) {
         _noTrace = true;
         // TODO: Error message
       }
+
+      if (options.skip > 0)
+        SeekToIcount(options.skip);
+    }
+
+  public:
+
+
+    // -------------------------------------------------------------------------
+    // Constructor with options
+    // -------------------------------------------------------------------------
+
+    TraceReader(string traceFileName, uint32 cpuID, bool wrapAround,
+        const TraceReaderOptions &options = TraceReaderOptions()) {
+      Initialize(traceFileName, cpuID, wrapAround,
+          OpenTraceReaderSource(traceFileName, options), options);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Constructor reading an already open source (owned by the reader). The
+    // file name is only used in messages.
+    // -------------------------------------------------------------------------
+
+    TraceReader(TraceSource *source, string traceFileName, uint32 cpuID,
+        bool wrapAround,
+        const TraceReaderOptions &options = TraceReaderOptions()) {
+      Initialize(traceFileName, cpuID, wrapAround, source, options);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Destructor
+    // -------------------------------------------------------------------------
+
+    ~TraceReader() {
+      delete _source;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to skip the given number of instructions from the start of the
+    // trace. The first request after the seek gets icount 1, as if the trace
+    // started there. Chunked traces and the cache jump to the position; other
+    // sources are read up to it. Wrapping around goes back to the start of
+    // the trace, not to the seek position.
+    // -------------------------------------------------------------------------
+
+    void SeekToIcount(uint64 icount) {
+
+      if (_noTrace)
+        return;
+
+      _first = true;
+      _icountShift = 0;
+      _hasPending = false;
+      _lastRaw = 0;
+      _lastRawRepeat = 0;
+      ClearBatch();
+
+      // the icount is relative to the first record
+      TraceRecord record;
+      _source -> Rewind();
+      if (!_source -> Next(record))
+        return;
+      uint64 target = record.icount + icount;
+
+      _source -> Seek(target);
+      while (_source -> Next(record)) {
+        if (record.icount >= target) {
+          _pending = record;
+          _hasPending = true;
+          return;
+        }
+      }
+
+      fprintf(stderr, "Warning: trace `%s' ends before icount %llu\n",
+          _traceFileName.c_str(), icount);
+      _source -> Rewind();
     }
 
 
@@ -97,34 +281,31 @@ class TraceReader {
       if (_noTrace)
         return NULL;
 
-      char line[300];
-      char *ret;
-
-      // read a line from the trace
-      ret = gzgets(_trace, line, 300);
+      TraceRecord record;
 
       // if there is a valid entry
-      if (ret != Z_NULL) {
+      if (NextRecord(record)) {
+        if (_lastRawRepeat > 0 && record.icount == _lastRaw)
+          _lastRawRepeat ++;
+        else {
+          _lastRaw = record.icount;
+          _lastRawRepeat = 1;
+        }
+
         MemoryRequest *request;
-        // create a new request and obtain the details
+        // create a new request and fill in the details
         request = new MemoryRequest;
-
-        // scan the line and fill the request
-        /* sscanf(line, "%u %llu %llu %llu %llu %llu %u %c",
-            &(request -> cpuID), &(request -> currentCycle), 
-            &(request -> icount), &(request -> ip), &(request -> virtualAddress),
-            &(request -> physicalAddress), &(request -> size), &type); */
-        uint32 type;
-        sscanf(line, "%llu %llu %llu %llu %u %u", &(request -> icount),
-            &(request -> ip), &(request -> virtualAddress), 
-            &(request -> physicalAddress), &(request -> size), 
-            &(type));
+        request -> icount = record.icount;
+        request -> ip = record.ip;
+        request -> virtualAddress = record.virtualAddress;
+        request -> physicalAddress = record.physicalAddress;
+        request -> size = record.size;
         
         // make initial updates
         request -> iniType = MemoryRequest::CPU;
         request -> cpuID = _cpuID;
         request -> iniPtr = NULL;
-        request -> type = (MemoryRequest::Type)(type);
+        request -> type = (MemoryRequest::Type)(record.type);
 
         // normalize the addresses
         request -> ip = Normalize(request -> ip);
@@ -163,9 +344,15 @@ class TraceReader {
       // if trace ended
       else if (_wrapAround) {
         _icountShift = _lastIcount + 1;
-        // close and reopen the file
-        gzclose(_trace);
-        _trace = gzopen64(_traceFileName.c_str(), "r");
+        _lastRaw = 0;
+        _lastRawRepeat = 0;
+        // go back to the start of the trace (streams cannot go back)
+        _source -> Rewind();
+        ClearBatch();
+        if (!NextRecord(record))
+          return NULL;
+        _pending = record;
+        _hasPending = true;
         // return the next request
         return NextRequest();
       }
@@ -173,6 +360,53 @@ class TraceReader {
       // return NULL
       return NULL;
     }
+
+
+    // -------------------------------------------------------------------------
+    // Function to save or restore the position of the reader. A restored
+    // reader goes back to the record after the last one it returned; a
+    // stream is read forward up to it.
+    // -------------------------------------------------------------------------
+
+    void CheckpointState(CheckpointFile &cp) {
+      CHECKPOINT(_noTrace);
+      CHECKPOINT(_startIcount);
+      CHECKPOINT(_lastIcount);
+      CHECKPOINT(_icountShift);
+      CHECKPOINT(_first);
+      CHECKPOINT(_lastRaw);
+      CHECKPOINT(_lastRawRepeat);
+      if (!cp.Restoring() || _noTrace)
+        return;
+
+      _hasPending = false;
+      _source -> Rewind();
+      ClearBatch();
+      if (_lastRawRepeat == 0)
+        return;
+
+      TraceRecord record;
+      uint32 repeat = 0;
+      _source -> Seek(_lastRaw);
+      while (_source -> Next(record)) {
+        if (record.icount < _lastRaw)
+          continue;
+        if (record.icount == _lastRaw && repeat < _lastRawRepeat) {
+          repeat ++;
+          continue;
+        }
+        if (repeat == _lastRawRepeat) {
+          _pending = record;
+          _hasPending = true;
+        }
+        break;
+      }
+      if (repeat < _lastRawRepeat) {
+        fprintf(stderr, "Error: trace `%s' does not fit the checkpoint\n",
+            _traceFileName.c_str());
+        exit(-1);
+      }
+    }
 };
 
 #endif // __TRACE_READER_H__
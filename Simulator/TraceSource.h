@@ -0,0 +1,507 @@
+// -----------------------------------------------------------------------------
+// File: TraceSource.h
+// Description:
+//    Defines the sources the trace reader gets raw records from. Names of the
+//    form shm:<name> are streams from a producer process (see
+//    SharedTraceRing.h). Otherwise the format of a file is picked from its
+//    first bytes: binary and chunked traces start with their magic,
+//    everything else is read as text.
+// -----------------------------------------------------------------------------
+
+#ifndef __TRACE_SOURCE_H__
+#define __TRACE_SOURCE_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "Types.h"
+#include "TraceFormat.h"
+#include "ChunkedTrace.h"
+#include "SharedTraceRing.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <zlib.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+
+// -----------------------------------------------------------------------------
+// Class: TraceSource
+// Description:
+//    Abstract source of trace records
+// -----------------------------------------------------------------------------
+
+class TraceSource {
+
+  public:
+
+    virtual ~TraceSource() {}
+
+    // -------------------------------------------------------------------------
+    // Function to get the next record. Returns false at the end of the trace.
+    // -------------------------------------------------------------------------
+
+    virtual bool Next(TraceRecord &record) = 0;
+
+    // -------------------------------------------------------------------------
+    // Function to get up to the given number of records. Returns the number
+    // of records read, fewer only at the end of the trace. Sources that
+    // decode records themselves override it to avoid a call per record.
+    // -------------------------------------------------------------------------
+
+    virtual uint32 NextBatch(TraceRecord *records, uint32 count) {
+      uint32 n = 0;
+      while (n < count && Next(records[n]))
+        n ++;
+      return n;
+    }
+
+    // -------------------------------------------------------------------------
+    // Function to go back to the first record
+    // -------------------------------------------------------------------------
+
+    virtual void Rewind() = 0;
+
+    // -------------------------------------------------------------------------
+    // Function to move to the first record with an icount of at least the
+    // given one, or anywhere before it. The default goes back to the start;
+    // sources with an index jump closer.
+    // -------------------------------------------------------------------------
+
+    virtual void Seek(uint64) {
+      Rewind();
+    }
+};
+
+
+// longest line handed to the parser, as read by gzgets into 300 bytes
+#define TEXT_TRACE_MAX_LINE 299
+
+
+// -----------------------------------------------------------------------------
+// Class: TextTraceSource
+// Description:
+//    Reads a (gzip compressed) text trace, one record per line. The trace is
+//    decompressed a block at a time and lines in the documented form (six
+//    decimal fields separated by single spaces) are parsed directly from the
+//    block. Any other line is handed to sscanf as before, so the records are
+//    the same either way. Lines are split as gzgets split them.
+// -----------------------------------------------------------------------------
+
+class TextTraceSource : public TraceSource {
+
+  protected:
+
+    gzFile _trace;
+
+    // decompressed bytes not parsed yet
+    char _buffer[1 << 16];
+    uint32 _begin;
+    uint32 _end;
+    bool _eof;
+
+
+    // -------------------------------------------------------------------------
+    // Function to move the remaining bytes to the front and refill
+    // -------------------------------------------------------------------------
+
+    void Refill() {
+      memmove(_buffer, _buffer + _begin, _end - _begin);
+      _end -= _begin;
+      _begin = 0;
+      while (!_eof && _end < sizeof(_buffer)) {
+        int got = gzread(_trace, _buffer + _end, sizeof(_buffer) - _end);
+        if (got <= 0) {
+          _eof = true;
+          break;
+        }
+        _end += got;
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to parse a decimal field of at most the given number of digits
+    // (so that it cannot overflow). Returns false if there is none.
+    // -------------------------------------------------------------------------
+
+    static bool ParseField(const char *&p, const char *end, uint32 maxDigits,
+        uint64 &value) {
+      const char *start = p;
+      const char *last = (end - p > maxDigits) ? p + maxDigits : end;
+      uint64 v = 0;
+      while (p < last) {
+        uint32 digit = (uint8)*p - '0';
+        if (digit > 9) break;
+        v = v * 10 + digit;
+        p ++;
+      }
+      if (p == start || (p < end && (uint8)(*p - '0') <= 9))
+        return false;
+      value = v;
+      return true;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to parse a line in the documented form. Returns false if the
+    // line is in any other form.
+    // -------------------------------------------------------------------------
+
+    static bool ParseLine(const char *p, const char *end, TraceRecord &record) {
+      uint64 size, type;
+      if (!(ParseField(p, end, 19, record.icount) && p < end && *p ++ == ' ' &&
+            ParseField(p, end, 19, record.ip) && p < end && *p ++ == ' ' &&
+            ParseField(p, end, 19, record.virtualAddress) &&
+            p < end && *p ++ == ' ' &&
+            ParseField(p, end, 19, record.physicalAddress) &&
+            p < end && *p ++ == ' ' &&
+            ParseField(p, end, 9, size) && p < end && *p ++ == ' ' &&
+            ParseField(p, end, 9, type)))
+        return false;
+      if (p != end && !(*p == '\n' && p + 1 == end))
+        return false;
+      record.size = size;
+      record.type = type;
+      return true;
+    }
+
+    // -------------------------------------------------------------------------
+    // Function to read the next record (the calls within the source are not
+    // virtual)
+    // -------------------------------------------------------------------------
+
+    bool Read(TraceRecord &record) {
+
+      // find the next line
+      if (_end - _begin < TEXT_TRACE_MAX_LINE && !_eof)
+        Refill();
+      if (_begin == _end)
+        return false;
+
+      uint32 length = _end - _begin;
+      if (length > TEXT_TRACE_MAX_LINE)
+        length = TEXT_TRACE_MAX_LINE;
+      const char *line = _buffer + _begin;
+      const char *newline = (const char *)memchr(line, '\n', length);
+      if (newline != NULL)
+        length = newline - line + 1;
+      _begin += length;
+
+      // a parsed line sets all the fields
+      if (ParseLine(line, line + length, record))
+        return true;
+
+      // scan the line and fill the record
+      char copy[TEXT_TRACE_MAX_LINE + 1];
+      memcpy(copy, line, length);
+      copy[length] = 0;
+      memset(&record, 0, sizeof(record));
+      sscanf(copy, "%llu %llu %llu %llu %u %u", &(record.icount),
+          &(record.ip), &(record.virtualAddress),
+          &(record.physicalAddress), &(record.size),
+          &(record.type));
+      return true;
+    }
+
+  public:
+
+    TextTraceSource(gzFile trace) {
+      _trace = trace;
+      _begin = _end = 0;
+      _eof = false;
+    }
+
+    ~TextTraceSource() {
+      gzclose(_trace);
+    }
+
+    bool Next(TraceRecord &record) {
+      return Read(record);
+    }
+
+    uint32 NextBatch(TraceRecord *records, uint32 count) {
+      uint32 n = 0;
+      while (n < count && Read(records[n]))
+        n ++;
+      return n;
+    }
+
+    void Rewind() {
+      gzrewind(_trace);
+      _begin = _end = 0;
+      _eof = false;
+    }
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: BinaryTraceSource
+// Description:
+//    Reads a binary trace (see TraceFormat.h)
+// -----------------------------------------------------------------------------
+
+class BinaryTraceSource : public TraceSource {
+
+  protected:
+
+    gzFile _trace;
+    TraceHeader _header;
+    TraceDeltaCoder _coder;
+
+    // decompressed bytes not decoded yet
+    uint8 _buffer[1 << 16];
+    uint32 _begin;
+    uint32 _end;
+    bool _eof;
+
+
+    // -------------------------------------------------------------------------
+    // Function to move the remaining bytes to the front and refill
+    // -------------------------------------------------------------------------
+
+    void Refill() {
+      memmove(_buffer, _buffer + _begin, _end - _begin);
+      _end -= _begin;
+      _begin = 0;
+      while (!_eof && _end < sizeof(_buffer)) {
+        int got = gzread(_trace, _buffer + _end, sizeof(_buffer) - _end);
+        if (got <= 0) {
+          _eof = true;
+          break;
+        }
+        _end += got;
+      }
+    }
+
+    // -------------------------------------------------------------------------
+    // Function to decode the next record
+    // -------------------------------------------------------------------------
+
+    bool Read(TraceRecord &record) {
+      if (_end - _begin < TRACE_RECORD_MAX_BYTES && !_eof)
+        Refill();
+      uint32 n = _coder.Decode(_buffer + _begin, _buffer + _end, record);
+      if (n == 0) {
+        if (_begin != _end)
+          fprintf(stderr, "Warning: truncated record at the end of trace\n");
+        return false;
+      }
+      _begin += n;
+      return true;
+    }
+
+  public:
+
+    // the header has already been read from the file
+    BinaryTraceSource(gzFile trace, const TraceHeader &header) {
+      _trace = trace;
+      _header = header;
+      _begin = _end = 0;
+      _eof = false;
+    }
+
+    ~BinaryTraceSource() {
+      gzclose(_trace);
+    }
+
+    const TraceHeader &Header() {
+      return _header;
+    }
+
+    bool Next(TraceRecord &record) {
+      return Read(record);
+    }
+
+    uint32 NextBatch(TraceRecord *records, uint32 count) {
+      uint32 n = 0;
+      while (n < count && Read(records[n]))
+        n ++;
+      return n;
+    }
+
+    void Rewind() {
+      gzrewind(_trace);
+      uint8 header[TRACE_BINARY_HEADER_SIZE];
+      gzread(_trace, header, TRACE_BINARY_HEADER_SIZE);
+      _coder.Reset();
+      _begin = _end = 0;
+      _eof = false;
+    }
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: ChunkedTraceSource
+// Description:
+//    Reads a chunked trace (see ChunkedTrace.h) one frame at a time
+// -----------------------------------------------------------------------------
+
+class ChunkedTraceSource : public TraceSource {
+
+  protected:
+
+    ChunkedTraceFile *_file;
+    TraceDeltaCoder _coder;
+
+    // decoded frame
+    uint32 _frame;
+    vector <uint8> _raw;
+    uint32 _pos;
+
+
+    // -------------------------------------------------------------------------
+    // Function to load a frame
+    // -------------------------------------------------------------------------
+
+    void Load(uint32 frame) {
+      _frame = frame;
+      _pos = 0;
+      _coder.Reset();
+      _raw.clear();
+      if (frame < _file -> NumFrames() && !_file -> LoadFrame(frame, _raw)) {
+        fprintf(stderr, "Error: corrupt frame %u in chunked trace\n", frame);
+        exit(-1);
+      }
+    }
+
+  public:
+
+    // takes over the opened file
+    ChunkedTraceSource(ChunkedTraceFile *file) {
+      _file = file;
+      Load(0);
+    }
+
+    ~ChunkedTraceSource() {
+      delete _file;
+    }
+
+    bool Next(TraceRecord &record) {
+      while (_pos == _raw.size()) {
+        if (_frame >= _file -> NumFrames())
+          return false;
+        Load(_frame + 1);
+      }
+      uint32 n = _coder.Decode(&_raw[_pos], &_raw[0] + _raw.size(), record);
+      if (n == 0) {
+        fprintf(stderr, "Warning: truncated record in frame %u of chunked "
+                "trace\n", _frame);
+        return false;
+      }
+      _pos += n;
+      return true;
+    }
+
+    void Rewind() {
+      Load(0);
+    }
+
+    void Seek(uint64 icount) {
+      Load(_file -> FindFrame(icount));
+    }
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: SharedTraceSource
+// Description:
+//    Reads the stream of a producer process from a shared memory ring. A
+//    stream cannot go back, so rewinding does nothing: after the end of the
+//    stream there are no more records.
+// -----------------------------------------------------------------------------
+
+class SharedTraceSource : public TraceSource {
+
+  protected:
+
+    SharedTraceRing *_ring;
+
+  public:
+
+    // takes over the attached ring
+    SharedTraceSource(SharedTraceRing *ring) {
+      _ring = ring;
+    }
+
+    ~SharedTraceSource() {
+      delete _ring;
+    }
+
+    bool Next(TraceRecord &record) {
+      return _ring -> Get(record);
+    }
+
+    void Rewind() {
+    }
+};
+
+
+// -----------------------------------------------------------------------------
+// Function to check whether a trace name is a stream
+// -----------------------------------------------------------------------------
+
+inline bool IsTraceStream(string fileName) {
+  return fileName.compare(0, strlen(SHARED_TRACE_PREFIX),
+      SHARED_TRACE_PREFIX) == 0;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to open a trace file. Returns NULL if the file cannot be opened.
+// -----------------------------------------------------------------------------
+
+inline TraceSource *OpenTraceSource(string fileName) {
+
+  // streams from a producer process
+  if (IsTraceStream(fileName)) {
+    SharedTraceRing *ring = new SharedTraceRing();
+    if (!ring -> Attach(fileName.substr(strlen(SHARED_TRACE_PREFIX)))) {
+      fprintf(stderr, "Error: `%s' is not a trace stream\n", fileName.c_str());
+      exit(-1);
+    }
+    return new SharedTraceSource(ring);
+  }
+
+  gzFile trace = gzopen64(fileName.c_str(), "r");
+  if (trace == Z_NULL)
+    return NULL;
+
+  // check for the binary header
+  uint8 bytes[TRACE_BINARY_HEADER_SIZE];
+  int got = gzread(trace, bytes, TRACE_BINARY_HEADER_SIZE);
+  TraceHeader header;
+  if (got == TRACE_BINARY_HEADER_SIZE && header.Read(bytes)) {
+    if (header.version != TRACE_BINARY_VERSION) {
+      fprintf(stderr, "Error: trace `%s' has unknown version %u\n",
+          fileName.c_str(), header.version);
+      exit(-1);
+    }
+    return new BinaryTraceSource(trace, header);
+  }
+
+  // chunked traces are read with random access
+  if (got >= 8 && memcmp(bytes, CHUNKED_TRACE_MAGIC, 8) == 0) {
+    gzclose(trace);
+    ChunkedTraceFile *file = new ChunkedTraceFile();
+    if (!file -> Open(fileName)) {
+      fprintf(stderr, "Error: cannot read chunked trace `%s'\n",
+          fileName.c_str());
+      exit(-1);
+    }
+    return new ChunkedTraceSource(file);
+  }
+
+  gzrewind(trace);
+  return new TextTraceSource(trace);
+}
+
+#endif // __TRACE_SOURCE_H__
@@ -0,0 +1,138 @@
+// -----------------------------------------------------------------------------
+// File: TraceStream.cc
+// Description:
+//    Stand-in trace producer. Replays a trace file (in any format) into a
+//    shared memory ring, which the simulator reads with --trace-files
+//    shm:<name>. Instrumentation tools can feed the simulator the same way
+//    through SharedTraceRing.
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "TraceSource.h"
+#include "SharedTraceRing.h"
+#include "Types.h"
+
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <getopt.h>
+
+using namespace std;
+
+
+// -----------------------------------------------------------------------------
+// Function: usage
+// -----------------------------------------------------------------------------
+
+void usage(char *name) {
+  cerr << "Usage: " << name << " [--capacity <records>] [--repeat <n>] "
+       << "<trace> <name>" << endl;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function: main
+// -----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+
+  // ---------------------------------------------------------------------------
+  // Get the command line arguments
+  // ---------------------------------------------------------------------------
+
+  uint64 capacity = SHARED_TRACE_CAPACITY;
+  uint32 repeat = 1;
+
+  struct option cmd_options[] = {
+    {"capacity", required_argument, 0, 'c'},
+    {"repeat", required_argument, 0, 'r'},
+    {0, 0, 0, 0}
+  };
+
+  int c;
+  int optindex = 0;
+
+  while ((c = getopt_long(argc, argv, "c:r:", cmd_options, &optindex)) != -1) {
+
+    switch(c) {
+
+      case 'c':
+        capacity = strtoull(optarg, NULL, 10);
+        break;
+
+      case 'r':
+        repeat = atoi(optarg);
+        break;
+
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if (argc - optind != 2) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  string input = argv[optind];
+  string name = argv[optind + 1];
+
+  // ---------------------------------------------------------------------------
+  // Open the trace and create the ring
+  // ---------------------------------------------------------------------------
+
+  TraceSource *source = OpenTraceSource(input);
+  if (source == NULL) {
+    cerr << "Error: cannot open `" << input << "'" << endl;
+    return 1;
+  }
+
+  SharedTraceRing ring;
+  if (!ring.Create(name, capacity)) {
+    cerr << "Error: cannot create the ring `" << name << "' (the capacity "
+         << "must be a power of two)" << endl;
+    return 1;
+  }
+
+  // ---------------------------------------------------------------------------
+  // Replay the records. Each repetition continues after the icounts of the
+  // previous one.
+  // ---------------------------------------------------------------------------
+
+  TraceRecord record;
+  uint64 count = 0;
+  uint64 shift = 0;
+  uint64 last = 0;
+  bool consumed = true;
+
+  for (uint32 r = 0; r < repeat && consumed; r ++) {
+    while (consumed && source -> Next(record)) {
+      record.icount += shift;
+      last = record.icount;
+      consumed = ring.Put(record);
+      count += consumed;
+    }
+    shift = last + 1;
+    source -> Rewind();
+  }
+
+  ring.Close();
+  delete source;
+
+  cerr << count << " records streamed to " << name;
+  if (!consumed)
+    cerr << " (the reader has gone)";
+  cerr << endl;
+  return 0;
+}
@@ -228,7 +228,23 @@ class victim_tag_store_t {
     double false_positive_rate() {
       return _bf.false_positive_rate();
     }
-    
+
+
+    // -------------------------------------------------------------------------
+    // save or restore the victim tags
+    // -------------------------------------------------------------------------
+
+    void CheckpointState(CheckpointFile &cp) {
+      CheckpointTransfer(cp, _index);
+      CheckpointTransfer(cp, _remove);
+      _bf.CheckpointState(cp);
+      CheckpointTransfer(cp, _numCurrentBlocks);
+      CheckpointTransfer(cp, _numHits);
+      CheckpointTransfer(cp, _fifo);
+      CheckpointTransfer(cp, _sindex[0]);
+      CheckpointTransfer(cp, _sindex[1]);
+      CheckpointTransfer(cp, _cindex);
+    }
 };
 
 typedef victim_tag_store_t evicted_address_filter_t;
@@ -0,0 +1,188 @@
+// -----------------------------------------------------------------------------
+// File: WakeUpQueue.h
+// Description:
+//    Defines the wake-up queue used by the memory simulator to step only the
+//    components that have work. Each component registers the earliest cycle
+//    at which processing its pending requests can do anything. When time
+//    moves, the components due by then are stepped in the order they appear
+//    in the definition, which is the order the simulator used to poll them.
+// -----------------------------------------------------------------------------
+
+#ifndef __WAKE_UP_QUEUE_H__
+#define __WAKE_UP_QUEUE_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "Types.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <vector>
+
+using namespace std;
+
+// wake-up cycle of a component with nothing to do
+#define WAKE_UP_NEVER ((cycles_t)(-1))
+
+
+// -----------------------------------------------------------------------------
+// Class: WakeUpQueue
+// Description:
+//    Wake-up cycle of each component, and the earliest of them. A hierarchy
+//    has a handful of components, so a pass scans them in index order
+//    instead of keeping a heap: a component is stepped if its wake-up cycle
+//    is due when the scan reaches it. A component woken during the pass
+//    thus joins it if it comes after the one being stepped, and waits for
+//    the next pass otherwise. Passes with nothing due stop at the earliest
+//    wake-up cycle without scanning.
+// -----------------------------------------------------------------------------
+
+class WakeUpQueue {
+
+  protected:
+
+    // registered wake-up cycle of each component
+    vector <cycles_t> _wake;
+    // no wake-up is before this cycle
+    cycles_t _earliest;
+
+    // current pass: next component to look at
+    bool _inPass;
+    cycles_t _passCycle;
+    uint32 _cursor;
+
+    // components with a registered wake-up (position in _active per
+    // component, or _wake.size() if not active)
+    vector <uint32> _active;
+    vector <uint32> _activePos;
+
+
+    // -------------------------------------------------------------------------
+    // Function to register a wake-up cycle
+    // -------------------------------------------------------------------------
+
+    void Register(uint32 index, cycles_t cycle) {
+
+      uint32 none = _wake.size();
+
+      _wake[index] = cycle;
+      if (cycle == WAKE_UP_NEVER) {
+        if (_activePos[index] != none) {
+          uint32 last = _active.back();
+          _active[_activePos[index]] = last;
+          _activePos[last] = _activePos[index];
+          _active.pop_back();
+          _activePos[index] = none;
+        }
+        return;
+      }
+
+      if (_activePos[index] == none) {
+        _activePos[index] = _active.size();
+        _active.push_back(index);
+      }
+      if (cycle < _earliest)
+        _earliest = cycle;
+    }
+
+
+  public:
+
+    // -------------------------------------------------------------------------
+    // Constructor
+    // -------------------------------------------------------------------------
+
+    WakeUpQueue() {
+      _earliest = WAKE_UP_NEVER;
+      _inPass = false;
+      _passCycle = 0;
+      _cursor = 0;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to set the number of components
+    // -------------------------------------------------------------------------
+
+    void Resize(uint32 numComponents) {
+      _wake.assign(numComponents, WAKE_UP_NEVER);
+      _earliest = WAKE_UP_NEVER;
+      _activePos.assign(numComponents, numComponents);
+      _active.clear();
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to wake a component up by a cycle (called when a request is
+    // added to the component). Later registrations are kept as they are.
+    // -------------------------------------------------------------------------
+
+    void Wake(uint32 index, cycles_t cycle) {
+      if (cycle < _wake[index])
+        Register(index, cycle);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to replace the wake-up cycle of a component (called after the
+    // component has been stepped)
+    // -------------------------------------------------------------------------
+
+    void Reset(uint32 index, cycles_t cycle) {
+      Register(index, cycle);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Functions to step through the components due by a cycle
+    // -------------------------------------------------------------------------
+
+    void BeginPass(cycles_t now) {
+      _inPass = (_earliest <= now);
+      _passCycle = now;
+      _cursor = 0;
+    }
+
+    bool NextDue(uint32 &index) {
+      if (!_inPass)
+        return false;
+      for (; _cursor < _wake.size(); _cursor ++) {
+        if (_wake[_cursor] <= _passCycle) {
+          index = _cursor ++;
+          return true;
+        }
+      }
+
+      // the pass is over, find the earliest wake-up left
+      _inPass = false;
+      _earliest = WAKE_UP_NEVER;
+      for (uint32 i = 0; i < _active.size(); i ++)
+        if (_wake[_active[i]] < _earliest)
+          _earliest = _wake[_active[i]];
+      return false;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Components with a registered wake-up
+    // -------------------------------------------------------------------------
+
+    const vector <uint32> &Active() {
+      return _active;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Registered wake-up cycle of a component (WAKE_UP_NEVER if none)
+    // -------------------------------------------------------------------------
+
+    cycles_t Registered(uint32 index) {
+      return _wake[index];
+    }
+};
+
+#endif // __WAKE_UP_QUEUE_H__